@@ -392,7 +392,7 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
         ("show_cfg_search_space", "Show the search space as a CFG")
         ("show_cfg_alignment_space", "Show the alignment hypergraph as a CFG")
         ("show_target_graph", po::value<string>(), "Directory to write the target hypergraphs to")
-        ("incremental_search", po::value<string>(), "Run lazy search with this language model file")
+        ("incremental_search", po::value<string>(), "Run lazy search with this language model file, applying the first pass feature functions during search")
         ("coarse_to_fine_beam_prune", po::value<double>(), "Prune paths from coarse parse forest before fine parse, keeping paths within exp(alpha>=0)")
         ("ctf_beam_widen", po::value<double>()->default_value(2.0), "Expand coarse pass beam by this factor if no fine parse is found")
         ("ctf_num_widenings", po::value<int>()->default_value(2), "Widen coarse beam this many times before backing off to full parse")
@@ -680,7 +680,13 @@ DecoderImpl::DecoderImpl(po::variables_map& conf, int argc, char** argv, istream
   g_count = 0;    // number of gradient pieces computed
 
   if (conf.count("incremental_search")) {
-    incremental.reset(IncrementalBase::Load(conf["incremental_search"].as<string>().c_str(), CurrentWeightVector()));
+    // the feature functions of the first pass are applied by the search itself
+    if (rescoring_passes.empty()) {
+      incremental.reset(IncrementalBase::Load(conf["incremental_search"].as<string>().c_str(), CurrentWeightVector(), vector<const FeatureFunction*>()));
+    } else {
+      const RescoringPass& rp = rescoring_passes.front();
+      incremental.reset(IncrementalBase::Load(conf["incremental_search"].as<string>().c_str(), *rp.weight_vector, rp.ffs));
+    }
   }
 }
 
@@ -820,14 +826,31 @@ bool DecoderImpl::Decode(const string& input, DecoderObserver* o) {
   if (conf.count("show_target_graph")) {
     HypergraphIO::WriteTarget(conf["show_target_graph"].as<string>(), sent_id, forest);
   }
-  if (conf.count("incremental_search")) {
-    incremental->Search(conf["cubepruning_pop_limit"].as<unsigned>(), forest);
-  }
-  if (conf.count("show_target_graph") || conf.count("incremental_search")) {
+  if (conf.count("show_target_graph")) {
     o->NotifyDecodingComplete(smeta);
     return true;
   }
 
+  if (incremental) {
+    Timer t("Incremental search:");
+    if (!rescoring_passes.empty()) rescoring_passes.front().models->PrepareForInput(smeta);
+    Hypergraph lm_forest;
+    incremental->Search(conf["cubepruning_pop_limit"].as<unsigned>(), smeta, forest, &lm_forest);
+    if (lm_forest.edges_.empty()) {
+      if (!SILENT) { cerr << "  NO PATH FOUND.\n"; }
+      o->NotifyDecodingComplete(smeta);
+      if (conf.count("show_conditional_prob")) {
+        cout << "-Inf" << endl << flush;
+      } else if (!SILENT) {
+        cout << endl;
+      }
+      return false;
+    }
+    forest.swap(lm_forest);
+    forest.Reweight(rescoring_passes.empty() ? *init_weights : *rescoring_passes.front().weight_vector);
+    if (!SILENT) forest_stats(forest,"  Incremental forest",show_tree_structure,oracle.show_derivation);
+  }
+
   for (int pass = 0; pass < rescoring_passes.size(); ++pass) {
     const RescoringPass& rp = rescoring_passes[pass];
     const vector<weight_t>& cur_weights = *rp.weight_vector;
@@ -835,7 +858,8 @@ bool DecoderImpl::Decode(const string& input, DecoderObserver* o) {
 
     string passtr = "Pass1"; passtr[4] += pass;
     forest.Reweight(cur_weights);
-    const bool has_rescoring_models = !rp.models->empty();
+    // the incremental search has already applied the first pass's models
+    const bool has_rescoring_models = !rp.models->empty() && !(pass == 0 && incremental);
     if (has_rescoring_models) {
       Timer t("Forest rescoring:");
       rp.models->PrepareForInput(smeta);
@@ -4,9 +4,9 @@
 #include "stringlib.h"
 #include "hg.h"
 #include "sentence_metadata.h"
-#include "hash.h"
 #include "ff_const_reorder_common.h"
 
+#include <cmath>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -15,7 +15,48 @@
 using namespace std;
 using namespace const_reorder;
 
-typedef HASH_MAP<std::string, vector<double> > MapClassifier;
+// the reordering of two adjacent constituents on the target side (see
+// fnGetOutcome)
+enum ReorderOutcome {
+  kMonotone = 0,
+  kDisconMonotone,
+  kSwap,
+  kDisconSwap,
+  kNumOutcomes
+};
+
+const char* const kOutcomeLabels[kNumOutcomes] = {"M", "DM", "S", "DS"};
+
+/*
+ * log10 probabilities of the outcomes given by one classifier for every
+ * pair of adjacent constituents of a sentence, and every pair of block
+ * statuses (ids in dict_block_status_) of the two constituents. Filled when
+ * the sentence is read, so scoring an edge only looks the outcomes up.
+ */
+struct ReorderTable {
+  ReorderTable(int num_pairs, int num_status)
+      : num_status_(num_status),
+        logprob_(num_pairs * num_status * num_status * kNumOutcomes, 0.0) {}
+
+  double* Outcomes(int pair, int status1, int status2) {
+    return &logprob_[Index(pair, status1, status2)];
+  }
+
+  double LogProb(int pair, int status1, int status2, int outcome) const {
+    return logprob_[Index(pair, status1, status2) + outcome];
+  }
+
+ private:
+  size_t Index(int pair, int status1, int status2) const {
+    assert(status1 > 0 && status1 <= num_status_);
+    assert(status2 > 0 && status2 <= num_status_);
+    return ((pair * num_status_ + status1 - 1) * num_status_ + status2 - 1) *
+           kNumOutcomes;
+  }
+
+  int num_status_;
+  vector<double> logprob_;
+};
 
 inline bool is_inside(int i, int left, int right) {
   if (i < left || i > right) return false;
@@ -288,11 +329,11 @@ struct ConstReorderFeatureImpl {
     srl_sentence_ = NULL;
     focused_srl_ = NULL;
 
-    map_left_ = NULL;
-    map_right_ = NULL;
+    table_left_ = NULL;
+    table_right_ = NULL;
 
-    map_srl_left_ = NULL;
-    map_srl_right_ = NULL;
+    table_srl_left_ = NULL;
+    table_srl_right_ = NULL;
 
     dict_block_status_ = new Dict();
     dict_block_status_->Convert("Unaligned", false);
@@ -330,8 +371,6 @@ struct ConstReorderFeatureImpl {
 
       if (b_order_feature_) {
         // we can do the classifier "off-line"
-        map_left_ = new MapClassifier();
-        map_right_ = new MapClassifier();
         InitializeConstReorderClassifierOutput();
       }
     }
@@ -340,8 +379,6 @@ struct ConstReorderFeatureImpl {
       focused_srl_ = new FocusedSRL(srl_sentence_);
 
       if (b_srl_order_feature_) {
-        map_srl_left_ = new MapClassifier();
-        map_srl_right_ = new MapClassifier();
         InitializeSRLReorderClassifierOutput();
       }
     }
@@ -535,24 +572,15 @@ struct ConstReorderFeatureImpl {
           if (k < vec_node.size()) continue;
 
           // they are not covered bye the same NT
-          string outcome;
-          string key;
-          GenerateKey(pred->vec_items_[j - 1]->tree_item_,
-                      pred->vec_items_[j]->tree_item_, vecBlockStatus[j - 1],
-                      vecBlockStatus[j], key);
-
-          fnGetOutcome(vecRelativePosition[j - 1], vecRelativePosition[j],
-                       outcome);
-          double prob = CalculateConstReorderProb(srl_reorder_classifier_left_,
-                                                  map_srl_left_, key, outcome);
-          // printf("%s %s %f\n", ostr.str().c_str(), outcome.c_str(), prob);
-          logprob_srl_reorder_left += log10(prob);
-
-          fnGetOutcome(vecRelativeRightPosition[j - 1],
-                       vecRelativeRightPosition[j], outcome);
-          prob = CalculateConstReorderProb(srl_reorder_classifier_right_,
-                                           map_srl_right_, key, outcome);
-          logprob_srl_reorder_right += log10(prob);
+          int pair = srl_pair_begin_[i] + j - 1;
+          logprob_srl_reorder_left += table_srl_left_->LogProb(
+              pair, vecBlockStatus[j - 1], vecBlockStatus[j],
+              fnGetOutcome(vecRelativePosition[j - 1],
+                           vecRelativePosition[j]));
+          logprob_srl_reorder_right += table_srl_right_->LogProb(
+              pair, vecBlockStatus[j - 1], vecBlockStatus[j],
+              fnGetOutcome(vecRelativeRightPosition[j - 1],
+                           vecRelativeRightPosition[j]));
         }
       }
 
@@ -668,23 +696,15 @@ struct ConstReorderFeatureImpl {
           if (k < vec_node.size()) continue;
 
           // they are not covered bye the same NT
-          string outcome;
-          string key;
-          GenerateKey(parent->m_vecChildren[j - 1], parent->m_vecChildren[j],
-                      vecChunkBlock[j - 1], vecChunkBlock[j], key);
-
-          fnGetOutcome(vecRelativePosition[j - 1], vecRelativePosition[j],
-                       outcome);
-          double prob = CalculateConstReorderProb(
-              const_reorder_classifier_left_, map_left_, key, outcome);
-          // printf("%s %s %f\n", ostr.str().c_str(), outcome.c_str(), prob);
-          logprob_const_reorder_left += log10(prob);
-
-          fnGetOutcome(vecRelativeRightPosition[j - 1],
-                       vecRelativeRightPosition[j], outcome);
-          prob = CalculateConstReorderProb(const_reorder_classifier_right_,
-                                           map_right_, key, outcome);
-          logprob_const_reorder_right += log10(prob);
+          int pair = const_pair_begin_[i] + j - 1;
+          logprob_const_reorder_left += table_left_->LogProb(
+              pair, vecChunkBlock[j - 1], vecChunkBlock[j],
+              fnGetOutcome(vecRelativePosition[j - 1],
+                           vecRelativePosition[j]));
+          logprob_const_reorder_right += table_right_->LogProb(
+              pair, vecChunkBlock[j - 1], vecChunkBlock[j],
+              fnGetOutcome(vecRelativeRightPosition[j - 1],
+                           vecRelativeRightPosition[j]));
         }
       }
 
@@ -700,29 +720,51 @@ struct ConstReorderFeatureImpl {
   }
 
  private:
-  void Byte_to_Char(unsigned char* str, int n) {
-    str[0] = (n & 255);
-    str[1] = n / 256;
+  // evaluates both classifiers on the features in ostr, filling the
+  // outcomes of pair under block statuses status1 and status2
+  void FillReorderTables(const Tsuruoka_Maxent* classifier_left,
+                         const Tsuruoka_Maxent* classifier_right,
+                         const ostringstream& ostr, int pair, int status1,
+                         int status2, ReorderTable* table_left,
+                         ReorderTable* table_right) {
+    vector<int> vecFeatures;
+    vector<double> vecOutput;
+
+    classifier_left->fnGetFeatureIds(ostr.str().c_str(), vecFeatures);
+    classifier_left->fnEval(vecFeatures, vecOutput);
+    SetOutcomes(classifier_left, vecOutput,
+                table_left->Outcomes(pair, status1, status2));
+
+    classifier_right->fnGetFeatureIds(ostr.str().c_str(), vecFeatures);
+    classifier_right->fnEval(vecFeatures, vecOutput);
+    SetOutcomes(classifier_right, vecOutput,
+                table_right->Outcomes(pair, status1, status2));
   }
-  void GenerateKey(const STreeItem* pCon1, const STreeItem* pCon2,
-                   int iBlockStatus1, int iBlockStatus2, string& key) {
-    assert(iBlockStatus1 != 0);
-    assert(iBlockStatus2 != 0);
-    unsigned char szTerm[1001];
-    Byte_to_Char(szTerm, pCon1->m_iBegin);
-    Byte_to_Char(szTerm + 2, pCon2->m_iEnd);
-    szTerm[4] = (char)iBlockStatus1;
-    szTerm[5] = (char)iBlockStatus2;
-    szTerm[6] = '\0';
-    // sprintf(szTerm, "%d|%d|%d|%d|%s|%s", pCon1->m_iBegin, pCon1->m_iEnd,
-    // pCon2->m_iBegin, pCon2->m_iEnd, strBlockStatus1.c_str(),
-    // strBlockStatus2.c_str());
-    key = string(szTerm, szTerm + 6);
+
+  void SetOutcomes(const Tsuruoka_Maxent* classifier,
+                   const vector<double>& vecOutput, double* logprob) {
+    for (int o = 0; o < kNumOutcomes; o++) {
+      int id = classifier->fnGetClassId(kOutcomeLabels[o]);
+      assert(id >= 0);
+      logprob[o] = log10(vecOutput[id]);
+    }
   }
+
   void InitializeConstReorderClassifierOutput() {
     if (!b_order_feature_) return;
     int size_block_status = dict_block_status_->max();
 
+    const_pair_begin_.clear();
+    int num_pairs = 0;
+    for (size_t i = 0; i < focused_consts_->focus_parents_.size(); i++) {
+      const_pair_begin_.push_back(num_pairs);
+      size_t num_children =
+          focused_consts_->focus_parents_[i]->m_vecChildren.size();
+      if (num_children > 1) num_pairs += num_children - 1;
+    }
+    table_left_ = new ReorderTable(num_pairs, size_block_status);
+    table_right_ = new ReorderTable(num_pairs, size_block_status);
+
     for (size_t i = 0; i < focused_consts_->focus_parents_.size(); i++) {
       STreeItem* parent = focused_consts_->focus_parents_[i];
 
@@ -734,18 +776,10 @@ struct ConstReorderFeatureImpl {
                             dict_block_status_->Convert(k),
                             dict_block_status_->Convert(l), ostr);
 
-            string strKey;
-            GenerateKey(parent->m_vecChildren[j - 1], parent->m_vecChildren[j],
-                        k, l, strKey);
-
-            vector<double> vecOutput;
-            const_reorder_classifier_left_->fnEval(ostr.str().c_str(),
-                                                   vecOutput);
-            (*map_left_)[strKey] = vecOutput;
-
-            const_reorder_classifier_right_->fnEval(ostr.str().c_str(),
-                                                    vecOutput);
-            (*map_right_)[strKey] = vecOutput;
+            FillReorderTables(const_reorder_classifier_left_,
+                              const_reorder_classifier_right_, ostr,
+                              const_pair_begin_[i] + j - 1, k, l, table_left_,
+                              table_right_);
           }
         }
       }
@@ -756,6 +790,16 @@ struct ConstReorderFeatureImpl {
     if (!b_srl_order_feature_) return;
     int size_block_status = dict_block_status_->max();
 
+    srl_pair_begin_.clear();
+    int num_pairs = 0;
+    for (size_t i = 0; i < focused_srl_->focus_predicates_.size(); i++) {
+      srl_pair_begin_.push_back(num_pairs);
+      size_t num_items = focused_srl_->focus_predicates_[i]->vec_items_.size();
+      if (num_items > 1) num_pairs += num_items - 1;
+    }
+    table_srl_left_ = new ReorderTable(num_pairs, size_block_status);
+    table_srl_right_ = new ReorderTable(num_pairs, size_block_status);
+
     for (size_t i = 0; i < focused_srl_->focus_predicates_.size(); i++) {
       const FocusedPredicate* pred = focused_srl_->focus_predicates_[i];
 
@@ -769,32 +813,16 @@ struct ConstReorderFeatureImpl {
                 dict_block_status_->Convert(k), dict_block_status_->Convert(l),
                 ostr);
 
-            string strKey;
-            GenerateKey(pred->vec_items_[j - 1]->tree_item_,
-                        pred->vec_items_[j]->tree_item_, k, l, strKey);
-
-            vector<double> vecOutput;
-            srl_reorder_classifier_left_->fnEval(ostr.str().c_str(), vecOutput);
-            (*map_srl_left_)[strKey] = vecOutput;
-
-            srl_reorder_classifier_right_->fnEval(ostr.str().c_str(),
-                                                  vecOutput);
-            (*map_srl_right_)[strKey] = vecOutput;
+            FillReorderTables(srl_reorder_classifier_left_,
+                              srl_reorder_classifier_right_, ostr,
+                              srl_pair_begin_[i] + j - 1, k, l,
+                              table_srl_left_, table_srl_right_);
           }
         }
       }
     }
   }
 
-  double CalculateConstReorderProb(
-      const Tsuruoka_Maxent* const_reorder_classifier, const MapClassifier* map,
-      const string& key, const string& outcome) {
-    MapClassifier::const_iterator iter = (*map).find(key);
-    assert(iter != map->end());
-    int id = const_reorder_classifier->fnGetClassId(outcome);
-    return iter->second[id];
-  }
-
   void FreeSentenceVariables() {
     if (srl_sentence_ != NULL) {
       delete srl_sentence_;
@@ -811,15 +839,15 @@ struct ConstReorderFeatureImpl {
       delete vec_target_tran_[i];
     vec_target_tran_.clear();
 
-    if (map_left_ != NULL) delete map_left_;
-    map_left_ = NULL;
-    if (map_right_ != NULL) delete map_right_;
-    map_right_ = NULL;
+    if (table_left_ != NULL) delete table_left_;
+    table_left_ = NULL;
+    if (table_right_ != NULL) delete table_right_;
+    table_right_ = NULL;
 
-    if (map_srl_left_ != NULL) delete map_srl_left_;
-    map_srl_left_ = NULL;
-    if (map_srl_right_ != NULL) delete map_srl_right_;
-    map_srl_right_ = NULL;
+    if (table_srl_left_ != NULL) delete table_srl_left_;
+    table_srl_left_ = NULL;
+    if (table_srl_right_ != NULL) delete table_srl_right_;
+    table_srl_right_ = NULL;
   }
 
   void InitializeClassifier(const char* pszFname,
@@ -938,18 +966,18 @@ struct ConstReorderFeatureImpl {
     }
   }
 
-  inline void fnGetOutcome(int i1, int i2, string& strOutcome) {
+  inline int fnGetOutcome(int i1, int i2) {
     assert(i1 != i2);
     if (i1 < i2) {
       if (i2 > i1 + 1)
-        strOutcome = string("DM");
+        return kDisconMonotone;
       else
-        strOutcome = string("M");
+        return kMonotone;
     } else {
       if (i1 > i2 + 1)
-        strOutcome = string("DS");
+        return kDisconSwap;
       else
-        strOutcome = string("S");
+        return kSwap;
     }
   }
 
@@ -1037,11 +1065,16 @@ struct ConstReorderFeatureImpl {
   Tsuruoka_Maxent* srl_reorder_classifier_left_;
   Tsuruoka_Maxent* srl_reorder_classifier_right_;
 
-  MapClassifier* map_left_;
-  MapClassifier* map_right_;
+  // outcomes of the adjacent children of focus parent i start at
+  // const_pair_begin_[i] in the tables, those of the arguments of focus
+  // predicate i at srl_pair_begin_[i]
+  ReorderTable* table_left_;
+  ReorderTable* table_right_;
+  vector<int> const_pair_begin_;
 
-  MapClassifier* map_srl_left_;
-  MapClassifier* map_srl_right_;
+  ReorderTable* table_srl_left_;
+  ReorderTable* table_srl_right_;
+  vector<int> srl_pair_begin_;
 
   SParsedTree* parsed_tree_;
   FocusedConstituent* focused_consts_;
@@ -1083,11 +1083,15 @@ struct Tsuruoka_Maxent {
     if (pszModelFName != NULL) {
       m_pModel = new maxent::ME_Model();
       m_pModel->load_from_file(pszModelFName);
-    } else
+      m_pCompiled = new maxent::ME_CompiledModel(*m_pModel);
+    } else {
       m_pModel = NULL;
+      m_pCompiled = NULL;
+    }
   }
 
   ~Tsuruoka_Maxent() {
+    if (m_pCompiled != NULL) delete m_pCompiled;
     if (m_pModel != NULL) delete m_pModel;
   }
 
@@ -1112,8 +1116,27 @@ struct Tsuruoka_Maxent {
     return m_pModel->get_class_id(strLabel);
   }
 
+  // the ids of the whitespace separated features in pszContext, for
+  // fnEval(vecFeatures, ...)
+  void fnGetFeatureIds(const char* pszContext,
+                       std::vector<int>& vecFeatures) const {
+    std::vector<std::string> vecContext;
+    SplitOnWhitespace(std::string(pszContext), &vecContext);
+
+    vecFeatures.clear();
+    for (size_t i = 0; i < vecContext.size(); i++) {
+      int id = m_pCompiled->feature_id(vecContext[i]);
+      if (id >= 0) vecFeatures.push_back(id);
+    }
+  }
+  void fnEval(const std::vector<int>& vecFeatures,
+              std::vector<double>& vecOutput) const {
+    m_pCompiled->classify(vecFeatures, vecOutput);
+  }
+
  private:
   maxent::ME_Model* m_pModel;
+  maxent::ME_CompiledModel* m_pCompiled;
 };
 
 // an argument item or a predicate item (the verb itself)
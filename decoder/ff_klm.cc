@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <iostream>
 
+#include <boost/functional/hash.hpp>
 #include <boost/scoped_ptr.hpp>
 
 #include "filelib.h"
@@ -20,11 +21,15 @@ using namespace std;
 
 // -x : rules include <s> and </s>
 // -n NAME : feature id is NAME
-bool ParseLMArgs(string const& in, string* filename, string* mapfile, bool* explicit_markers, string* featname) {
+// -c SIZE : cache the scores of SIZE terminal prefixes (0 disables the cache).
+//           The cache is updated while edges are scored, so a KLanguageModel
+//           with a cache must not be used from several threads at once.
+bool ParseLMArgs(string const& in, string* filename, string* mapfile, bool* explicit_markers, string* featname, unsigned* cache_size) {
   vector<string> const& argv=SplitOnWhitespace(in);
   *explicit_markers = false;
   *featname="LanguageModel";
   *mapfile = "";
+  *cache_size = 65536;
 #define LMSPEC_NEXTARG if (i==argv.end()) {            \
     cerr << "Missing argument for "<<*last<<". "; goto usage; \
     } else { ++i; }
@@ -43,6 +48,9 @@ bool ParseLMArgs(string const& in, string* filename, string* mapfile, bool* expl
       case 'n':
         LMSPEC_NEXTARG; *featname=*i;
         break;
+      case 'c':
+        LMSPEC_NEXTARG; *cache_size=atoi(i->c_str());
+        break;
 #undef LMSPEC_NEXTARG
       default:
       fail:
@@ -138,6 +146,22 @@ template <class Model> class BoundaryRuleScore {
       return penalty_ + back_.Finish();
     }
 
+    // Finishes a prefix of the rule, keeping the penalty separate so that the
+    // rest of the rule can be scored later with Resume.
+    float FinishPrefix(float *penalty) {
+      *penalty = penalty_;
+      return back_.Finish();
+    }
+
+    // Continues after a prefix scored with FinishPrefix, as if its words had
+    // just been passed to Terminal.
+    void Resume(const BoundaryAnnotatedState &prefix, float prob, float penalty) {
+      back_.BeginNonTerminal(prefix.state, prob);
+      bos_ = prefix.seen_bos;
+      eos_ = prefix.seen_eos;
+      penalty_ = penalty;
+    }
+
   private:
     lm::ngram::RuleScore<Model> back_;
     bool &bos_, &eos_;
@@ -149,14 +173,48 @@ template <class Model> class BoundaryRuleScore {
 
 } // namespace
 
+// Score of the terminals preceding the first nonterminal of a rule's target
+// side.  It does not depend on the antecedents, so it is the same for every
+// edge (in every sentence) whose rule starts with the same words.
+struct TerminalPrefix {
+  vector<WordID> words;
+  BoundaryAnnotatedState state;
+  float prob;
+  float penalty;
+  double oovs;
+  double emit;
+  // false if the rest of a rule cannot be scored from the state alone (see
+  // ScorePrefix)
+  bool resumable;
+};
+
 template <class Model>
 class KLanguageModelImpl {
  public:
   double LookupWords(const TRule& rule, const vector<const void*>& ant_states, double* oovs, double* emit, void* remnant) {
+    const vector<WordID>& e = rule.e();
+    BoundaryAnnotatedState& out_state = *static_cast<BoundaryAnnotatedState*>(remnant);
+    unsigned prefix_len = 0;
+    if (!prefix_cache_.empty())
+      while (prefix_len < e.size() && e[prefix_len] > 0) ++prefix_len;
+    if (prefix_len) {
+      const TerminalPrefix& prefix = LookupPrefix(e, prefix_len);
+      if (prefix_len == e.size() || prefix.resumable) {
+        *oovs = prefix.oovs;
+        *emit = prefix.emit;
+        if (prefix_len == e.size()) {  // no nonterminals
+          out_state = prefix.state;
+          return prefix.penalty + prefix.prob;
+        }
+        BoundaryRuleScore<Model> ruleScore(*ngram_, out_state);
+        ruleScore.Resume(prefix.state, prefix.prob, prefix.penalty);
+        return ScoreWords(e, prefix_len, ant_states, ruleScore, oovs, emit, out_state);
+      }
+    }
+
     *oovs = 0;
     *emit = 0;
-    const vector<WordID>& e = rule.e();
-    BoundaryRuleScore<Model> ruleScore(*ngram_, *static_cast<BoundaryAnnotatedState*>(remnant));
+    BoundaryRuleScore<Model> ruleScore(*ngram_, out_state);
     unsigned i = 0;
     if (e.size()) {
       if (e[i] == kCDEC_SOS) {
@@ -167,23 +225,64 @@ class KLanguageModelImpl {
         ++i;
       }
     }
+    return ScoreWords(e, i, ant_states, ruleScore, oovs, emit, out_state);
+  }
+
+  // scores the target words of a rule from position i onwards
+  double ScoreWords(const vector<WordID>& e, unsigned i, const vector<const void*>& ant_states, BoundaryRuleScore<Model>& ruleScore, double* oovs, double* emit, BoundaryAnnotatedState& out_state) {
     for (; i < e.size(); ++i) {
       if (e[i] <= 0) {
         ruleScore.NonTerminal(*static_cast<const BoundaryAnnotatedState*>(ant_states[-e[i]]));
       } else {
-        float ep = 0.f;
-        const WordID cdec_word_or_class = ClassifyWordIfNecessary(e[i], &ep);
-        if (ep) { *emit += ep; }
-        const lm::WordIndex cur_word = MapWord(cdec_word_or_class); // map to LM's id
-        if (cur_word == 0) (*oovs) += 1.0;
-        ruleScore.Terminal(cur_word);
+        ScoreTerminal(e[i], ruleScore, oovs, emit);
       }
     }
     double ret = ruleScore.Finish();
-    static_cast<BoundaryAnnotatedState*>(remnant)->state.ZeroRemaining();
+    out_state.state.ZeroRemaining();
     return ret;
   }
 
+  void ScoreTerminal(WordID w, BoundaryRuleScore<Model>& ruleScore, double* oovs, double* emit) {
+    float ep = 0.f;
+    const WordID cdec_word_or_class = ClassifyWordIfNecessary(w, &ep);
+    if (ep) { *emit += ep; }
+    const lm::WordIndex cur_word = MapWord(cdec_word_or_class); // map to LM's id
+    if (cur_word == 0) (*oovs) += 1.0;
+    ruleScore.Terminal(cur_word);
+  }
+
+  // returns the score of the first len (terminal) words of e, from the cache
+  // if possible.  the cache is direct mapped: a prefix replaces any other
+  // prefix with the same hash slot.
+  const TerminalPrefix& LookupPrefix(const vector<WordID>& e, unsigned len) {
+    TerminalPrefix& prefix = prefix_cache_[boost::hash_range(e.begin(), e.begin() + len) % prefix_cache_.size()];
+    if (prefix.words.size() != len || !equal(e.begin(), e.begin() + len, prefix.words.begin())) {
+      prefix.words.assign(e.begin(), e.begin() + len);
+      ScorePrefix(&prefix);
+    }
+    return prefix;
+  }
+
+  void ScorePrefix(TerminalPrefix* prefix) {
+    const vector<WordID>& e = prefix->words;
+    prefix->oovs = 0;
+    prefix->emit = 0;
+    BoundaryRuleScore<Model> ruleScore(*ngram_, prefix->state);
+    unsigned i = 0;
+    if (e[i] == kCDEC_SOS) {
+      ++i;
+      ruleScore.BeginSentence();
+    }
+    for (; i < e.size(); ++i)
+      ScoreTerminal(e[i], ruleScore, &prefix->oovs, &prefix->emit);
+    prefix->prob = ruleScore.FinishPrefix(&prefix->penalty);
+    // Resuming treats a left state with order-1 words as complete, which is
+    // what RuleScore would do next only if no word extended further left,
+    // and the state does not tell.
+    prefix->resumable = prefix->state.state.left.length < order_ - 1;
+    prefix->state.state.ZeroRemaining();
+  }
+
   // this assumes no target words on final unary -> goal rule.  is that ok?
   // for <s> (n-1 left words) and (n-1 right words) </s>
   double FinalTraversalCost(const void* state_void, double* oovs) {
@@ -228,10 +327,11 @@ class KLanguageModelImpl {
   }
 
  public:
-  KLanguageModelImpl(const string& filename, const string& mapfile, bool explicit_markers) :
+  KLanguageModelImpl(const string& filename, const string& mapfile, bool explicit_markers, unsigned cache_size) :
       kCDEC_UNK(TD::Convert("<unk>")) ,
       kCDEC_SOS(TD::Convert("<s>")) ,
-      add_sos_eos_(!explicit_markers) {
+      add_sos_eos_(!explicit_markers) ,
+      prefix_cache_(cache_size) {
     {
       VMapper vm(&cdec2klm_map_);
       lm::ngram::Config conf;
@@ -313,17 +413,21 @@ class KLanguageModelImpl {
   vector<pair<WordID,float> > word2class_map_; // if this is a class-based LM,
           // .first is the word->class mapping
           // .second is the emission log probability
+  // indexed by the hash of the words.  it is filled in by the const
+  // TraversalFeaturesImpl, so scoring is not thread-safe unless it is empty.
+  vector<TerminalPrefix> prefix_cache_;
 };
 
 template <class Model>
 KLanguageModel<Model>::KLanguageModel(const string& param) {
   string filename, mapfile, featname;
   bool explicit_markers;
-  if (!ParseLMArgs(param, &filename, &mapfile, &explicit_markers, &featname)) {
+  unsigned cache_size;
+  if (!ParseLMArgs(param, &filename, &mapfile, &explicit_markers, &featname, &cache_size)) {
     abort();
   }
   try {
-    pimpl_ = new KLanguageModelImpl<Model>(filename, mapfile, explicit_markers);
+    pimpl_ = new KLanguageModelImpl<Model>(filename, mapfile, explicit_markers, cache_size);
   } catch (std::exception &e) {
     std::cerr << e.what() << std::endl;
     abort();
@@ -376,7 +480,8 @@ boost::shared_ptr<FeatureFunction> KLanguageModelFactory::Create(std::string par
   std::string filename, ignored_map;
   bool ignored_markers;
   std::string ignored_featname;
-  ParseLMArgs(param, &filename, &ignored_map, &ignored_markers, &ignored_featname);
+  unsigned ignored_cache_size;
+  ParseLMArgs(param, &filename, &ignored_map, &ignored_markers, &ignored_featname, &ignored_cache_size);
   ModelType m;
   if (!RecognizeBinary(filename.c_str(), m)) m = HASH_PROBING;
 
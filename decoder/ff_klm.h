@@ -11,6 +11,8 @@ template <class Model> class KLanguageModelImpl;
 
 // the supported template types are instantiated explicitly
 // in ff_klm.cc.
+// not thread-safe: the scores of rule prefixes are cached (see -c in
+// ff_klm.cc) while edges are scored, so use one instance per thread or -c 0.
 template <class Model>
 class KLanguageModel : public FeatureFunction {
  public:
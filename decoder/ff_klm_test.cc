@@ -0,0 +1,115 @@
+#define BOOST_TEST_MODULE KLanguageModelTest
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ff_klm.h"
+#include "hg.h"
+#include "lattice.h"
+#include "sentence_metadata.h"
+#include "trule.h"
+
+using namespace std;
+
+namespace {
+
+string TestData() {
+  return boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA;
+}
+
+typedef vector<char> State;
+
+struct Scored {
+  SparseVector<double> features;
+  State state;
+};
+
+// scores rule over the antecedent states with ff
+Scored ScoreEdge(const FeatureFunction& ff, const TRulePtr& rule, const vector<const State*>& ants) {
+  static const Lattice no_ref;
+  static const SentenceMetadata smeta(0, no_ref);
+  HG::Edge edge;
+  edge.rule_ = rule;
+  vector<const void*> ant_states;
+  for (unsigned i = 0; i < ants.size(); ++i)
+    ant_states.push_back(&(*ants[i])[0]);
+  Scored out;
+  out.state.resize(ff.StateSize());
+  SparseVector<double> estimated;
+  ff.TraversalFeatures(smeta, edge, ant_states, &out.features, &estimated, &out.state[0]);
+  return out;
+}
+
+void CheckSame(const Scored& expected, const Scored& actual) {
+  BOOST_CHECK_EQUAL(expected.features.size(), actual.features.size());
+  for (SparseVector<double>::const_iterator it = expected.features.begin(); it != expected.features.end(); ++it)
+    BOOST_CHECK_EQUAL(it->second, actual.features.value(it->first));
+  BOOST_REQUIRE_EQUAL(expected.state.size(), actual.state.size());
+  BOOST_CHECK(memcmp(&expected.state[0], &actual.state[0], expected.state.size()) == 0);
+}
+
+}  // namespace
+
+// The prefix cache only saves work: the scores and states of the same edges
+// are the same with the cache disabled, at the default size and with a
+// single slot that keeps being replaced.
+BOOST_AUTO_TEST_CASE(TestPrefixCacheDoesNotChangeScores) {
+  const string lm = TestData() + "/dummy.3gram.lm";
+  KLanguageModelFactory factory;
+  vector<boost::shared_ptr<FeatureFunction> > ffs;
+  ffs.push_back(factory.Create("-c 0 " + lm));
+  ffs.push_back(factory.Create(lm));
+  ffs.push_back(factory.Create("-c 1 " + lm));
+
+  // terminal prefixes shorter and not shorter than the order - 1, unknown
+  // words and rules starting with a nonterminal
+  vector<TRulePtr> leaves;
+  leaves.push_back(TRulePtr(new TRule("[X] ||| a ||| control ! as ||| 0")));
+  leaves.push_back(TRulePtr(new TRule("[X] ||| b ||| ( and ||| 0")));
+  leaves.push_back(TRulePtr(new TRule("[X] ||| c ||| zzz ||| 0")));
+  leaves.push_back(TRulePtr(new TRule("[X] ||| d ||| the ||| 0")));
+  vector<TRulePtr> binary;
+  binary.push_back(TRulePtr(new TRule("[X] ||| [X,1] e [X,2] ||| ( in [1] the [2] . ||| 0")));
+  binary.push_back(TRulePtr(new TRule("[X] ||| [X,1] f [X,2] ||| ! [2] , [1] ||| 0")));
+  binary.push_back(TRulePtr(new TRule("[X] ||| [X,1] g [X,2] ||| [1] instead [2] ||| 0")));
+  binary.push_back(TRulePtr(new TRule("[X] ||| [X,1] h [X,2] ||| zzz [1] a [2] ||| 0")));
+  binary.push_back(TRulePtr(new TRule("[X] ||| [X,1] i [X,2] ||| \" [2] [1] ||| 0")));
+
+  // scored[f] has the scores of every edge by ffs[f], in the same order
+  vector<vector<Scored> > scored(ffs.size());
+  for (unsigned f = 0; f < ffs.size(); ++f) {
+    const FeatureFunction& ff = *ffs[f];
+    vector<Scored> states;
+    const vector<const State*> none;
+    for (unsigned i = 0; i < leaves.size(); ++i)
+      states.push_back(ScoreEdge(ff, leaves[i], none));
+    // two levels of binary rules, so the same prefixes are looked up with
+    // many different antecedents
+    for (unsigned level = 0; level < 2; ++level) {
+      const unsigned n = states.size();
+      for (unsigned r = 0; r < binary.size(); ++r) {
+        for (unsigned a = 0; a < n; ++a) {
+          vector<const State*> ants(2);
+          ants[0] = &states[a].state;
+          ants[1] = &states[(a * 7 + r) % n].state;
+          scored[f].push_back(ScoreEdge(ff, binary[r], ants));
+        }
+      }
+      states.insert(states.end(), scored[f].end() - binary.size() * n, scored[f].end());
+    }
+    // score the leaves again, now from the cache
+    for (unsigned i = 0; i < leaves.size(); ++i) {
+      scored[f].push_back(states[i]);
+      scored[f].push_back(ScoreEdge(ff, leaves[i], none));
+    }
+  }
+
+  BOOST_CHECK(scored[0].size() > 100);
+  for (unsigned f = 1; f < ffs.size(); ++f) {
+    BOOST_REQUIRE_EQUAL(scored[0].size(), scored[f].size());
+    for (unsigned i = 0; i < scored[0].size(); ++i)
+      CheckSame(scored[0][i], scored[f][i]);
+  }
+}
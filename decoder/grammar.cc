@@ -1,6 +1,8 @@
 #include "grammar.h"
 
 #include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <utility>
 #include <map>
 #ifndef HAVE_OLD_CPP
@@ -14,6 +16,7 @@ namespace std { using std::tr1::unordered_map; using std::tr1::unordered_set; }
 
 #include "rule_lexer.h"
 #include "filelib.h"
+#include "fdict.h"
 #include "tdict.h"
 
 using namespace std;
@@ -119,13 +122,147 @@ static void AddRuleHelper(const TRulePtr& new_rule, const unsigned int ctf_level
   static_cast<TextGrammar*>(extra)->AddRule(new_rule, ctf_level, coarse_rule);
 }
 
+// Binary grammars (written by extractor::Grammar::WriteBinary) start with a
+// NUL byte, which can never start a text grammar. All values are in native
+// byte order:
+//   magic "\0cdecgrm", uint32 version
+//   uint32 #symbols, then for each symbol: uint32 length, characters
+//   uint32 #features, then for each feature name: uint32 length, characters
+//   uint32 #rules, then for each rule:
+//     int32 lhs (symbol index of the category)
+//     uint16 |f|, uint16 |e|, uint16 #features, uint16 #alignment points
+//     int32 f[|f|]: symbol index for terminals, -1-index of the category for
+//                   nonterminals
+//     int32 e[|e|]: symbol index for terminals, -k for the k-th nonterminal
+//     uint16 feature indexes, float values
+//     int16 (source, target) alignment points
+// Symbols and feature names are converted to ids once per grammar.
+static const char kBinaryGrammarMagic[] = "\0cdecgrm";
+static const int kBinaryGrammarMagicSize = 8;
+static const uint32_t kBinaryGrammarVersion = 1;
+
+namespace {
+
+struct BinaryGrammarReader {
+  BinaryGrammarReader(const string& data, const string& fname) :
+      data_(data), pos_(0), fname_(fname) {}
+
+  template <typename T> T Read() {
+    T value;
+    ReadArray(&value, 1);
+    return value;
+  }
+
+  template <typename T> void ReadArray(T* values, size_t n) {
+    const size_t size = n * sizeof(T);
+    if (pos_ + size > data_.size()) {
+      cerr << "Truncated binary grammar " << fname_ << endl;
+      abort();
+    }
+    memcpy(values, data_.data() + pos_, size);
+    pos_ += size;
+  }
+
+  string ReadString() {
+    const uint32_t size = Read<uint32_t>();
+    string s(size, '\0');
+    ReadArray(&s[0], size);
+    return s;
+  }
+
+  const string& data_;
+  size_t pos_;
+  const string& fname_;
+};
+
+}  // namespace
+
+static void ReadBinaryRules(istream* in, RuleLexer::RuleCallback func, const string& fname, void* extra) {
+  const string data((istreambuf_iterator<char>(*in)), istreambuf_iterator<char>());
+  BinaryGrammarReader reader(data, fname);
+  char magic[kBinaryGrammarMagicSize];
+  reader.ReadArray(magic, kBinaryGrammarMagicSize);
+  if (memcmp(magic, kBinaryGrammarMagic, kBinaryGrammarMagicSize) != 0 ||
+      reader.Read<uint32_t>() != kBinaryGrammarVersion) {
+    cerr << "Unsupported binary grammar " << fname << endl;
+    abort();
+  }
+
+  vector<WordID> symbols(reader.Read<uint32_t>());
+  for (unsigned i = 0; i < symbols.size(); ++i)
+    symbols[i] = TD::Convert(reader.ReadString());
+  vector<int> features(reader.Read<uint32_t>());
+  for (unsigned i = 0; i < features.size(); ++i) {
+    const string feature_name = reader.ReadString();
+    features[i] = FD::Convert(feature_name);
+    if (features[i] < 1) {
+      cerr << "\nUNWEIGHED FEATURE " << feature_name << endl;
+      abort();
+    }
+  }
+
+  const uint32_t num_rules = reader.Read<uint32_t>();
+  vector<int32_t> f, e;
+  vector<WordID> src, trg;
+  vector<uint16_t> feat_indexes;
+  vector<float> feat_vals;
+  vector<int> feat_ids;
+  vector<double> feat_dvals;
+  vector<int16_t> links;
+  vector<AlignmentPoint> als;
+  for (uint32_t r = 0; r < num_rules; ++r) {
+    const WordID lhs = -symbols.at(reader.Read<int32_t>());
+    f.resize(reader.Read<uint16_t>());
+    e.resize(reader.Read<uint16_t>());
+    feat_indexes.resize(reader.Read<uint16_t>());
+    links.resize(2 * reader.Read<uint16_t>());
+    reader.ReadArray(f.data(), f.size());
+    reader.ReadArray(e.data(), e.size());
+    reader.ReadArray(feat_indexes.data(), feat_indexes.size());
+    feat_vals.resize(feat_indexes.size());
+    reader.ReadArray(feat_vals.data(), feat_vals.size());
+    reader.ReadArray(links.data(), links.size());
+
+    int arity = 0;
+    src.resize(f.size());
+    for (unsigned i = 0; i < f.size(); ++i) {
+      if (f[i] < 0) {
+        src[i] = -symbols.at(-1 - f[i]);
+        ++arity;
+      } else {
+        src[i] = symbols.at(f[i]);
+      }
+    }
+    trg.resize(e.size());
+    for (unsigned i = 0; i < e.size(); ++i)
+      trg[i] = e[i] < 0 ? 1 + e[i] : symbols.at(e[i]);
+    feat_ids.resize(feat_indexes.size());
+    feat_dvals.resize(feat_indexes.size());
+    for (unsigned i = 0; i < feat_indexes.size(); ++i) {
+      feat_ids[i] = features.at(feat_indexes[i]);
+      feat_dvals[i] = feat_vals[i];
+    }
+    als.resize(links.size() / 2);
+    for (unsigned i = 0; i < als.size(); ++i)
+      als[i] = AlignmentPoint(links[2 * i], links[2 * i + 1]);
+
+    TRulePtr rule(new TRule(lhs, src.data(), src.size(), trg.data(), trg.size(),
+                            feat_ids.data(), feat_dvals.data(), feat_ids.size(),
+                            arity, als.data(), als.size()));
+    func(rule, 0, TRulePtr(), extra);
+  }
+}
+
 void TextGrammar::ReadFromFile(const string& filename) {
   ReadFile in(filename);
-  RuleLexer::ReadRules(in.stream(), &AddRuleHelper, filename, this);
+  ReadFromStream(in.stream(), filename);
 }
 
-void TextGrammar::ReadFromStream(istream* in) {
-  RuleLexer::ReadRules(in, &AddRuleHelper, "UNKNOWN", this);
+void TextGrammar::ReadFromStream(istream* in, const string& name) {
+  if (in->peek() == '\0')
+    ReadBinaryRules(in, &AddRuleHelper, name, this);
+  else
+    RuleLexer::ReadRules(in, &AddRuleHelper, name, this);
 }
 
 bool TextGrammar::HasRuleForSpan(int /* i */, int /* j */, int distance) const {
@@ -70,8 +70,10 @@ struct TextGrammar : public Grammar {
 
   virtual const GrammarIter* GetRoot() const;
   void AddRule(const TRulePtr& rule, const unsigned int ctf_level=0, const TRulePtr& coarse_parent=TRulePtr());
+  // reads rules in the text format or in the binary format written by the
+  // extractor (see ReadBinaryRules in grammar.cc)
   void ReadFromFile(const std::string& filename);
-  void ReadFromStream(std::istream* in);
+  void ReadFromStream(std::istream* in, const std::string& name = "UNKNOWN");
   virtual bool HasRuleForSpan(int i, int j, int distance) const;
   const std::vector<TRulePtr>& GetUnaryRules(const WordID& cat) const;
 
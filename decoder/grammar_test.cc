@@ -5,6 +5,7 @@
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include "trule.h"
 #include "tdict.h"
@@ -14,6 +15,10 @@
 #include "ff.h"
 #include "ffset.h"
 #include "weights.h"
+#include "extractor/grammar.h"
+#include "extractor/phrase_builder.h"
+#include "extractor/rule.h"
+#include "extractor/vocabulary.h"
 
 using namespace std;
 
@@ -57,5 +62,80 @@ BOOST_AUTO_TEST_CASE(TestTextGrammarFile) {
   parser.Parse(lattice, &forest);
   forest.PrintGraphviz();
 }
+
+// rules of g whose source side is f
+static vector<TRulePtr> RulesFor(const Grammar& g, const vector<WordID>& f) {
+  vector<TRulePtr> rules;
+  const GrammarIter* it = g.GetRoot();
+  for (unsigned i = 0; it && i < f.size(); ++i)
+    it = it->Extend(f[i]);
+  const RuleBin* bin = it ? it->GetRules() : NULL;
+  for (int i = 0; bin && i < bin->GetNumRules(); ++i)
+    rules.push_back(bin->GetIthRule(i));
+  return rules;
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryGrammarMatchesText) {
+  using namespace extractor;
+  shared_ptr<Vocabulary> vocabulary = make_shared<Vocabulary>();
+  PhraseBuilder builder(vocabulary);
+  const int x1 = vocabulary->GetNonterminalIndex(1);
+  const int x2 = vocabulary->GetNonterminalIndex(2);
+  auto words = [&](const vector<string>& ws) {
+    vector<int> symbols;
+    for (const string& w: ws)
+      symbols.push_back(w == "[X,1]" ? x1 : w == "[X,2]" ? x2 : vocabulary->GetTerminalIndex(w));
+    return builder.Build(symbols);
+  };
+  vector<Rule> rules;
+  rules.push_back(Rule(words({"das", "haus"}), words({"the", "house"}),
+                       {0.1, -2.5, 3.0}, {{0, 0}, {1, 1}}));
+  rules.push_back(Rule(words({"das", "haus"}), words({"the", "home"}),
+                       {0.7, 1e-3, 0.0}, {{0, 0}}));
+  rules.push_back(Rule(words({"[X,1]", "des", "[X,2]"}), words({"[X,2]", "'s", "[X,1]"}),
+                       {-1.0 / 3, 12.75, 1.0}, {{1, 1}}));
+  rules.push_back(Rule(words({"klein", "[X,1]"}), words({"small", "[X,1]", "."}),
+                       {1.0, 0.0, -0.125}, {}));
+  extractor::Grammar grammar(rules, {"EgivenFCoherent", "SampleCountF", "IsSingletonF"});
+
+  ostringstream text_out, binary_out;
+  text_out << grammar;
+  grammar.WriteBinary(binary_out);
+  BOOST_CHECK(binary_out.str().size() < text_out.str().size());
+  istringstream text_in(text_out.str()), binary_in(binary_out.str());
+  TextGrammar text(&text_in), binary(&binary_in);
+
+  const WordID x = -TD::Convert("X");
+  const vector<vector<WordID> > sources = {
+      {TD::Convert("das"), TD::Convert("haus")},
+      {x, TD::Convert("des"), x},
+      {TD::Convert("klein"), x}};
+  size_t found = 0;
+  for (const vector<WordID>& f: sources) {
+    const vector<TRulePtr> expected = RulesFor(text, f), actual = RulesFor(binary, f);
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (unsigned i = 0; i < expected.size(); ++i, ++found) {
+      const TRule& e = *expected[i];
+      const TRule& a = *actual[i];
+      BOOST_CHECK_EQUAL(e.AsString(false), a.AsString(false));
+      BOOST_CHECK_EQUAL(e.GetLHS(), a.GetLHS());
+      BOOST_CHECK(e.f() == a.f());
+      BOOST_CHECK(e.e() == a.e());
+      BOOST_CHECK_EQUAL(e.Arity(), a.Arity());
+      BOOST_REQUIRE_EQUAL(e.als().size(), a.als().size());
+      for (unsigned j = 0; j < e.als().size(); ++j) {
+        BOOST_CHECK_EQUAL(e.als()[j].s_, a.als()[j].s_);
+        BOOST_CHECK_EQUAL(e.als()[j].t_, a.als()[j].t_);
+      }
+      const SparseVector<double>& ef = e.GetFeatureValues();
+      const SparseVector<double>& af = a.GetFeatureValues();
+      BOOST_CHECK_EQUAL(ef.size(), af.size());
+      for (SparseVector<double>::const_iterator it = ef.begin(); it != ef.end(); ++it)
+        BOOST_CHECK_CLOSE(it->second, af.value(it->first), 1e-5);
+    }
+  }
+  BOOST_CHECK_EQUAL(rules.size(), found);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -2,9 +2,13 @@
 
 #include "hg.h"
 #include "fdict.h"
+#include "ff.h"
+#include "ffset.h"
+#include "sentence_metadata.h"
 #include "tdict.h"
 
 #include "lm/enumerate_vocab.hh"
+#include "lm/left.hh"
 #include "lm/model.hh"
 #include "search/applied.hh"
 #include "search/config.hh"
@@ -15,11 +19,15 @@
 #include "search/vertex.hh"
 #include "search/vertex_generator.hh"
 #include "util/exception.hh"
+#include "util/murmur_hash.hh"
 
-#include <boost/scoped_ptr.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/scoped_array.hpp>
 
+#include <algorithm>
+#include <deque>
 #include <iostream>
+#include <set>
 #include <vector>
 
 namespace {
@@ -28,14 +36,14 @@ struct MapVocab : public lm::EnumerateVocab {
   public:
     MapVocab() {}
 
-    // Do not call after Lookup.  
+    // Do not call after Lookup.
     void Add(lm::WordIndex index, const StringPiece &str) {
       const WordID cdec_id = TD::Convert(str.as_string());
       if (cdec_id >= out_.size()) out_.resize(cdec_id + 1);
       out_[cdec_id] = index;
     }
 
-    // Assumes Add has been called and will never be called again.  
+    // Assumes Add has been called and will never be called again.
     lm::WordIndex FromCDec(WordID id) const {
       return out_[out_.size() > id ? id : 0];
     }
@@ -44,21 +52,154 @@ struct MapVocab : public lm::EnumerateVocab {
     std::vector<lm::WordIndex> out_;
 };
 
+struct PlusNode;
+
+// An edge of the +LM forest: the -LM edge it instantiates, its antecedents
+// (in tail order), the complete feature vector and the state of the stateful
+// feature functions after applying it.
+struct PlusEdge {
+  const Hypergraph::Edge *in;
+  std::vector<PlusNode*> tails;
+  SparseVector<double> features;
+  FFState state;
+  uint64_t state_hash;
+};
+
+// Hypotheses recombined because they agree on both language model state and
+// feature function state.
+struct PlusNode {
+  PlusNode() : in(NULL), hash(0), id(-1) {}
+  const Hypergraph::Node *in;
+  lm::ngram::ChartState lm_state;
+  FFState state;
+  size_t hash;
+  std::vector<PlusEdge*> edges;
+  int id;  // in the output forest, -1 until added
+};
+
+// Everything that lives as long as one sentence's search.
+struct Sentence {
+  Sentence(const SentenceMetadata &smeta_in, const Hypergraph &hg_in)
+    : smeta(smeta_in), hg(hg_in), stateless(hg_in.edges_.size()) {}
+
+  const SentenceMetadata &smeta;
+  const Hypergraph &hg;
+  // Values of the stateless features, indexed by -LM edge.
+  std::vector<SparseVector<double> > stateless;
+  // deque so that pointers stay valid as the forest grows.
+  std::deque<PlusEdge> edges;
+  std::deque<PlusNode> nodes;
+};
+
+// search:: output policy that keeps every hypothesis recombined into a state,
+// not just the best, so they all appear in the +LM forest.
+class ForestOutput {
+  public:
+    typedef std::vector<search::PartialEdge> Combine;
+
+    explicit ForestOutput(Sentence &sentence) : sentence_(sentence) {}
+
+    void Add(Combine &existing, search::PartialEdge add) const {
+      existing.push_back(add);
+    }
+
+    search::NBestComplete Complete(Combine &partials) {
+      assert(!partials.empty());
+      const search::PartialEdge &best = *std::max_element(partials.begin(), partials.end());
+      sentence_.nodes.push_back(PlusNode());
+      PlusNode &node = sentence_.nodes.back();
+      node.edges.reserve(partials.size());
+      for (Combine::const_iterator i = partials.begin(); i != partials.end(); ++i) {
+        node.edges.push_back(static_cast<PlusEdge*>(const_cast<void*>(i->GetNote().vp)));
+      }
+      const PlusEdge &best_edge = *static_cast<const PlusEdge*>(best.GetNote().vp);
+      node.in = &sentence_.hg.nodes_[best_edge.in->head_node_];
+      node.lm_state = best.CompletedState();
+      node.state = best_edge.state;
+      node.hash = hash_value(node.lm_state);
+      boost::hash_combine(node.hash, best_edge.state_hash);
+      return search::NBestComplete(&node, node.lm_state, best.GetScore());
+    }
+
+  private:
+    Sentence &sentence_;
+};
+
+// Scores the stateful features of each complete hypothesis, then recombines
+// it into the vertex by language model and feature state.
+template <class Search> class CompletingVertexGenerator {
+  public:
+    CompletingVertexGenerator(const Search &search, Sentence &sentence, search::ContextBase &context, search::Vertex &gen, ForestOutput &out)
+      : search_(search), sentence_(sentence), inner_(context, gen, out) {}
+
+    void NewHypothesis(search::PartialEdge partial) {
+      const PlusEdge &edge = search_.Complete(sentence_, partial, false);
+      inner_.NewHypothesis(partial, edge.state_hash);
+    }
+
+    void FinishedSearch() {
+      inner_.FinishedSearch();
+    }
+
+  private:
+    const Search &search_;
+    Sentence &sentence_;
+    search::VertexGenerator<ForestOutput> inner_;
+};
+
+// Everything comes together at the goal, which nothing is built on top of.
+template <class Search> class GoalGenerator {
+  public:
+    GoalGenerator(const Search &search, Sentence &sentence, PlusNode &goal)
+      : search_(search), sentence_(sentence), goal_(goal) {}
+
+    void NewHypothesis(search::PartialEdge partial) {
+      goal_.edges.push_back(&search_.Complete(sentence_, partial, true));
+    }
+
+    void FinishedSearch() {}
+
+  private:
+    const Search &search_;
+    Sentence &sentence_;
+    PlusNode &goal_;
+};
+
 template <class Model> class Incremental : public IncrementalBase {
   public:
-    Incremental(const char *model_file, const std::vector<weight_t> &weights) :
-      IncrementalBase(weights), 
+    Incremental(const char *model_file, const std::vector<weight_t> &weights, const std::vector<const FeatureFunction*> &features) :
+      IncrementalBase(weights, features),
       m_(model_file, GetConfig()),
-      lm_(weights[FD::Convert("KLanguageModel")]),
-      oov_(weights[FD::Convert("KLanguageModel_OOV")]),
-      word_penalty_(weights[FD::Convert("WordPenalty")]) {
-      std::cerr << "Weights KLanguageModel " << lm_ << " KLanguageModel_OOV " << oov_ << " WordPenalty " << word_penalty_ << std::endl;
+      lm_fid_(FD::Convert("KLanguageModel")),
+      oov_fid_(FD::Convert("KLanguageModel_OOV")),
+      word_penalty_fid_(FD::Convert("WordPenalty")),
+      state_size_(0) {
+      for (unsigned int i = 0; i < stateful_.size(); ++i) {
+        state_pos_.push_back(state_size_);
+        state_size_ += stateful_[i]->StateSize();
+      }
+      std::cerr << "Weights KLanguageModel " << Weight(lm_fid_) << " KLanguageModel_OOV " << Weight(oov_fid_) << " WordPenalty " << Weight(word_penalty_fid_) << std::endl;
+      std::cerr << "Incremental search with " << stateless_.size() << " stateless and " << stateful_.size() << " stateful feature functions" << std::endl;
     }
 
-    void Search(unsigned int pop_limit, const Hypergraph &hg) const;
+    void Search(unsigned int pop_limit, const SentenceMetadata &smeta, const Hypergraph &hg, Hypergraph *out) const;
+
+    // Called once all antecedents of partial are known.  Adds the exact
+    // language model and stateful feature values, adjusts the score of partial
+    // by the latter, and points its note at the resulting +LM edge.
+    PlusEdge &Complete(Sentence &sentence, search::PartialEdge &partial, bool goal) const;
 
   private:
-    void ConvertEdge(const search::Context<Model> &context, search::Vertex *vertices, const Hypergraph::Edge &in, search::EdgeGenerator &gen) const;
+    // Removes the features the search scores itself (the language model, its
+    // OOV count and the word penalty) from the values fired by ff, so that
+    // e.g. a WordPenalty feature function does not count them twice.
+    void DropSearchFeatures(const FeatureFunction &ff, SparseVector<double> *values) const;
+
+    void ConvertEdge(const search::Context<Model> &context, Sentence &sentence, search::Vertex *vertices, const Hypergraph::Edge &in, bool goal, search::EdgeGenerator &gen) const;
+
+    float Weight(int fid) const {
+      return fid < static_cast<int>(cdec_weights_.size()) ? cdec_weights_[fid] : 0.0;
+    }
 
     lm::ngram::Config GetConfig() {
       lm::ngram::Config ret;
@@ -70,53 +211,95 @@ template <class Model> class Incremental : public IncrementalBase {
 
     const Model m_;
 
-    const float lm_, oov_, word_penalty_;
+    const int lm_fid_, oov_fid_, word_penalty_fid_;
+
+    // Layout of the stateful features' state, as in ModelSet.
+    int state_size_;
+    std::vector<int> state_pos_;
+
+    // Feature functions already reported by DropSearchFeatures.
+    mutable std::set<const FeatureFunction*> dropped_;
 };
 
-void PrintApplied(const Hypergraph &hg, const search::Applied final) {
-  const std::vector<WordID> &words = static_cast<const Hypergraph::Edge*>(final.GetNote().vp)->rule_->e();
-  const search::Applied *child(final.Children());
-  for (std::vector<WordID>::const_iterator i = words.begin(); i != words.end(); ++i) {
-    if (*i > 0) {
-      std::cout << TD::Convert(*i) << ' ';
-    } else {
-      PrintApplied(hg, *child++);
+// Adds node (and everything below it) to out in topological order.
+int AddToForest(PlusNode &node, Hypergraph *out) {
+  if (node.id >= 0) return node.id;
+  for (std::vector<PlusEdge*>::const_iterator e = node.edges.begin(); e != node.edges.end(); ++e) {
+    for (std::vector<PlusNode*>::const_iterator t = (*e)->tails.begin(); t != (*e)->tails.end(); ++t) {
+      AddToForest(**t, out);
+    }
+  }
+  Hypergraph::Node *added = out->AddNode(node.in->cat_);
+  added->node_hash = node.in->node_hash;
+  boost::hash_combine(added->node_hash, node.hash);
+  node.id = added->id_;
+  Hypergraph::TailNodeVector tails;
+  for (std::vector<PlusEdge*>::const_iterator e = node.edges.begin(); e != node.edges.end(); ++e) {
+    tails.clear();
+    for (std::vector<PlusNode*>::const_iterator t = (*e)->tails.begin(); t != (*e)->tails.end(); ++t) {
+      tails.push_back((*t)->id);
     }
+    Hypergraph::Edge *edge = out->AddEdge(*(*e)->in, tails);
+    edge->feature_values_ = (*e)->features;
+    out->ConnectEdgeToHeadNode(edge, node.id);
   }
+  return node.id;
 }
 
-template <class Model> void Incremental<Model>::Search(unsigned int pop_limit, const Hypergraph &hg) const {
+template <class Model> void Incremental<Model>::Search(unsigned int pop_limit, const SentenceMetadata &smeta, const Hypergraph &hg, Hypergraph *out) const {
+  out->clear();
   boost::scoped_array<search::Vertex> out_vertices(new search::Vertex[hg.nodes_.size()]);
-  search::Config config(lm_, pop_limit, search::NBestConfig(1));
+  search::Config config(Weight(lm_fid_), pop_limit, search::NBestConfig(1));
   search::Context<Model> context(config, m_);
-  search::SingleBest best;
+  Sentence sentence(smeta, hg);
+  ForestOutput output(sentence);
 
-  for (unsigned int i = 0; i < hg.nodes_.size() - 1; ++i) {
+  const unsigned int goal = hg.nodes_.size() - 1;
+  for (unsigned int i = 0; i < goal; ++i) {
     search::EdgeGenerator gen;
     const Hypergraph::EdgesVector &down_edges = hg.nodes_[i].in_edges_;
     for (unsigned int j = 0; j < down_edges.size(); ++j) {
       unsigned int edge_index = down_edges[j];
-      ConvertEdge(context, out_vertices.get(), hg.edges_[edge_index], gen);
+      ConvertEdge(context, sentence, out_vertices.get(), hg.edges_[edge_index], false, gen);
     }
-    search::VertexGenerator<search::SingleBest> vertex_gen(context, out_vertices[i], best);
+    CompletingVertexGenerator<Incremental<Model> > vertex_gen(*this, sentence, context, out_vertices[i], output);
     gen.Search(context, vertex_gen);
   }
-  const search::Applied top = out_vertices[hg.nodes_.size() - 2].BestChild();
-  if (!top.Valid()) {
-    std::cout << "NO PATH FOUND" << std::endl;
-  } else {
-    PrintApplied(hg, top);
-    std::cout << "||| " << top.GetScore() << std::endl;
+
+  sentence.nodes.push_back(PlusNode());
+  PlusNode &top = sentence.nodes.back();
+  top.in = &hg.nodes_[goal];
+  search::EdgeGenerator gen;
+  const Hypergraph::EdgesVector &goal_edges = hg.nodes_[goal].in_edges_;
+  for (unsigned int j = 0; j < goal_edges.size(); ++j) {
+    ConvertEdge(context, sentence, out_vertices.get(), hg.edges_[goal_edges[j]], true, gen);
   }
+  GoalGenerator<Incremental<Model> > goal_gen(*this, sentence, top);
+  gen.Search(context, goal_gen);
+
+  if (top.edges.empty()) return;
+  AddToForest(top, out);
 }
 
-template <class Model> void Incremental<Model>::ConvertEdge(const search::Context<Model> &context, search::Vertex *vertices, const Hypergraph::Edge &in, search::EdgeGenerator &gen) const {
+template <class Model> void Incremental<Model>::DropSearchFeatures(const FeatureFunction &ff, SparseVector<double> *values) const {
+  const int fids[] = {lm_fid_, oov_fid_, word_penalty_fid_};
+  for (unsigned int i = 0; i < sizeof(fids) / sizeof(fids[0]); ++i) {
+    if (values->value(fids[i]) == 0.0) continue;
+    values->erase(fids[i]);
+    if (dropped_.insert(&ff).second) {
+      std::cerr << "Incremental search: ignoring the " << FD::Convert(fids[i]) << " feature fired by a feature function, the search already adds it" << std::endl;
+    }
+  }
+}
+
+template <class Model> void Incremental<Model>::ConvertEdge(const search::Context<Model> &context, Sentence &sentence, search::Vertex *vertices, const Hypergraph::Edge &in, bool goal, search::EdgeGenerator &gen) const {
   const std::vector<WordID> &e = in.rule_->e();
   std::vector<lm::WordIndex> words;
-  words.reserve(e.size());
+  words.reserve(e.size() + 2);
   std::vector<search::PartialVertex> nts;
   unsigned int terminals = 0;
   float score = 0.0;
+  if (goal) words.push_back(m_.GetVocabulary().BeginSentence());
   for (std::vector<WordID>::const_iterator word = e.begin(); word != e.end(); ++word) {
     if (*word <= 0) {
       nts.push_back(vertices[in.tail_nodes_[-*word]].RootAlternate());
@@ -128,6 +311,7 @@ template <class Model> void Incremental<Model>::ConvertEdge(const search::Contex
       words.push_back(vocab_.FromCDec(*word));
     }
   }
+  if (goal) words.push_back(m_.GetVocabulary().EndSentence());
 
   search::PartialEdge out(gen.AllocateEdge(nts.size()));
 
@@ -137,26 +321,112 @@ template <class Model> void Incremental<Model>::ConvertEdge(const search::Contex
   note.vp = &in;
   out.SetNote(note);
 
-  score += in.rule_->GetFeatureValues().dot(cdec_weights_);
-  score -= static_cast<float>(terminals) * word_penalty_ / M_LN10;
+  score += in.feature_values_.dot(cdec_weights_);
+  // Stateless features do not depend on the antecedents, so score them once.
+  // Goal edges only get their final features, as in ModelSet::AddFinalFeatures.
+  SparseVector<double> &stateless = sentence.stateless[in.id_];
+  SparseVector<double> values, ignored;
+  const std::vector<const void*> no_ants(in.tail_nodes_.size(), NULL);
+  for (unsigned int i = 0; i < stateless_.size(); ++i) {
+    values.clear();
+    if (goal) {
+      stateless_[i]->FinalTraversalFeatures(NULL, &values);
+    } else {
+      stateless_[i]->TraversalFeatures(sentence.smeta, in, no_ants, &values, &ignored, NULL);
+    }
+    DropSearchFeatures(*stateless_[i], &values);
+    stateless += values;
+  }
+  score += stateless.dot(cdec_weights_);
+  score -= static_cast<float>(terminals) * Weight(word_penalty_fid_) / M_LN10;
   search::ScoreRuleRet res(search::ScoreRule(context.LanguageModel(), words, out.Between()));
-  score += res.prob * lm_ + static_cast<float>(res.oov) * oov_;
+  score += res.prob * Weight(lm_fid_) + static_cast<float>(res.oov) * Weight(oov_fid_);
 
   out.SetScore(score);
 
   gen.AddEdge(out);
 }
 
+template <class Model> PlusEdge &Incremental<Model>::Complete(Sentence &sentence, search::PartialEdge &partial, bool goal) const {
+  const Hypergraph::Edge &in = *static_cast<const Hypergraph::Edge*>(partial.GetNote().vp);
+  const std::vector<WordID> &e = in.rule_->e();
+  sentence.edges.push_back(PlusEdge());
+  PlusEdge &out = sentence.edges.back();
+  out.in = &in;
+  out.features = in.feature_values_;
+
+  // Non-terminals are in target order; tails are in source order.
+  out.tails.resize(in.tail_nodes_.size());
+  const search::PartialVertex *nt = partial.NT();
+  for (std::vector<WordID>::const_iterator word = e.begin(); word != e.end(); ++word) {
+    if (*word <= 0) out.tails[-*word] = static_cast<PlusNode*>((nt++)->End());
+  }
+
+  // The search only tracks the language model score as a whole, so
+  // recompute this edge's share of it from the antecedent states.
+  lm::ngram::ChartState ignored_state;
+  lm::ngram::RuleScore<Model> scorer(m_, ignored_state);
+  unsigned int terminals = 0, oovs = 0;
+  if (goal) scorer.BeginSentence();
+  for (std::vector<WordID>::const_iterator word = e.begin(); word != e.end(); ++word) {
+    if (*word <= 0) {
+      scorer.NonTerminal(out.tails[-*word]->lm_state);
+    } else {
+      ++terminals;
+      const lm::WordIndex index = vocab_.FromCDec(*word);
+      if (index == m_.GetVocabulary().NotFound()) ++oovs;
+      scorer.Terminal(index);
+    }
+  }
+  if (goal) scorer.Terminal(m_.GetVocabulary().EndSentence());
+  out.features.add_value(lm_fid_, scorer.Finish());
+  if (oovs) out.features.add_value(oov_fid_, oovs);
+  if (terminals) out.features.add_value(word_penalty_fid_, -static_cast<double>(terminals) / M_LN10);
+  out.features += sentence.stateless[in.id_];
+
+  out.state.resize(state_size_);
+  if (state_size_) memset(&out.state[0], 0, state_size_);
+  out.state_hash = 0;
+  if (!stateful_.empty()) {
+    SparseVector<double> stateful, values, ignored_estimate;
+    std::vector<const void*> ants(out.tails.size());
+    for (unsigned int i = 0; i < stateful_.size(); ++i) {
+      const FeatureFunction &ff = *stateful_[i];
+      const int pos = state_pos_[i];
+      for (unsigned int j = 0; j < ants.size(); ++j) {
+        ants[j] = &out.tails[j]->state[pos];
+      }
+      values.clear();
+      if (goal) {
+        ff.FinalTraversalFeatures(ants.front(), &values);
+      } else {
+        ff.TraversalFeatures(sentence.smeta, in, ants, &values, &ignored_estimate, &out.state[pos]);
+        // Bytes the feature asks to ignore do not split hypotheses.
+        out.state_hash = util::MurmurHashNative(&out.state[pos], ff.StateSize() - ff.IgnoredStateSize(), out.state_hash);
+      }
+      DropSearchFeatures(ff, &values);
+      stateful += values;
+    }
+    partial.SetScore(partial.GetScore() + stateful.dot(cdec_weights_));
+    out.features += stateful;
+  }
+
+  search::Note note;
+  note.vp = &out;
+  partial.SetNote(note);
+  return out;
+}
+
 } // namespace
 
-IncrementalBase *IncrementalBase::Load(const char *model_file, const std::vector<weight_t> &weights) {
+IncrementalBase *IncrementalBase::Load(const char *model_file, const std::vector<weight_t> &weights, const std::vector<const FeatureFunction*> &features) {
   lm::ngram::ModelType model_type;
   if (!lm::ngram::RecognizeBinary(model_file, model_type)) model_type = lm::ngram::PROBING;
   switch (model_type) {
     case lm::ngram::PROBING:
-      return new Incremental<lm::ngram::ProbingModel>(model_file, weights);
+      return new Incremental<lm::ngram::ProbingModel>(model_file, weights, features);
     case lm::ngram::REST_PROBING:
-      return new Incremental<lm::ngram::RestProbingModel>(model_file, weights);
+      return new Incremental<lm::ngram::RestProbingModel>(model_file, weights, features);
     default:
       UTIL_THROW(util::Exception, "Sorry this lm type isn't supported yet.");
   }
@@ -164,4 +434,12 @@ IncrementalBase *IncrementalBase::Load(const char *model_file, const std::vector
 
 IncrementalBase::~IncrementalBase() {}
 
-IncrementalBase::IncrementalBase(const std::vector<weight_t> &weights) : cdec_weights_(weights) {}
+IncrementalBase::IncrementalBase(const std::vector<weight_t> &weights, const std::vector<const FeatureFunction*> &features) : cdec_weights_(weights) {
+  for (std::vector<const FeatureFunction*>::const_iterator i = features.begin(); i != features.end(); ++i) {
+    if ((*i)->IsStateful()) {
+      stateful_.push_back(*i);
+    } else {
+      stateless_.push_back(*i);
+    }
+  }
+}
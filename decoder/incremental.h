@@ -5,19 +5,30 @@
 #include <vector>
 
 class Hypergraph;
+class FeatureFunction;
+class SentenceMetadata;
 
 class IncrementalBase {
   public:
-    static IncrementalBase *Load(const char *model_file, const std::vector<weight_t> &weights);
+    // features are applied during search in addition to the language model
+    // (and word penalty) handled by the search itself.  Stateful features
+    // split hypotheses by their state just as in cube pruning.  Values a
+    // feature function fires for KLanguageModel, KLanguageModel_OOV or
+    // WordPenalty are ignored, since the search adds those itself.
+    static IncrementalBase *Load(const char *model_file, const std::vector<weight_t> &weights, const std::vector<const FeatureFunction*> &features);
 
     virtual ~IncrementalBase();
 
-    virtual void Search(unsigned int pop_limit, const Hypergraph &hg) const = 0;
+    // Intersects hg with the language model and features, writing the pruned
+    // +LM forest to out.  out is left empty if no path survives the search.
+    virtual void Search(unsigned int pop_limit, const SentenceMetadata &smeta, const Hypergraph &hg, Hypergraph *out) const = 0;
 
   protected:
-    IncrementalBase(const std::vector<weight_t> &weights);
+    IncrementalBase(const std::vector<weight_t> &weights, const std::vector<const FeatureFunction*> &features);
 
     const std::vector<weight_t> &cdec_weights_;
+
+    std::vector<const FeatureFunction*> stateless_, stateful_;
 };
 
 #endif // _INCREMENTAL_H_
@@ -0,0 +1,129 @@
+#define BOOST_TEST_MODULE IncrementalTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "decoder.h"
+#include "fdict.h"
+#include "ff.h"
+#include "ff_factory.h"
+#include "ff_register.h"
+#include "hg.h"
+#include "sparse_vector.h"
+#include "viterbi.h"
+
+using namespace std;
+
+namespace {
+
+struct ViterbiObserver : public DecoderObserver {
+  virtual void NotifyTranslationForest(const SentenceMetadata&, Hypergraph* hg) {
+    feats = ViterbiFeatures(*hg);
+    trans = ViterbiETree(*hg);
+  }
+  SparseVector<double> feats;
+  string trans;
+};
+
+// a stateless feature that also fires on the goal edge, where only
+// FinalTraversalFeatures is called
+class FinalCount : public FeatureFunction {
+ public:
+  FinalCount(const string&) : edge_fid_(FD::Convert("FinalCount_Edges")), final_fid_(FD::Convert("FinalCount_Final")) {}
+  static string usage(bool p, bool d) {
+    return usage_helper("FinalCount", "", "counts edges and goal edges", p, d);
+  }
+  virtual void FinalTraversalFeatures(const void*, SparseVector<double>* features) const {
+    features->add_value(final_fid_, 1.0);
+  }
+ protected:
+  virtual void TraversalFeaturesImpl(const SentenceMetadata&, const HG::Edge&, const vector<const void*>&,
+                                     SparseVector<double>* features, SparseVector<double>*, void*) const {
+    features->add_value(edge_fid_, 1.0);
+  }
+ private:
+  const int edge_fid_, final_fid_;
+};
+
+string TestData() {
+  static bool registered = false;
+  if (!registered) {
+    register_feature_functions();
+    ff_registry.Register("FinalCount", new FFFactory<FinalCount>);
+    registered = true;
+  }
+  return boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA;
+}
+
+// decodes input with the test grammar and weights and the extra config lines
+void DecodeWith(const string& extra, const string& input, ViterbiObserver* o) {
+  const string path = TestData();
+  ostringstream config;
+  config << "formalism=scfg\n"
+         << "grammar=" << path << "/incremental.scfg\n"
+         << "weights=" << path << "/incremental.weights\n"
+         << "cubepruning_pop_limit=1000\n"
+         << "quiet=true\n"
+         << extra;
+  istringstream in(config.str());
+  Decoder decoder(&in);
+  BOOST_REQUIRE(decoder.Decode(input, o));
+}
+
+// stateless feature functions (SourceWordPenalty, FinalCount) and a
+// stateful one (a second language model) on top of the language model and
+// word penalty
+void CheckSameViterbi(const string& input) {
+  const string path = TestData();
+  const string ffs =
+      "feature_function=SourceWordPenalty\n"
+      "feature_function=FinalCount\n"
+      "feature_function=KLanguageModel -n LM2 " + path + "/test_2gram.lm.gz\n";
+  ViterbiObserver cube;
+  DecodeWith(ffs +
+      "feature_function=KLanguageModel -n KLanguageModel " + path + "/dummy.3gram.lm\n"
+      "feature_function=WordPenalty\n", input, &cube);
+  // WordPenalty is added by the search itself, so the feature function
+  // must not count it a second time
+  ViterbiObserver incremental;
+  DecodeWith(ffs +
+      "incremental_search=" + path + "/dummy.3gram.lm\n"
+      "feature_function=WordPenalty\n", input, &incremental);
+
+  BOOST_CHECK_EQUAL(cube.trans, incremental.trans);
+  BOOST_CHECK_EQUAL(cube.feats.size(), incremental.feats.size());
+  const SparseVector<double>& expected = cube.feats;
+  for (SparseVector<double>::const_iterator it = expected.begin(); it != expected.end(); ++it) {
+    BOOST_CHECK_CLOSE(it->second, incremental.feats.value(it->first), 1e-4);
+  }
+  BOOST_CHECK(cube.feats.value(FD::Convert("LM2")) != 0.0);
+  BOOST_CHECK(cube.feats.value(FD::Convert("SourceWordPenalty")) != 0.0);
+  BOOST_CHECK_EQUAL(1.0, cube.feats.value(FD::Convert("FinalCount_Final")));
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestIncrementalMatchesCubePruning) {
+  CheckSameViterbi("a b c");
+  CheckSameViterbi("a b c d");
+}
+
+BOOST_AUTO_TEST_CASE(TestIncrementalOOV) {
+  // mary is unknown to the trigram model and zzz to both
+  CheckSameViterbi("d c d");
+}
+
+// the search scores KLanguageModel itself, so a feature function firing it
+// again is ignored
+BOOST_AUTO_TEST_CASE(TestIncrementalIgnoresDuplicateLM) {
+  const string path = TestData();
+  const string search = "incremental_search=" + path + "/dummy.3gram.lm\n";
+  ViterbiObserver plain, duplicate;
+  DecodeWith(search, "a b c d", &plain);
+  DecodeWith(search + "feature_function=KLanguageModel -n KLanguageModel " + path + "/dummy.3gram.lm\n", "a b c d", &duplicate);
+  BOOST_CHECK_EQUAL(plain.trans, duplicate.trans);
+  BOOST_CHECK(plain.feats == duplicate.feats);
+  BOOST_CHECK(plain.feats.value(FD::Convert("KLanguageModel")) != 0.0);
+}
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include <unordered_set>
 #include <boost/foreach.hpp>
@@ -387,7 +389,28 @@ void SCFGTranslator::ProcessMarkupHintsImpl(const map<string, string>& kv) {
       abort();
     }
     loaded.insert(gfile);
-    TextGrammar* sentGrammar = new TextGrammar(gfile);
+    TextGrammar* sentGrammar;
+    map<string,string>::const_iterator offset = kv.find(gkey + "_offset");
+    if (offset != kv.end()) {
+      // the grammar is a section of a file holding the grammars of many
+      // sentences (e.g. written by the extractor with --grammar_format=indexed)
+      map<string,string>::const_iterator size = kv.find(gkey + "_size");
+      if (size == kv.end()) {
+        cerr << "SGML tag " << gkey << "_offset requires " << gkey << "_size\n";
+        abort();
+      }
+      ifstream file(gfile.c_str(), ios::binary);
+      string section(boost::lexical_cast<size_t>(size->second), '\0');
+      if (!file.seekg(boost::lexical_cast<streamoff>(offset->second)) ||
+          !file.read(&section[0], section.size())) {
+        cerr << "Failed to read grammar at offset " << offset->second << " of " << gfile << endl;
+        abort();
+      }
+      istringstream in(section);
+      sentGrammar = new TextGrammar(&in);
+    } else {
+      sentGrammar = new TextGrammar(gfile);
+    }
     sentGrammar->SetMaxSpan(pimpl_->max_span_limit);
     sentGrammar->SetGrammarName(gfile);
     pimpl_->AddSupplementalGrammar(GrammarPtr(sentGrammar));
@@ -19,6 +19,7 @@ Alignment::Alignment(const string& filename) {
   ReadFile rf(filename);
   istream& infile = *rf.stream();
   string line;
+  vector<vector<pair<int, int>>> alignments;
   while (getline(infile, line)) {
     vector<string> items;
     boost::split(items, line, boost::is_any_of(" -"));
@@ -29,19 +30,57 @@ Alignment::Alignment(const string& filename) {
     }
     alignments.push_back(alignment);
   }
-  alignments.shrink_to_fit();
+  SetAlignments(alignments);
 }
 
-Alignment::Alignment() {}
+Alignment::Alignment(const vector<vector<pair<int, int>>>& alignments) {
+  SetAlignments(alignments);
+}
+
+Alignment::Alignment() {
+  SetAlignments({});
+}
 
 Alignment::~Alignment() {}
 
+void Alignment::SetAlignments(
+    const vector<vector<pair<int, int>>>& alignments) {
+  vector<int> links;
+  vector<int64_t> sentence_start = {0};
+  for (const vector<pair<int, int>>& alignment: alignments) {
+    for (const pair<int, int>& link: alignment) {
+      links.push_back(link.first);
+      links.push_back(link.second);
+    }
+    sentence_start.push_back(links.size() / 2);
+  }
+  this->links = FlatArray<int>(move(links));
+  this->sentence_start = FlatArray<int64_t>(move(sentence_start));
+}
+
 vector<pair<int, int>> Alignment::GetLinks(int sentence_index) const {
-  return alignments[sentence_index];
+  vector<pair<int, int>> alignment;
+  alignment.reserve(sentence_start[sentence_index + 1] -
+                    sentence_start[sentence_index]);
+  for (int64_t i = sentence_start[sentence_index];
+       i < sentence_start[sentence_index + 1]; ++i) {
+    alignment.push_back(make_pair(links[2 * i], links[2 * i + 1]));
+  }
+  return alignment;
+}
+
+void Alignment::WriteFlat(FlatFileWriter& writer) const {
+  writer.WriteArray(links);
+  writer.WriteArray(sentence_start);
+}
+
+void Alignment::ReadFlat(FlatFileReader& reader) {
+  links = reader.ReadArray<int>();
+  sentence_start = reader.ReadArray<int64_t>();
 }
 
 bool Alignment::operator==(const Alignment& other) const {
-  return alignments == other.alignments;
+  return links == other.links && sentence_start == other.sentence_start;
 }
 
 } // namespace extractor
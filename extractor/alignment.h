@@ -9,18 +9,26 @@
 #include <boost/serialization/utility.hpp>
 #include <boost/serialization/vector.hpp>
 
+#include "flat_file.h"
+
 using namespace std;
 
 namespace extractor {
 
 /**
  * Data structure storing the word alignments for a parallel corpus.
+ *
+ * The links of all sentences are stored in a single array (two positions per
+ * link), together with the offset where each sentence starts.
  */
 class Alignment {
  public:
   // Reads alignment from text file.
   Alignment(const string& filename);
 
+  // Creates alignment from the links of each sentence.
+  Alignment(const vector<vector<pair<int, int>>>& alignments);
+
   // Creates empty alignment.
   Alignment();
 
@@ -29,16 +37,44 @@ class Alignment {
 
   virtual ~Alignment();
 
+  // Writes the alignment in the flat format.
+  void WriteFlat(FlatFileWriter& writer) const;
+
+  // Reads an alignment written by WriteFlat (the arrays are not copied).
+  void ReadFlat(FlatFileReader& reader);
+
   bool operator==(const Alignment& alignment) const;
 
  private:
+  // Constructs the flat arrays from the links of each sentence.
+  void SetAlignments(const vector<vector<pair<int, int>>>& alignments);
+
   friend class boost::serialization::access;
 
-  template<class Archive> void serialize(Archive& ar, unsigned int) {
-    ar & alignments;
+  template<class Archive> void save(Archive& ar, unsigned int) const {
+    vector<vector<pair<int, int>>> alignments;
+    for (size_t i = 0; i + 1 < sentence_start.size(); ++i) {
+      vector<pair<int, int>> alignment;
+      for (int64_t j = sentence_start[i]; j < sentence_start[i + 1]; ++j) {
+        alignment.push_back(make_pair(links[2 * j], links[2 * j + 1]));
+      }
+      alignments.push_back(alignment);
+    }
+    ar << alignments;
+  }
+
+  template<class Archive> void load(Archive& ar, unsigned int) {
+    vector<vector<pair<int, int>>> alignments;
+    ar >> alignments;
+    SetAlignments(alignments);
   }
 
-  vector<vector<pair<int, int>>> alignments;
+  BOOST_SERIALIZATION_SPLIT_MEMBER();
+
+  // The links of sentence i are links[2 * sentence_start[i]] ..
+  // links[2 * sentence_start[i + 1] - 1].
+  FlatArray<int> links;
+  FlatArray<int64_t> sentence_start;
 };
 
 } // namespace extractor
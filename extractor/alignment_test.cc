@@ -5,12 +5,14 @@
 
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
 
 #include "alignment.h"
 
 using namespace std;
 using namespace ::testing;
 namespace ar = boost::archive;
+namespace fs = boost::filesystem;
 
 namespace extractor {
 namespace {
@@ -45,5 +47,20 @@ TEST_F(AlignmentTest, TestSerialization) {
   EXPECT_EQ(alignment, alignment_copy);
 }
 
+TEST_F(AlignmentTest, TestFlatFile) {
+  fs::path path = fs::temp_directory_path() / fs::unique_path();
+  {
+    FlatFileWriter writer(path.string(), FLAT_ALIGNMENT);
+    alignment.WriteFlat(writer);
+  }
+
+  Alignment alignment_copy;
+  FlatFileReader reader(path.string(), FLAT_ALIGNMENT);
+  alignment_copy.ReadFlat(reader);
+  fs::remove(path);
+
+  EXPECT_EQ(alignment, alignment_copy);
+}
+
 } // namespace
 } // namespace extractor
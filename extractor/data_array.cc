@@ -4,6 +4,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 
 #include "filelib.h"
 
@@ -17,11 +18,10 @@ string DataArray::NULL_WORD_STR = "__NULL__";
 string DataArray::END_OF_LINE_STR = "__END_OF_LINE__";
 
 DataArray::DataArray() {
-  InitializeDataArray();
+  SetWords({NULL_WORD_STR, END_OF_LINE_STR});
 }
 
 DataArray::DataArray(const string& filename) {
-  InitializeDataArray();
   ReadFile rf(filename);
   istream& infile = *rf.stream();
   vector<string> lines;
@@ -33,7 +33,6 @@ DataArray::DataArray(const string& filename) {
 }
 
 DataArray::DataArray(const string& filename, const Side& side) {
-  InitializeDataArray();
   ReadFile rf(filename);
   istream& infile = *rf.stream();
   vector<string> lines;
@@ -49,25 +48,28 @@ DataArray::DataArray(const string& filename, const Side& side) {
   CreateDataArray(lines);
 }
 
-void DataArray::InitializeDataArray() {
-  word2id[NULL_WORD_STR] = NULL_WORD;
-  id2word.push_back(NULL_WORD_STR);
-  word2id[END_OF_LINE_STR] = END_OF_LINE;
-  id2word.push_back(END_OF_LINE_STR);
+DataArray::DataArray(const vector<string>& sentences) {
+  CreateDataArray(sentences);
 }
 
 void DataArray::CreateDataArray(const vector<string>& lines) {
+  unordered_map<string, int> word2id;
+  vector<string> id2word = {NULL_WORD_STR, END_OF_LINE_STR};
+  word2id[NULL_WORD_STR] = NULL_WORD;
+  word2id[END_OF_LINE_STR] = END_OF_LINE;
+
+  vector<int> data, sentence_id, sentence_start;
   for (size_t i = 0; i < lines.size(); ++i) {
     sentence_start.push_back(data.size());
 
     istringstream iss(lines[i]);
     string word;
     while (iss >> word) {
-      if (word2id.count(word) == 0) {
-        word2id[word] = id2word.size();
+      auto result = word2id.insert(make_pair(word, id2word.size()));
+      if (result.second) {
         id2word.push_back(word);
       }
-      data.push_back(word2id[word]);
+      data.push_back(result.first->second);
       sentence_id.push_back(i);
     }
     data.push_back(END_OF_LINE);
@@ -75,14 +77,29 @@ void DataArray::CreateDataArray(const vector<string>& lines) {
   }
   sentence_start.push_back(data.size());
 
-  data.shrink_to_fit();
-  sentence_id.shrink_to_fit();
-  sentence_start.shrink_to_fit();
+  SetWords(id2word);
+  this->data = FlatArray<int>(move(data));
+  this->sentence_id = FlatArray<int>(move(sentence_id));
+  this->sentence_start = FlatArray<int>(move(sentence_start));
+}
+
+void DataArray::SetWords(const vector<string>& words) {
+  vector<int64_t> offsets = {0};
+  string chars;
+  vector<uint64_t> hashes;
+  for (const string& word: words) {
+    chars += word;
+    offsets.push_back(chars.size());
+    hashes.push_back(HashFlatKey(word.data(), word.size()));
+  }
+  word_offsets = FlatArray<int64_t>(move(offsets));
+  word_chars = FlatArray<char>(vector<char>(chars.begin(), chars.end()));
+  word_index = FlatArray<int>(BuildFlatHashTable(hashes));
 }
 
 DataArray::~DataArray() {}
 
-vector<int> DataArray::GetData() const {
+FlatArray<int> DataArray::GetData() const {
   return data;
 }
 
@@ -91,17 +108,17 @@ int DataArray::AtIndex(int index) const {
 }
 
 string DataArray::GetWordAtIndex(int index) const {
-  return id2word[data[index]];
+  return GetWord(data[index]);
 }
 
-vector<int> DataArray::GetWordIds(int index, int size) const {
-  return vector<int>(data.begin() + index, data.begin() + index + size);
+FlatArray<int> DataArray::GetWordIds(int index, int size) const {
+  return data.Slice(index, size);
 }
 
 vector<string> DataArray::GetWords(int start_index, int size) const {
   vector<string> words;
   for (int word_id: GetWordIds(start_index, size)) {
-    words.push_back(id2word[word_id]);
+    words.push_back(GetWord(word_id));
   }
   return words;
 }
@@ -111,7 +128,7 @@ int DataArray::GetSize() const {
 }
 
 int DataArray::GetVocabularySize() const {
-  return id2word.size();
+  return word_offsets.size() - 1;
 }
 
 int DataArray::GetNumSentences() const {
@@ -132,17 +149,42 @@ int DataArray::GetSentenceId(int position) const {
 }
 
 int DataArray::GetWordId(const string& word) const {
-  auto result = word2id.find(word);
-  return result == word2id.end() ? -1 : result->second;
+  return FindInFlatHashTable(word_index, HashFlatKey(word.data(), word.size()),
+      [&](int word_id) {
+        return word_offsets[word_id + 1] - word_offsets[word_id] ==
+                   static_cast<int64_t>(word.size()) &&
+               equal(word.begin(), word.end(),
+                     word_chars.begin() + word_offsets[word_id]);
+      });
 }
 
 string DataArray::GetWord(int word_id) const {
-  return id2word[word_id];
+  return string(word_chars.begin() + word_offsets[word_id],
+                word_chars.begin() + word_offsets[word_id + 1]);
+}
+
+void DataArray::WriteFlat(FlatFileWriter& writer) const {
+  writer.WriteArray(word_offsets);
+  writer.WriteArray(word_chars);
+  writer.WriteArray(word_index);
+  writer.WriteArray(data);
+  writer.WriteArray(sentence_id);
+  writer.WriteArray(sentence_start);
+}
+
+void DataArray::ReadFlat(FlatFileReader& reader) {
+  word_offsets = reader.ReadArray<int64_t>();
+  word_chars = reader.ReadArray<char>();
+  word_index = reader.ReadArray<int>();
+  data = reader.ReadArray<int>();
+  sentence_id = reader.ReadArray<int>();
+  sentence_start = reader.ReadArray<int>();
 }
 
 bool DataArray::operator==(const DataArray& other) const {
-  return word2id == other.word2id && id2word == other.id2word &&
-         data == other.data && sentence_start == other.sentence_start &&
+  return word_offsets == other.word_offsets &&
+         word_chars == other.word_chars && data == other.data &&
+         sentence_start == other.sentence_start &&
          sentence_id == other.sentence_id;
 }
 
@@ -2,7 +2,6 @@
 #define _DATA_ARRAY_H_
 
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include <boost/serialization/serialization.hpp>
@@ -10,6 +9,8 @@
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/vector.hpp>
 
+#include "flat_file.h"
+
 using namespace std;
 
 namespace extractor {
@@ -28,6 +29,10 @@ enum Side {
  * index for each sentence and, for each token, the index of the sentence it
  * belongs to.
  *
+ * The words are kept in a string table with an open addressing hash index, so
+ * that the data array can be stored in a flat file and used in place after
+ * memory mapping it.
+ *
  * Note: This class has features for both the source and target data arrays.
  * Maybe we can save some memory by having more specific implementations (not
  * likely to save a lot of memory tough).
@@ -45,13 +50,16 @@ class DataArray {
   // Reads data array from bitext file where the sentences are separated by |||.
   DataArray(const string& filename, const Side& side);
 
+  // Creates data array from the given sentences.
+  DataArray(const vector<string>& sentences);
+
   // Creates empty data array.
   DataArray();
 
   virtual ~DataArray();
 
-  // Returns a vector containing the word ids.
-  virtual vector<int> GetData() const;
+  // Returns the word ids (without copying them).
+  virtual FlatArray<int> GetData() const;
 
   // Returns the word id at the specified position.
   virtual int AtIndex(int index) const;
@@ -60,8 +68,8 @@ class DataArray {
   virtual string GetWordAtIndex(int index) const;
 
   // Returns the substring of word ids starting at the specified position and
-  // having the specified length.
-  virtual vector<int> GetWordIds(int start_index, int size) const;
+  // having the specified length (as a view into the data array).
+  virtual FlatArray<int> GetWordIds(int start_index, int size) const;
 
   // Returns the substring of words starting at the specified position and
   // having the specified length.
@@ -92,42 +100,61 @@ class DataArray {
   // Returns the number of the sentence containing the given position.
   virtual int GetSentenceId(int position) const;
 
+  // Writes the data array in the flat format.
+  void WriteFlat(FlatFileWriter& writer) const;
+
+  // Reads a data array written by WriteFlat (the arrays are not copied).
+  void ReadFlat(FlatFileReader& reader);
+
   bool operator==(const DataArray& other) const;
 
  private:
-  // Sets up specific constants.
-  void InitializeDataArray();
-
   // Constructs the data array.
   void CreateDataArray(const vector<string>& lines);
 
+  // Builds the string table and the hash index for the given words.
+  void SetWords(const vector<string>& words);
+
   friend class boost::serialization::access;
 
   template<class Archive> void save(Archive& ar, unsigned int) const {
+    vector<string> id2word;
+    for (size_t i = 0; i + 1 < word_offsets.size(); ++i) {
+      id2word.push_back(string(word_chars.begin() + word_offsets[i],
+                               word_chars.begin() + word_offsets[i + 1]));
+    }
     ar << id2word;
-    ar << data;
-    ar << sentence_id;
-    ar << sentence_start;
+    vector<int> values = data.ToVector();
+    ar << values;
+    values = sentence_id.ToVector();
+    ar << values;
+    values = sentence_start.ToVector();
+    ar << values;
   }
 
   template<class Archive> void load(Archive& ar, unsigned int) {
+    vector<string> id2word;
     ar >> id2word;
-    for (size_t i = 0; i < id2word.size(); ++i) {
-      word2id[id2word[i]] = i;
-    }
-
-    ar >> data;
-    ar >> sentence_id;
-    ar >> sentence_start;
+    SetWords(id2word);
+
+    vector<int> values;
+    ar >> values;
+    data = FlatArray<int>(move(values));
+    ar >> values;
+    sentence_id = FlatArray<int>(move(values));
+    ar >> values;
+    sentence_start = FlatArray<int>(move(values));
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER();
 
-  unordered_map<string, int> word2id;
-  vector<string> id2word;
-  vector<int> data;
-  vector<int> sentence_id;
-  vector<int> sentence_start;
+  // Word i is word_chars[word_offsets[i]..word_offsets[i + 1]).
+  FlatArray<int64_t> word_offsets;
+  FlatArray<char> word_chars;
+  FlatArray<int> word_index;
+  FlatArray<int> data;
+  FlatArray<int> sentence_id;
+  FlatArray<int> sentence_start;
 };
 
 } // namespace extractor
@@ -36,7 +36,7 @@ TEST_F(DataArrayTest, TestGetData) {
       "ana", "are", "mere", ".", "__END_OF_LINE__",
       "ana", "bea", "mult", "lapte", ".", "__END_OF_LINE__"
   };
-  EXPECT_EQ(expected_source_data, source_data.GetData());
+  EXPECT_EQ(expected_source_data, source_data.GetData().ToVector());
   EXPECT_EQ(expected_source_data.size(), source_data.GetSize());
   for (size_t i = 0; i < expected_source_data.size(); ++i) {
     EXPECT_EQ(expected_source_data[i], source_data.AtIndex(i));
@@ -48,7 +48,7 @@ TEST_F(DataArrayTest, TestGetData) {
       "anna", "has", "apples", ".", "__END_OF_LINE__",
       "anna", "drinks", "a", "lot", "of", "milk", ".", "__END_OF_LINE__"
   };
-  EXPECT_EQ(expected_target_data, target_data.GetData());
+  EXPECT_EQ(expected_target_data, target_data.GetData().ToVector());
   EXPECT_EQ(expected_target_data.size(), target_data.GetSize());
   for (size_t i = 0; i < expected_target_data.size(); ++i) {
     EXPECT_EQ(expected_target_data[i], target_data.AtIndex(i));
@@ -59,12 +59,12 @@ TEST_F(DataArrayTest, TestGetData) {
 TEST_F(DataArrayTest, TestSubstrings) {
   vector<int> expected_word_ids = {3, 4, 5};
   vector<string> expected_words = {"are", "mere", "."};
-  EXPECT_EQ(expected_word_ids, source_data.GetWordIds(1, 3));
+  EXPECT_EQ(expected_word_ids, source_data.GetWordIds(1, 3).ToVector());
   EXPECT_EQ(expected_words, source_data.GetWords(1, 3));
 
   expected_word_ids = {7, 8};
   expected_words = {"a", "lot"};
-  EXPECT_EQ(expected_word_ids, target_data.GetWordIds(7, 2));
+  EXPECT_EQ(expected_word_ids, target_data.GetWordIds(7, 2).ToVector());
   EXPECT_EQ(expected_words, target_data.GetWords(7, 2));
 }
 
@@ -119,5 +119,27 @@ TEST_F(DataArrayTest, TestSerialization) {
   EXPECT_EQ(target_data, target_copy);
 }
 
+TEST_F(DataArrayTest, TestFlatFile) {
+  fs::path path = fs::temp_directory_path() / fs::unique_path();
+  {
+    FlatFileWriter writer(path.string(), FLAT_DATA_ARRAY);
+    source_data.WriteFlat(writer);
+    target_data.WriteFlat(writer);
+  }
+
+  DataArray source_copy, target_copy;
+  FlatFileReader reader(path.string(), FLAT_DATA_ARRAY);
+  source_copy.ReadFlat(reader);
+  target_copy.ReadFlat(reader);
+  // The file stays mapped after it is removed.
+  fs::remove(path);
+
+  EXPECT_EQ(source_data, source_copy);
+  EXPECT_EQ(target_data, target_copy);
+  EXPECT_EQ(4, source_copy.GetWordId("mere"));
+  EXPECT_EQ(-1, source_copy.GetWordId("apples"));
+  EXPECT_EQ("apples", target_copy.GetWord(4));
+}
+
 } // namespace
 } // namespace extractor
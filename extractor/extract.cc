@@ -1,10 +1,13 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/archive/binary_iarchive.hpp>
+#include <boost/asio.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -25,8 +28,11 @@
 #include "features/max_lex_target_given_source.h"
 #include "features/sample_source_count.h"
 #include "features/target_given_source_coherent.h"
+#include "flat_file.h"
 #include "grammar.h"
 #include "grammar_extractor.h"
+#include "grammar_stream.h"
+#include "online_index.h"
 #include "precomputation.h"
 #include "rule.h"
 #include "scorer.h"
@@ -38,14 +44,23 @@
 namespace ar = boost::archive;
 namespace fs = boost::filesystem;
 namespace po = boost::program_options;
+using boost::asio::ip::tcp;
 using namespace extractor;
 using namespace features;
 using namespace std;
 
-// Returns the file path in which a given grammar should be written.
-fs::path GetGrammarFilePath(const fs::path& grammar_path, int file_number, bool use_zip) {
-  string file_name = "grammar." + to_string(file_number) + (use_zip ? ".gz" : "");
-  return grammar_path / file_name;
+// Reads a data structure compiled by sacompile. Flat files are memory mapped
+// and used in place, while boost archives are deserialized.
+template<class T>
+void ReadCompiled(const string& filename, FlatFileType type, T& object) {
+  if (FlatFileReader::IsFlatFile(filename)) {
+    FlatFileReader reader(filename, type);
+    object.ReadFlat(reader);
+  } else {
+    ifstream fstream(filename);
+    ar::binary_iarchive stream(fstream);
+    stream >> object;
+  }
 }
 
 int main(int argc, char** argv) {
@@ -58,8 +73,25 @@ int main(int argc, char** argv) {
   general_options.add_options()
     ("threads,t", po::value<int>()->required()->default_value(1),
      threads_option.c_str())
-    ("grammars,g", po::value<string>()->required(), "Grammars output path")
+    ("grammars,g", po::value<string>(),
+        "Grammars output path (not needed for inline grammars)")
     ("gzip,z", "Gzip grammars")
+    ("grammar_format", po::value<string>()->default_value("files"),
+        "How grammars are passed on: files (one file per sentence), inline "
+        "(the rules follow the <seg> line and end with an empty line) or "
+        "indexed (a single file, the <seg> line gives the offset and size)")
+    ("binary_grammars", "Write the grammars in the binary format read by "
+        "the decoder (smaller and faster to load than text grammars)")
+    ("streaming", "Extract sentences as they arrive and write each <seg> line "
+        "as soon as the previous ones are done")
+    ("reorder_buffer", po::value<int>()->default_value(100),
+        "Maximum number of sentences read ahead of the first one not written "
+        "yet in streaming mode")
+    ("online", "Accept \"LEARN ||| source ||| target ||| alignment\" input "
+        "lines adding sentence pairs to the data used for the following "
+        "sentences (implies --streaming)")
+    ("port", po::value<int>(),
+        "Serve clients connecting on this TCP port (implies --streaming)")
     ("max_rule_span", po::value<int>()->default_value(15),
         "Maximum rule span")
     ("max_rule_symbols", po::value<int>()->default_value(5),
@@ -71,6 +103,9 @@ int main(int argc, char** argv) {
         "Maximum number of samples")
     ("tight_phrases", po::value<bool>()->default_value(true),
         "False if phrases may be loose (better, but slower)")
+    ("rule_cache_size", po::value<int>()->default_value(200000),
+        "Maximum number of rules kept in the cache shared across sentences "
+        "(0 disables the cache)")
     ("leave_one_out", po::value<bool>()->zero_tokens(),
         "do leave-one-out estimation of grammars "
         "(e.g. for extracting grammars for the training set");
@@ -115,14 +150,37 @@ int main(int argc, char** argv) {
   int num_threads = vm["threads"].as<int>();
   cerr << "Grammar extraction will use " << num_threads << " threads." << endl;
 
+  GrammarFormat grammar_format;
+  if (!ParseGrammarFormat(vm["grammar_format"].as<string>(), &grammar_format)) {
+    cerr << "Unknown grammar format: " << vm["grammar_format"].as<string>()
+         << endl;
+    return 1;
+  }
+  if (grammar_format != GRAMMAR_INLINE && !vm.count("grammars")) {
+    cerr << "The grammars output path (-g) is required." << endl;
+    return 1;
+  }
+  const bool use_zip = vm.count("gzip");
+  if (use_zip && grammar_format != GRAMMAR_FILES) {
+    cerr << "Only grammars written to separate files can be gzipped." << endl;
+    return 1;
+  }
+  const bool use_binary = vm.count("binary_grammars");
+  if (use_binary && grammar_format == GRAMMAR_INLINE) {
+    cerr << "Inline grammars can only be written as text." << endl;
+    return 1;
+  }
+  if (vm["reorder_buffer"].as<int>() < 1) {
+    cerr << "The reorder buffer must hold at least one sentence." << endl;
+    return 1;
+  }
+
   Clock::time_point read_start_time = Clock::now();
 
   Clock::time_point start_time = Clock::now();
   cerr << "Reading target data in binary format..." << endl;
   shared_ptr<DataArray> target_data_array = make_shared<DataArray>();
-  ifstream target_fstream(vm["target"].as<string>());
-  ar::binary_iarchive target_stream(target_fstream);
-  target_stream >> *target_data_array;
+  ReadCompiled(vm["target"].as<string>(), FLAT_DATA_ARRAY, *target_data_array);
   Clock::time_point end_time = Clock::now();
   cerr << "Reading target data took " << GetDuration(start_time, end_time)
        << " seconds" << endl;
@@ -130,9 +188,8 @@ int main(int argc, char** argv) {
   start_time = Clock::now();
   cerr << "Reading source suffix array in binary format..." << endl;
   shared_ptr<SuffixArray> source_suffix_array = make_shared<SuffixArray>();
-  ifstream source_fstream(vm["source"].as<string>());
-  ar::binary_iarchive source_stream(source_fstream);
-  source_stream >> *source_suffix_array;
+  ReadCompiled(vm["source"].as<string>(), FLAT_SUFFIX_ARRAY,
+               *source_suffix_array);
   end_time = Clock::now();
   cerr << "Reading source suffix array took "
        << GetDuration(start_time, end_time) << " seconds" << endl;
@@ -140,9 +197,7 @@ int main(int argc, char** argv) {
   start_time = Clock::now();
   cerr << "Reading alignment in binary format..." << endl;
   shared_ptr<Alignment> alignment = make_shared<Alignment>();
-  ifstream alignment_fstream(vm["alignment"].as<string>());
-  ar::binary_iarchive alignment_stream(alignment_fstream);
-  alignment_stream >> *alignment;
+  ReadCompiled(vm["alignment"].as<string>(), FLAT_ALIGNMENT, *alignment);
   end_time = Clock::now();
   cerr << "Reading alignment took " << GetDuration(start_time, end_time)
        << " seconds" << endl;
@@ -150,9 +205,8 @@ int main(int argc, char** argv) {
   start_time = Clock::now();
   cerr << "Reading precomputation in binary format..." << endl;
   shared_ptr<Precomputation> precomputation = make_shared<Precomputation>();
-  ifstream precomputation_fstream(vm["precomputation"].as<string>());
-  ar::binary_iarchive precomputation_stream(precomputation_fstream);
-  precomputation_stream >> *precomputation;
+  ReadCompiled(vm["precomputation"].as<string>(), FLAT_PRECOMPUTATION,
+               *precomputation);
   end_time = Clock::now();
   cerr << "Reading precomputation took " << GetDuration(start_time, end_time)
        << " seconds" << endl;
@@ -170,9 +224,17 @@ int main(int argc, char** argv) {
   start_time = Clock::now();
   cerr << "Reading translation table in binary format..." << endl;
   shared_ptr<TranslationTable> table = make_shared<TranslationTable>();
-  ifstream ttable_fstream(vm["ttable"].as<string>());
-  ar::binary_iarchive ttable_stream(ttable_fstream);
-  ttable_stream >> *table;
+  string ttable_path = vm["ttable"].as<string>();
+  if (FlatFileReader::IsFlatFile(ttable_path)) {
+    // The flat table shares the data arrays read above.
+    FlatFileReader ttable_reader(ttable_path, FLAT_TRANSLATION_TABLE);
+    table->ReadFlat(ttable_reader, source_suffix_array->GetData(),
+                    target_data_array);
+  } else {
+    ifstream ttable_fstream(ttable_path);
+    ar::binary_iarchive ttable_stream(ttable_fstream);
+    ttable_stream >> *table;
+  }
   end_time = Clock::now();
   cerr << "Reading translation table took " << GetDuration(start_time, end_time)
        << " seconds" << endl;
@@ -194,6 +256,16 @@ int main(int argc, char** argv) {
   };
   shared_ptr<Scorer> scorer = make_shared<Scorer>(features);
 
+  // The sentence pairs added online are indexed in the background.
+  shared_ptr<OnlineIndex> online_index;
+  CommandFunction command;
+  if (vm.count("online")) {
+    online_index = make_shared<OnlineIndex>(table);
+    command = [&](const string& line) {
+      return online_index->HandleLearnCommand(line);
+    };
+  }
+
   GrammarExtractor extractor(
       source_suffix_array,
       target_data_array,
@@ -206,50 +278,77 @@ int main(int argc, char** argv) {
       vm["max_nonterminals"].as<int>(),
       vm["max_rule_symbols"].as<int>(),
       vm["max_samples"].as<int>(),
-      vm["tight_phrases"].as<bool>());
-  const bool use_zip = vm.count("gzip");
-
-  // Creates the grammars directory if it doesn't exist.
-  fs::path grammar_path = vm["grammars"].as<string>();
-  if (!fs::is_directory(grammar_path)) {
-    fs::create_directory(grammar_path);
-  }
-  grammar_path = fs::canonical(grammar_path);
-
-  // Reads all sentences for which we extract grammar rules (the paralellization
-  // is simplified if we read all sentences upfront).
-  string sentence;
-  vector<string> sentences;
-  while (getline(cin, sentence)) {
-    sentences.push_back(sentence);
+      vm["tight_phrases"].as<bool>(),
+      vm["rule_cache_size"].as<int>(),
+      online_index);
+  // The <seg> lines point at the grammars through absolute paths, so that the
+  // decoder can be run from another directory.
+  string grammar_path;
+  if (grammar_format != GRAMMAR_INLINE) {
+    fs::path path = vm["grammars"].as<string>();
+    if (!fs::is_directory(path)) {
+      fs::create_directory(path);
+    }
+    grammar_path = fs::canonical(path).string();
   }
+  GrammarWriter writer(grammar_path, grammar_format, use_zip);
 
-  // Extracts the grammar for each sentence and saves it to a file.
-  vector<string> suffixes(sentences.size());
   bool leave_one_out = vm.count("leave_one_out");
-  #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
-  for (size_t i = 0; i < sentences.size(); ++i) {
-    string suffix;
-    int position = sentences[i].find("|||");
-    if (position != sentences[i].npos) {
-      suffix = sentences[i].substr(position);
-      sentences[i] = sentences[i].substr(0, position);
-    }
-    suffixes[i] = suffix;
-
+  ExtractFunction extract = [&](int sentence_id, const string& sentence) {
     unordered_set<int> blacklisted_sentence_ids;
     if (leave_one_out) {
-      blacklisted_sentence_ids.insert(i);
+      blacklisted_sentence_ids.insert(sentence_id);
     }
-    Grammar grammar = extractor.GetGrammar(
-        sentences[i], blacklisted_sentence_ids);
-    WriteFile wf(GetGrammarFilePath(grammar_path, i, use_zip).c_str());
-    *wf.stream() << grammar;
-  }
+    Grammar grammar = extractor.GetGrammar(sentence, blacklisted_sentence_ids);
+    ostringstream rules;
+    if (use_binary) {
+      grammar.WriteBinary(rules);
+    } else {
+      rules << grammar;
+    }
+    return rules.str();
+  };
 
-  for (size_t i = 0; i < sentences.size(); ++i) {
-    cout << "<seg grammar=" << GetGrammarFilePath(grammar_path, i, use_zip) << " id=\""
-         << i << "\"> " << sentences[i] << " </seg> " << suffixes[i] << endl;
+  int reorder_buffer = vm["reorder_buffer"].as<int>();
+  if (vm.count("port")) {
+    // Serves one client at a time. Sentence ids keep increasing across
+    // clients, so grammar files are never overwritten.
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor(io_service,
+                           tcp::endpoint(tcp::v4(), vm["port"].as<int>()));
+    cerr << "Listening on port " << vm["port"].as<int>() << "..." << endl;
+    int num_sentences = 0;
+    while (true) {
+      tcp::iostream stream;
+      acceptor.accept(*stream.rdbuf());
+      num_sentences += StreamGrammars(stream, stream, num_sentences,
+                                      num_threads, reorder_buffer, extract,
+                                      writer, command);
+    }
+  } else if (vm.count("streaming") || vm.count("online")) {
+    StreamGrammars(cin, cout, 0, num_threads, reorder_buffer, extract, writer,
+                   command);
+  } else {
+    // Reads all sentences for which we extract grammar rules (the
+    // paralellization is simplified if we read all sentences upfront).
+    string line;
+    vector<string> lines;
+    while (getline(cin, line)) {
+      lines.push_back(line);
+    }
+
+    // Extracts the grammar for each sentence and saves it to a file.
+    vector<ExtractedGrammar> grammars(lines.size());
+    #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t i = 0; i < lines.size(); ++i) {
+      SplitInputLine(lines[i], &grammars[i].sentence, &grammars[i].suffix);
+      grammars[i].rules = extract(i, grammars[i].sentence);
+      writer.WriteGrammarFile(i, grammars[i]);
+    }
+
+    for (size_t i = 0; i < grammars.size(); ++i) {
+      writer.WriteSegment(i, grammars[i], cout);
+    }
   }
 
   Clock::time_point extraction_stop_time = Clock::now();
@@ -31,7 +31,7 @@ PhraseLocation FastIntersector::Intersect(
     PhraseLocation& prefix_location,
     PhraseLocation& suffix_location,
     const Phrase& phrase) {
-  vector<int> symbols = phrase.Get();
+  const vector<int>& symbols = phrase.Get();
 
   // We should never attempt to do an intersect query for a pattern starting or
   // ending with a non terminal. The RuleFactory should handle these cases,
@@ -68,7 +68,7 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
     PhraseLocation& prefix_location, const Phrase& phrase,
     bool prefix_ends_with_x, int next_symbol) const {
   ExtendPhraseLocation(prefix_location);
-  vector<int> positions = *prefix_location.matchings;
+  const FlatArray<int>& positions = prefix_location.matchings;
   int num_subpatterns = prefix_location.num_subpatterns;
 
   vector<int> new_positions;
@@ -114,7 +114,7 @@ PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
     PhraseLocation& suffix_location, const Phrase& phrase,
     bool suffix_starts_with_x, int prev_symbol) const {
   ExtendPhraseLocation(suffix_location);
-  vector<int> positions = *suffix_location.matchings;
+  const FlatArray<int>& positions = suffix_location.matchings;
   int num_subpatterns = suffix_location.num_subpatterns;
 
   vector<int> new_positions;
@@ -154,16 +154,16 @@ PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
 }
 
 void FastIntersector::ExtendPhraseLocation(PhraseLocation& location) const {
-  if (location.matchings != NULL) {
+  if (location.HasMatchings()) {
     return;
   }
 
-  location.num_subpatterns = 1;
-  location.matchings = make_shared<vector<int>>();
+  vector<int> matchings;
+  matchings.reserve(location.sa_high - location.sa_low);
   for (int i = location.sa_low; i < location.sa_high; ++i) {
-    location.matchings->push_back(suffix_array->GetSuffix(i));
+    matchings.push_back(suffix_array->GetSuffix(i));
   }
-  location.sa_low = location.sa_high = 0;
+  location = PhraseLocation(move(matchings), 1);
 }
 
 pair<int, int> FastIntersector::GetSearchRange(bool has_marginal_x) const {
@@ -0,0 +1,151 @@
+#include "flat_file.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "murmur_hash3.h"
+
+using namespace std;
+
+namespace extractor {
+
+namespace {
+
+const char FLAT_FILE_MAGIC[8] = {'C', 'D', 'E', 'C', 'F', 'L', 'A', 'T'};
+const uint32_t FLAT_FILE_VERSION = 2;
+const size_t FLAT_FILE_ALIGNMENT = 8;
+const uint32_t FLAT_HASH_SEED = 0x9e3779b9;
+
+size_t PaddingSize(size_t num_bytes) {
+  return (FLAT_FILE_ALIGNMENT - num_bytes % FLAT_FILE_ALIGNMENT) %
+      FLAT_FILE_ALIGNMENT;
+}
+
+} // namespace
+
+MappedFile::MappedFile(const string& filename) :
+    filename(filename), data(NULL), size(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    cerr << "Failed to open " << filename << endl;
+    abort();
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1) {
+    cerr << "Failed to stat " << filename << endl;
+    abort();
+  }
+  size = file_stat.st_size;
+  if (size > 0) {
+    data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      cerr << "Failed to map " << filename << " into memory" << endl;
+      abort();
+    }
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (size > 0) {
+    munmap(data, size);
+  }
+}
+
+const char* MappedFile::GetData() const {
+  return reinterpret_cast<const char*>(data);
+}
+
+size_t MappedFile::GetSize() const {
+  return size;
+}
+
+FlatFileWriter::FlatFileWriter(const string& filename, FlatFileType type) :
+    filename(filename), stream(filename, ios_base::binary) {
+  if (!stream) {
+    cerr << "Failed to open " << filename << " for writing" << endl;
+    abort();
+  }
+  WriteBytes(FLAT_FILE_MAGIC, sizeof(FLAT_FILE_MAGIC));
+  Write<uint32_t>(FLAT_FILE_VERSION);
+  Write<uint32_t>(type);
+}
+
+void FlatFileWriter::WriteBytes(const void* bytes, size_t num_bytes) {
+  static const char padding[FLAT_FILE_ALIGNMENT] = {0};
+  stream.write(reinterpret_cast<const char*>(bytes), num_bytes);
+  stream.write(padding, PaddingSize(num_bytes));
+  if (!stream) {
+    cerr << "Failed to write to " << filename << endl;
+    abort();
+  }
+}
+
+FlatFileReader::FlatFileReader(const string& filename, FlatFileType type) :
+    file(make_shared<MappedFile>(filename)), offset(0) {
+  const char* magic = ReadBytes(sizeof(FLAT_FILE_MAGIC));
+  if (memcmp(magic, FLAT_FILE_MAGIC, sizeof(FLAT_FILE_MAGIC))) {
+    cerr << filename << " is not a compiled extractor file" << endl;
+    abort();
+  }
+  uint32_t version = Read<uint32_t>();
+  if (version != FLAT_FILE_VERSION) {
+    cerr << filename << " has format version " << version << " instead of "
+         << FLAT_FILE_VERSION << ", recompile it with sacompile" << endl;
+    abort();
+  }
+  uint32_t file_type = Read<uint32_t>();
+  if (file_type != type) {
+    cerr << filename << " holds the wrong type of data structure" << endl;
+    abort();
+  }
+}
+
+bool FlatFileReader::IsFlatFile(const string& filename) {
+  char magic[sizeof(FLAT_FILE_MAGIC)];
+  ifstream stream(filename, ios_base::binary);
+  return stream.read(magic, sizeof(magic)) &&
+         !memcmp(magic, FLAT_FILE_MAGIC, sizeof(FLAT_FILE_MAGIC));
+}
+
+const char* FlatFileReader::ReadBytes(size_t num_bytes) {
+  size_t item_size = num_bytes + PaddingSize(num_bytes);
+  if (item_size > file->GetSize() - offset) {
+    cerr << "Unexpected end of compiled extractor file" << endl;
+    abort();
+  }
+  const char* bytes = file->GetData() + offset;
+  offset += item_size;
+  return bytes;
+}
+
+vector<int> BuildFlatHashTable(const vector<uint64_t>& hashes) {
+  size_t num_slots = 1;
+  while (num_slots < 2 * hashes.size()) {
+    num_slots <<= 1;
+  }
+  vector<int> slots(num_slots, -1);
+  size_t mask = num_slots - 1;
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    size_t slot = hashes[i] & mask;
+    while (slots[slot] != -1) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = i;
+  }
+  return slots;
+}
+
+uint64_t HashFlatKey(const char* key, size_t length) {
+  return cdec::MurmurHash3_64(key, length, FLAT_HASH_SEED);
+}
+
+uint64_t HashFlatKey(const int* key, size_t length) {
+  return cdec::MurmurHash3_64(key, length * sizeof(int), FLAT_HASH_SEED);
+}
+
+} // namespace extractor
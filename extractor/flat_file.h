@@ -0,0 +1,210 @@
+#ifndef _FLAT_FILE_H_
+#define _FLAT_FILE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace extractor {
+
+// Types of data structures stored in flat files.
+enum FlatFileType {
+  FLAT_DATA_ARRAY = 1,
+  FLAT_SUFFIX_ARRAY = 2,
+  FLAT_ALIGNMENT = 3,
+  FLAT_PRECOMPUTATION = 4,
+  FLAT_TRANSLATION_TABLE = 5
+};
+
+/**
+ * Read-only memory mapping of a whole file.
+ *
+ * The pages are shared between all the processes mapping the same file, so
+ * several extractors running on the same machine hold a single copy of the
+ * compiled data.
+ */
+class MappedFile {
+ public:
+  MappedFile(const string& filename);
+
+  ~MappedFile();
+
+  const char* GetData() const;
+
+  size_t GetSize() const;
+
+ private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  string filename;
+  void* data;
+  size_t size;
+};
+
+/**
+ * Immutable array which either owns its elements or is a view of elements
+ * owned by someone else (a memory mapped file or another array), in which case
+ * it keeps the owner alive. Copies and slices share the same elements, so
+ * FlatArrays can be passed around by value without copying the data.
+ */
+template<typename T>
+class FlatArray {
+ public:
+  FlatArray() : first(NULL), length(0) {}
+
+  explicit FlatArray(vector<T> values) {
+    shared_ptr<vector<T>> elements = make_shared<vector<T>>();
+    elements->swap(values);
+    owner = elements;
+    first = elements->data();
+    length = elements->size();
+  }
+
+  FlatArray(shared_ptr<const void> owner, const T* first, size_t length) :
+      owner(owner), first(first), length(length) {}
+
+  const T& operator[](size_t index) const {
+    return first[index];
+  }
+
+  size_t size() const {
+    return length;
+  }
+
+  bool empty() const {
+    return length == 0;
+  }
+
+  const T* begin() const {
+    return first;
+  }
+
+  const T* end() const {
+    return first + length;
+  }
+
+  // Returns a view of length elements starting from offset.
+  FlatArray<T> Slice(size_t offset, size_t length) const {
+    return FlatArray<T>(owner, first + offset, length);
+  }
+
+  vector<T> ToVector() const {
+    return vector<T>(begin(), end());
+  }
+
+  bool operator==(const FlatArray<T>& other) const {
+    return length == other.length && equal(begin(), end(), other.begin());
+  }
+
+ private:
+  shared_ptr<const void> owner;
+  const T* first;
+  size_t length;
+};
+
+/**
+ * Writes data structures in the flat format read by FlatFileReader.
+ *
+ * A flat file starts with a header (magic string, format version and the type
+ * of the stored data structure) followed by a sequence of scalars and arrays.
+ * Every item starts at an offset aligned to 8 bytes, so arrays can be used in
+ * place once the file is memory mapped. Values are stored in the native byte
+ * order.
+ */
+class FlatFileWriter {
+ public:
+  FlatFileWriter(const string& filename, FlatFileType type);
+
+  template<typename T> void Write(const T& value) {
+    WriteBytes(&value, sizeof(T));
+  }
+
+  template<typename T> void WriteArray(const T* values, size_t length) {
+    Write<uint64_t>(length);
+    WriteBytes(values, length * sizeof(T));
+  }
+
+  template<typename T> void WriteArray(const vector<T>& values) {
+    WriteArray(values.data(), values.size());
+  }
+
+  template<typename T> void WriteArray(const FlatArray<T>& values) {
+    WriteArray(values.begin(), values.size());
+  }
+
+ private:
+  void WriteBytes(const void* bytes, size_t num_bytes);
+
+  string filename;
+  ofstream stream;
+};
+
+/**
+ * Reads data structures from a memory mapped flat file. Arrays point directly
+ * into the mapping.
+ */
+class FlatFileReader {
+ public:
+  FlatFileReader(const string& filename, FlatFileType type);
+
+  // Returns whether the file starts with the header of a flat file.
+  static bool IsFlatFile(const string& filename);
+
+  template<typename T> T Read() {
+    T value;
+    memcpy(&value, ReadBytes(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  template<typename T> FlatArray<T> ReadArray() {
+    size_t length = Read<uint64_t>();
+    const T* values =
+        reinterpret_cast<const T*>(ReadBytes(length * sizeof(T)));
+    return FlatArray<T>(file, values, length);
+  }
+
+ private:
+  const char* ReadBytes(size_t num_bytes);
+
+  shared_ptr<const MappedFile> file;
+  size_t offset;
+};
+
+// Open addressing hash tables are stored as an array of slots holding entry
+// indexes (-1 marks an empty slot) and are probed linearly. The number of
+// slots is a power of 2, at least twice the number of entries.
+vector<int> BuildFlatHashTable(const vector<uint64_t>& hashes);
+
+// Returns the index of the entry with the given hash for which the predicate
+// holds or -1 if there is no such entry.
+template<typename Predicate>
+int FindInFlatHashTable(const FlatArray<int>& slots, uint64_t hash,
+                        Predicate matches) {
+  if (slots.empty()) {
+    return -1;
+  }
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask; slots[i] != -1; i = (i + 1) & mask) {
+    if (matches(slots[i])) {
+      return slots[i];
+    }
+  }
+  return -1;
+}
+
+// Hash functions for the keys of the flat hash tables. They must not change
+// between the time the tables are compiled and the time they are used.
+uint64_t HashFlatKey(const char* key, size_t length);
+
+uint64_t HashFlatKey(const int* key, size_t length);
+
+} // namespace extractor
+
+#endif
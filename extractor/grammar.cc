@@ -1,6 +1,8 @@
 #include "grammar.h"
 
+#include <cstdint>
 #include <iomanip>
+#include <unordered_map>
 
 #include "rule.h"
 
@@ -20,6 +22,108 @@ vector<string> Grammar::GetFeatureNames() const {
   return feature_names;
 }
 
+namespace {
+
+template<typename T> void WriteValue(ostream& os, const T& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void WriteString(ostream& os, const string& value) {
+  WriteValue<uint32_t>(os, value.size());
+  os.write(value.data(), value.size());
+}
+
+const char kBinaryMagic[] = "\0cdecgrm";
+const int kBinaryMagicSize = 8;
+const uint32_t kBinaryVersion = 1;
+
+// Assigns indexes to the words of a binary grammar.
+class SymbolTable {
+ public:
+  int GetIndex(const string& word) {
+    auto result = indexes.insert(make_pair(word, (int) words.size()));
+    if (result.second) {
+      words.push_back(word);
+    }
+    return result.first->second;
+  }
+
+  // Converts the symbols of a phrase. Nonterminals are encoded as -1 - the
+  // index of their category on the source side and as -k (for [X,k]) on the
+  // target side.
+  vector<int32_t> Encode(const Phrase& phrase, bool source_side) {
+    vector<string> phrase_words = phrase.GetWords();
+    vector<int32_t> encoding;
+    int next_word = 0;
+    for (int symbol: phrase.Get()) {
+      if (symbol < 0) {
+        encoding.push_back(source_side ? -1 - GetIndex("X") : symbol);
+      } else {
+        encoding.push_back(GetIndex(phrase_words[next_word++]));
+      }
+    }
+    return encoding;
+  }
+
+  const vector<string>& GetWords() const {
+    return words;
+  }
+
+ private:
+  unordered_map<string, int> indexes;
+  vector<string> words;
+};
+
+} // namespace
+
+void Grammar::WriteBinary(ostream& os) const {
+  // The symbol table is written first, so the rules are encoded upfront.
+  SymbolTable symbols;
+  int32_t lhs = symbols.GetIndex("X");
+  vector<vector<int32_t>> source_sides, target_sides;
+  for (const Rule& rule: rules) {
+    source_sides.push_back(symbols.Encode(rule.source_phrase, true));
+    target_sides.push_back(symbols.Encode(rule.target_phrase, false));
+  }
+
+  os.write(kBinaryMagic, kBinaryMagicSize);
+  WriteValue(os, kBinaryVersion);
+  WriteValue<uint32_t>(os, symbols.GetWords().size());
+  for (const string& word: symbols.GetWords()) {
+    WriteString(os, word);
+  }
+  WriteValue<uint32_t>(os, feature_names.size());
+  for (const string& feature_name: feature_names) {
+    WriteString(os, feature_name);
+  }
+
+  WriteValue<uint32_t>(os, rules.size());
+  for (size_t i = 0; i < rules.size(); ++i) {
+    const Rule& rule = rules[i];
+    WriteValue(os, lhs);
+    WriteValue<uint16_t>(os, source_sides[i].size());
+    WriteValue<uint16_t>(os, target_sides[i].size());
+    WriteValue<uint16_t>(os, rule.scores.size());
+    WriteValue<uint16_t>(os, rule.alignment.size());
+    for (int32_t symbol: source_sides[i]) {
+      WriteValue(os, symbol);
+    }
+    for (int32_t symbol: target_sides[i]) {
+      WriteValue(os, symbol);
+    }
+    for (size_t j = 0; j < rule.scores.size(); ++j) {
+      WriteValue<uint16_t>(os, j);
+    }
+    for (double score: rule.scores) {
+      WriteValue<float>(os, score);
+    }
+    for (auto link: rule.alignment) {
+      WriteValue<int16_t>(os, link.first);
+      WriteValue<int16_t>(os, link.second);
+    }
+  }
+}
+
 ostream& operator<<(ostream& os, const Grammar& grammar) {
   vector<Rule> rules = grammar.GetRules();
   vector<string> feature_names = grammar.GetFeatureNames();
@@ -22,6 +22,13 @@ class Grammar {
 
   vector<string> GetFeatureNames() const;
 
+  // Writes the rules in the compact binary format read by the decoder's
+  // TextGrammar (described in decoder/grammar.cc): a table with the words and
+  // feature names used by the grammar followed by the rules as arrays of
+  // symbol and feature indexes. The decoder can read these grammars without
+  // tokenizing them and looks up every word only once per sentence.
+  void WriteBinary(ostream& os) const;
+
   friend ostream& operator<<(ostream& os, const Grammar& grammar);
 
  private:
@@ -22,12 +22,14 @@ GrammarExtractor::GrammarExtractor(
     shared_ptr<Scorer> scorer, shared_ptr<Vocabulary> vocabulary,
     int min_gap_size, int max_rule_span,
     int max_nonterminals, int max_rule_symbols, int max_samples,
-    bool require_tight_phrases) :
+    bool require_tight_phrases, int max_cached_rules,
+    shared_ptr<OnlineIndex> online_index) :
     vocabulary(vocabulary),
     rule_factory(make_shared<HieroCachingRuleFactory>(
         source_suffix_array, target_data_array, alignment, vocabulary,
         precomputation, scorer, min_gap_size, max_rule_span, max_nonterminals,
-        max_rule_symbols, max_samples, require_tight_phrases)) {}
+        max_rule_symbols, max_samples, require_tight_phrases,
+        max_cached_rules, online_index)) {}
 
 GrammarExtractor::GrammarExtractor(
     shared_ptr<Vocabulary> vocabulary,
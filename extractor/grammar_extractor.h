@@ -14,6 +14,7 @@ class Alignment;
 class DataArray;
 class Grammar;
 class HieroCachingRuleFactory;
+class OnlineIndex;
 class Precomputation;
 class Scorer;
 class SuffixArray;
@@ -21,7 +22,8 @@ class Vocabulary;
 
 /**
  * Class wrapping all the logic for extracting the synchronous context free
- * grammars.
+ * grammars. The online index (which may be NULL) holds the sentence pairs
+ * added after the data was compiled.
  */
 class GrammarExtractor {
  public:
@@ -37,7 +39,9 @@ class GrammarExtractor {
       int max_nonterminals,
       int max_rule_symbols,
       int max_samples,
-      bool require_tight_phrases);
+      bool require_tight_phrases,
+      int max_cached_rules,
+      shared_ptr<OnlineIndex> online_index);
 
   // For testing only.
   GrammarExtractor(shared_ptr<Vocabulary> vocabulary,
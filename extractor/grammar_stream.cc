@@ -0,0 +1,162 @@
+#include "grammar_stream.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+#include <boost/filesystem.hpp>
+
+#include "filelib.h"
+
+namespace fs = boost::filesystem;
+using namespace std;
+
+namespace extractor {
+
+bool ParseGrammarFormat(const string& name, GrammarFormat* format) {
+  if (name == "files") {
+    *format = GRAMMAR_FILES;
+  } else if (name == "inline") {
+    *format = GRAMMAR_INLINE;
+  } else if (name == "indexed") {
+    *format = GRAMMAR_INDEXED;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void SplitInputLine(const string& line, string* sentence, string* suffix) {
+  size_t position = line.find("|||");
+  if (position != line.npos) {
+    *suffix = line.substr(position);
+    *sentence = line.substr(0, position);
+  } else {
+    suffix->clear();
+    *sentence = line;
+  }
+}
+
+GrammarWriter::GrammarWriter(const string& path, GrammarFormat format,
+                             bool use_zip) :
+    format(format), use_zip(use_zip) {
+  if (format == GRAMMAR_INLINE) {
+    return;
+  }
+
+  // Creates the grammars directory if it doesn't exist.
+  if (!fs::is_directory(path)) {
+    fs::create_directory(path);
+  }
+  grammar_path = path;
+
+  if (format == GRAMMAR_INDEXED) {
+    indexed_path = (fs::path(grammar_path) / "grammars").string();
+    indexed_stream.open(indexed_path.c_str(), ios_base::binary);
+    string index_path = (fs::path(grammar_path) / "grammars.index").string();
+    index_stream.open(index_path.c_str());
+    if (!indexed_stream || !index_stream) {
+      cerr << "Failed to open " << indexed_path << " for writing" << endl;
+      abort();
+    }
+  }
+}
+
+string GrammarWriter::GetGrammarFilePath(int sentence_id) const {
+  string file_name = "grammar." + to_string(sentence_id) +
+                     (use_zip ? ".gz" : "");
+  return (fs::path(grammar_path) / file_name).string();
+}
+
+void GrammarWriter::WriteGrammarFile(int sentence_id,
+                                     ExtractedGrammar& grammar) const {
+  if (format != GRAMMAR_FILES) {
+    return;
+  }
+  WriteFile wf(GetGrammarFilePath(sentence_id));
+  *wf.stream() << grammar.rules;
+  string().swap(grammar.rules);
+}
+
+void GrammarWriter::WriteSegment(int sentence_id,
+                                 const ExtractedGrammar& grammar,
+                                 ostream& output) {
+  output << "<seg";
+  if (format == GRAMMAR_FILES) {
+    output << " grammar=\"" << GetGrammarFilePath(sentence_id) << "\"";
+  } else if (format == GRAMMAR_INDEXED) {
+    streamoff offset = indexed_stream.tellp();
+    indexed_stream << grammar.rules;
+    // The decoder reads the grammar as soon as it gets the <seg> line.
+    indexed_stream.flush();
+    index_stream << sentence_id << '\t' << offset << '\t'
+                 << grammar.rules.size() << '\n';
+    output << " grammar=\"" << indexed_path << "\" grammar_offset=\""
+           << offset << "\" grammar_size=\"" << grammar.rules.size() << "\"";
+  }
+  output << " id=\"" << sentence_id << "\"> " << grammar.sentence
+         << " </seg> " << grammar.suffix << '\n';
+  if (format == GRAMMAR_INLINE) {
+    output << grammar.rules << '\n';
+  }
+}
+
+int StreamGrammars(istream& input, ostream& output, int first_sentence_id,
+                   int num_threads, int max_pending,
+                   const ExtractFunction& extract, GrammarWriter& writer,
+                   const CommandFunction& command) {
+  // Lines are read under input_mutex. The grammars which cannot be written
+  // yet wait in the reorder buffer, guarded by output_mutex.
+  mutex input_mutex, output_mutex;
+  condition_variable buffer_not_full;
+  map<int, ExtractedGrammar> reorder_buffer;
+  int next_id = first_sentence_id;
+  int next_output_id = first_sentence_id;
+  bool end_of_input = false;
+
+  #pragma omp parallel num_threads(num_threads)
+  while (true) {
+    int sentence_id;
+    string line;
+    {
+      lock_guard<mutex> input_lock(input_mutex);
+      if (end_of_input) {
+        break;
+      }
+      {
+        unique_lock<mutex> output_lock(output_mutex);
+        buffer_not_full.wait(output_lock, [&] {
+          return next_id - next_output_id < max_pending;
+        });
+      }
+      if (!getline(input, line)) {
+        end_of_input = true;
+        break;
+      }
+      if (command && command(line)) {
+        continue;
+      }
+      sentence_id = next_id++;
+    }
+
+    ExtractedGrammar grammar;
+    SplitInputLine(line, &grammar.sentence, &grammar.suffix);
+    grammar.rules = extract(sentence_id, grammar.sentence);
+    writer.WriteGrammarFile(sentence_id, grammar);
+
+    lock_guard<mutex> output_lock(output_mutex);
+    reorder_buffer[sentence_id] = move(grammar);
+    auto it = reorder_buffer.begin();
+    while (it != reorder_buffer.end() && it->first == next_output_id) {
+      writer.WriteSegment(it->first, it->second, output);
+      it = reorder_buffer.erase(it);
+      ++next_output_id;
+    }
+    output.flush();
+    buffer_not_full.notify_all();
+  }
+
+  return next_id - first_sentence_id;
+}
+
+} // namespace extractor
@@ -0,0 +1,104 @@
+#ifndef _GRAMMAR_STREAM_H_
+#define _GRAMMAR_STREAM_H_
+
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+namespace extractor {
+
+// Ways of handing the extracted grammars to the decoder.
+enum GrammarFormat {
+  // One (optionally gzipped) file per sentence, referenced by the <seg> line.
+  GRAMMAR_FILES,
+  // The rules follow the <seg> line and are terminated by an empty line.
+  GRAMMAR_INLINE,
+  // The grammars are appended to a single file. The <seg> line references the
+  // file together with the offset and size of the grammar, which are also
+  // written to an index file.
+  GRAMMAR_INDEXED
+};
+
+// Returns false if the name is not one of files, inline or indexed.
+bool ParseGrammarFormat(const string& name, GrammarFormat* format);
+
+// Splits an input line into the sentence and the part starting with the first
+// ||| (copied to the output after the <seg> element).
+void SplitInputLine(const string& line, string* sentence, string* suffix);
+
+/**
+ * Grammar extracted for an input sentence.
+ */
+struct ExtractedGrammar {
+  string sentence;
+  string suffix;
+  string rules;
+};
+
+/**
+ * Writes the extracted grammars in one of the formats above together with the
+ * <seg> lines passed to the decoder.
+ */
+class GrammarWriter {
+ public:
+  // Grammars are written in the grammar_path directory (which is created if
+  // it doesn't exist). The <seg> lines refer to them through grammar_path as
+  // given.
+  GrammarWriter(const string& grammar_path, GrammarFormat format,
+                bool use_zip);
+
+  // Writes the grammar file of a sentence when each grammar has its own file
+  // (and releases the rules). Can be called from several threads at once.
+  void WriteGrammarFile(int sentence_id, ExtractedGrammar& grammar) const;
+
+  // Writes the <seg> line of a sentence and, unless it was already written
+  // to its own file, the grammar. Must be called in the order of the sentence
+  // ids.
+  void WriteSegment(int sentence_id, const ExtractedGrammar& grammar,
+                    ostream& output);
+
+ private:
+  // Returns the file path in which a given grammar should be written.
+  string GetGrammarFilePath(int sentence_id) const;
+
+  string grammar_path;
+  GrammarFormat format;
+  bool use_zip;
+  string indexed_path;
+  ofstream indexed_stream;
+  ofstream index_stream;
+};
+
+// Extracts the grammar rules for a sentence.
+typedef function<string(int sentence_id, const string& sentence)>
+    ExtractFunction;
+
+// Handles an input line which is a command rather than a sentence (e.g. a
+// sentence pair to learn from). Returns false if the line is a sentence.
+typedef function<bool(const string& line)> CommandFunction;
+
+/**
+ * Extracts the grammars of the lines read from the input stream as they
+ * arrive, on num_threads threads, and writes each <seg> line as soon as the
+ * grammars of all the previous lines have been written. At most max_pending
+ * lines are read ahead of the first line that was not written yet (so that a
+ * slow sentence cannot make the buffered output grow without bounds).
+ *
+ * If a command function is given, it is called for every line in input order
+ * before the lines read afterwards are extracted. Commands produce no output.
+ *
+ * Sentence ids start from first_sentence_id. Returns the number of sentences
+ * read.
+ */
+int StreamGrammars(istream& input, ostream& output, int first_sentence_id,
+                   int num_threads, int max_pending,
+                   const ExtractFunction& extract, GrammarWriter& writer,
+                   const CommandFunction& command = CommandFunction());
+
+} // namespace extractor
+
+#endif
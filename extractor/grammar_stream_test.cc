@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "grammar_stream.h"
+
+using namespace std;
+using namespace ::testing;
+
+namespace extractor {
+namespace {
+
+string ExtractRules(int sentence_id, const string& sentence) {
+  return "[X] ||| " + sentence + "||| " + to_string(sentence_id) + "\n";
+}
+
+TEST(GrammarStreamTest, TestSplitInputLine) {
+  string sentence, suffix;
+  SplitInputLine("a b c ||| d e", &sentence, &suffix);
+  EXPECT_EQ("a b c ", sentence);
+  EXPECT_EQ("||| d e", suffix);
+
+  SplitInputLine("a b", &sentence, &suffix);
+  EXPECT_EQ("a b", sentence);
+  EXPECT_EQ("", suffix);
+}
+
+TEST(GrammarStreamTest, TestParseGrammarFormat) {
+  GrammarFormat format;
+  EXPECT_TRUE(ParseGrammarFormat("inline", &format));
+  EXPECT_EQ(GRAMMAR_INLINE, format);
+  EXPECT_TRUE(ParseGrammarFormat("indexed", &format));
+  EXPECT_EQ(GRAMMAR_INDEXED, format);
+  EXPECT_FALSE(ParseGrammarFormat("zip", &format));
+}
+
+TEST(GrammarStreamTest, TestInlineGrammarsInOrder) {
+  string input;
+  string expected_output;
+  for (int i = 0; i < 20; ++i) {
+    string sentence = "s" + to_string(i) + " ";
+    input += sentence + "||| r" + to_string(i) + "\n";
+    expected_output += "<seg id=\"" + to_string(i + 5) + "\"> " + sentence +
+                       " </seg> ||| r" + to_string(i) + "\n" +
+                       ExtractRules(i + 5, sentence) + "\n";
+  }
+
+  GrammarWriter writer("", GRAMMAR_INLINE, false);
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    for (int max_pending = 1; max_pending <= 3; ++max_pending) {
+      istringstream input_stream(input);
+      ostringstream output_stream;
+      EXPECT_EQ(20, StreamGrammars(input_stream, output_stream, 5, num_threads,
+                                   max_pending, ExtractRules, writer));
+      EXPECT_EQ(expected_output, output_stream.str());
+    }
+  }
+}
+
+TEST(GrammarStreamTest, TestCommands) {
+  string input = "CMD 1\na\nCMD 2\nb\n";
+  vector<string> commands;
+  CommandFunction command = [&](const string& line) {
+    if (line.substr(0, 3) != "CMD") {
+      return false;
+    }
+    commands.push_back(line);
+    return true;
+  };
+
+  GrammarWriter writer("", GRAMMAR_INLINE, false);
+  istringstream input_stream(input);
+  ostringstream output_stream;
+  EXPECT_EQ(2, StreamGrammars(input_stream, output_stream, 0, 1, 1,
+                              ExtractRules, writer, command));
+  EXPECT_EQ(vector<string>({"CMD 1", "CMD 2"}), commands);
+  EXPECT_EQ("<seg id=\"0\"> a </seg> \n" + ExtractRules(0, "a") + "\n" +
+            "<seg id=\"1\"> b </seg> \n" + ExtractRules(1, "b") + "\n",
+            output_stream.str());
+}
+
+} // namespace
+} // namespace extractor
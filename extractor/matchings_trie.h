@@ -13,13 +13,15 @@ namespace extractor {
 
 /**
  * Trie node containing all the occurrences of the corresponding phrase in the
- * source data.
+ * source data and in the sentence pairs added online.
  */
 struct TrieNode {
   TrieNode(shared_ptr<TrieNode> suffix_link = shared_ptr<TrieNode>(),
            Phrase phrase = Phrase(),
-           PhraseLocation matchings = PhraseLocation()) :
-      suffix_link(suffix_link), phrase(phrase), matchings(matchings) {}
+           PhraseLocation matchings = PhraseLocation(),
+           PhraseLocation online_matchings = PhraseLocation()) :
+      suffix_link(suffix_link), phrase(phrase), matchings(matchings),
+      online_matchings(online_matchings) {}
 
   // Adds a trie node as a child of the current node.
   void AddChild(int key, shared_ptr<TrieNode> child_node) {
@@ -39,6 +41,7 @@ struct TrieNode {
   shared_ptr<TrieNode> suffix_link;
   Phrase phrase;
   PhraseLocation matchings;
+  PhraseLocation online_matchings;
   unordered_map<int, shared_ptr<TrieNode>> children;
 };
 
@@ -0,0 +1,175 @@
+#include "online_index.h"
+
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#include "alignment.h"
+#include "data_array.h"
+#include "suffix_array.h"
+#include "translation_table.h"
+
+namespace extractor {
+
+namespace {
+
+vector<string> Tokenize(const string& sentence) {
+  istringstream buffer(sentence);
+  return vector<string>(istream_iterator<string>(buffer),
+                        istream_iterator<string>());
+}
+
+} // namespace
+
+OnlineIndex::OnlineIndex(shared_ptr<TranslationTable> table) :
+    table(table), num_indexed(0), stopped(false) {
+  update_thread = thread(&OnlineIndex::UpdateLoop, this);
+}
+
+OnlineIndex::~OnlineIndex() {
+  {
+    lock_guard<mutex> lock(index_mutex);
+    stopped = true;
+  }
+  queue_not_empty.notify_all();
+  queue_indexed.notify_all();
+  update_thread.join();
+}
+
+bool OnlineIndex::AddSentencePair(const string& source_sentence,
+                                  const string& target_sentence,
+                                  const vector<pair<int, int>>& links) {
+  int source_length = Tokenize(source_sentence).size();
+  int target_length = Tokenize(target_sentence).size();
+  for (pair<int, int> link: links) {
+    if (link.first < 0 || link.first >= source_length ||
+        link.second < 0 || link.second >= target_length) {
+      cerr << "Alignment link " << link.first << "-" << link.second
+           << " is out of bounds for the sentence pair: " << source_sentence
+           << " ||| " << target_sentence << endl;
+      return false;
+    }
+  }
+
+  {
+    lock_guard<mutex> lock(index_mutex);
+    source_sentences.push_back(source_sentence);
+    target_sentences.push_back(target_sentence);
+    alignments.push_back(links);
+  }
+  queue_not_empty.notify_one();
+  return true;
+}
+
+bool OnlineIndex::HandleLearnCommand(const string& line) {
+  const string prefix = "LEARN |||";
+  if (line.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+
+  string source_sentence, target_sentence;
+  vector<pair<int, int>> links;
+  if (ParseSentencePair(line.substr(prefix.size()), &source_sentence,
+                        &target_sentence, &links)) {
+    AddSentencePair(source_sentence, target_sentence, links);
+  } else {
+    cerr << "Malformed LEARN command: " << line << endl;
+  }
+  return true;
+}
+
+void OnlineIndex::WaitForUpdates() {
+  unique_lock<mutex> lock(index_mutex);
+  queue_indexed.wait(lock, [&] {
+    return stopped || num_indexed == source_sentences.size();
+  });
+}
+
+shared_ptr<const OnlineData> OnlineIndex::GetData() const {
+  lock_guard<mutex> lock(index_mutex);
+  return data;
+}
+
+void OnlineIndex::UpdateLoop() {
+  unique_lock<mutex> lock(index_mutex);
+  int version = 0;
+  while (true) {
+    queue_not_empty.wait(lock, [&] {
+      return stopped || num_indexed < source_sentences.size();
+    });
+    if (stopped) {
+      break;
+    }
+
+    // The sentence pairs are copied, so that new ones can be queued while the
+    // index is being rebuilt.
+    size_t num_sentences = source_sentences.size();
+    vector<string> sources(source_sentences.begin(),
+                           source_sentences.begin() + num_sentences);
+    vector<string> targets(target_sentences.begin(),
+                           target_sentences.begin() + num_sentences);
+    vector<vector<pair<int, int>>> links(alignments.begin(),
+                                         alignments.begin() + num_sentences);
+    size_t first_new = num_indexed;
+    lock.unlock();
+
+    shared_ptr<SuffixArray> source_suffix_array = make_shared<SuffixArray>(
+        make_shared<DataArray>(sources));
+    shared_ptr<DataArray> target_data_array = make_shared<DataArray>(targets);
+    shared_ptr<Alignment> alignment = make_shared<Alignment>(links);
+    vector<vector<string>> new_sources, new_targets;
+    for (size_t i = first_new; i < num_sentences; ++i) {
+      new_sources.push_back(Tokenize(sources[i]));
+      new_targets.push_back(Tokenize(targets[i]));
+    }
+    vector<vector<pair<int, int>>> new_links(links.begin() + first_new,
+                                             links.end());
+
+    lock.lock();
+    // The link counts of the new sentence pairs are published in the same
+    // critical section as the index, so a sentence that gets the new version
+    // from GetData is always scored with the new counts. (The table is read
+    // without this lock, so the sentences still being extracted from the
+    // previous version score their remaining rules with the new counts too.)
+    if (table != NULL) {
+      table->AddLinks(new_sources, new_targets, new_links);
+    }
+    data = make_shared<OnlineData>(++version, source_suffix_array,
+                                   target_data_array, alignment);
+    num_indexed = num_sentences;
+    queue_indexed.notify_all();
+  }
+}
+
+bool ParseSentencePair(const string& line, string* source_sentence,
+                       string* target_sentence,
+                       vector<pair<int, int>>* links) {
+  const string delimiter = "|||";
+  size_t target_start = line.find(delimiter);
+  if (target_start == string::npos) {
+    return false;
+  }
+  size_t links_start = line.find(delimiter, target_start + delimiter.size());
+  if (links_start == string::npos) {
+    return false;
+  }
+
+  *source_sentence = line.substr(0, target_start);
+  *target_sentence = line.substr(target_start + delimiter.size(),
+                                 links_start - target_start - delimiter.size());
+  links->clear();
+  for (const string& link: Tokenize(line.substr(
+           links_start + delimiter.size()))) {
+    istringstream buffer(link);
+    int source_index, target_index;
+    char separator;
+    if (!(buffer >> source_index >> separator >> target_index) ||
+        separator != '-' || buffer.peek() != EOF) {
+      return false;
+    }
+    links->push_back(make_pair(source_index, target_index));
+  }
+  return true;
+}
+
+} // namespace extractor
@@ -0,0 +1,100 @@
+#ifndef _ONLINE_INDEX_H_
+#define _ONLINE_INDEX_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace extractor {
+
+class Alignment;
+class DataArray;
+class SuffixArray;
+class TranslationTable;
+
+/**
+ * Index of the sentence pairs added online, as seen by the extraction threads.
+ * Positions and sentence ids refer to the added sentence pairs only.
+ */
+struct OnlineData {
+  OnlineData(int version, shared_ptr<SuffixArray> source_suffix_array,
+             shared_ptr<DataArray> target_data_array,
+             shared_ptr<Alignment> alignment) :
+      version(version), source_suffix_array(source_suffix_array),
+      target_data_array(target_data_array), alignment(alignment) {}
+
+  // Increases every time new sentence pairs are indexed.
+  int version;
+  shared_ptr<SuffixArray> source_suffix_array;
+  shared_ptr<DataArray> target_data_array;
+  shared_ptr<Alignment> alignment;
+};
+
+/**
+ * Sentence pairs added after the data was compiled (e.g. post-edited
+ * translations), queried by the rule factory alongside the compiled data.
+ *
+ * The compiled data is memory mapped and never modified, so the new sentence
+ * pairs are kept in a small separate index: a suffix array over the added
+ * source sentences, with its own target data and alignment. Adding a sentence
+ * pair only queues it. A background thread merges the queued sentence pairs
+ * into a new index and publishes it together with their links in the
+ * translation table. The new index is used for all the sentences whose
+ * extraction starts afterwards. Rebuilding the index takes time linear in the number of
+ * added sentence pairs, so the new data is picked up within seconds.
+ */
+class OnlineIndex {
+ public:
+  // The link counts of the sentence pairs are added to the table (if any).
+  OnlineIndex(shared_ptr<TranslationTable> table);
+
+  virtual ~OnlineIndex();
+
+  // Queues a sentence pair for indexing. The alignment links are pairs of
+  // (source position, target position). Returns false if a link is out of the
+  // bounds of the sentences.
+  bool AddSentencePair(const string& source_sentence,
+                       const string& target_sentence,
+                       const vector<pair<int, int>>& links);
+
+  // Adds the sentence pair of a "LEARN ||| source ||| target ||| alignment"
+  // input line. Returns false if the line is not a LEARN command.
+  bool HandleLearnCommand(const string& line);
+
+  // Blocks until all the sentence pairs added so far are indexed.
+  void WaitForUpdates();
+
+  // Returns the latest index or NULL if no sentence pairs were indexed yet.
+  shared_ptr<const OnlineData> GetData() const;
+
+ private:
+  // Indexes the queued sentence pairs until the index is destroyed.
+  void UpdateLoop();
+
+  shared_ptr<TranslationTable> table;
+  vector<string> source_sentences;
+  vector<string> target_sentences;
+  vector<vector<pair<int, int>>> alignments;
+  size_t num_indexed;
+  shared_ptr<const OnlineData> data;
+  bool stopped;
+  mutable mutex index_mutex;
+  condition_variable queue_not_empty;
+  condition_variable queue_indexed;
+  thread update_thread;
+};
+
+// Parses a "source ||| target ||| alignment" line, where the alignment is a
+// list of i-j links. Returns false if the line is malformed.
+bool ParseSentencePair(const string& line, string* source_sentence,
+                       string* target_sentence,
+                       vector<pair<int, int>>* links);
+
+} // namespace extractor
+
+#endif
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alignment.h"
+#include "data_array.h"
+#include "online_index.h"
+#include "suffix_array.h"
+
+using namespace std;
+using namespace ::testing;
+
+namespace extractor {
+namespace {
+
+TEST(OnlineIndexTest, TestParseSentencePair) {
+  string source_sentence, target_sentence;
+  vector<pair<int, int>> links;
+  EXPECT_TRUE(ParseSentencePair("a b ||| c d ||| 0-1 1-0", &source_sentence,
+                                &target_sentence, &links));
+  EXPECT_EQ("a b ", source_sentence);
+  EXPECT_EQ(" c d ", target_sentence);
+  vector<pair<int, int>> expected_links = {make_pair(0, 1), make_pair(1, 0)};
+  EXPECT_EQ(expected_links, links);
+
+  EXPECT_TRUE(ParseSentencePair("a ||| b |||", &source_sentence,
+                                &target_sentence, &links));
+  EXPECT_TRUE(links.empty());
+
+  EXPECT_FALSE(ParseSentencePair("a ||| b", &source_sentence,
+                                 &target_sentence, &links));
+  EXPECT_FALSE(ParseSentencePair("a ||| b ||| 0-1x", &source_sentence,
+                                 &target_sentence, &links));
+  EXPECT_FALSE(ParseSentencePair("a ||| b ||| 0:1", &source_sentence,
+                                 &target_sentence, &links));
+}
+
+TEST(OnlineIndexTest, TestAddSentencePairs) {
+  OnlineIndex index(NULL);
+  EXPECT_TRUE(index.GetData() == NULL);
+
+  vector<pair<int, int>> links = {make_pair(0, 0), make_pair(1, 2)};
+  EXPECT_TRUE(index.AddSentencePair("a b", "c d e", links));
+  EXPECT_FALSE(index.AddSentencePair("a b", "c", links));
+  EXPECT_TRUE(index.HandleLearnCommand("LEARN ||| b a ||| e c ||| 1-1"));
+  EXPECT_FALSE(index.HandleLearnCommand("b a ||| e c ||| 1-1"));
+  index.WaitForUpdates();
+
+  shared_ptr<const OnlineData> data = index.GetData();
+  ASSERT_TRUE(data != NULL);
+  EXPECT_LE(1, data->version);
+  shared_ptr<DataArray> source_data_array =
+      data->source_suffix_array->GetData();
+  EXPECT_EQ(2, source_data_array->GetNumSentences());
+  EXPECT_EQ(6, source_data_array->GetSize());
+  EXPECT_EQ(vector<string>({"b", "a"}), source_data_array->GetWords(3, 2));
+  EXPECT_EQ(vector<string>({"e", "c"}),
+            data->target_data_array->GetWords(4, 2));
+  EXPECT_EQ(links, data->alignment->GetLinks(0));
+  vector<pair<int, int>> expected_links = {make_pair(1, 1)};
+  EXPECT_EQ(expected_links, data->alignment->GetLinks(1));
+
+  EXPECT_TRUE(index.AddSentencePair("f", "g", {make_pair(0, 0)}));
+  index.WaitForUpdates();
+  EXPECT_LT(data->version, index.GetData()->version);
+  EXPECT_EQ(3, index.GetData()->target_data_array->GetNumSentences());
+}
+
+} // namespace
+} // namespace extractor
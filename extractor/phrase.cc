@@ -1,5 +1,7 @@
 #include "phrase.h"
 
+#include "vocabulary.h"
+
 namespace extractor {
 
 int Phrase::Arity() const {
@@ -18,7 +20,7 @@ int Phrase::GetChunkLen(int index) const {
   }
 }
 
-vector<int> Phrase::Get() const {
+const vector<int>& Phrase::Get() const {
   return symbols;
 }
 
@@ -31,6 +33,12 @@ int Phrase::GetNumSymbols() const {
 }
 
 vector<string> Phrase::GetWords() const {
+  vector<string> words;
+  for (int symbol: symbols) {
+    if (symbol >= 0) {
+      words.push_back(vocabulary->GetTerminalValue(symbol));
+    }
+  }
   return words;
 }
 
@@ -39,13 +47,11 @@ bool Phrase::operator<(const Phrase& other) const {
 }
 
 ostream& operator<<(ostream& os, const Phrase& phrase) {
-  int current_word = 0;
   for (size_t i = 0; i < phrase.symbols.size(); ++i) {
     if (phrase.symbols[i] < 0) {
       os << "[X," << -phrase.symbols[i] << "]";
     } else {
-      os << phrase.words[current_word];
-      ++current_word;
+      os << phrase.vocabulary->GetTerminalValue(phrase.symbols[i]);
     }
 
     if (i + 1 < phrase.symbols.size()) {
@@ -2,6 +2,7 @@
 #define _PHRASE_H_
 
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -11,8 +12,13 @@ using namespace std;
 
 namespace extractor {
 
+class Vocabulary;
+
 /**
  * Structure containing the data for a phrase.
+ *
+ * Phrases only store symbol ids. The words are looked up in the vocabulary
+ * when they are needed (for scoring and for writing the rules).
  */
 class Phrase {
  public:
@@ -26,7 +32,7 @@ class Phrase {
   int GetChunkLen(int index) const;
 
   // Returns the symbols (word ids) marking up the phrase.
-  vector<int> Get() const;
+  const vector<int>& Get() const;
 
   // Returns the symbol located at the given position in the phrase.
   int GetSymbol(int position) const;
@@ -44,7 +50,7 @@ class Phrase {
  private:
   vector<int> symbols;
   vector<int> var_pos;
-  vector<string> words;
+  shared_ptr<Vocabulary> vocabulary;
 };
 
 } // namespace extractor
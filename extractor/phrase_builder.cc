@@ -11,10 +11,9 @@ PhraseBuilder::PhraseBuilder(shared_ptr<Vocabulary> vocabulary) :
 Phrase PhraseBuilder::Build(const vector<int>& symbols) {
   Phrase phrase;
   phrase.symbols = symbols;
+  phrase.vocabulary = vocabulary;
   for (size_t i = 0; i < symbols.size(); ++i) {
-    if (vocabulary->IsTerminal(symbols[i])) {
-      phrase.words.push_back(vocabulary->GetTerminalValue(symbols[i]));
-    } else {
+    if (!vocabulary->IsTerminal(symbols[i])) {
       phrase.var_pos.push_back(i);
     }
   }
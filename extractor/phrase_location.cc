@@ -7,19 +7,28 @@ namespace extractor {
 PhraseLocation::PhraseLocation(int sa_low, int sa_high) :
     sa_low(sa_low), sa_high(sa_high), num_subpatterns(0) {}
 
-PhraseLocation::PhraseLocation(const vector<int>& matchings,
+PhraseLocation::PhraseLocation(vector<int> matchings, int num_subpatterns) :
+    sa_low(0), sa_high(0),
+    matchings(move(matchings)),
+    num_subpatterns(num_subpatterns) {}
+
+PhraseLocation::PhraseLocation(const FlatArray<int>& matchings,
                                int num_subpatterns) :
     sa_low(0), sa_high(0),
-    matchings(make_shared<vector<int>>(matchings)),
+    matchings(matchings),
     num_subpatterns(num_subpatterns) {}
 
+bool PhraseLocation::HasMatchings() const {
+  return num_subpatterns > 0;
+}
+
 bool PhraseLocation::IsEmpty() const {
   return GetSize() == 0;
 }
 
 int PhraseLocation::GetSize() const {
   if (num_subpatterns > 0) {
-    return matchings->size();
+    return matchings.size();
   } else {
     return sa_high - sa_low;
   }
@@ -31,15 +40,7 @@ bool operator==(const PhraseLocation& a, const PhraseLocation& b) {
     return false;
   }
 
-  if (a.matchings == NULL && b.matchings == NULL) {
-    return true;
-  }
-
-  if (a.matchings == NULL || b.matchings == NULL) {
-    return false;
-  }
-
-  return *a.matchings == *b.matchings;
+  return a.matchings == b.matchings;
 }
 
 } // namespace extractor
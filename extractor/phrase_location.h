@@ -4,6 +4,8 @@
 #include <memory>
 #include <vector>
 
+#include "flat_file.h"
+
 using namespace std;
 
 namespace extractor {
@@ -17,11 +19,20 @@ namespace extractor {
  * represents the start of the i-th subpattern of the phrase. If the phrase
  * doesn't contain any nonterminals, then it may also be represented as the
  * range in the suffix array which matches the phrase.
+ *
+ * The matchings are immutable and may be a view into the precomputed
+ * collocations, so copying a PhraseLocation never copies the matchings.
  */
 struct PhraseLocation {
   PhraseLocation(int sa_low = -1, int sa_high = -1);
 
-  PhraseLocation(const vector<int>& matchings, int num_subpatterns);
+  PhraseLocation(vector<int> matchings, int num_subpatterns);
+
+  PhraseLocation(const FlatArray<int>& matchings, int num_subpatterns);
+
+  // Checks if the occurrences are stored as a list of matchings (rather than
+  // a suffix array range).
+  bool HasMatchings() const;
 
   // Checks if a phrase has any occurrences in the source data.
   bool IsEmpty() const;
@@ -32,7 +43,7 @@ struct PhraseLocation {
   friend bool operator==(const PhraseLocation& a, const PhraseLocation& b);
 
   int sa_low, sa_high;
-  shared_ptr<vector<int>> matchings;
+  FlatArray<int> matchings;
   int num_subpatterns;
 };
 
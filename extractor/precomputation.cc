@@ -1,5 +1,6 @@
 #include "precomputation.h"
 
+#include <algorithm>
 #include <iostream>
 #include <queue>
 
@@ -19,7 +20,7 @@ Precomputation::Precomputation(
     int max_frequent_phrase_len, int min_frequency) {
   Clock::time_point start_time = Clock::now();
   shared_ptr<DataArray> data_array = suffix_array->GetData();
-  vector<int> data = data_array->GetData();
+  FlatArray<int> data = data_array->GetData();
   vector<vector<int>> frequent_patterns = FindMostFrequentPatterns(
       suffix_array, data, num_frequent_patterns, max_frequent_phrase_len,
       min_frequency);
@@ -36,13 +37,14 @@ Precomputation::Precomputation(
   }
 
   start_time = Clock::now();
+  Index index;
   vector<tuple<int, int, int>> matchings;
   vector<vector<int>> annotations;
   for (size_t i = 0; i < data.size(); ++i) {
     // If the sentence is over, add all the discontiguous frequent patterns to
     // the index.
     if (data[i] == DataArray::END_OF_LINE) {
-      UpdateIndex(matchings, annotations, max_rule_span, min_gap_size,
+      UpdateIndex(index, matchings, annotations, max_rule_span, min_gap_size,
                   max_rule_symbols);
       matchings.clear();
       annotations.clear();
@@ -63,17 +65,20 @@ Precomputation::Precomputation(
       annotations.push_back(pattern_annotations[it->second]);
     }
   }
+  SetIndex(index);
   end_time = Clock::now();
   cerr << "Constructing collocations index took "
        << GetDuration(start_time, end_time) << " seconds..." << endl;
 }
 
-Precomputation::Precomputation() {}
+Precomputation::Precomputation() {
+  SetIndex(Index());
+}
 
 Precomputation::~Precomputation() {}
 
 vector<vector<int>> Precomputation::FindMostFrequentPatterns(
-    shared_ptr<SuffixArray> suffix_array, const vector<int>& data,
+    shared_ptr<SuffixArray> suffix_array, const FlatArray<int>& data,
     int num_frequent_patterns, int max_frequent_phrase_len, int min_frequency) {
   vector<int> lcp = suffix_array->BuildLCPArray();
   vector<int> run_start(max_frequent_phrase_len);
@@ -119,6 +124,7 @@ vector<int> Precomputation::AnnotatePattern(
 }
 
 void Precomputation::UpdateIndex(
+    Index& index,
     const vector<tuple<int, int, int>>& matchings,
     const vector<vector<int>>& annotations,
     int max_rule_span, int min_gap_size, int max_rule_symbols) {
@@ -188,16 +194,92 @@ void Precomputation::AppendCollocation(
   collocations.push_back(pos3);
 }
 
+void Precomputation::SetIndex(const Index& index) {
+  // Sorting the entries makes the flat index independent of the iteration
+  // order of the hash table.
+  vector<Index::const_iterator> entries;
+  for (auto it = index.begin(); it != index.end(); ++it) {
+    entries.push_back(it);
+  }
+  sort(entries.begin(), entries.end(),
+       [](Index::const_iterator a, Index::const_iterator b) {
+         return a->first < b->first;
+       });
+
+  vector<int> patterns, collocations;
+  vector<int64_t> pattern_start = {0}, collocation_start = {0};
+  vector<uint64_t> hashes;
+  for (Index::const_iterator entry: entries) {
+    const vector<int>& pattern = entry->first;
+    hashes.push_back(HashFlatKey(pattern.data(), pattern.size()));
+    patterns.insert(patterns.end(), pattern.begin(), pattern.end());
+    pattern_start.push_back(patterns.size());
+    collocations.insert(collocations.end(), entry->second.begin(),
+                        entry->second.end());
+    collocation_start.push_back(collocations.size());
+  }
+
+  this->patterns = FlatArray<int>(move(patterns));
+  this->pattern_start = FlatArray<int64_t>(move(pattern_start));
+  this->collocations = FlatArray<int>(move(collocations));
+  this->collocation_start = FlatArray<int64_t>(move(collocation_start));
+  pattern_index = FlatArray<int>(BuildFlatHashTable(hashes));
+}
+
+int Precomputation::FindPattern(const vector<int>& pattern) const {
+  return FindInFlatHashTable(pattern_index,
+      HashFlatKey(pattern.data(), pattern.size()),
+      [&](int i) {
+        return pattern_start[i + 1] - pattern_start[i] ==
+                   static_cast<int64_t>(pattern.size()) &&
+               equal(pattern.begin(), pattern.end(),
+                     patterns.begin() + pattern_start[i]);
+      });
+}
+
+Index Precomputation::GetIndex() const {
+  Index index;
+  for (size_t i = 0; i + 1 < pattern_start.size(); ++i) {
+    vector<int> pattern(patterns.begin() + pattern_start[i],
+                        patterns.begin() + pattern_start[i + 1]);
+    index[pattern] = vector<int>(
+        collocations.begin() + collocation_start[i],
+        collocations.begin() + collocation_start[i + 1]);
+  }
+  return index;
+}
+
 bool Precomputation::Contains(const vector<int>& pattern) const {
-  return index.count(pattern);
+  return FindPattern(pattern) != -1;
+}
+
+FlatArray<int> Precomputation::GetCollocations(
+    const vector<int>& pattern) const {
+  int i = FindPattern(pattern);
+  return collocations.Slice(collocation_start[i],
+                            collocation_start[i + 1] - collocation_start[i]);
+}
+
+void Precomputation::WriteFlat(FlatFileWriter& writer) const {
+  writer.WriteArray(patterns);
+  writer.WriteArray(pattern_start);
+  writer.WriteArray(collocations);
+  writer.WriteArray(collocation_start);
+  writer.WriteArray(pattern_index);
 }
 
-vector<int> Precomputation::GetCollocations(const vector<int>& pattern) const {
-  return index.at(pattern);
+void Precomputation::ReadFlat(FlatFileReader& reader) {
+  patterns = reader.ReadArray<int>();
+  pattern_start = reader.ReadArray<int64_t>();
+  collocations = reader.ReadArray<int>();
+  collocation_start = reader.ReadArray<int64_t>();
+  pattern_index = reader.ReadArray<int>();
 }
 
 bool Precomputation::operator==(const Precomputation& other) const {
-  return index == other.index;
+  return patterns == other.patterns && pattern_start == other.pattern_start &&
+         collocations == other.collocations &&
+         collocation_start == other.collocation_start;
 }
 
 } // namespace extractor
@@ -12,6 +12,8 @@
 #include <boost/serialization/utility.hpp>
 #include <boost/serialization/vector.hpp>
 
+#include "flat_file.h"
+
 using namespace std;
 
 namespace extractor {
@@ -32,6 +34,9 @@ class Vocabulary;
  * - aXb, where a and b are frequent
  * - aXbXc, where a and b are super-frequent and c is frequent or
  *                b and c are super-frequent and a is frequent.
+ *
+ * Once constructed, the index is stored as a flat open addressing hash table
+ * over the concatenated patterns and the concatenated lists of collocations.
  */
 class Precomputation {
  public:
@@ -50,15 +55,22 @@ class Precomputation {
   // Returns whether a pattern is contained in the index of collocations.
   virtual bool Contains(const vector<int>& pattern) const;
 
-  // Returns the list of collocations for a given pattern.
-  virtual vector<int> GetCollocations(const vector<int>& pattern) const;
+  // Returns the list of collocations for a given pattern (a view into the
+  // index, which is not copied).
+  virtual FlatArray<int> GetCollocations(const vector<int>& pattern) const;
+
+  // Writes the index in the flat format.
+  void WriteFlat(FlatFileWriter& writer) const;
+
+  // Reads an index written by WriteFlat (the arrays are not copied).
+  void ReadFlat(FlatFileReader& reader);
 
   bool operator==(const Precomputation& other) const;
 
  private:
   // Finds the most frequent contiguous collocations.
   vector<vector<int>> FindMostFrequentPatterns(
-      shared_ptr<SuffixArray> suffix_array, const vector<int>& data,
+      shared_ptr<SuffixArray> suffix_array, const FlatArray<int>& data,
       int num_frequent_patterns, int max_frequent_phrase_len,
       int min_frequency);
 
@@ -70,6 +82,7 @@ class Precomputation {
   // it adds new entries to the index for each discontiguous collocation
   // matching the criteria specified in the class description.
   void UpdateIndex(
+      Index& index,
       const vector<tuple<int, int, int>>& matchings,
       const vector<vector<int>>& annotations,
       int max_rule_span, int min_gap_size, int max_rule_symbols);
@@ -82,9 +95,20 @@ class Precomputation {
   // Adds an occurrence of a ternary collocation.
   void AppendCollocation(vector<int>& collocations, int pos1, int pos2, int pos3);
 
+  // Constructs the flat index.
+  void SetIndex(const Index& index);
+
+  // Returns the position of the pattern in the flat index or -1 if the pattern
+  // is not in the index.
+  int FindPattern(const vector<int>& pattern) const;
+
+  // Returns the entries of the flat index.
+  Index GetIndex() const;
+
   friend class boost::serialization::access;
 
   template<class Archive> void save(Archive& ar, unsigned int) const {
+    Index index = GetIndex();
     int num_entries = index.size();
     ar << num_entries;
     for (pair<vector<int>, vector<int>> entry: index) {
@@ -93,6 +117,7 @@ class Precomputation {
   }
 
   template<class Archive> void load(Archive& ar, unsigned int) {
+    Index index;
     int num_entries;
     ar >> num_entries;
     for (size_t i = 0; i < num_entries; ++i) {
@@ -100,11 +125,18 @@ class Precomputation {
       ar >> entry;
       index.insert(entry);
     }
+    SetIndex(index);
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER();
 
-  Index index;
+  // Pattern i is stored in patterns from pattern_start[i] up to (excluding)
+  // pattern_start[i + 1]. Its collocations are stored in the same way.
+  FlatArray<int> patterns;
+  FlatArray<int64_t> pattern_start;
+  FlatArray<int> collocations;
+  FlatArray<int64_t> collocation_start;
+  FlatArray<int> pattern_index;
 };
 
 } // namespace extractor
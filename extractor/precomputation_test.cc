@@ -6,6 +6,7 @@
 
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
+#include <boost/filesystem.hpp>
 
 #include "mocks/mock_data_array.h"
 #include "mocks/mock_suffix_array.h"
@@ -15,6 +16,7 @@
 using namespace std;
 using namespace ::testing;
 namespace ar = boost::archive;
+namespace fs = boost::filesystem;
 
 namespace extractor {
 namespace {
@@ -24,7 +26,8 @@ class PrecomputationTest : public Test {
   virtual void SetUp() {
     data = {4, 2, 3, 5, 7, 2, 3, 5, 2, 3, 4, 2, 1};
     data_array = make_shared<MockDataArray>();
-    EXPECT_CALL(*data_array, GetData()).WillRepeatedly(Return(data));
+    EXPECT_CALL(*data_array, GetData())
+        .WillRepeatedly(Return(FlatArray<int>(data)));
     for (size_t i = 0; i < data.size(); ++i) {
       EXPECT_CALL(*data_array, AtIndex(i)).WillRepeatedly(Return(data[i]));
     }
@@ -60,72 +63,72 @@ TEST_F(PrecomputationTest, TestCollocations) {
   vector<int> key = {2, 3, -1, 2};
   vector<int> expected_value = {1, 5, 1, 8, 5, 8, 5, 11, 8, 11};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {2, 3, -1, 2, 3};
   expected_value = {1, 5, 1, 8, 5, 8};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {2, 3, -1, 3};
   expected_value = {1, 6, 1, 9, 5, 9};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {3, -1, 2};
   expected_value = {2, 5, 2, 8, 2, 11, 6, 8, 6, 11, 9, 11};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {3, -1, 3};
   expected_value = {2, 6, 2, 9, 6, 9};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {3, -1, 2, 3};
   expected_value = {2, 5, 2, 8, 6, 8};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {2, -1, 2};
   expected_value = {1, 5, 1, 8, 5, 8, 5, 11, 8, 11};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {2, -1, 2, 3};
   expected_value = {1, 5, 1, 8, 5, 8};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {2, -1, 3};
   expected_value = {1, 6, 1, 9, 5, 9};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
 
   key = {2, -1, 2, -2, 2};
   expected_value = {1, 5, 8, 5, 8, 11};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {2, -1, 2, -2, 3};
   expected_value = {1, 5, 9};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {2, -1, 3, -2, 2};
   expected_value = {1, 6, 8, 5, 9, 11};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {2, -1, 3, -2, 3};
   expected_value = {1, 6, 9};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {3, -1, 2, -2, 2};
   expected_value = {2, 5, 8, 2, 5, 11, 2, 8, 11, 6, 8, 11};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {3, -1, 2, -2, 3};
   expected_value = {2, 5, 9};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {3, -1, 3, -2, 2};
   expected_value = {2, 6, 8, 2, 6, 11, 2, 9, 11, 6, 9, 11};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
   key = {3, -1, 3, -2, 3};
   expected_value = {2, 6, 9};
   EXPECT_TRUE(precomputation.Contains(key));
-  EXPECT_EQ(expected_value, precomputation.GetCollocations(key));
+  EXPECT_EQ(expected_value, precomputation.GetCollocations(key).ToVector());
 
   // Exceeds max_rule_symbols.
   key = {2, -1, 2, -2, 2, 3};
@@ -147,6 +150,27 @@ TEST_F(PrecomputationTest, TestSerialization) {
   EXPECT_EQ(precomputation, precomputation_copy);
 }
 
+TEST_F(PrecomputationTest, TestFlatFile) {
+  fs::path path = fs::temp_directory_path() / fs::unique_path();
+  {
+    FlatFileWriter writer(path.string(), FLAT_PRECOMPUTATION);
+    precomputation.WriteFlat(writer);
+  }
+
+  Precomputation precomputation_copy;
+  FlatFileReader reader(path.string(), FLAT_PRECOMPUTATION);
+  precomputation_copy.ReadFlat(reader);
+  fs::remove(path);
+
+  EXPECT_EQ(precomputation, precomputation_copy);
+  vector<int> key = {2, 3, -1, 2};
+  vector<int> expected_value = {1, 5, 1, 8, 5, 8, 5, 11, 8, 11};
+  EXPECT_TRUE(precomputation_copy.Contains(key));
+  EXPECT_EQ(expected_value, precomputation_copy.GetCollocations(key).ToVector());
+  key = {2, -1, 4};
+  EXPECT_FALSE(precomputation_copy.Contains(key));
+}
+
 } // namespace
 } // namespace extractor
 
@@ -0,0 +1,138 @@
+#include "rule_cache.h"
+
+#include <algorithm>
+
+#include "data_array.h"
+#include "phrase.h"
+#include "phrase_location.h"
+#include "rule.h"
+#include "rule_extractor.h"
+
+namespace extractor {
+
+RuleCache::RuleCache(shared_ptr<DataArray> source_data_array,
+                     size_t max_rules) :
+    source_data_array(source_data_array), max_rules(max_rules), num_rules(0),
+    num_lookups(0), num_hits(0) {}
+
+RuleCache::~RuleCache() {}
+
+bool RuleCache::Find(const Phrase& phrase, int data_version,
+                     const unordered_set<int>& blacklisted_sentence_ids,
+                     shared_ptr<const RuleCounts>& counts,
+                     shared_ptr<const vector<Rule>>& rules) {
+  lock_guard<mutex> lock(cache_mutex);
+  ++num_lookups;
+  auto it = entries.find(phrase.Get());
+  if (it == entries.end()) {
+    return false;
+  }
+  for (int sentence_id: it->second.sentence_ids) {
+    if (blacklisted_sentence_ids.count(sentence_id)) {
+      return false;
+    }
+  }
+  lru.splice(lru.begin(), lru, it->second.lru_position);
+  counts = it->second.counts;
+  rules.reset();
+  if (it->second.data_version == data_version) {
+    rules = it->second.rules;
+  }
+  ++num_hits;
+  return true;
+}
+
+bool RuleCache::IsBlacklisted(
+    const PhraseLocation& sample,
+    const unordered_set<int>& blacklisted_sentence_ids) const {
+  if (blacklisted_sentence_ids.empty()) {
+    return false;
+  }
+  for (int sentence_id: GetSentenceIds(sample)) {
+    if (blacklisted_sentence_ids.count(sentence_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void RuleCache::Insert(const Phrase& phrase, int data_version,
+                       const PhraseLocation& sample,
+                       const shared_ptr<const RuleCounts>& counts,
+                       const shared_ptr<const vector<Rule>>& rules) {
+  size_t num_phrase_pairs = 0;
+  for (const auto& source_phrase_entry: counts->alignments_counter) {
+    num_phrase_pairs += source_phrase_entry.second.size();
+  }
+  if (num_phrase_pairs > max_rules) {
+    return;
+  }
+
+  lock_guard<mutex> lock(cache_mutex);
+  Key key = phrase.Get();
+  auto it = entries.find(key);
+  if (it != entries.end()) {
+    // Another thread extracted the same phrase in the meantime.
+    UpdateEntry(it->second, data_version, rules);
+    return;
+  }
+
+  Entry entry;
+  entry.counts = counts;
+  entry.data_version = data_version;
+  entry.rules = rules;
+  entry.num_rules = num_phrase_pairs;
+  entry.sentence_ids = GetSentenceIds(sample);
+  lru.push_front(key);
+  entry.lru_position = lru.begin();
+  entries[key] = entry;
+  num_rules += num_phrase_pairs;
+
+  while (num_rules > max_rules) {
+    auto it = entries.find(lru.back());
+    num_rules -= it->second.num_rules;
+    entries.erase(it);
+    lru.pop_back();
+  }
+}
+
+void RuleCache::UpdateRules(const Phrase& phrase, int data_version,
+                            const shared_ptr<const vector<Rule>>& rules) {
+  lock_guard<mutex> lock(cache_mutex);
+  auto it = entries.find(phrase.Get());
+  if (it != entries.end()) {
+    UpdateEntry(it->second, data_version, rules);
+  }
+}
+
+void RuleCache::UpdateEntry(Entry& entry, int data_version,
+                            const shared_ptr<const vector<Rule>>& rules) {
+  if (rules != NULL &&
+      (entry.rules == NULL || entry.data_version < data_version)) {
+    entry.data_version = data_version;
+    entry.rules = rules;
+  }
+}
+
+void RuleCache::GetStats(long long& num_lookups, long long& num_hits) const {
+  lock_guard<mutex> lock(cache_mutex);
+  num_lookups = this->num_lookups;
+  num_hits = this->num_hits;
+}
+
+vector<int> RuleCache::GetSentenceIds(const PhraseLocation& sample) const {
+  vector<int> sentence_ids;
+  if (!sample.HasMatchings()) {
+    return sentence_ids;
+  }
+  const FlatArray<int>& matchings = sample.matchings;
+  for (size_t i = 0; i < matchings.size(); i += sample.num_subpatterns) {
+    sentence_ids.push_back(source_data_array->GetSentenceId(matchings[i]));
+  }
+  sort(sentence_ids.begin(), sentence_ids.end());
+  sentence_ids.erase(unique(sentence_ids.begin(), sentence_ids.end()),
+                     sentence_ids.end());
+  return sentence_ids;
+}
+
+} // namespace extractor
@@ -0,0 +1,111 @@
+#ifndef _RULE_CACHE_H_
+#define _RULE_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+using namespace std;
+
+namespace extractor {
+
+class DataArray;
+class Phrase;
+class PhraseLocation;
+class Rule;
+struct RuleCounts;
+
+/**
+ * Cache mapping source phrases to the rules extracted for them, shared by all
+ * the sentences (and threads) of an extraction run.
+ *
+ * The rules extracted for a phrase only depend on the sampled occurrences, so
+ * they can be reused across sentences as long as the sample would not change.
+ * The sample changes only if one of the sampled occurrences belongs to a
+ * blacklisted sentence, so the cache also records the sentences of the sample
+ * and reports a miss for a lookup with a blacklist overlapping them.
+ *
+ * The statistics of the phrase pairs extracted from the sample are cached
+ * together with the rules scored from them. The lexical scores change when
+ * sentence pairs are added online, so the rules are tagged with the version of
+ * the online data they were scored with. Rules scored with a different version
+ * are not returned, but the statistics remain valid and only need to be scored
+ * again.
+ *
+ * The least recently used phrases are evicted once the cached phrases hold more
+ * than max_rules rules.
+ */
+class RuleCache {
+ public:
+  RuleCache(shared_ptr<DataArray> source_data_array, size_t max_rules);
+
+  virtual ~RuleCache();
+
+  // Looks up a phrase. Returns false if the phrase is not cached or if its
+  // sample contains blacklisted sentences. Otherwise, returns the statistics of
+  // the phrase pairs and the rules if they were scored with the given data
+  // version (NULL if not).
+  bool Find(const Phrase& phrase, int data_version,
+            const unordered_set<int>& blacklisted_sentence_ids,
+            shared_ptr<const RuleCounts>& counts,
+            shared_ptr<const vector<Rule>>& rules);
+
+  // Checks if any of the sampled occurrences belongs to a blacklisted
+  // sentence.
+  bool IsBlacklisted(const PhraseLocation& sample,
+                     const unordered_set<int>& blacklisted_sentence_ids) const;
+
+  // Caches the statistics computed from a sample without a blacklist and the
+  // rules scored from them (which may be NULL). If the phrase is already
+  // cached, only replaces rules scored with an older data version.
+  void Insert(const Phrase& phrase, int data_version,
+              const PhraseLocation& sample,
+              const shared_ptr<const RuleCounts>& counts,
+              const shared_ptr<const vector<Rule>>& rules);
+
+  // Replaces the rules of a cached phrase if they were scored with an older
+  // data version (or not scored at all).
+  void UpdateRules(const Phrase& phrase, int data_version,
+                   const shared_ptr<const vector<Rule>>& rules);
+
+  // Returns the number of lookups and the number of hits so far.
+  void GetStats(long long& num_lookups, long long& num_hits) const;
+
+ private:
+  typedef vector<int> Key;
+
+  struct Entry {
+    shared_ptr<const RuleCounts> counts;
+    int data_version;
+    shared_ptr<const vector<Rule>> rules;
+    size_t num_rules;
+    vector<int> sentence_ids;
+    list<Key>::iterator lru_position;
+  };
+
+  vector<int> GetSentenceIds(const PhraseLocation& sample) const;
+
+  // Replaces the rules of an entry if they are older (must be called while
+  // holding the lock).
+  void UpdateEntry(Entry& entry, int data_version,
+                   const shared_ptr<const vector<Rule>>& rules);
+
+  shared_ptr<DataArray> source_data_array;
+  size_t max_rules;
+  size_t num_rules;
+  long long num_lookups;
+  long long num_hits;
+  unordered_map<Key, Entry, boost::hash<Key>> entries;
+  // Most recently used phrases first.
+  list<Key> lru;
+  mutable mutex cache_mutex;
+};
+
+} // namespace extractor
+
+#endif
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "mocks/mock_data_array.h"
+#include "mocks/mock_vocabulary.h"
+#include "phrase.h"
+#include "phrase_builder.h"
+#include "phrase_location.h"
+#include "rule.h"
+#include "rule_cache.h"
+#include "rule_extractor.h"
+
+using namespace std;
+using namespace ::testing;
+
+namespace extractor {
+namespace {
+
+class RuleCacheTest : public Test {
+ protected:
+  virtual void SetUp() {
+    data_array = make_shared<MockDataArray>();
+    for (int i = 0; i < 100; ++i) {
+      EXPECT_CALL(*data_array, GetSentenceId(i))
+          .WillRepeatedly(Return(i / 10));
+    }
+
+    vocabulary = make_shared<MockVocabulary>();
+    EXPECT_CALL(*vocabulary, GetTerminalValue(_)).WillRepeatedly(Return("a"));
+    phrase_builder = make_shared<PhraseBuilder>(vocabulary);
+
+    vector<int> symbols = {1};
+    phrase1 = phrase_builder->Build(symbols);
+    symbols = {2};
+    phrase2 = phrase_builder->Build(symbols);
+    symbols = {3};
+    phrase3 = phrase_builder->Build(symbols);
+  }
+
+  // Statistics with num_rules phrase pairs and the rules scored from them.
+  void MakeRules(int num_rules, shared_ptr<const RuleCounts>& counts,
+                 shared_ptr<const vector<Rule>>& rules) {
+    shared_ptr<RuleCounts> new_counts = make_shared<RuleCounts>();
+    vector<double> scores = {0.5};
+    vector<pair<int, int>> alignment = {make_pair(0, 0)};
+    shared_ptr<vector<Rule>> new_rules = make_shared<vector<Rule>>();
+    for (int i = 0; i < num_rules; ++i) {
+      vector<int> symbols = {i + 10};
+      Phrase target_phrase = phrase_builder->Build(symbols);
+      new_counts->alignments_counter[phrase1][target_phrase][alignment] = 1;
+      new_rules->push_back(Rule(phrase1, target_phrase, scores, alignment));
+    }
+    counts = new_counts;
+    rules = new_rules;
+  }
+
+  void Insert(RuleCache& cache, const Phrase& phrase, int data_version,
+              const PhraseLocation& sample, int num_rules) {
+    shared_ptr<const RuleCounts> counts;
+    shared_ptr<const vector<Rule>> rules;
+    MakeRules(num_rules, counts, rules);
+    cache.Insert(phrase, data_version, sample, counts, rules);
+  }
+
+  bool Find(RuleCache& cache, const Phrase& phrase, int data_version,
+            const unordered_set<int>& blacklisted_sentence_ids) {
+    shared_ptr<const RuleCounts> counts;
+    shared_ptr<const vector<Rule>> rules;
+    return cache.Find(phrase, data_version, blacklisted_sentence_ids, counts,
+                      rules);
+  }
+
+  shared_ptr<MockDataArray> data_array;
+  shared_ptr<MockVocabulary> vocabulary;
+  shared_ptr<PhraseBuilder> phrase_builder;
+  Phrase phrase1, phrase2, phrase3;
+};
+
+TEST_F(RuleCacheTest, TestFind) {
+  RuleCache cache(data_array, 10);
+  EXPECT_FALSE(Find(cache, phrase1, 0, unordered_set<int>()));
+
+  PhraseLocation sample(vector<int>{5, 25, 27}, 1);
+  Insert(cache, phrase1, 0, sample, 3);
+  shared_ptr<const RuleCounts> counts;
+  shared_ptr<const vector<Rule>> rules;
+  EXPECT_TRUE(cache.Find(phrase1, 0, unordered_set<int>(), counts, rules));
+  ASSERT_TRUE(rules != NULL);
+  EXPECT_EQ(3, rules->size());
+  EXPECT_EQ(1, counts->alignments_counter.size());
+  EXPECT_FALSE(Find(cache, phrase2, 0, unordered_set<int>()));
+
+  long long num_lookups, num_hits;
+  cache.GetStats(num_lookups, num_hits);
+  EXPECT_EQ(3, num_lookups);
+  EXPECT_EQ(1, num_hits);
+}
+
+TEST_F(RuleCacheTest, TestBlacklist) {
+  RuleCache cache(data_array, 10);
+  PhraseLocation sample(vector<int>{5, 6, 25, 26}, 2);
+  EXPECT_TRUE(cache.IsBlacklisted(sample, {2}));
+  EXPECT_FALSE(cache.IsBlacklisted(sample, {1, 3}));
+  EXPECT_FALSE(cache.IsBlacklisted(sample, unordered_set<int>()));
+
+  Insert(cache, phrase1, 0, sample, 1);
+  EXPECT_TRUE(Find(cache, phrase1, 0, {1, 3}));
+  EXPECT_FALSE(Find(cache, phrase1, 0, {0}));
+}
+
+TEST_F(RuleCacheTest, TestEviction) {
+  RuleCache cache(data_array, 5);
+  PhraseLocation sample(vector<int>{0}, 1);
+  Insert(cache, phrase1, 0, sample, 2);
+  Insert(cache, phrase2, 0, sample, 2);
+  // Makes phrase2 the least recently used phrase.
+  EXPECT_TRUE(Find(cache, phrase1, 0, unordered_set<int>()));
+  Insert(cache, phrase3, 0, sample, 2);
+
+  EXPECT_TRUE(Find(cache, phrase1, 0, unordered_set<int>()));
+  EXPECT_FALSE(Find(cache, phrase2, 0, unordered_set<int>()));
+  EXPECT_TRUE(Find(cache, phrase3, 0, unordered_set<int>()));
+
+  // Phrases with more rules than the whole cache are not cached.
+  Insert(cache, phrase2, 0, sample, 6);
+  EXPECT_FALSE(Find(cache, phrase2, 0, unordered_set<int>()));
+}
+
+TEST_F(RuleCacheTest, TestDataVersion) {
+  RuleCache cache(data_array, 10);
+  PhraseLocation sample(vector<int>{0}, 1);
+  Insert(cache, phrase1, 0, sample, 2);
+
+  // The statistics are returned for any version, the rules only for the
+  // version they were scored with.
+  shared_ptr<const RuleCounts> counts;
+  shared_ptr<const vector<Rule>> rules;
+  EXPECT_TRUE(cache.Find(phrase1, 1, unordered_set<int>(), counts, rules));
+  EXPECT_TRUE(counts != NULL);
+  EXPECT_TRUE(rules == NULL);
+
+  shared_ptr<const RuleCounts> new_counts;
+  shared_ptr<const vector<Rule>> new_rules;
+  MakeRules(3, new_counts, new_rules);
+  cache.UpdateRules(phrase1, 1, new_rules);
+  EXPECT_TRUE(cache.Find(phrase1, 1, unordered_set<int>(), counts, rules));
+  EXPECT_EQ(new_rules, rules);
+
+  // Rules scored with older online data do not replace newer ones.
+  MakeRules(2, new_counts, new_rules);
+  cache.UpdateRules(phrase1, 0, new_rules);
+  EXPECT_TRUE(cache.Find(phrase1, 1, unordered_set<int>(), counts, rules));
+  EXPECT_EQ(3, rules->size());
+  EXPECT_TRUE(cache.Find(phrase1, 0, unordered_set<int>(), counts, rules));
+  EXPECT_TRUE(rules == NULL);
+}
+
+} // namespace
+} // namespace extractor
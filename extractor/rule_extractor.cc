@@ -74,29 +74,53 @@ RuleExtractor::RuleExtractor() {}
 
 RuleExtractor::~RuleExtractor() {}
 
+void RuleCounts::Add(const RuleCounts& other) {
+  for (const auto& entry: other.source_phrase_counter) {
+    source_phrase_counter[entry.first] += entry.second;
+  }
+  for (const auto& source_phrase_entry: other.alignments_counter) {
+    auto& target_phrases = alignments_counter[source_phrase_entry.first];
+    for (const auto& target_phrase_entry: source_phrase_entry.second) {
+      auto& alignments = target_phrases[target_phrase_entry.first];
+      for (const auto& alignment_entry: target_phrase_entry.second) {
+        alignments[alignment_entry.first] += alignment_entry.second;
+      }
+    }
+  }
+  num_samples += other.num_samples;
+}
+
 vector<Rule> RuleExtractor::ExtractRules(const Phrase& phrase,
                                          const PhraseLocation& location) const {
+  return ScoreRules(CountRules(phrase, location));
+}
+
+RuleCounts RuleExtractor::CountRules(const Phrase& phrase,
+                                     const PhraseLocation& location) const {
   int num_subpatterns = location.num_subpatterns;
-  vector<int> matchings = *location.matchings;
+  const FlatArray<int>& matchings = location.matchings;
 
   // Calculate statistics for the (sampled) occurrences of the source phrase.
-  map<Phrase, double> source_phrase_counter;
-  map<Phrase, map<Phrase, map<PhraseAlignment, int>>> alignments_counter;
+  RuleCounts counts;
   for (auto i = matchings.begin(); i != matchings.end(); i += num_subpatterns) {
     vector<int> matching(i, i + num_subpatterns);
     vector<Extract> extracts = ExtractAlignments(phrase, matching);
 
     for (Extract e: extracts) {
-      source_phrase_counter[e.source_phrase] += e.pairs_count;
-      alignments_counter[e.source_phrase][e.target_phrase][e.alignment] += 1;
+      counts.source_phrase_counter[e.source_phrase] += e.pairs_count;
+      counts.alignments_counter[e.source_phrase][e.target_phrase]
+          [e.alignment] += 1;
     }
   }
+  counts.num_samples = matchings.size() / num_subpatterns;
+  return counts;
+}
 
+vector<Rule> RuleExtractor::ScoreRules(const RuleCounts& counts) const {
   // Compute the feature scores and find the most likely (frequent) alignment
   // for each pair of source-target phrases.
-  int num_samples = matchings.size() / num_subpatterns;
   vector<Rule> rules;
-  for (auto source_phrase_entry: alignments_counter) {
+  for (auto source_phrase_entry: counts.alignments_counter) {
     Phrase source_phrase = source_phrase_entry.first;
     for (auto target_phrase_entry: source_phrase_entry.second) {
       Phrase target_phrase = target_phrase_entry.first;
@@ -112,7 +136,8 @@ vector<Rule> RuleExtractor::ExtractRules(const Phrase& phrase,
       }
 
       features::FeatureContext context(source_phrase, target_phrase,
-          source_phrase_counter[source_phrase], num_locations, num_samples);
+          counts.source_phrase_counter.at(source_phrase), num_locations,
+          counts.num_samples);
       vector<double> scores = scorer->Score(context);
       rules.push_back(Rule(source_phrase, target_phrase, scores,
                            most_frequent_alignment));
@@ -1,6 +1,7 @@
 #ifndef _RULE_EXTRACTOR_H_
 #define _RULE_EXTRACTOR_H_
 
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -38,6 +39,23 @@ struct Extract {
   PhraseAlignment alignment;
 };
 
+/**
+ * Statistics about the source-target phrase pairs extracted from a sample of
+ * occurrences of a source phrase. Statistics computed from different samples
+ * (e.g. from the compiled data and from the sentence pairs added online) can
+ * be added together before computing the feature scores.
+ */
+struct RuleCounts {
+  RuleCounts() : num_samples(0) {}
+
+  // Adds the statistics computed from another sample.
+  void Add(const RuleCounts& other);
+
+  map<Phrase, double> source_phrase_counter;
+  map<Phrase, map<Phrase, map<PhraseAlignment, int>>> alignments_counter;
+  int num_samples;
+};
+
 /**
  * Component for extracting SCFG rules.
  */
@@ -76,6 +94,15 @@ class RuleExtractor {
   virtual vector<Rule> ExtractRules(const Phrase& phrase,
                                     const PhraseLocation& location) const;
 
+  // Computes the statistics of the phrase pairs extracted from the given
+  // occurrences of the source phrase.
+  RuleCounts CountRules(const Phrase& phrase,
+                        const PhraseLocation& location) const;
+
+  // Computes the feature scores and finds the most frequent alignment of each
+  // phrase pair.
+  vector<Rule> ScoreRules(const RuleCounts& counts) const;
+
  protected:
   RuleExtractor();
 
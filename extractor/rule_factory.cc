@@ -8,11 +8,14 @@
 #include "grammar.h"
 #include "fast_intersector.h"
 #include "matchings_finder.h"
+#include "online_index.h"
 #include "phrase.h"
 #include "phrase_builder.h"
 #include "rule.h"
+#include "rule_cache.h"
 #include "rule_extractor.h"
 #include "phrase_location_sampler.h"
+#include "precomputation.h"
 #include "sampler.h"
 #include "scorer.h"
 #include "suffix_array.h"
@@ -53,14 +56,19 @@ HieroCachingRuleFactory::HieroCachingRuleFactory(
     int max_nonterminals,
     int max_rule_symbols,
     int max_samples,
-    bool require_tight_phrases) :
+    bool require_tight_phrases,
+    int max_cached_rules,
+    shared_ptr<OnlineIndex> online_index) :
     vocabulary(vocabulary),
     scorer(scorer),
+    online_index(online_index),
     min_gap_size(min_gap_size),
     max_rule_span(max_rule_span),
     max_nonterminals(max_nonterminals),
     max_chunks(max_nonterminals + 1),
-    max_rule_symbols(max_rule_symbols) {
+    max_rule_symbols(max_rule_symbols),
+    max_samples(max_samples),
+    require_tight_phrases(require_tight_phrases) {
   matchings_finder = make_shared<MatchingsFinder>(source_suffix_array);
   fast_intersector = make_shared<FastIntersector>(source_suffix_array,
       precomputation, vocabulary, max_rule_span, min_gap_size);
@@ -71,6 +79,10 @@ HieroCachingRuleFactory::HieroCachingRuleFactory(
       false, require_tight_phrases);
   sampler = make_shared<PhraseLocationSampler>(
       source_suffix_array, max_samples);
+  if (max_cached_rules > 0) {
+    rule_cache = make_shared<RuleCache>(
+        source_suffix_array->GetData(), max_cached_rules);
+  }
 }
 
 HieroCachingRuleFactory::HieroCachingRuleFactory(
@@ -111,6 +123,9 @@ Grammar HieroCachingRuleFactory::GetGrammar(
   double total_intersect_time = 0;
   double total_lookup_time = 0;
 
+  // The same online index is used for the whole sentence.
+  shared_ptr<OnlineComponents> online = GetOnlineComponents();
+
   MatchingsTrie trie;
   shared_ptr<TrieNode> root = trie.GetRoot();
 
@@ -153,9 +168,10 @@ Grammar HieroCachingRuleFactory::GetGrammar(
         // If the phrase starts with a non terminal, we simply use the matchings
         // from the suffix link.
         next_node = make_shared<TrieNode>(
-            next_suffix_link, next_phrase, next_suffix_link->matchings);
+            next_suffix_link, next_phrase, next_suffix_link->matchings,
+            next_suffix_link->online_matchings);
       } else {
-        PhraseLocation phrase_location;
+        PhraseLocation phrase_location, online_location;
         if (next_phrase.Arity() > 0) {
           // For phrases containing a nonterminal, we use either the occurrences
           // of the prefix or the suffix to determine the occurrences of the
@@ -163,6 +179,11 @@ Grammar HieroCachingRuleFactory::GetGrammar(
           Clock::time_point intersect_start = Clock::now();
           phrase_location = fast_intersector->Intersect(
               node->matchings, next_suffix_link->matchings, next_phrase);
+          if (online != NULL) {
+            online_location = online->fast_intersector->Intersect(
+                node->online_matchings, next_suffix_link->online_matchings,
+                next_phrase);
+          }
           Clock::time_point intersect_stop = Clock::now();
           total_intersect_time += GetDuration(intersect_start, intersect_stop);
         } else {
@@ -174,17 +195,23 @@ Grammar HieroCachingRuleFactory::GetGrammar(
               node->matchings,
               vocabulary->GetTerminalValue(word_id),
               state.phrase.size());
+          if (online != NULL) {
+            online_location = online->matchings_finder->Find(
+                node->online_matchings,
+                vocabulary->GetTerminalValue(word_id),
+                state.phrase.size());
+          }
           Clock::time_point lookup_stop = Clock::now();
           total_lookup_time += GetDuration(lookup_start, lookup_stop);
         }
 
-        if (phrase_location.IsEmpty()) {
+        if (phrase_location.IsEmpty() && online_location.IsEmpty()) {
           continue;
         }
 
         // Create new trie node to store data about the current phrase.
         next_node = make_shared<TrieNode>(
-            next_suffix_link, next_phrase, phrase_location);
+            next_suffix_link, next_phrase, phrase_location, online_location);
       }
       // Add the new trie node to the trie cache.
       node->AddChild(word_id, next_node);
@@ -197,10 +224,9 @@ Grammar HieroCachingRuleFactory::GetGrammar(
       Clock::time_point extract_start = Clock::now();
       if (!state.starts_with_x) {
         // Extract rules for the sampled set of occurrences.
-        PhraseLocation sample = sampler->Sample(
-            next_node->matchings, blacklisted_sentence_ids);
-        vector<Rule> new_rules =
-            rule_extractor->ExtractRules(next_phrase, sample);
+        vector<Rule> new_rules = ExtractRules(
+            next_phrase, next_node->matchings, next_node->online_matchings,
+            online, blacklisted_sentence_ids);
         rules.insert(rules.end(), new_rules.begin(), new_rules.end());
       }
       Clock::time_point extract_stop = Clock::now();
@@ -225,10 +251,117 @@ Grammar HieroCachingRuleFactory::GetGrammar(
     cerr << "Extract time = " << total_extract_time << " seconds" << endl;
     cerr << "Intersect time = " << total_intersect_time << " seconds" << endl;
     cerr << "Lookup time = " << total_lookup_time << " seconds" << endl;
+    if (rule_cache != NULL) {
+      long long num_lookups, num_hits;
+      rule_cache->GetStats(num_lookups, num_hits);
+      cerr << "Rule cache hits = " << num_hits << " / " << num_lookups << endl;
+    }
   }
   return Grammar(rules, scorer->GetFeatureNames());
 }
 
+vector<Rule> HieroCachingRuleFactory::ExtractRules(
+    const Phrase& phrase,
+    const PhraseLocation& location,
+    const PhraseLocation& online_location,
+    const shared_ptr<OnlineComponents>& online,
+    const unordered_set<int>& blacklisted_sentence_ids) {
+  if (rule_cache == NULL && online_location.IsEmpty()) {
+    PhraseLocation sample = sampler->Sample(location, blacklisted_sentence_ids);
+    return rule_extractor->ExtractRules(phrase, sample);
+  }
+
+  int data_version = online == NULL ? 0 : online->version;
+  shared_ptr<const RuleCounts> counts;
+  shared_ptr<const vector<Rule>> rules;
+  bool cached = rule_cache != NULL && rule_cache->Find(
+      phrase, data_version, blacklisted_sentence_ids, counts, rules);
+  if (rules != NULL && online_location.IsEmpty()) {
+    return *rules;
+  }
+
+  bool cache_counts = false;
+  PhraseLocation sample;
+  if (!cached) {
+    if (location.IsEmpty()) {
+      counts = make_shared<RuleCounts>();
+    } else if (rule_cache == NULL) {
+      sample = sampler->Sample(location, blacklisted_sentence_ids);
+      counts = make_shared<RuleCounts>(
+          rule_extractor->CountRules(phrase, sample));
+    } else {
+      // The blacklist only changes the sample if it covers one of the sampled
+      // occurrences, so the statistics can be cached in all other cases.
+      sample = sampler->Sample(location, unordered_set<int>());
+      cache_counts = !rule_cache->IsBlacklisted(
+          sample, blacklisted_sentence_ids);
+      if (!cache_counts) {
+        sample = sampler->Sample(location, blacklisted_sentence_ids);
+      }
+      counts = make_shared<RuleCounts>(
+          rule_extractor->CountRules(phrase, sample));
+    }
+  }
+
+  if (!online_location.IsEmpty()) {
+    // The occurrences in the online data are sampled separately (the blacklist
+    // only refers to the source data) and the statistics of both samples are
+    // scored together.
+    PhraseLocation online_sample =
+        online->sampler->Sample(online_location, unordered_set<int>());
+    RuleCounts all_counts = *counts;
+    all_counts.Add(online->rule_extractor->CountRules(phrase, online_sample));
+    if (cache_counts) {
+      rule_cache->Insert(phrase, data_version, sample, counts, rules);
+    }
+    return rule_extractor->ScoreRules(all_counts);
+  }
+
+  // The statistics of the source data never change, but the rules are scored
+  // again whenever sentence pairs are added online.
+  rules = make_shared<vector<Rule>>(rule_extractor->ScoreRules(*counts));
+  if (cache_counts) {
+    rule_cache->Insert(phrase, data_version, sample, counts, rules);
+  } else if (cached) {
+    rule_cache->UpdateRules(phrase, data_version, rules);
+  }
+  return *rules;
+}
+
+shared_ptr<HieroCachingRuleFactory::OnlineComponents>
+    HieroCachingRuleFactory::GetOnlineComponents() {
+  if (online_index == NULL) {
+    return shared_ptr<OnlineComponents>();
+  }
+  shared_ptr<const OnlineData> data = online_index->GetData();
+  if (data == NULL) {
+    return shared_ptr<OnlineComponents>();
+  }
+
+  lock_guard<mutex> lock(online_mutex);
+  if (online_components == NULL ||
+      online_components->version != data->version) {
+    shared_ptr<SuffixArray> suffix_array = data->source_suffix_array;
+    shared_ptr<OnlineComponents> components = make_shared<OnlineComponents>();
+    components->version = data->version;
+    components->matchings_finder = make_shared<MatchingsFinder>(suffix_array);
+    // There are too few sentence pairs online for precomputed collocations to
+    // pay off.
+    components->fast_intersector = make_shared<FastIntersector>(suffix_array,
+        make_shared<Precomputation>(), vocabulary, max_rule_span,
+        min_gap_size);
+    components->rule_extractor = make_shared<RuleExtractor>(
+        suffix_array->GetData(), data->target_data_array, data->alignment,
+        phrase_builder, scorer, vocabulary, max_rule_span, min_gap_size,
+        max_nonterminals, max_rule_symbols, true, false,
+        require_tight_phrases);
+    components->sampler = make_shared<PhraseLocationSampler>(
+        suffix_array, max_samples);
+    online_components = components;
+  }
+  return online_components;
+}
+
 bool HieroCachingRuleFactory::CannotHaveMatchings(
     shared_ptr<TrieNode> node, int word_id) {
   if (node->HasChild(word_id) && node->GetChild(word_id) == NULL) {
@@ -263,7 +396,8 @@ void HieroCachingRuleFactory::AddTrailingNonterminal(
       prefix_node->suffix_link->GetChild(suffix_var_id);
 
   prefix_node->AddChild(var_id, make_shared<TrieNode>(
-      var_suffix_link, var_phrase, prefix_node->matchings));
+      var_suffix_link, var_phrase, prefix_node->matchings,
+      prefix_node->online_matchings));
 }
 
 vector<State> HieroCachingRuleFactory::ExtendState(
@@ -2,6 +2,7 @@
 #define _RULE_FACTORY_H_
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <unordered_set>
 
@@ -16,9 +17,12 @@ class DataArray;
 class FastIntersector;
 class Grammar;
 class MatchingsFinder;
+class OnlineIndex;
 class PhraseBuilder;
+class PhraseLocation;
 class Precomputation;
 class Rule;
+class RuleCache;
 class RuleExtractor;
 class Sampler;
 class Scorer;
@@ -36,6 +40,12 @@ class Vocabulary;
  * occurrences to extract aligned source-target phrase pairs. A trie cache is
  * used to avoid unnecessary computations if a source phrase can be constructed
  * more than once (e.g. some words occur more than once in the sentence).
+ * The rules extracted for frequent phrases are also kept in a cache shared
+ * across sentences (see RuleCache).
+ *
+ * If an online index is given, the sentence pairs added to it are searched
+ * together with the source data. The statistics of the phrase pairs extracted
+ * from both are added up before scoring the rules.
  */
 class HieroCachingRuleFactory {
  public:
@@ -51,7 +61,9 @@ class HieroCachingRuleFactory {
       int max_nonterminals,
       int max_rule_symbols,
       int max_samples,
-      bool require_tight_phrases);
+      bool require_tight_phrases,
+      int max_cached_rules,
+      shared_ptr<OnlineIndex> online_index);
 
   // For testing only.
   HieroCachingRuleFactory(
@@ -80,6 +92,19 @@ class HieroCachingRuleFactory {
   HieroCachingRuleFactory();
 
  private:
+  // Components searching the index of the sentence pairs added online.
+  struct OnlineComponents {
+    int version;
+    shared_ptr<MatchingsFinder> matchings_finder;
+    shared_ptr<FastIntersector> fast_intersector;
+    shared_ptr<RuleExtractor> rule_extractor;
+    shared_ptr<Sampler> sampler;
+  };
+
+  // Returns the components for the latest online index (built the first time
+  // the index is seen) or NULL if there is no online data.
+  shared_ptr<OnlineComponents> GetOnlineComponents();
+
   // Checks if the phrase (if previously encountered) or its prefix have any
   // occurrences in the source data.
   bool CannotHaveMatchings(shared_ptr<TrieNode> node, int word_id);
@@ -94,6 +119,14 @@ class HieroCachingRuleFactory {
                               const shared_ptr<TrieNode>& prefix_node,
                               bool starts_with_x);
 
+  // Samples the occurrences of a phrase and extracts the rules, going through
+  // the rule cache if there is one and the phrase does not occur in the online
+  // data.
+  vector<Rule> ExtractRules(const Phrase& phrase, const PhraseLocation& location,
+                            const PhraseLocation& online_location,
+                            const shared_ptr<OnlineComponents>& online,
+                            const unordered_set<int>& blacklisted_sentence_ids);
+
   // Extends the current state by possibly adding a nonterminal followed by a
   // terminal.
   vector<State> ExtendState(const vector<int>& word_ids,
@@ -109,11 +142,17 @@ class HieroCachingRuleFactory {
   shared_ptr<Vocabulary> vocabulary;
   shared_ptr<Sampler> sampler;
   shared_ptr<Scorer> scorer;
+  shared_ptr<RuleCache> rule_cache;
+  shared_ptr<OnlineIndex> online_index;
+  shared_ptr<OnlineComponents> online_components;
+  mutex online_mutex;
   int min_gap_size;
   int max_rule_span;
   int max_nonterminals;
   int max_chunks;
   int max_rule_symbols;
+  int max_samples;
+  bool require_tight_phrases;
 };
 
 } // namespace extractor
@@ -2,10 +2,10 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
-#include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 #if HAVE_OPEN_MP
@@ -26,6 +26,8 @@
 #include "features/target_given_source_coherent.h"
 #include "grammar.h"
 #include "grammar_extractor.h"
+#include "grammar_stream.h"
+#include "online_index.h"
 #include "precomputation.h"
 #include "rule.h"
 #include "scorer.h"
@@ -34,18 +36,11 @@
 #include "translation_table.h"
 #include "vocabulary.h"
 
-namespace fs = boost::filesystem;
 namespace po = boost::program_options;
 using namespace std;
 using namespace extractor;
 using namespace features;
 
-// Returns the file path in which a given grammar should be written.
-fs::path GetGrammarFilePath(const fs::path& grammar_path, int file_number) {
-  string file_name = "grammar." + to_string(file_number);
-  return grammar_path / file_name;
-}
-
 int main(int argc, char** argv) {
   // Sets up the command line arguments map.
   int max_threads = 1;
@@ -60,7 +55,20 @@ int main(int argc, char** argv) {
     ("target,e", po::value<string>(), "Target language corpus")
     ("bitext,b", po::value<string>(), "Parallel text (source ||| target)")
     ("alignment,a", po::value<string>()->required(), "Bitext word alignment")
-    ("grammars,g", po::value<string>()->required(), "Grammars output path")
+    ("grammars,g", po::value<string>(),
+        "Grammars output path (not needed for inline grammars)")
+    ("grammar_format", po::value<string>()->default_value("files"),
+        "How grammars are passed on: files, inline or indexed")
+    ("binary_grammars", "Write the grammars in the binary format read by "
+        "the decoder (smaller and faster to load than text grammars)")
+    ("streaming", "Extract sentences as they arrive and write each <seg> line "
+        "as soon as the previous ones are done")
+    ("reorder_buffer", po::value<int>()->default_value(100),
+        "Maximum number of sentences read ahead of the first one not written "
+        "yet in streaming mode")
+    ("online", "Accept \"LEARN ||| source ||| target ||| alignment\" input "
+        "lines adding sentence pairs to the data used for the following "
+        "sentences (implies --streaming)")
     ("threads,t", po::value<int>()->default_value(1), threads_option.c_str())
     ("frequent", po::value<int>()->default_value(100),
         "Number of precomputed frequent patterns")
@@ -81,6 +89,9 @@ int main(int argc, char** argv) {
         "Maximum number of samples")
     ("tight_phrases", po::value<bool>()->default_value(true),
         "False if phrases may be loose (better, but slower)")
+    ("rule_cache_size", po::value<int>()->default_value(200000),
+        "Maximum number of rules kept in the cache shared across sentences "
+        "(0 disables the cache)")
     ("leave_one_out", po::value<bool>()->zero_tokens(),
         "do leave-one-out estimation of grammars "
         "(e.g. for extracting grammars for the training set");
@@ -107,6 +118,26 @@ int main(int argc, char** argv) {
   int num_threads = vm["threads"].as<int>();
   cerr << "Grammar extraction will use " << num_threads << " threads." << endl;
 
+  GrammarFormat grammar_format;
+  if (!ParseGrammarFormat(vm["grammar_format"].as<string>(), &grammar_format)) {
+    cerr << "Unknown grammar format: " << vm["grammar_format"].as<string>()
+         << endl;
+    return 1;
+  }
+  if (grammar_format != GRAMMAR_INLINE && !vm.count("grammars")) {
+    cerr << "The grammars output path (-g) is required." << endl;
+    return 1;
+  }
+  const bool use_binary = vm.count("binary_grammars");
+  if (use_binary && grammar_format == GRAMMAR_INLINE) {
+    cerr << "Inline grammars can only be written as text." << endl;
+    return 1;
+  }
+  if (vm["reorder_buffer"].as<int>() < 1) {
+    cerr << "The reorder buffer must hold at least one sentence." << endl;
+    return 1;
+  }
+
   // Reads the parallel corpus.
   Clock::time_point preprocess_start_time = Clock::now();
   cerr << "Reading source and target data..." << endl;
@@ -191,6 +222,16 @@ int main(int argc, char** argv) {
   };
   shared_ptr<Scorer> scorer = make_shared<Scorer>(features);
 
+  // The sentence pairs added online are indexed in the background.
+  shared_ptr<OnlineIndex> online_index;
+  CommandFunction command;
+  if (vm.count("online")) {
+    online_index = make_shared<OnlineIndex>(table);
+    command = [&](const string& line) {
+      return online_index->HandleLearnCommand(line);
+    };
+  }
+
   // Sets up the grammar extractor.
   GrammarExtractor extractor(
       source_suffix_array,
@@ -204,48 +245,53 @@ int main(int argc, char** argv) {
       vm["max_nonterminals"].as<int>(),
       vm["max_rule_symbols"].as<int>(),
       vm["max_samples"].as<int>(),
-      vm["tight_phrases"].as<bool>());
+      vm["tight_phrases"].as<bool>(),
+      vm["rule_cache_size"].as<int>(),
+      online_index);
 
-  // Creates the grammars directory if it doesn't exist.
-  fs::path grammar_path = vm["grammars"].as<string>();
-  if (!fs::is_directory(grammar_path)) {
-    fs::create_directory(grammar_path);
-  }
-
-  // Reads all sentences for which we extract grammar rules (the paralellization
-  // is simplified if we read all sentences upfront).
-  string sentence;
-  vector<string> sentences;
-  while (getline(cin, sentence)) {
-    sentences.push_back(sentence);
-  }
+  GrammarWriter writer(vm.count("grammars") ? vm["grammars"].as<string>() : "",
+                       grammar_format, false);
 
-  // Extracts the grammar for each sentence and saves it to a file.
   bool leave_one_out = vm.count("leave_one_out");
-  vector<string> suffixes(sentences.size());
-  #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
-  for (size_t i = 0; i < sentences.size(); ++i) {
-    string suffix;
-    int position = sentences[i].find("|||");
-    if (position != sentences[i].npos) {
-      suffix = sentences[i].substr(position);
-      sentences[i] = sentences[i].substr(0, position);
-    }
-    suffixes[i] = suffix;
-
+  ExtractFunction extract = [&](int sentence_id, const string& sentence) {
     unordered_set<int> blacklisted_sentence_ids;
     if (leave_one_out) {
-      blacklisted_sentence_ids.insert(i);
+      blacklisted_sentence_ids.insert(sentence_id);
+    }
+    Grammar grammar = extractor.GetGrammar(sentence, blacklisted_sentence_ids);
+    ostringstream rules;
+    if (use_binary) {
+      grammar.WriteBinary(rules);
+    } else {
+      rules << grammar;
+    }
+    return rules.str();
+  };
+
+  if (vm.count("streaming") || vm.count("online")) {
+    StreamGrammars(cin, cout, 0, num_threads, vm["reorder_buffer"].as<int>(),
+                   extract, writer, command);
+  } else {
+    // Reads all sentences for which we extract grammar rules (the
+    // paralellization is simplified if we read all sentences upfront).
+    string line;
+    vector<string> lines;
+    while (getline(cin, line)) {
+      lines.push_back(line);
     }
-    Grammar grammar = extractor.GetGrammar(
-        sentences[i], blacklisted_sentence_ids);
-    ofstream output(GetGrammarFilePath(grammar_path, i).c_str());
-    output << grammar;
-  }
 
-  for (size_t i = 0; i < sentences.size(); ++i) {
-    cout << "<seg grammar=" << GetGrammarFilePath(grammar_path, i) << " id=\""
-         << i << "\"> " << sentences[i] << " </seg> " << suffixes[i] << endl;
+    // Extracts the grammar for each sentence and saves it to a file.
+    vector<ExtractedGrammar> grammars(lines.size());
+    #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t i = 0; i < lines.size(); ++i) {
+      SplitInputLine(lines[i], &grammars[i].sentence, &grammars[i].suffix);
+      grammars[i].rules = extract(i, grammars[i].sentence);
+      writer.WriteGrammarFile(i, grammars[i]);
+    }
+
+    for (size_t i = 0; i < grammars.size(); ++i) {
+      writer.WriteSegment(i, grammars[i], cout);
+    }
   }
 
   Clock::time_point extraction_stop_time = Clock::now();
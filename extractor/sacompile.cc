@@ -9,6 +9,7 @@
 
 #include "alignment.h"
 #include "data_array.h"
+#include "flat_file.h"
 #include "precomputation.h"
 #include "suffix_array.h"
 #include "time_util.h"
@@ -21,6 +22,21 @@ namespace po = boost::program_options;
 using namespace std;
 using namespace extractor;
 
+// Writes a compiled data structure either in the flat format, which extract
+// memory maps and uses in place, or as a boost archive.
+template<class T>
+void WriteCompiled(const string& filename, FlatFileType type, const T& object,
+                   bool use_boost_archives) {
+  if (use_boost_archives) {
+    ofstream fstream(filename);
+    ar::binary_oarchive stream(fstream);
+    stream << object;
+  } else {
+    FlatFileWriter writer(filename, type);
+    object.WriteFlat(writer);
+  }
+}
+
 int main(int argc, char** argv) {
   po::options_description desc("Command line options");
   desc.add_options()
@@ -44,7 +60,11 @@ int main(int argc, char** argv) {
     ("max_phrase_len,p", po::value<int>()->default_value(4),
         "Maximum frequent phrase length")
     ("min_frequency", po::value<int>()->default_value(1000),
-        "Minimum number of occurrences for a pharse to be considered frequent");
+        "Minimum number of occurrences for a pharse to be considered frequent")
+    ("sa_algorithm", po::value<string>()->default_value("sais"),
+        "Suffix array construction algorithm: sais or prefix_doubling")
+    ("boost_archives",
+        "Write boost serialization archives instead of memory mappable files");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -65,6 +85,19 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  SuffixArray::Algorithm sa_algorithm;
+  if (vm["sa_algorithm"].as<string>() == "sais") {
+    sa_algorithm = SuffixArray::SAIS;
+  } else if (vm["sa_algorithm"].as<string>() == "prefix_doubling") {
+    sa_algorithm = SuffixArray::PREFIX_DOUBLING;
+  } else {
+    cerr << "Unknown suffix array algorithm: "
+         << vm["sa_algorithm"].as<string>() << endl;
+    return 1;
+  }
+
+  bool use_boost_archives = vm.count("boost_archives");
+
   fs::path output_dir(vm["output"].as<string>());
   if (!fs::exists(output_dir)) {
     fs::create_directory(output_dir);
@@ -89,9 +122,8 @@ int main(int argc, char** argv) {
   Clock::time_point start_write = Clock::now();
   string target_path = (output_dir / fs::path("target.bin")).string();
   config_stream << "target = " << target_path << endl;
-  ofstream target_fstream(target_path);
-  ar::binary_oarchive target_stream(target_fstream);
-  target_stream << *target_data_array;
+  WriteCompiled(target_path, FLAT_DATA_ARRAY, *target_data_array,
+                use_boost_archives);
   Clock::time_point stop_write = Clock::now();
   double write_duration = GetDuration(start_write, stop_write);
 
@@ -103,14 +135,13 @@ int main(int argc, char** argv) {
   start_time = Clock::now();
   cerr << "Constructing source suffix array..." << endl;
   shared_ptr<SuffixArray> source_suffix_array =
-      make_shared<SuffixArray>(source_data_array);
+      make_shared<SuffixArray>(source_data_array, sa_algorithm);
 
   start_write = Clock::now();
   string source_path = (output_dir / fs::path("source.bin")).string();
   config_stream << "source = " << source_path << endl;
-  ofstream source_fstream(source_path);
-  ar::binary_oarchive output_stream(source_fstream);
-  output_stream << *source_suffix_array;
+  WriteCompiled(source_path, FLAT_SUFFIX_ARRAY, *source_suffix_array,
+                use_boost_archives);
   stop_write = Clock::now();
   write_duration += GetDuration(start_write, stop_write);
 
@@ -127,9 +158,8 @@ int main(int argc, char** argv) {
   start_write = Clock::now();
   string alignment_path = (output_dir / fs::path("alignment.bin")).string();
   config_stream << "alignment = " << alignment_path << endl;
-  ofstream alignment_fstream(alignment_path);
-  ar::binary_oarchive alignment_stream(alignment_fstream);
-  alignment_stream << *alignment;
+  WriteCompiled(alignment_path, FLAT_ALIGNMENT, *alignment,
+                use_boost_archives);
   stop_write = Clock::now();
   write_duration += GetDuration(start_write, stop_write);
 
@@ -155,9 +185,8 @@ int main(int argc, char** argv) {
   start_write = Clock::now();
   string precomputation_path = (output_dir / fs::path("precomp.bin")).string();
   config_stream << "precomputation = " << precomputation_path << endl;
-  ofstream precomp_fstream(precomputation_path);
-  ar::binary_oarchive precomp_stream(precomp_fstream);
-  precomp_stream << precomputation;
+  WriteCompiled(precomputation_path, FLAT_PRECOMPUTATION, precomputation,
+                use_boost_archives);
 
   string vocabulary_path = (output_dir / fs::path("vocab.bin")).string();
   config_stream << "vocabulary = " << vocabulary_path << endl;
@@ -178,9 +207,7 @@ int main(int argc, char** argv) {
   start_write = Clock::now();
   string table_path = (output_dir / fs::path("bilex.bin")).string();
   config_stream << "ttable = " << table_path << endl;
-  ofstream table_fstream(table_path);
-  ar::binary_oarchive table_stream(table_fstream);
-  table_stream << table;
+  WriteCompiled(table_path, FLAT_TRANSLATION_TABLE, table, use_boost_archives);
   stop_write = Clock::now();
   write_duration += GetDuration(start_write, stop_write);
 
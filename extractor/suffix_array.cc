@@ -1,5 +1,6 @@
 #include "suffix_array.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <iostream>
@@ -15,43 +16,26 @@ using namespace chrono;
 
 namespace extractor {
 
-SuffixArray::SuffixArray(shared_ptr<DataArray> data_array) :
+SuffixArray::SuffixArray(shared_ptr<DataArray> data_array,
+                         Algorithm algorithm) :
     data_array(data_array) {
-  BuildSuffixArray();
+  if (algorithm == SAIS) {
+    BuildSuffixArraySAIS();
+  } else {
+    BuildSuffixArray();
+  }
 }
 
 SuffixArray::SuffixArray() {}
 
 SuffixArray::~SuffixArray() {}
 
-void SuffixArray::BuildSuffixArray() {
-  vector<int> groups = data_array->GetData();
-  groups.reserve(groups.size() + 1);
-  groups.push_back(DataArray::NULL_WORD);
-  suffix_array.resize(groups.size());
-  word_start.resize(data_array->GetVocabularySize() + 1);
-
-  InitialBucketSort(groups);
-
-  int combined_group_size = 0;
-  for (size_t i = 1; i < word_start.size(); ++i) {
-    if (word_start[i] - word_start[i - 1] == 1) {
-      ++combined_group_size;
-      suffix_array[word_start[i] - combined_group_size] = -combined_group_size;
-    } else {
-      combined_group_size = 0;
-    }
-  }
-
-  PrefixDoublingSort(groups);
-  cerr << "\tFinalizing sort..." << endl;
-
-  for (size_t i = 0; i < groups.size(); ++i) {
-    suffix_array[groups[i]] = i;
-  }
-}
+namespace {
 
-void SuffixArray::InitialBucketSort(vector<int>& groups) {
+// Bucket sort on the data array (used for initializing the construction of
+// the suffix array.)
+void InitialBucketSort(vector<int>& suffix_array, vector<int>& word_start,
+                       vector<int>& groups) {
   Clock::time_point start_time = Clock::now();
   for (size_t i = 0; i < groups.size(); ++i) {
     ++word_start[groups[i]];
@@ -74,30 +58,8 @@ void SuffixArray::InitialBucketSort(vector<int>& groups) {
        << " seconds" << endl;
 }
 
-void SuffixArray::PrefixDoublingSort(vector<int>& groups) {
-  int step = 1;
-  while (suffix_array[0] != -suffix_array.size()) {
-    int combined_group_size = 0;
-    int i = 0;
-    while (i < suffix_array.size()) {
-      if (suffix_array[i] < 0) {
-        int skip = -suffix_array[i];
-        combined_group_size += skip;
-        i += skip;
-        suffix_array[i - combined_group_size] = -combined_group_size;
-      } else {
-        combined_group_size = 0;
-        int j = groups[suffix_array[i]];
-        TernaryQuicksort(i, j, step, groups);
-        i = j + 1;
-      }
-    }
-    step *= 2;
-  }
-}
-
-void SuffixArray::TernaryQuicksort(int left, int right, int step,
-    vector<int>& groups) {
+void TernaryQuicksort(vector<int>& suffix_array, int left, int right, int step,
+                      vector<int>& groups) {
   if (left > right) {
     return;
   }
@@ -122,7 +84,7 @@ void SuffixArray::TernaryQuicksort(int left, int right, int step,
     }
   }
 
-  TernaryQuicksort(left, mid_left - 1, step, groups);
+  TernaryQuicksort(suffix_array, left, mid_left - 1, step, groups);
 
   if (mid_left == mid_right) {
     groups[suffix_array[mid_left]] = mid_left;
@@ -133,36 +95,280 @@ void SuffixArray::TernaryQuicksort(int left, int right, int step,
     }
   }
 
-  TernaryQuicksort(mid_right + 1, right, step, groups);
+  TernaryQuicksort(suffix_array, mid_right + 1, right, step, groups);
+}
+
+// Constructs the suffix array in log(n) steps by doubling the length of the
+// suffixes at each step.
+void PrefixDoublingSort(vector<int>& suffix_array, vector<int>& groups) {
+  int step = 1;
+  while (suffix_array[0] != -suffix_array.size()) {
+    int combined_group_size = 0;
+    int i = 0;
+    while (i < suffix_array.size()) {
+      if (suffix_array[i] < 0) {
+        int skip = -suffix_array[i];
+        combined_group_size += skip;
+        i += skip;
+        suffix_array[i - combined_group_size] = -combined_group_size;
+      } else {
+        combined_group_size = 0;
+        int j = groups[suffix_array[i]];
+        TernaryQuicksort(suffix_array, i, j, step, groups);
+        i = j + 1;
+      }
+    }
+    step *= 2;
+  }
+}
+
+// The words of the data array followed by the NULL_WORD sentinel, which is not
+// stored so that the data does not have to be copied to append it.
+class SentinelText {
+ public:
+  explicit SentinelText(const FlatArray<int>& data) :
+      words(data.begin()), size(data.size()) {}
+
+  int operator[](int index) const {
+    return index < size ? words[index] : DataArray::NULL_WORD;
+  }
+
+ private:
+  const int* words;
+  int size;
+};
+
+// Sets bucket[c] to the start (or one past the end) of the bucket of suffixes
+// starting with c.
+template<typename Text>
+void GetBuckets(const Text& text, int size, int alphabet_size, bool end,
+                vector<int>& bucket) {
+  fill(bucket.begin(), bucket.begin() + alphabet_size, 0);
+  for (int i = 0; i < size; ++i) {
+    ++bucket[text[i]];
+  }
+  int sum = 0;
+  for (int c = 0; c < alphabet_size; ++c) {
+    sum += bucket[c];
+    bucket[c] = end ? sum : sum - bucket[c];
+  }
+}
+
+inline bool IsLMS(const vector<bool>& is_s_type, int i) {
+  return i > 0 && is_s_type[i] && !is_s_type[i - 1];
+}
+
+// Sorts the L-type and then the S-type suffixes, given the positions of the
+// LMS suffixes at the ends of their buckets.
+template<typename Text>
+void InduceSort(const Text& text, int* suffix_array, int size,
+                int alphabet_size, const vector<bool>& is_s_type,
+                vector<int>& bucket) {
+  GetBuckets(text, size, alphabet_size, false, bucket);
+  for (int i = 0; i < size; ++i) {
+    int j = suffix_array[i] - 1;
+    if (j >= 0 && !is_s_type[j]) {
+      suffix_array[bucket[text[j]]++] = j;
+    }
+  }
+  GetBuckets(text, size, alphabet_size, true, bucket);
+  for (int i = size - 1; i >= 0; --i) {
+    int j = suffix_array[i] - 1;
+    if (j >= 0 && is_s_type[j]) {
+      suffix_array[--bucket[text[j]]] = j;
+    }
+  }
+}
+
+// SA-IS (Nong, Zhang and Chan, 2009). The text must end with a unique
+// character smaller than all the others and all characters must be in
+// [0, alphabet_size). The reduced texts of the recursive calls are stored in
+// the unused part of the suffix array.
+template<typename Text>
+void SAISort(const Text& text, int* suffix_array, int size,
+             int alphabet_size) {
+  if (size == 1) {
+    suffix_array[0] = 0;
+    return;
+  }
+
+  vector<bool> is_s_type(size);
+  is_s_type[size - 1] = true;
+  for (int i = size - 2; i >= 0; --i) {
+    is_s_type[i] = text[i] < text[i + 1] ||
+        (text[i] == text[i + 1] && is_s_type[i + 1]);
+  }
+
+  // Sort the LMS substrings.
+  vector<int> bucket(alphabet_size);
+  GetBuckets(text, size, alphabet_size, true, bucket);
+  fill(suffix_array, suffix_array + size, -1);
+  for (int i = 1; i < size; ++i) {
+    if (IsLMS(is_s_type, i)) {
+      suffix_array[--bucket[text[i]]] = i;
+    }
+  }
+  InduceSort(text, suffix_array, size, alphabet_size, is_s_type, bucket);
+
+  // Compact the sorted LMS substrings at the start of the suffix array and
+  // name them.
+  int num_lms = 0;
+  for (int i = 0; i < size; ++i) {
+    if (IsLMS(is_s_type, suffix_array[i])) {
+      suffix_array[num_lms++] = suffix_array[i];
+    }
+  }
+  fill(suffix_array + num_lms, suffix_array + size, -1);
+  int name = 0, prev = -1;
+  for (int i = 0; i < num_lms; ++i) {
+    int pos = suffix_array[i];
+    bool diff = false;
+    for (int d = 0; ; ++d) {
+      if (prev == -1 || text[pos + d] != text[prev + d] ||
+          is_s_type[pos + d] != is_s_type[prev + d]) {
+        diff = true;
+        break;
+      } else if (d > 0 && (IsLMS(is_s_type, pos + d) ||
+                           IsLMS(is_s_type, prev + d))) {
+        break;
+      }
+    }
+    if (diff) {
+      ++name;
+      prev = pos;
+    }
+    suffix_array[num_lms + pos / 2] = name - 1;
+  }
+  for (int i = size - 1, j = size - 1; i >= num_lms; --i) {
+    if (suffix_array[i] >= 0) {
+      suffix_array[j--] = suffix_array[i];
+    }
+  }
+
+  // Sort the reduced text, recursively if the names are not unique.
+  int* reduced_text = suffix_array + size - num_lms;
+  if (name < num_lms) {
+    SAISort<const int*>(reduced_text, suffix_array, num_lms, name);
+  } else {
+    for (int i = 0; i < num_lms; ++i) {
+      suffix_array[reduced_text[i]] = i;
+    }
+  }
+
+  // Induce the order of all suffixes from the sorted LMS suffixes.
+  for (int i = 1, j = 0; i < size; ++i) {
+    if (IsLMS(is_s_type, i)) {
+      reduced_text[j++] = i;
+    }
+  }
+  for (int i = 0; i < num_lms; ++i) {
+    suffix_array[i] = reduced_text[suffix_array[i]];
+  }
+  fill(suffix_array + num_lms, suffix_array + size, -1);
+  GetBuckets(text, size, alphabet_size, true, bucket);
+  for (int i = num_lms - 1; i >= 0; --i) {
+    int j = suffix_array[i];
+    suffix_array[i] = -1;
+    suffix_array[--bucket[text[j]]] = j;
+  }
+  InduceSort(text, suffix_array, size, alphabet_size, is_s_type, bucket);
+}
+
+} // namespace
+
+void SuffixArray::BuildSuffixArray() {
+  // The groups start as a copy of the data, which the sort then overwrites.
+  FlatArray<int> data = data_array->GetData();
+  vector<int> groups(data.size() + 1);
+  copy(data.begin(), data.end(), groups.begin());
+  groups.back() = DataArray::NULL_WORD;
+  vector<int> suffix_array(groups.size());
+  vector<int> word_start(data_array->GetVocabularySize() + 1);
+
+  InitialBucketSort(suffix_array, word_start, groups);
+
+  int combined_group_size = 0;
+  for (size_t i = 1; i < word_start.size(); ++i) {
+    if (word_start[i] - word_start[i - 1] == 1) {
+      ++combined_group_size;
+      suffix_array[word_start[i] - combined_group_size] = -combined_group_size;
+    } else {
+      combined_group_size = 0;
+    }
+  }
+
+  PrefixDoublingSort(suffix_array, groups);
+  cerr << "\tFinalizing sort..." << endl;
+
+  for (size_t i = 0; i < groups.size(); ++i) {
+    suffix_array[groups[i]] = i;
+  }
+  this->suffix_array = FlatArray<int>(move(suffix_array));
+  this->word_start = FlatArray<int>(move(word_start));
+}
+
+void SuffixArray::BuildSuffixArraySAIS() {
+  Clock::time_point start_time = Clock::now();
+  FlatArray<int> data = data_array->GetData();
+  int vocabulary_size = data_array->GetVocabularySize();
+  vector<int> suffix_array(data.size() + 1);
+  SAISort(SentinelText(data), suffix_array.data(), suffix_array.size(),
+          vocabulary_size);
+
+  vector<int> word_start(vocabulary_size + 1, 0);
+  for (int word_id: data) {
+    ++word_start[word_id + 1];
+  }
+  ++word_start[DataArray::NULL_WORD + 1];
+  for (size_t i = 1; i < word_start.size(); ++i) {
+    word_start[i] += word_start[i - 1];
+  }
+  this->suffix_array = FlatArray<int>(move(suffix_array));
+  this->word_start = FlatArray<int>(move(word_start));
+  Clock::time_point stop_time = Clock::now();
+  cerr << "\tSA-IS took " << GetDuration(start_time, stop_time)
+       << " seconds" << endl;
 }
 
 vector<int> SuffixArray::BuildLCPArray() const {
   Clock::time_point start_time = Clock::now();
   cerr << "\tConstructing LCP array..." << endl;
 
-  vector<int> lcp(suffix_array.size());
-  vector<int> rank(suffix_array.size());
-  const vector<int>& data = data_array->GetData();
+  int size = suffix_array.size();
+  vector<int> lcp(size);
+  vector<int> rank(size);
+  FlatArray<int> data = data_array->GetData();
+  int data_size = data.size();
 
-  for (size_t i = 0; i < suffix_array.size(); ++i) {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < size; ++i) {
     rank[suffix_array[i]] = i;
   }
 
-  int prefix_len = 0;
-  for (size_t i = 0; i < suffix_array.size(); ++i) {
-    if (rank[i] == 0) {
-      lcp[rank[i]] = -1;
-    } else {
-      int j = suffix_array[rank[i] - 1];
-      while (i + prefix_len < data.size() && j + prefix_len < data.size()
-          && data[i + prefix_len] == data[j + prefix_len]) {
-        ++prefix_len;
+  // Kasai et al. carry the prefix length over from one position to the next,
+  // so the text is split into a few large blocks, each of which starts over
+  // from zero.
+  const int kNumBlocks = 64;
+  int block_size = (size + kNumBlocks - 1) / kNumBlocks;
+  #pragma omp parallel for schedule(dynamic)
+  for (int block = 0; block < kNumBlocks; ++block) {
+    int block_end = min(size, (block + 1) * block_size);
+    int prefix_len = 0;
+    for (int i = block * block_size; i < block_end; ++i) {
+      if (rank[i] == 0) {
+        lcp[rank[i]] = -1;
+      } else {
+        int j = suffix_array[rank[i] - 1];
+        while (i + prefix_len < data_size && j + prefix_len < data_size
+            && data[i + prefix_len] == data[j + prefix_len]) {
+          ++prefix_len;
+        }
+        lcp[rank[i]] = prefix_len;
       }
-      lcp[rank[i]] = prefix_len;
-    }
 
-    if (prefix_len > 0) {
-      --prefix_len;
+      if (prefix_len > 0) {
+        --prefix_len;
+      }
     }
   }
 
@@ -217,6 +423,19 @@ int SuffixArray::LookupRangeStart(int low, int high, int word_id,
   return result;
 }
 
+void SuffixArray::WriteFlat(FlatFileWriter& writer) const {
+  data_array->WriteFlat(writer);
+  writer.WriteArray(suffix_array);
+  writer.WriteArray(word_start);
+}
+
+void SuffixArray::ReadFlat(FlatFileReader& reader) {
+  data_array = make_shared<DataArray>();
+  data_array->ReadFlat(reader);
+  suffix_array = reader.ReadArray<int>();
+  word_start = reader.ReadArray<int>();
+}
+
 bool SuffixArray::operator==(const SuffixArray& other) const {
   return *data_array == *other.data_array &&
          suffix_array == other.suffix_array &&
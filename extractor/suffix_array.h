@@ -9,6 +9,8 @@
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/vector.hpp>
 
+#include "flat_file.h"
+
 using namespace std;
 
 namespace extractor {
@@ -18,8 +20,16 @@ class PhraseLocation;
 
 class SuffixArray {
  public:
+  // Suffix array construction algorithms. Both produce the same array.
+  enum Algorithm {
+    // Larsson and Sadakane (1999).
+    PREFIX_DOUBLING,
+    // Nong, Zhang and Chan (2009), linear time over integer alphabets.
+    SAIS
+  };
+
   // Creates a suffix array from a data array.
-  SuffixArray(shared_ptr<DataArray> data_array);
+  SuffixArray(shared_ptr<DataArray> data_array, Algorithm algorithm = SAIS);
 
   // Creates empty suffix array.
   SuffixArray();
@@ -33,7 +43,8 @@ class SuffixArray {
   virtual shared_ptr<DataArray> GetData() const;
 
   // Constructs the longest-common-prefix array using the algorithm of Kasai et
-  // al. (2001).
+  // al. (2001). The text is split into blocks processed in parallel (with
+  // OpenMP).
   virtual vector<int> BuildLCPArray() const;
 
   // Returns the i-th suffix.
@@ -44,6 +55,13 @@ class SuffixArray {
   virtual PhraseLocation Lookup(int low, int high, const string& word,
                                 int offset) const;
 
+  // Writes the suffix array (together with its data array) in the flat
+  // format.
+  void WriteFlat(FlatFileWriter& writer) const;
+
+  // Reads a suffix array written by WriteFlat (the arrays are not copied).
+  void ReadFlat(FlatFileReader& reader);
+
   bool operator==(const SuffixArray& other) const;
 
  private:
@@ -51,15 +69,8 @@ class SuffixArray {
   // (1999).
   void BuildSuffixArray();
 
-  // Bucket sort on the data array (used for initializing the construction of
-  // the suffix array.)
-  void InitialBucketSort(vector<int>& groups);
-
-  void TernaryQuicksort(int left, int right, int step, vector<int>& groups);
-
-  // Constructs the suffix array in log(n) steps by doubling the length of the
-  // suffixes at each step.
-  void PrefixDoublingSort(vector<int>& groups);
+  // Constructs the suffix array using SA-IS.
+  void BuildSuffixArraySAIS();
 
   // Given a [low, high) range in the suffix array in which all elements have
   // the first offset-1 values the same, it returns the first position where the
@@ -70,22 +81,27 @@ class SuffixArray {
 
   template<class Archive> void save(Archive& ar, unsigned int) const {
     ar << *data_array;
-    ar << suffix_array;
-    ar << word_start;
+    vector<int> values = suffix_array.ToVector();
+    ar << values;
+    values = word_start.ToVector();
+    ar << values;
   }
 
   template<class Archive> void load(Archive& ar, unsigned int) {
     data_array = make_shared<DataArray>();
     ar >> *data_array;
-    ar >> suffix_array;
-    ar >> word_start;
+    vector<int> values;
+    ar >> values;
+    suffix_array = FlatArray<int>(move(values));
+    ar >> values;
+    word_start = FlatArray<int>(move(values));
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER();
 
   shared_ptr<DataArray> data_array;
-  vector<int> suffix_array;
-  vector<int> word_start;
+  FlatArray<int> suffix_array;
+  FlatArray<int> word_start;
 };
 
 } // namespace extractor
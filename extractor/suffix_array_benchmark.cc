@@ -0,0 +1,76 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "data_array.h"
+#include "suffix_array.h"
+#include "time_util.h"
+
+namespace po = boost::program_options;
+using namespace std;
+using namespace extractor;
+
+// Compares the suffix array construction algorithms on a corpus: reports the
+// time each of them takes and checks that they build the same array.
+int main(int argc, char** argv) {
+  po::options_description desc("Command line options");
+  desc.add_options()
+    ("help,h", "Show available options")
+    ("source,f", po::value<string>(), "Source language corpus")
+    ("bitext,b", po::value<string>(), "Parallel text (source ||| target)")
+    ("skip_prefix_doubling",
+        "Only time SA-IS (for corpora too large for prefix doubling)")
+    ("lcp", "Also time the construction of the LCP array");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  if (vm.count("help") || !(vm.count("source") || vm.count("bitext"))) {
+    cerr << desc << endl;
+    return vm.count("help") ? 0 : 1;
+  }
+  po::notify(vm);
+
+  Clock::time_point start_time = Clock::now();
+  shared_ptr<DataArray> data_array;
+  if (vm.count("bitext")) {
+    data_array = make_shared<DataArray>(vm["bitext"].as<string>(), SOURCE);
+  } else {
+    data_array = make_shared<DataArray>(vm["source"].as<string>());
+  }
+  Clock::time_point stop_time = Clock::now();
+  cerr << "Read " << data_array->GetSize() << " tokens ("
+       << data_array->GetVocabularySize() << " types) in "
+       << GetDuration(start_time, stop_time) << " seconds" << endl;
+
+  start_time = Clock::now();
+  SuffixArray sais(data_array, SuffixArray::SAIS);
+  stop_time = Clock::now();
+  double sais_duration = GetDuration(start_time, stop_time);
+  cout << "sais\t" << sais_duration << endl;
+
+  if (!vm.count("skip_prefix_doubling")) {
+    start_time = Clock::now();
+    SuffixArray prefix_doubling(data_array, SuffixArray::PREFIX_DOUBLING);
+    stop_time = Clock::now();
+    double prefix_doubling_duration = GetDuration(start_time, stop_time);
+    cout << "prefix_doubling\t" << prefix_doubling_duration << endl;
+    cout << "speedup\t" << prefix_doubling_duration / sais_duration << endl;
+    if (!(sais == prefix_doubling)) {
+      cerr << "The suffix arrays differ!" << endl;
+      return 1;
+    }
+  }
+
+  if (vm.count("lcp")) {
+    start_time = Clock::now();
+    vector<int> lcp = sais.BuildLCPArray();
+    stop_time = Clock::now();
+    cout << "lcp\t" << GetDuration(start_time, stop_time) << endl;
+  }
+
+  return 0;
+}
@@ -4,6 +4,7 @@
 
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
 
 #include "mocks/mock_data_array.h"
 #include "phrase_location.h"
@@ -12,6 +13,7 @@
 using namespace std;
 using namespace ::testing;
 namespace ar = boost::archive;
+namespace fs = boost::filesystem;
 
 namespace extractor {
 namespace {
@@ -21,7 +23,8 @@ class SuffixArrayTest : public Test {
   virtual void SetUp() {
     data = {6, 4, 1, 2, 4, 5, 3, 4, 6, 6, 4, 1, 2};
     data_array = make_shared<MockDataArray>();
-    EXPECT_CALL(*data_array, GetData()).WillRepeatedly(Return(data));
+    EXPECT_CALL(*data_array, GetData())
+        .WillRepeatedly(Return(FlatArray<int>(data)));
     EXPECT_CALL(*data_array, GetVocabularySize()).WillRepeatedly(Return(7));
     EXPECT_CALL(*data_array, GetSize()).WillRepeatedly(Return(13));
     suffix_array = SuffixArray(data_array);
@@ -86,5 +89,66 @@ TEST_F(SuffixArrayTest, TestSerialization) {
   EXPECT_EQ(suffix_array, suffix_array_copy);
 }
 
+TEST_F(SuffixArrayTest, TestPrefixDoubling) {
+  SuffixArray prefix_doubling(data_array, SuffixArray::PREFIX_DOUBLING);
+  EXPECT_EQ(suffix_array, prefix_doubling);
+}
+
+TEST(SuffixArrayAlgorithmsTest, TestRandomData) {
+  srand(17);
+  for (int vocabulary_size : {3, 4, 50}) {
+    vector<int> data;
+    for (int i = 0; i < 5000; ++i) {
+      // Long repeats make the reduced problems of SA-IS non-trivial.
+      if (i > 100 && rand() % 10 == 0) {
+        int start = rand() % (i - 50);
+        for (int j = 0; j < 40; ++j) {
+          data.push_back(data[start + j]);
+        }
+        i += 39;
+      } else {
+        data.push_back(1 + rand() % (vocabulary_size - 1));
+      }
+    }
+    shared_ptr<MockDataArray> data_array = make_shared<MockDataArray>();
+    EXPECT_CALL(*data_array, GetData())
+        .WillRepeatedly(Return(FlatArray<int>(data)));
+    EXPECT_CALL(*data_array, GetVocabularySize())
+        .WillRepeatedly(Return(vocabulary_size));
+    EXPECT_CALL(*data_array, GetSize()).WillRepeatedly(Return(data.size()));
+
+    SuffixArray sais(data_array, SuffixArray::SAIS);
+    SuffixArray prefix_doubling(data_array, SuffixArray::PREFIX_DOUBLING);
+    EXPECT_EQ(prefix_doubling, sais);
+
+    vector<int> lcp = sais.BuildLCPArray();
+    ASSERT_EQ(data.size() + 1, lcp.size());
+    EXPECT_EQ(-1, lcp[0]);
+    for (size_t i = 1; i < lcp.size(); ++i) {
+      int a = sais.GetSuffix(i - 1), b = sais.GetSuffix(i), len = 0;
+      while (a + len < data.size() && b + len < data.size() &&
+             data[a + len] == data[b + len]) {
+        ++len;
+      }
+      EXPECT_EQ(len, lcp[i]);
+    }
+  }
+}
+
+TEST_F(SuffixArrayTest, TestFlatFile) {
+  fs::path path = fs::temp_directory_path() / fs::unique_path();
+  {
+    FlatFileWriter writer(path.string(), FLAT_SUFFIX_ARRAY);
+    suffix_array.WriteFlat(writer);
+  }
+
+  SuffixArray suffix_array_copy;
+  FlatFileReader reader(path.string(), FLAT_SUFFIX_ARRAY);
+  suffix_array_copy.ReadFlat(reader);
+  fs::remove(path);
+
+  EXPECT_EQ(suffix_array, suffix_array_copy);
+}
+
 } // namespace
 } // namespace extractor
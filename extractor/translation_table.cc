@@ -1,5 +1,9 @@
 #include "translation_table.h"
 
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -12,16 +16,95 @@ using namespace std;
 
 namespace extractor {
 
+/**
+ * Link counts of the sentence pairs added to the table online, keyed by the
+ * words themselves (they may be missing from the data arrays).
+ */
+struct OnlineLinks {
+  unordered_map<string, int> source_links_count;
+  unordered_map<string, int> target_links_count;
+  unordered_map<pair<string, string>, int, boost::hash<pair<string, string>>>
+      links_count;
+};
+
+/**
+ * Publishes the online link counts to the readers. A snapshot is never
+ * modified once published: AddLinks copies the latest one, counts the new
+ * sentence pairs in the copy and swaps it in atomically, so the lookups only
+ * load a pointer and never wait for a writer or for each other.
+ */
+struct OnlineLinksCount {
+  // Serializes the writers.
+  mutex update_mutex;
+  // Null until the first sentence pair is added, so that the tables which are
+  // never updated keep using the precomputed scores. Only accessed through
+  // atomic_load and atomic_store.
+  shared_ptr<const OnlineLinks> links;
+};
+
+namespace {
+
+// Calls increment for every pair of linked words of a sentence pair. Unaligned
+// words are paired with the NULL word.
+template<typename Word, typename Increment>
+void CountLinks(const vector<Word>& source_sentence,
+                const vector<Word>& target_sentence,
+                const vector<pair<int, int>>& links,
+                const Word& null_word,
+                Increment increment) {
+  vector<int> source_linked_words(source_sentence.size());
+  vector<int> target_linked_words(target_sentence.size());
+  for (pair<int, int> link: links) {
+    source_linked_words[link.first] = 1;
+    target_linked_words[link.second] = 1;
+    increment(source_sentence[link.first], target_sentence[link.second]);
+  }
+
+  for (size_t i = 0; i < source_sentence.size(); ++i) {
+    if (!source_linked_words[i]) {
+      increment(source_sentence[i], null_word);
+    }
+  }
+
+  for (size_t i = 0; i < target_sentence.size(); ++i) {
+    if (!target_linked_words[i]) {
+      increment(null_word, target_sentence[i]);
+    }
+  }
+}
+
+// Stores the counts in a vector indexed by word id.
+vector<int> IndexByWordId(const unordered_map<int, int>& counts) {
+  int max_word_id = -1;
+  for (pair<int, int> entry: counts) {
+    max_word_id = max(max_word_id, entry.first);
+  }
+  vector<int> result(max_word_id + 1);
+  for (pair<int, int> entry: counts) {
+    result[entry.first] = entry.second;
+  }
+  return result;
+}
+
+} // namespace
+
 TranslationTable::TranslationTable(shared_ptr<DataArray> source_data_array,
                                    shared_ptr<DataArray> target_data_array,
                                    shared_ptr<Alignment> alignment) :
-    source_data_array(source_data_array), target_data_array(target_data_array) {
-  const vector<int>& source_data = source_data_array->GetData();
-  const vector<int>& target_data = target_data_array->GetData();
+    source_data_array(source_data_array), target_data_array(target_data_array),
+    has_links_count(true),
+    online_links_count(make_shared<OnlineLinksCount>()) {
+  FlatArray<int> source_data = source_data_array->GetData();
+  FlatArray<int> target_data = target_data_array->GetData();
 
   unordered_map<int, int> source_links_count;
   unordered_map<int, int> target_links_count;
   unordered_map<pair<int, int>, int, PairHash> links_count;
+  auto increment = [&](int source_word_id, int target_word_id) {
+    ++source_links_count[source_word_id];
+    ++target_links_count[target_word_id];
+    ++links_count[make_pair(source_word_id, target_word_id)];
+  };
 
   // For each pair of aligned source target words increment their link count by
   // 1. Unaligned words are paired with the NULL token.
@@ -36,34 +119,14 @@ TranslationTable::TranslationTable(shared_ptr<DataArray> source_data_array,
         source_data.begin() + next_source_start);
     vector<int> target_sentence(target_data.begin() + target_start,
         target_data.begin() + next_target_start);
-    vector<int> source_linked_words(source_sentence.size());
-    vector<int> target_linked_words(target_sentence.size());
-
-    for (pair<int, int> link: links) {
-      source_linked_words[link.first] = 1;
-      target_linked_words[link.second] = 1;
-      IncrementLinksCount(source_links_count, target_links_count, links_count,
-          source_sentence[link.first], target_sentence[link.second]);
-    }
-
-    for (size_t i = 0; i < source_sentence.size(); ++i) {
-      if (!source_linked_words[i]) {
-        IncrementLinksCount(source_links_count, target_links_count, links_count,
-                            source_sentence[i], DataArray::NULL_WORD);
-      }
-    }
-
-    for (size_t i = 0; i < target_sentence.size(); ++i) {
-      if (!target_linked_words[i]) {
-        IncrementLinksCount(source_links_count, target_links_count, links_count,
-                            DataArray::NULL_WORD, target_sentence[i]);
-      }
-    }
+    CountLinks(source_sentence, target_sentence, links, DataArray::NULL_WORD,
+               increment);
   }
 
   // Calculating:
   //   p(e | f) = count(e, f) / count(f)
   //   p(f | e) = count(e, f) / count(e)
+  TranslationProbabilities translation_probabilities;
   for (pair<pair<int, int>, int> link_count: links_count) {
     int source_word = link_count.first.first;
     int target_word = link_count.first.second;
@@ -71,59 +134,243 @@ TranslationTable::TranslationTable(shared_ptr<DataArray> source_data_array,
     double score2 = 1.0 * link_count.second / target_links_count[target_word];
     translation_probabilities[link_count.first] = make_pair(score1, score2);
   }
+  SetProbabilities(translation_probabilities);
+  SetLinksCounts(links_count, source_links_count, target_links_count);
 }
 
-TranslationTable::TranslationTable() {}
+TranslationTable::TranslationTable() :
+    has_links_count(true),
+    online_links_count(make_shared<OnlineLinksCount>()) {
+  SetProbabilities(TranslationProbabilities());
+}
 
 TranslationTable::~TranslationTable() {}
 
-void TranslationTable::IncrementLinksCount(
-    unordered_map<int, int>& source_links_count,
-    unordered_map<int, int>& target_links_count,
-    unordered_map<pair<int, int>, int, PairHash>& links_count,
-    int source_word_id,
-    int target_word_id) const {
-  ++source_links_count[source_word_id];
-  ++target_links_count[target_word_id];
-  ++links_count[make_pair(source_word_id, target_word_id)];
+void TranslationTable::SetProbabilities(
+    const TranslationProbabilities& probabilities) {
+  // Sorting the entries makes the flat table independent of the iteration
+  // order of the hash table.
+  vector<pair<pair<int, int>, pair<double, double>>> entries(
+      probabilities.begin(), probabilities.end());
+  sort(entries.begin(), entries.end());
+
+  vector<int> source_words, target_words;
+  vector<double> target_given_source, source_given_target;
+  vector<uint64_t> hashes;
+  for (const auto& entry: entries) {
+    int key[2] = {entry.first.first, entry.first.second};
+    hashes.push_back(HashFlatKey(key, 2));
+    source_words.push_back(entry.first.first);
+    target_words.push_back(entry.first.second);
+    target_given_source.push_back(entry.second.first);
+    source_given_target.push_back(entry.second.second);
+  }
+
+  this->source_words = FlatArray<int>(move(source_words));
+  this->target_words = FlatArray<int>(move(target_words));
+  this->target_given_source = FlatArray<double>(move(target_given_source));
+  this->source_given_target = FlatArray<double>(move(source_given_target));
+  pair_index = FlatArray<int>(BuildFlatHashTable(hashes));
+}
+
+void TranslationTable::SetLinksCounts(
+    const unordered_map<pair<int, int>, int, PairHash>& links_count,
+    const unordered_map<int, int>& source_links_count,
+    const unordered_map<int, int>& target_links_count) {
+  vector<int> counts;
+  for (size_t i = 0; i < source_words.size(); ++i) {
+    counts.push_back(
+        links_count.at(make_pair(source_words[i], target_words[i])));
+  }
+  this->links_count = FlatArray<int>(move(counts));
+
+  this->source_links_count = FlatArray<int>(
+      IndexByWordId(source_links_count));
+  this->target_links_count = FlatArray<int>(
+      IndexByWordId(target_links_count));
+}
+
+TranslationProbabilities TranslationTable::GetProbabilities() const {
+  TranslationProbabilities probabilities;
+  for (size_t i = 0; i < source_words.size(); ++i) {
+    probabilities[make_pair(source_words[i], target_words[i])] =
+        make_pair(target_given_source[i], source_given_target[i]);
+  }
+  return probabilities;
+}
+
+int TranslationTable::FindPair(int source_word_id, int target_word_id) const {
+  int key[2] = {source_word_id, target_word_id};
+  return FindInFlatHashTable(pair_index, HashFlatKey(key, 2),
+      [&](int i) {
+        return source_words[i] == source_word_id &&
+               target_words[i] == target_word_id;
+      });
 }
 
 double TranslationTable::GetTargetGivenSourceScore(
     const string& source_word, const string& target_word) {
+  shared_ptr<const OnlineLinks> online_links =
+      atomic_load(&online_links_count->links);
+  if (online_links != nullptr) {
+    int links_count, source_links_count, target_links_count;
+    if (!GetLinksCounts(*online_links, source_word, target_word, links_count,
+                        source_links_count, target_links_count)) {
+      return -1;
+    }
+    return links_count == 0 ? 0 : 1.0 * links_count / source_links_count;
+  }
+
   int source_id = source_data_array->GetWordId(source_word);
   int target_id = target_data_array->GetWordId(target_word);
   if (source_id == -1 || target_id == -1) {
     return -1;
   }
 
-  auto entry = make_pair(source_id, target_id);
-  auto it = translation_probabilities.find(entry);
-  if (it == translation_probabilities.end()) {
+  int i = FindPair(source_id, target_id);
+  if (i == -1) {
     return 0;
   }
-  return it->second.first;
+  return target_given_source[i];
 }
 
 double TranslationTable::GetSourceGivenTargetScore(
     const string& source_word, const string& target_word) {
+  shared_ptr<const OnlineLinks> online_links =
+      atomic_load(&online_links_count->links);
+  if (online_links != nullptr) {
+    int links_count, source_links_count, target_links_count;
+    if (!GetLinksCounts(*online_links, source_word, target_word, links_count,
+                        source_links_count, target_links_count)) {
+      return -1;
+    }
+    return links_count == 0 ? 0 : 1.0 * links_count / target_links_count;
+  }
+
   int source_id = source_data_array->GetWordId(source_word);
   int target_id = target_data_array->GetWordId(target_word);
   if (source_id == -1 || target_id == -1) {
     return -1;
   }
 
-  auto entry = make_pair(source_id, target_id);
-  auto it = translation_probabilities.find(entry);
-  if (it == translation_probabilities.end()) {
+  int i = FindPair(source_id, target_id);
+  if (i == -1) {
     return 0;
   }
-  return it->second.second;
+  return source_given_target[i];
+}
+
+bool TranslationTable::GetLinksCounts(
+    const OnlineLinks& online_links, const string& source_word, const string& target_word, int& links_count,
+    int& source_links_count, int& target_links_count) const {
+  links_count = source_links_count = target_links_count = 0;
+  int source_id = source_data_array->GetWordId(source_word);
+  int target_id = target_data_array->GetWordId(target_word);
+  if (source_id != -1) {
+    source_links_count = this->source_links_count[source_id];
+  }
+  if (target_id != -1) {
+    target_links_count = this->target_links_count[target_id];
+  }
+  if (source_id != -1 && target_id != -1) {
+    int i = FindPair(source_id, target_id);
+    if (i != -1) {
+      links_count = this->links_count[i];
+    }
+  }
+  bool source_found = source_id != -1, target_found = target_id != -1;
+
+  auto source_it = online_links.source_links_count.find(source_word);
+  if (source_it != online_links.source_links_count.end()) {
+    source_links_count += source_it->second;
+    source_found = true;
+  }
+  auto target_it = online_links.target_links_count.find(target_word);
+  if (target_it != online_links.target_links_count.end()) {
+    target_links_count += target_it->second;
+    target_found = true;
+  }
+  auto it = online_links.links_count.find(
+      make_pair(source_word, target_word));
+  if (it != online_links.links_count.end()) {
+    links_count += it->second;
+  }
+  return source_found && target_found;
+}
+
+void TranslationTable::AddLinks(const vector<string>& source_sentence,
+                                const vector<string>& target_sentence,
+                                const vector<pair<int, int>>& links) {
+  AddLinks(vector<vector<string>>(1, source_sentence),
+           vector<vector<string>>(1, target_sentence),
+           vector<vector<pair<int, int>>>(1, links));
+}
+
+void TranslationTable::AddLinks(
+    const vector<vector<string>>& source_sentences,
+    const vector<vector<string>>& target_sentences,
+    const vector<vector<pair<int, int>>>& links) {
+  if (!has_links_count) {
+    cerr << "The translation table was compiled without link counts and "
+         << "cannot be updated, recompile it with sacompile" << endl;
+    return;
+  }
+
+  lock_guard<mutex> lock(online_links_count->update_mutex);
+  shared_ptr<const OnlineLinks> current =
+      atomic_load(&online_links_count->links);
+  shared_ptr<OnlineLinks> updated = current == nullptr ?
+      make_shared<OnlineLinks>() : make_shared<OnlineLinks>(*current);
+  for (size_t i = 0; i < source_sentences.size(); ++i) {
+    CountLinks(source_sentences[i], target_sentences[i], links[i],
+        DataArray::NULL_WORD_STR,
+        [&](const string& source_word, const string& target_word) {
+          ++updated->source_links_count[source_word];
+          ++updated->target_links_count[target_word];
+          ++updated->links_count[make_pair(source_word, target_word)];
+        });
+  }
+  atomic_store(&online_links_count->links,
+               shared_ptr<const OnlineLinks>(move(updated)));
+}
+
+void TranslationTable::WriteFlat(FlatFileWriter& writer) const {
+  writer.WriteArray(source_words);
+  writer.WriteArray(target_words);
+  writer.WriteArray(target_given_source);
+  writer.WriteArray(source_given_target);
+  writer.WriteArray(pair_index);
+  writer.WriteArray(links_count);
+  writer.WriteArray(source_links_count);
+  writer.WriteArray(target_links_count);
+}
+
+void TranslationTable::ReadFlat(FlatFileReader& reader,
+                                shared_ptr<DataArray> source_data_array,
+                                shared_ptr<DataArray> target_data_array) {
+  this->source_data_array = source_data_array;
+  this->target_data_array = target_data_array;
+  source_words = reader.ReadArray<int>();
+  target_words = reader.ReadArray<int>();
+  target_given_source = reader.ReadArray<double>();
+  source_given_target = reader.ReadArray<double>();
+  pair_index = reader.ReadArray<int>();
+  links_count = reader.ReadArray<int>();
+  source_links_count = reader.ReadArray<int>();
+  target_links_count = reader.ReadArray<int>();
+  has_links_count = true;
 }
 
 bool TranslationTable::operator==(const TranslationTable& other) const {
   return *source_data_array == *other.source_data_array &&
          *target_data_array == *other.target_data_array &&
-         translation_probabilities == other.translation_probabilities;
+         source_words == other.source_words &&
+         target_words == other.target_words &&
+         target_given_source == other.target_given_source &&
+         source_given_target == other.source_given_target &&
+         links_count == other.links_count &&
+         source_links_count == other.source_links_count &&
+         target_links_count == other.target_links_count;
 }
 
 } // namespace extractor
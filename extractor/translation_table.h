@@ -4,23 +4,38 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/functional/hash.hpp>
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
+
+#include "flat_file.h"
 
 using namespace std;
 
 namespace extractor {
 
 typedef boost::hash<pair<int, int>> PairHash;
+typedef unordered_map<pair<int, int>, pair<double, double>, PairHash>
+    TranslationProbabilities;
 
 class Alignment;
 class DataArray;
+struct OnlineLinks;
+struct OnlineLinksCount;
 
 /**
  * Bilexical table with conditional probabilities.
+ *
+ * The probabilities are stored in flat arrays indexed by an open addressing
+ * hash table over the (source word id, target word id) pairs, together with the
+ * link counts they were computed from. The counts of sentence pairs added after
+ * the table was built (see AddLinks) are kept in hash tables on the side and
+ * combined with the compiled counts when the table is queried.
  */
 class TranslationTable {
  public:
@@ -44,35 +59,83 @@ class TranslationTable {
   virtual double GetSourceGivenTargetScore(const string& source_word,
                                            const string& target_word);
 
+  // Adds the links of a sentence pair which is not part of the data arrays
+  // (unaligned words are linked to NULL). Can be called while other threads
+  // query the table.
+  void AddLinks(const vector<string>& source_sentence,
+                const vector<string>& target_sentence,
+                const vector<pair<int, int>>& links);
+
+  // Adds the links of several sentence pairs. The online counts are copied
+  // and published once for the whole batch, so the readers see either none
+  // or all of the sentence pairs.
+  void AddLinks(const vector<vector<string>>& source_sentences,
+                const vector<vector<string>>& target_sentences,
+                const vector<vector<pair<int, int>>>& links);
+
+  // Writes the table in the flat format. The data arrays are not written, as
+  // they are already part of the compiled source suffix array and target data.
+  void WriteFlat(FlatFileWriter& writer) const;
+
+  // Reads a table written by WriteFlat (the arrays are not copied).
+  void ReadFlat(FlatFileReader& reader,
+                shared_ptr<DataArray> source_data_array,
+                shared_ptr<DataArray> target_data_array);
+
   bool operator==(const TranslationTable& other) const;
 
  private:
-  // Increment links count for the given (f, e) word pair.
-  void IncrementLinksCount(
-      unordered_map<int, int>& source_links_count,
-      unordered_map<int, int>& target_links_count,
-      unordered_map<pair<int, int>, int, PairHash>& links_count,
-      int source_word_id,
-      int target_word_id) const;
+  // Constructs the flat table.
+  void SetProbabilities(const TranslationProbabilities& probabilities);
+
+  // Constructs the flat link counts (must be called after SetProbabilities).
+  void SetLinksCounts(
+      const unordered_map<pair<int, int>, int, PairHash>& links_count,
+      const unordered_map<int, int>& source_links_count,
+      const unordered_map<int, int>& target_links_count);
+
+  // Returns the number of times the words were linked together and the total
+  // number of links of each word, including the sentence pairs added online.
+  // Returns false if either word has never been observed.
+  bool GetLinksCounts(const OnlineLinks& online_links,
+                      const string& source_word, const string& target_word,
+                      int& links_count, int& source_links_count,
+                      int& target_links_count) const;
+
+  // Returns the entries of the flat table.
+  TranslationProbabilities GetProbabilities() const;
+
+  // Returns the position of the pair of words in the flat table or -1 if the
+  // pair has never been aligned.
+  int FindPair(int source_word_id, int target_word_id) const;
 
   friend class boost::serialization::access;
 
   template<class Archive> void save(Archive& ar, unsigned int) const {
     ar << *source_data_array << *target_data_array;
 
+    TranslationProbabilities translation_probabilities = GetProbabilities();
     int num_entries = translation_probabilities.size();
     ar << num_entries;
     for (auto entry: translation_probabilities) {
       ar << entry;
     }
+
+    vector<int> values = links_count.ToVector();
+    ar << values;
+    values = source_links_count.ToVector();
+    ar << values;
+    values = target_links_count.ToVector();
+    ar << values;
   }
 
-  template<class Archive> void load(Archive& ar, unsigned int) {
+  template<class Archive> void load(Archive& ar, unsigned int version) {
     source_data_array = make_shared<DataArray>();
     ar >> *source_data_array;
     target_data_array = make_shared<DataArray>();
     ar >> *target_data_array;
 
+    TranslationProbabilities translation_probabilities;
     int num_entries;
     ar >> num_entries;
     for (size_t i = 0; i < num_entries; ++i) {
@@ -80,16 +143,41 @@ class TranslationTable {
       ar >> entry;
       translation_probabilities.insert(entry);
     }
+    SetProbabilities(translation_probabilities);
+
+    // Tables saved before the link counts were stored can still be queried,
+    // but cannot be updated online.
+    has_links_count = version > 0;
+    if (has_links_count) {
+      vector<int> values;
+      ar >> values;
+      links_count = FlatArray<int>(move(values));
+      ar >> values;
+      source_links_count = FlatArray<int>(move(values));
+      ar >> values;
+      target_links_count = FlatArray<int>(move(values));
+    }
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER();
 
   shared_ptr<DataArray> source_data_array;
   shared_ptr<DataArray> target_data_array;
-  unordered_map<pair<int, int>, pair<double, double>, PairHash>
-      translation_probabilities;
+  FlatArray<int> source_words;
+  FlatArray<int> target_words;
+  FlatArray<double> target_given_source;
+  FlatArray<double> source_given_target;
+  FlatArray<int> pair_index;
+  FlatArray<int> links_count;
+  // Indexed by word id.
+  FlatArray<int> source_links_count;
+  FlatArray<int> target_links_count;
+  bool has_links_count;
+  shared_ptr<OnlineLinksCount> online_links_count;
 };
 
 } // namespace extractor
 
+BOOST_CLASS_VERSION(extractor::TranslationTable, 1)
+
 #endif
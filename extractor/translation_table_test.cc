@@ -7,6 +7,7 @@
 
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
 
 #include "mocks/mock_alignment.h"
 #include "mocks/mock_data_array.h"
@@ -15,6 +16,7 @@
 using namespace std;
 using namespace ::testing;
 namespace ar = boost::archive;
+namespace fs = boost::filesystem;
 
 namespace extractor {
 namespace {
@@ -26,9 +28,9 @@ class TranslationTableTest : public Test {
 
     vector<int> source_data = {2, 3, 2, 3, 4, 0, 2, 3, 6, 0, 2, 3, 6, 0};
     vector<int> source_sentence_start = {0, 6, 10, 14};
-    shared_ptr<MockDataArray> source_data_array = make_shared<MockDataArray>();
+    source_data_array = make_shared<MockDataArray>();
     EXPECT_CALL(*source_data_array, GetData())
-        .WillRepeatedly(Return(source_data));
+        .WillRepeatedly(Return(FlatArray<int>(source_data)));
     EXPECT_CALL(*source_data_array, GetNumSentences())
         .WillRepeatedly(Return(3));
     for (size_t i = 0; i < source_sentence_start.size(); ++i) {
@@ -43,9 +45,9 @@ class TranslationTableTest : public Test {
 
     vector<int> target_data = {2, 3, 2, 3, 4, 5, 0, 3, 6, 0, 2, 7, 0};
     vector<int> target_sentence_start = {0, 7, 10, 13};
-    shared_ptr<MockDataArray> target_data_array = make_shared<MockDataArray>();
+    target_data_array = make_shared<MockDataArray>();
     EXPECT_CALL(*target_data_array, GetData())
-        .WillRepeatedly(Return(target_data));
+        .WillRepeatedly(Return(FlatArray<int>(target_data)));
     for (size_t i = 0; i < target_sentence_start.size(); ++i) {
       EXPECT_CALL(*target_data_array, GetSentenceStart(i))
           .WillRepeatedly(Return(target_sentence_start[i]));
@@ -70,6 +72,8 @@ class TranslationTableTest : public Test {
     table = TranslationTable(source_data_array, target_data_array, alignment);
   }
 
+  shared_ptr<MockDataArray> source_data_array;
+  shared_ptr<MockDataArray> target_data_array;
   TranslationTable table;
 };
 
@@ -85,6 +89,43 @@ TEST_F(TranslationTableTest, TestScores) {
   EXPECT_EQ(-1, table.GetSourceGivenTargetScore("c", "d"));
 }
 
+TEST_F(TranslationTableTest, TestAddLinks) {
+  for (auto data_array: {source_data_array, target_data_array}) {
+    EXPECT_CALL(*data_array, GetWordId("__NULL__")).WillRepeatedly(Return(0));
+    EXPECT_CALL(*data_array, GetWordId("e")).WillRepeatedly(Return(-1));
+  }
+  vector<string> source_sentence = {"a", "d", "b"};
+  vector<string> target_sentence = {"a", "d"};
+  vector<pair<int, int>> links = {make_pair(0, 0), make_pair(1, 1)};
+  table.AddLinks(source_sentence, target_sentence, links);
+
+  EXPECT_EQ(0.8, table.GetTargetGivenSourceScore("a", "a"));
+  EXPECT_EQ(1, table.GetSourceGivenTargetScore("a", "a"));
+  EXPECT_EQ(1, table.GetTargetGivenSourceScore("d", "d"));
+  EXPECT_EQ(0, table.GetTargetGivenSourceScore("c", "d"));
+  EXPECT_EQ(-1, table.GetTargetGivenSourceScore("c", "e"));
+  EXPECT_EQ(0.5, table.GetTargetGivenSourceScore("c", "c"));
+  // The unaligned source word is linked to NULL.
+  EXPECT_EQ(0.4, table.GetTargetGivenSourceScore("b", "__NULL__"));
+}
+
+TEST_F(TranslationTableTest, TestAddLinksBatch) {
+  for (auto data_array: {source_data_array, target_data_array}) {
+    EXPECT_CALL(*data_array, GetWordId("__NULL__")).WillRepeatedly(Return(0));
+  }
+  vector<vector<string>> source_sentences = {{"a", "d", "b"}, {"a"}};
+  vector<vector<string>> target_sentences = {{"a", "d"}, {"a"}};
+  vector<vector<pair<int, int>>> links = {
+    {make_pair(0, 0), make_pair(1, 1)}, {make_pair(0, 0)}
+  };
+  table.AddLinks(source_sentences, target_sentences, links);
+
+  EXPECT_DOUBLE_EQ(5.0 / 6, table.GetTargetGivenSourceScore("a", "a"));
+  EXPECT_EQ(1, table.GetSourceGivenTargetScore("a", "a"));
+  EXPECT_EQ(1, table.GetTargetGivenSourceScore("d", "d"));
+  EXPECT_EQ(0.4, table.GetTargetGivenSourceScore("b", "__NULL__"));
+}
+
 TEST_F(TranslationTableTest, TestSerialization) {
   stringstream stream(ios_base::binary | ios_base::out | ios_base::in);
   ar::binary_oarchive output_stream(stream, ar::no_header);
@@ -97,5 +138,24 @@ TEST_F(TranslationTableTest, TestSerialization) {
   EXPECT_EQ(table, table_copy);
 }
 
+TEST_F(TranslationTableTest, TestFlatFile) {
+  fs::path path = fs::temp_directory_path() / fs::unique_path();
+  {
+    FlatFileWriter writer(path.string(), FLAT_TRANSLATION_TABLE);
+    table.WriteFlat(writer);
+  }
+
+  TranslationTable table_copy;
+  FlatFileReader reader(path.string(), FLAT_TRANSLATION_TABLE);
+  table_copy.ReadFlat(reader, source_data_array, target_data_array);
+  fs::remove(path);
+
+  EXPECT_EQ(table, table_copy);
+  EXPECT_EQ(0.75, table_copy.GetTargetGivenSourceScore("a", "a"));
+  EXPECT_EQ(0, table_copy.GetTargetGivenSourceScore("a", "b"));
+  EXPECT_EQ(1, table_copy.GetSourceGivenTargetScore("c", "c"));
+  EXPECT_EQ(-1, table_copy.GetSourceGivenTargetScore("c", "d"));
+}
+
 } // namespace
 } // namespace extractor
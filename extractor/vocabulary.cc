@@ -2,7 +2,17 @@
 
 namespace extractor {
 
-Vocabulary::~Vocabulary() {}
+Vocabulary::Vocabulary() : blocks(new atomic<string*>[MAX_BLOCKS]) {
+  for (int i = 0; i < MAX_BLOCKS; ++i) {
+    blocks[i].store(nullptr, memory_order_relaxed);
+  }
+}
+
+Vocabulary::~Vocabulary() {
+  for (int i = 0; i < MAX_BLOCKS; ++i) {
+    delete[] blocks[i].load(memory_order_relaxed);
+  }
+}
 
 int Vocabulary::GetTerminalIndex(const string& word) {
   int word_id = -1;
@@ -12,14 +22,32 @@ int Vocabulary::GetTerminalIndex(const string& word) {
     if (it != dictionary.end()) {
       word_id = it->second;
     } else {
-      word_id = words.size();
-      dictionary[word] = word_id;
-      words.push_back(word);
+      word_id = AddWord(word);
     }
   }
   return word_id;
 }
 
+int Vocabulary::AddWord(const string& word) {
+  int word_id = dictionary.size();
+  atomic<string*>& block = blocks[word_id >> BLOCK_BITS];
+  string* words = block.load(memory_order_relaxed);
+  if (words == nullptr) {
+    words = new string[BLOCK_SIZE];
+    block.store(words, memory_order_release);
+  }
+  // The id is handed out only after the word is stored.
+  words[word_id & (BLOCK_SIZE - 1)] = word;
+  dictionary[word] = word_id;
+  return word_id;
+}
+
+const string& Vocabulary::GetWord(int word_id) const {
+  const string* words =
+      blocks[word_id >> BLOCK_BITS].load(memory_order_acquire);
+  return words[word_id & (BLOCK_SIZE - 1)];
+}
+
 int Vocabulary::GetNonterminalIndex(int position) {
   return -position;
 }
@@ -29,14 +57,19 @@ bool Vocabulary::IsTerminal(int symbol) {
 }
 
 string Vocabulary::GetTerminalValue(int symbol) {
-  string word;
-  #pragma omp critical (vocabulary)
-  word = words[symbol];
-  return word;
+  return GetWord(symbol);
 }
 
 bool Vocabulary::operator==(const Vocabulary& other) const {
-  return words == other.words && dictionary == other.dictionary;
+  if (dictionary != other.dictionary) {
+    return false;
+  }
+  for (size_t i = 0; i < dictionary.size(); ++i) {
+    if (GetWord(i) != other.GetWord(i)) {
+      return false;
+    }
+  }
+  return true;
 }
 
 } // namespace extractor
@@ -1,6 +1,8 @@
 #ifndef _VOCABULARY_H_
 #define _VOCABULARY_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -20,7 +22,9 @@ namespace extractor {
  * encountered during the grammar extraction time. This dictionary is
  * considerably smaller than the dictionaries in the data arays (and so is the
  * query time). Note that this is the single data structure that changes state
- * and needs to have thread safe read/write operations.
+ * and needs to have thread safe read/write operations. Words are only ever
+ * appended and never move once added, so looking up the word of an id does not
+ * take the lock.
  *
  * Note: For an experiment using different vocabulary instances for each thread,
  * the running time did not improve implying that the critical regions do not
@@ -28,6 +32,8 @@ namespace extractor {
  */
 class Vocabulary {
  public:
+  Vocabulary();
+
   virtual ~Vocabulary();
 
   // Returns the word id for the given word.
@@ -48,20 +54,38 @@ class Vocabulary {
   friend class boost::serialization::access;
 
   template<class Archive> void save(Archive& ar, unsigned int) const {
+    vector<string> words;
+    for (size_t i = 0; i < dictionary.size(); ++i) {
+      words.push_back(GetWord(i));
+    }
     ar << words;
   }
 
   template<class Archive> void load(Archive& ar, unsigned int) {
+    vector<string> words;
     ar >> words;
-    for (size_t i = 0; i < words.size(); ++i) {
-      dictionary[words[i]] = i;
+    for (const string& word: words) {
+      AddWord(word);
     }
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER();
 
+  // Appends a new word (with the lock held, or before the vocabulary is
+  // shared) and returns its id.
+  int AddWord(const string& word);
+
+  const string& GetWord(int word_id) const;
+
+  static const int BLOCK_BITS = 16;
+  static const int BLOCK_SIZE = 1 << BLOCK_BITS;
+  static const int MAX_BLOCKS = 1 << (31 - BLOCK_BITS);
+
   unordered_map<string, int> dictionary;
-  vector<string> words;
+  // The words by id, in blocks of BLOCK_SIZE. The block table has a fixed size
+  // and a block is never moved once allocated, so the readers only need to
+  // load the pointer to the block.
+  unique_ptr<atomic<string*>[]> blocks;
 };
 
 } // namespace extractor
@@ -2,6 +2,7 @@
 
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <boost/archive/text_iarchive.hpp>
@@ -25,6 +26,29 @@ TEST(VocabularyTest, TestIndexes) {
   EXPECT_EQ("one", vocabulary.GetTerminalValue(1));
 }
 
+// Words are looked up without the lock while other words are being added, also
+// across the blocks the words are stored in.
+TEST(VocabularyTest, TestReadWhileAdding) {
+  Vocabulary vocabulary;
+  const int num_words = 150000;
+  EXPECT_EQ(0, vocabulary.GetTerminalIndex("0"));
+  thread writer([&] {
+    for (int i = 1; i < num_words; ++i) {
+      vocabulary.GetTerminalIndex(to_string(i));
+    }
+  });
+  for (int i = 0; i < 1000000; ++i) {
+    ASSERT_EQ("0", vocabulary.GetTerminalValue(0));
+  }
+  writer.join();
+
+  for (int i = 0; i < num_words; ++i) {
+    ASSERT_EQ(to_string(i), vocabulary.GetTerminalValue(i));
+  }
+  EXPECT_EQ(num_words - 1,
+            vocabulary.GetTerminalIndex(to_string(num_words - 1)));
+}
+
 TEST(VocabularyTest, TestSerialization) {
   Vocabulary vocabulary;
   EXPECT_EQ(0, vocabulary.GetTerminalIndex("zero"));
@@ -0,0 +1,91 @@
+#include "lm/builder/binary.hh"
+
+#include "lm/builder/ngram_stream.hh"
+#include "lm/builder/print.hh"
+#include "lm/model.hh"
+#include "lm/ngram_source.hh"
+#include "util/exception.hh"
+#include "util/stream/timer.hh"
+
+#include <algorithm>
+
+namespace lm { namespace builder {
+
+namespace {
+
+// Hands the n-grams in the streams to the model with the words as ids of the
+// vocabulary file.
+class StreamSource : public NGramSource {
+  public:
+    StreamSource(const VocabReconstitute &vocab, const std::vector<uint64_t> &counts, const util::stream::ChainPositions &positions)
+      : vocab_(vocab), counts_(counts), streams_(positions), order_(0) {}
+
+    void ReadCounts(std::vector<uint64_t> &counts) {
+      counts = counts_;
+    }
+
+    void BeginOrder(unsigned int order) {
+      CheckFinished();
+      order_ = order;
+    }
+
+    void ReadNGram(WordIndex *words, float &prob, float &backoff) {
+      NGramStream &stream = streams_[order_ - 1];
+      UTIL_THROW_IF(!stream, util::Exception, "Fewer " << order_ << "-grams in the stream than counted");
+      std::copy(stream->begin(), stream->end(), words);
+      prob = stream->Value().complete.prob;
+      backoff = (order_ == streams_.size()) ? 0.0 : stream->Value().complete.backoff;
+      ++stream;
+    }
+
+    StringPiece Word(WordIndex word) const {
+      return vocab_.LookupPiece(word);
+    }
+
+    // The model reads as many n-grams as counted.  The rest of the stream
+    // would never be consumed.
+    void CheckFinished() const {
+      UTIL_THROW_IF(order_ && streams_[order_ - 1], util::Exception, "More " << order_ << "-grams in the stream than counted");
+    }
+
+  private:
+    const VocabReconstitute &vocab_;
+    const std::vector<uint64_t> &counts_;
+    NGramStreams streams_;
+    unsigned int order_;
+};
+
+} // namespace
+
+BuildBinary::BuildBinary(const VocabReconstitute &vocab, const std::vector<uint64_t> &counts, ngram::ModelType type, const ngram::Config &config)
+  : vocab_(vocab), counts_(counts), type_(type), config_(config) {}
+
+void BuildBinary::Run(const util::stream::ChainPositions &positions) {
+  UTIL_TIMER("(%w s) Built binary file\n");
+  StreamSource source(vocab_, counts_, positions);
+  switch (type_) {
+    case ngram::PROBING:
+      ngram::ProbingModel(source, config_);
+      break;
+    case ngram::REST_PROBING:
+      ngram::RestProbingModel(source, config_);
+      break;
+    case ngram::TRIE:
+      ngram::TrieModel(source, config_);
+      break;
+    case ngram::QUANT_TRIE:
+      ngram::QuantTrieModel(source, config_);
+      break;
+    case ngram::ARRAY_TRIE:
+      ngram::ArrayTrieModel(source, config_);
+      break;
+    case ngram::QUANT_ARRAY_TRIE:
+      ngram::QuantArrayTrieModel(source, config_);
+      break;
+    default:
+      UTIL_THROW(util::Exception, "Unrecognized model type " << type_);
+  }
+  source.CheckFinished();
+}
+
+}} // namespaces
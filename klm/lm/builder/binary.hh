@@ -0,0 +1,38 @@
+#ifndef LM_BUILDER_BINARY_H
+#define LM_BUILDER_BINARY_H
+
+#include "lm/config.hh"
+#include "lm/model_type.hh"
+#include "util/stream/multi_stream.hh"
+
+#include <vector>
+
+#include <stdint.h>
+
+// Like PrintARPA, reads all unigrams before all bigrams before all trigrams
+// etc.
+
+namespace lm { namespace builder {
+
+class VocabReconstitute;
+
+// Builds a binary model from the estimated n-grams, the same as running
+// build_binary on the ARPA file written by PrintARPA.
+class BuildBinary {
+  public:
+    // config.write_mmap is the binary file to write.  type is the data
+    // structure including quantization and pointer compression, so
+    // config.prob_bits etc. should be consistent with it.
+    BuildBinary(const VocabReconstitute &vocab, const std::vector<uint64_t> &counts, ngram::ModelType type, const ngram::Config &config);
+
+    void Run(const util::stream::ChainPositions &positions);
+
+  private:
+    const VocabReconstitute &vocab_;
+    std::vector<uint64_t> counts_;
+    ngram::ModelType type_;
+    ngram::Config config_;
+};
+
+}} // namespaces
+#endif // LM_BUILDER_BINARY_H
@@ -0,0 +1,146 @@
+#include "lm/builder/pipeline.hh"
+
+#include "lm/model.hh"
+#include "util/file.hh"
+
+#define BOOST_TEST_MODULE BinaryTest
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace lm { namespace builder { namespace {
+
+// A named temporary file that is removed on destruction.
+class TempFile {
+  public:
+    explicit TempFile(const std::string &contents = std::string()) : name_("/tmp/binary_test_XXXXXX") {
+      util::scoped_fd fd(mkstemp(&name_[0]));
+      UTIL_THROW_IF(fd.get() == -1, util::ErrnoException, "mkstemp failed");
+      util::WriteOrThrow(fd.get(), contents.data(), contents.size());
+    }
+
+    ~TempFile() { unlink(name_.c_str()); }
+
+    const std::string &Name() const { return name_; }
+
+  private:
+    std::string name_;
+};
+
+// A few thousand sentences over a skewed vocabulary.
+std::string Corpus() {
+  std::ostringstream out;
+  unsigned state = 12345;
+  for (unsigned sentence = 0; sentence < 2000; ++sentence) {
+    state = state * 1103515245 + 12345;
+    unsigned length = 1 + (state >> 16) % 12;
+    for (unsigned i = 0; i < length; ++i) {
+      state = state * 1103515245 + 12345;
+      float uniform = static_cast<float>((state >> 16) % 1000) / 1000.0;
+      out << (i ? " " : "") << 'w' << static_cast<unsigned>(300.0 * uniform * uniform * uniform);
+    }
+    out << '\n';
+  }
+  return out.str();
+}
+
+PipelineConfig Estimation(std::size_t order) {
+  PipelineConfig config;
+  config.order = order;
+  config.vocab_file = "";
+  config.sort.temp_prefix = "/tmp/binary_test_sort";
+  config.sort.buffer_size = 1 << 16;
+  config.sort.total_memory = 1 << 24;
+  config.initial_probs.interpolate_unigrams = true;
+  config.initial_probs.adder_in.total_memory = 32768;
+  config.initial_probs.adder_in.block_count = 2;
+  config.initial_probs.adder_out.total_memory = 32768;
+  config.initial_probs.adder_out.block_count = 2;
+  config.read_backoffs = config.initial_probs.adder_out;
+  config.verbose_header = false;
+  config.vocab_estimate = 100;
+  config.minimum_block = 8192;
+  config.block_count = 2;
+  config.shards = 1;
+  config.prune_thresholds.assign(order, 0);
+  // The corpus is too small to estimate every discount, as with
+  // lmplz --discount_fallback.
+  config.discount.fallback.amount[0] = 0.0;
+  config.discount.fallback.amount[1] = 0.5;
+  config.discount.fallback.amount[2] = 1.0;
+  config.discount.fallback.amount[3] = 1.5;
+  config.discount.bad_action = SILENT;
+  config.output_q = false;
+  config.vocab_size_for_unk = 0;
+  config.disallowed_symbol_action = THROW_UP;
+  config.binary_type = ngram::PROBING;
+  return config;
+}
+
+std::string Contents(const std::string &file) {
+  std::ifstream in(file.c_str(), std::ios::binary);
+  BOOST_REQUIRE(in);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Builds the model directly and by writing ARPA for build_binary to load, with
+// the data structure and settings lmplz --binary_type would use.
+template <class Model> void CheckSameAsBuildBinary(ngram::ModelType type, ngram::Config config) {
+  config.messages = NULL;
+  TempFile text(Corpus()), arpa, direct, loaded;
+  for (std::size_t order = 2; order <= 4; ++order) {
+    PipelineConfig estimation(Estimation(order));
+    Pipeline(estimation, util::OpenReadOrThrow(text.Name().c_str()), util::CreateOrThrow(arpa.Name().c_str()));
+
+    estimation.binary_file = direct.Name();
+    estimation.binary_type = type;
+    estimation.binary_config = config;
+    Pipeline(estimation, util::OpenReadOrThrow(text.Name().c_str()), -1);
+
+    // As build_binary does.
+    ngram::Config from_arpa(config);
+    from_arpa.write_mmap = loaded.Name().c_str();
+    { Model model(arpa.Name().c_str(), from_arpa); }
+
+    const std::string expected(Contents(loaded.Name())), actual(Contents(direct.Name()));
+    BOOST_CHECK(!expected.empty());
+    BOOST_CHECK_EQUAL(expected.size(), actual.size());
+    BOOST_CHECK_MESSAGE(expected == actual, "order " << order << " differs from build_binary");
+
+    // And it loads.
+    Model model(direct.Name().c_str(), config);
+    BOOST_CHECK_EQUAL(order, model.Order());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Probing) {
+  ngram::Config config;
+  config.write_method = ngram::Config::WRITE_AFTER;
+  CheckSameAsBuildBinary<ngram::ProbingModel>(ngram::PROBING, config);
+}
+
+BOOST_AUTO_TEST_CASE(Trie) {
+  ngram::Config config;
+  config.write_method = ngram::Config::WRITE_MMAP;
+  config.temporary_directory_prefix = "/tmp/binary_test_trie";
+  CheckSameAsBuildBinary<ngram::TrieModel>(ngram::TRIE, config);
+}
+
+BOOST_AUTO_TEST_CASE(QuantArrayTrie) {
+  ngram::Config config;
+  config.write_method = ngram::Config::WRITE_MMAP;
+  config.temporary_directory_prefix = "/tmp/binary_test_trie";
+  config.prob_bits = 8;
+  config.backoff_bits = 8;
+  config.pointer_bhiksha_bits = 22;
+  CheckSameAsBuildBinary<ngram::QuantArrayTrieModel>(ngram::QUANT_ARRAY_TRIE, config);
+}
+
+}}} // namespaces
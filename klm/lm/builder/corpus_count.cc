@@ -11,6 +11,8 @@
 #include "util/probing_hash_table.hh"
 #include "util/scoped.hh"
 #include "util/stream/chain.hh"
+#include "util/stream/multi_stream.hh"
+#include "util/stream/stream.hh"
 #include "util/stream/timer.hh"
 #include "util/tokenize_piece.hh"
 
@@ -82,7 +84,7 @@ typedef util::ProbingHashTable<DedupeEntry, DedupeHash, DedupeEquals> Dedupe;
 
 class Writer {
   public:
-    Writer(std::size_t order, const util::stream::ChainPosition &position, void *dedupe_mem, std::size_t dedupe_mem_size) 
+    Writer(std::size_t order, const util::stream::ChainPosition &position, void *dedupe_mem, std::size_t dedupe_mem_size, bool special_words = true) 
       : block_(position), gram_(block_->Get(), order),
         dedupe_invalid_(order, std::numeric_limits<WordIndex>::max()),
         dedupe_(dedupe_mem, dedupe_mem_size, &dedupe_invalid_[0], DedupeHash(order), DedupeEquals(order)),
@@ -90,7 +92,7 @@ class Writer {
         block_size_(position.GetChain().BlockSize()) {
       dedupe_.Clear();
       assert(Dedupe::Size(position.GetChain().BlockSize() / position.GetChain().EntrySize(), kProbingMultiplier) == dedupe_mem_size);
-      if (order == 1) {
+      if (order == 1 && special_words) {
         // Add special words.  AdjustCounts is responsible if order != 1.    
         AddUnigramWord(kUNK);
         AddUnigramWord(kBOS);
@@ -111,6 +113,17 @@ class Writer {
 
     void Append(WordIndex word) {
       *(gram_.end() - 1) = word;
+      Insert();
+    }
+
+    // Count an entire n-gram from a shard.
+    void Append(const WordIndex *ngram) {
+      std::copy(ngram, ngram + gram_.Order(), gram_.begin());
+      Insert();
+    }
+
+  private:
+    void Insert() {
       Dedupe::MutableIterator at;
       bool found = dedupe_.FindOrInsert(DedupeEntry::Construct(gram_.begin()), at);
       if (found) {
@@ -138,7 +151,6 @@ class Writer {
       std::copy(buffer_.get(), buffer_.get() + gram_.Order() - 1, gram_.begin());
     }
 
-  private:
     void AddUnigramWord(WordIndex index) {
       *gram_.begin() = index;
       gram_.Count() = 0;
@@ -164,6 +176,35 @@ class Writer {
     const std::size_t block_size_;
 };
 
+// Sends the n-grams ending at each word to the shard of that word.
+class ShardRouter {
+  public:
+    ShardRouter(std::size_t order, const util::stream::ChainPositions &positions)
+      : shards_(positions), window_(order) {}
+
+    ~ShardRouter() {
+      for (util::stream::Stream *i = shards_.begin(); i != shards_.end(); ++i) {
+        i->Poison();
+      }
+    }
+
+    void StartSentence() {
+      std::fill(window_.begin(), window_.end() - 1, kBOS);
+    }
+
+    void Append(WordIndex word) {
+      window_.back() = word;
+      util::stream::Stream &shard = shards_[word % shards_.size()];
+      std::copy(window_.begin(), window_.end(), static_cast<WordIndex*>(shard.Get()));
+      ++shard;
+      std::copy(window_.begin() + 1, window_.end(), window_.begin());
+    }
+
+  private:
+    util::stream::Streams shards_;
+    std::vector<WordIndex> window_;
+};
+
 } // namespace
 
 float CorpusCount::DedupeMultiplier(std::size_t order) {
@@ -176,8 +217,8 @@ std::size_t CorpusCount::VocabUsage(std::size_t vocab_estimate) {
 
 CorpusCount::CorpusCount(util::FilePiece &from, int vocab_write, uint64_t &token_count, WordIndex &type_count, std::size_t entries_per_block, WarningAction disallowed_symbol)
   : from_(from), vocab_write_(vocab_write), token_count_(token_count), type_count_(type_count),
-    dedupe_mem_size_(Dedupe::Size(entries_per_block, kProbingMultiplier)),
-    dedupe_mem_(util::MallocOrThrow(dedupe_mem_size_)),
+    dedupe_mem_size_(entries_per_block ? Dedupe::Size(entries_per_block, kProbingMultiplier) : 0),
+    dedupe_mem_(entries_per_block ? util::MallocOrThrow(dedupe_mem_size_) : NULL),
     disallowed_symbol_action_(disallowed_symbol) {
 }
 
@@ -196,23 +237,20 @@ namespace {
   }
 } // namespace
 
-void CorpusCount::Run(const util::stream::ChainPosition &position) {
-  ngram::GrowableVocab<ngram::WriteUniqueWords> vocab(type_count_, vocab_write_);
-  token_count_ = 0;
-  type_count_ = 0;
+namespace {
+// Reads the corpus, sending each word to the writer.
+template <class Writer> void CountWords(util::FilePiece &from, ngram::GrowableVocab<ngram::WriteUniqueWords> &vocab, Writer &writer, WarningAction &disallowed_symbol_action, uint64_t &count) {
   const WordIndex end_sentence = vocab.FindOrInsert("</s>");
-  Writer writer(NGram::OrderFromSize(position.GetChain().EntrySize()), position, dedupe_mem_.get(), dedupe_mem_size_);
-  uint64_t count = 0;
   bool delimiters[256];
   util::BoolCharacter::Build("\0\t\n\r ", delimiters);
   try {
     while(true) {
-      StringPiece line(from_.ReadLine());
+      StringPiece line(from.ReadLine());
       writer.StartSentence();
       for (util::TokenIter<util::BoolCharacter, true> w(line, delimiters); w; ++w) {
         WordIndex word = vocab.FindOrInsert(*w);
         if (word <= 2) {
-          ComplainDisallowed(*w, disallowed_symbol_action_);
+          ComplainDisallowed(*w, disallowed_symbol_action);
           continue;
         }
         writer.Append(word);
@@ -221,9 +259,42 @@ void CorpusCount::Run(const util::stream::ChainPosition &position) {
       writer.Append(end_sentence);
     }
   } catch (const util::EndOfFileException &e) {}
+}
+} // namespace
+
+void CorpusCount::Run(const util::stream::ChainPosition &position) {
+  ngram::GrowableVocab<ngram::WriteUniqueWords> vocab(type_count_, vocab_write_);
+  token_count_ = 0;
+  type_count_ = 0;
+  Writer writer(NGram::OrderFromSize(position.GetChain().EntrySize()), position, dedupe_mem_.get(), dedupe_mem_size_);
+  uint64_t count = 0;
+  CountWords(from_, vocab, writer, disallowed_symbol_action_, count);
   token_count_ = count;
   type_count_ = vocab.Size();
 }
 
+void CorpusCount::Run(const util::stream::ChainPositions &positions) {
+  ngram::GrowableVocab<ngram::WriteUniqueWords> vocab(type_count_, vocab_write_);
+  token_count_ = 0;
+  type_count_ = 0;
+  uint64_t count = 0;
+  {
+    ShardRouter router(positions.begin()->GetChain().EntrySize() / sizeof(WordIndex), positions);
+    CountWords(from_, vocab, router, disallowed_symbol_action_, count);
+  }
+  token_count_ = count;
+  type_count_ = vocab.Size();
+}
+
+void ShardCount::Run(const util::stream::ChainPosition &position) {
+  const util::stream::Chain &chain = out_.GetChain();
+  const std::size_t dedupe_mem_size = Dedupe::Size(chain.BlockSize() / chain.EntrySize(), kProbingMultiplier);
+  util::scoped_malloc dedupe_mem(util::MallocOrThrow(dedupe_mem_size));
+  Writer writer(NGram::OrderFromSize(chain.EntrySize()), out_, dedupe_mem.get(), dedupe_mem_size, special_words_);
+  for (util::stream::Stream in(position); in; ++in) {
+    writer.Append(static_cast<const WordIndex*>(in.Get()));
+  }
+}
+
 } // namespace builder
 } // namespace lm
@@ -4,6 +4,7 @@
 #include "lm/lm_exception.hh"
 #include "lm/word_index.hh"
 #include "util/scoped.hh"
+#include "util/stream/chain.hh"
 
 #include <cstddef>
 #include <string>
@@ -12,7 +13,7 @@
 namespace util {
 class FilePiece;
 namespace stream {
-class ChainPosition;
+class ChainPositions;
 } // namespace stream
 } // namespace util
 
@@ -29,10 +30,19 @@ class CorpusCount {
 
     // token_count: out.
     // type_count aka vocabulary size.  Initialize to an estimate.  It is set to the exact value.
+    // entries_per_block: of the output chain.  Zero if sharding.
     CorpusCount(util::FilePiece &from, int vocab_write, uint64_t &token_count, WordIndex &type_count, std::size_t entries_per_block, WarningAction disallowed_symbol);
 
+    // Writes deduplicated n-grams with counts to position.
     void Run(const util::stream::ChainPosition &position);
 
+    /* Sharded counting: writes every n-gram occurrence (just the words) to
+     * the shard of its last word, positions[word % positions.size()].  Each
+     * shard is counted by a ShardCount thread.  The vocabulary is assigned in
+     * this thread so ids are the same as without sharding.
+     */
+    void Run(const util::stream::ChainPositions &positions);
+
   private:
     util::FilePiece &from_;
     int vocab_write_;
@@ -45,6 +55,21 @@ class CorpusCount {
     WarningAction disallowed_symbol_action_;
 };
 
+// Deduplicates and counts the n-gram occurrences of one shard, writing the
+// same records as CorpusCount does without sharding.
+class ShardCount {
+  public:
+    // special_words: write <unk> and <s> unigrams (for one of the shards).
+    ShardCount(const util::stream::ChainPosition &out, bool special_words)
+      : out_(out), special_words_(special_words) {}
+
+    void Run(const util::stream::ChainPosition &position);
+
+  private:
+    util::stream::ChainPosition out_;
+    bool special_words_;
+};
+
 } // namespace builder
 } // namespace lm
 #endif // LM_BUILDER_CORPUS_COUNT_H
@@ -1,5 +1,6 @@
 #include "lm/builder/pipeline.hh"
 #include "lm/lm_exception.hh"
+#include "lm/model_type.hh"
 #include "util/file.hh"
 #include "util/file_piece.hh"
 #include "util/usage.hh"
@@ -78,6 +79,37 @@ lm::builder::Discount ParseDiscountFallback(const std::vector<std::string> &para
   return ret;
 }
 
+uint8_t ParseBitCount(const boost::program_options::variables_map &vm, const char *name) {
+  unsigned int bits = vm[name].as<unsigned int>();
+  UTIL_THROW_IF(bits > 25, util::Exception, "--" << name << " is " << bits << " but bit counts are limited to 25.");
+  return bits;
+}
+
+// Pick the data structure of the binary file and set its options the same way
+// build_binary does.
+lm::ngram::ModelType ParseBinaryType(const std::string &type, const boost::program_options::variables_map &vm, lm::ngram::Config &config) {
+  bool quantize = vm.count("prob_bits"), bhiksha = vm.count("array_pointers");
+  UTIL_THROW_IF(vm.count("backoff_bits") && !quantize, util::Exception, "--backoff_bits requires --prob_bits");
+  if (type == "probing") {
+    UTIL_THROW_IF(quantize || bhiksha, util::Exception, "Quantization and pointer compression are only implemented in the trie data structure.");
+    config.write_method = lm::ngram::Config::WRITE_AFTER;
+    return lm::ngram::PROBING;
+  }
+  UTIL_THROW_IF(type != "trie", util::Exception, "Unknown binary type " << type << ".  Use probing or trie.");
+  config.write_method = lm::ngram::Config::WRITE_MMAP;
+  lm::ngram::ModelType ret = lm::ngram::TRIE;
+  if (quantize) {
+    config.prob_bits = ParseBitCount(vm, "prob_bits");
+    config.backoff_bits = vm.count("backoff_bits") ? ParseBitCount(vm, "backoff_bits") : config.prob_bits;
+    ret = static_cast<lm::ngram::ModelType>(ret + lm::ngram::kQuantAdd);
+  }
+  if (bhiksha) {
+    config.pointer_bhiksha_bits = ParseBitCount(vm, "array_pointers");
+    ret = static_cast<lm::ngram::ModelType>(ret + lm::ngram::kArrayAdd);
+  }
+  return ret;
+}
+
 } // namespace
 
 int main(int argc, char *argv[]) {
@@ -86,7 +118,7 @@ int main(int argc, char *argv[]) {
     po::options_description options("Language model building options");
     lm::builder::PipelineConfig pipeline;
 
-    std::string text, arpa;
+    std::string text, arpa, binary_type;
     std::vector<std::string> pruning;
     std::vector<std::string> discount_fallback;
     std::vector<std::string> discount_fallback_default;
@@ -108,12 +140,19 @@ int main(int argc, char *argv[]) {
       ("minimum_block", SizeOption(pipeline.minimum_block, "8K"), "Minimum block size to allow")
       ("sort_block", SizeOption(pipeline.sort.buffer_size, "64M"), "Size of IO operations for sort (determines arity)")
       ("block_count", po::value<std::size_t>(&pipeline.block_count)->default_value(2), "Block count (per order)")
+      ("shards", po::value<std::size_t>(&pipeline.shards)->default_value(1), "Count and sort n-grams in this many threads, each for a subset of the vocabulary.  The model is the same.")
       ("vocab_estimate", po::value<lm::WordIndex>(&pipeline.vocab_estimate)->default_value(1000000), "Assume this vocabulary size for purposes of calculating memory in step 1 (corpus count) and pre-sizing the hash table")
       ("vocab_file", po::value<std::string>(&pipeline.vocab_file)->default_value(""), "Location to write a file containing the unique vocabulary strings delimited by null bytes")
       ("vocab_pad", po::value<uint64_t>(&pipeline.vocab_size_for_unk)->default_value(0), "If the vocabulary is smaller than this value, pad with <unk> to reach this size. Requires --interpolate_unigrams")
       ("verbose_header", po::bool_switch(&pipeline.verbose_header), "Add a verbose header to the ARPA file that includes information such as token count, smoothing type, etc.")
       ("text", po::value<std::string>(&text), "Read text from a file instead of stdin")
       ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout")
+      ("binary", po::value<std::string>(&pipeline.binary_file), "Build a KenLM binary file directly instead of writing ARPA.  The result is the same as running build_binary on the ARPA file.")
+      ("binary_type", po::value<std::string>(&binary_type)->default_value("probing"), "Data structure of the binary file: probing or trie")
+      ("probing_multiplier", po::value<float>(&pipeline.binary_config.probing_multiplier)->default_value(1.5), "Space multiplier of the probing hash table.  Must be > 1.0")
+      ("prob_bits", po::value<unsigned int>(), "Quantize probabilities in the trie to this many bits (like build_binary -q)")
+      ("backoff_bits", po::value<unsigned int>(), "Quantize backoffs in the trie to this many bits (like build_binary -b).  Defaults to --prob_bits")
+      ("array_pointers", po::value<unsigned int>(), "Compress trie pointers using an array of offsets with at most this many bits (like build_binary -a)")
       ("collapse_values", po::bool_switch(&pipeline.output_q), "Collapse probability and backoff into a single value, q that yields the same sentence-level probabilities.  See http://kheafield.com/professional/edinburgh/rest_paper.pdf for more details, including a proof.")
       ("prune", po::value<std::vector<std::string> >(&pruning)->multitoken(), "Prune n-grams with count less than or equal to the given threshold.  Specify one value for each order i.e. 0 0 1 to prune singleton trigrams and above.  The sequence of values must be non-decreasing and the last value applies to any remaining orders.  Unigram pruning is not implemented, so the first value must be zero.  Default is to not prune, which is equivalent to --prune 0.")
       ("discount_fallback", po::value<std::vector<std::string> >(&discount_fallback)->multitoken()->implicit_value(discount_fallback_default, "0.5 1 1.5"), "The closed-form estimate for Kneser-Ney discounts does not work without singletons or doubletons.  It can also fail if these values are out of range.  This option falls back to user-specified discounts when the closed-form estimate fails.  Note that this option is generally a bad idea: you should deduplicate your corpus instead.  However, class-based models need custom discounts because they lack singleton unigrams.  Provide up to three discounts (for adjusted counts 1, 2, and 3+), which will be applied to all orders where the closed-form estimates fail.");
@@ -135,7 +174,8 @@ int main(int argc, char *argv[]) {
         "}\n\n"
         "Provide the corpus on stdin.  The ARPA file will be written to stdout.  Order of\n"
         "the model (-o) is the only mandatory option.  As this is an on-disk program,\n"
-        "setting the temporary file location (-T) and sorting memory (-S) is recommended.\n\n"
+        "setting the temporary file location (-T) and sorting memory (-S) is recommended.\n"
+        "Use --binary to build a binary file for querying instead of the ARPA file.\n\n"
         "Memory sizes are specified like GNU sort: a number followed by a unit character.\n"
         "Valid units are \% for percentage of memory (supported platforms only) and (in\n"
         "increasing powers of 1024): b, K, M, G, T, P, E, Z, Y.  Default is K (*1024).\n";
@@ -179,6 +219,11 @@ int main(int argc, char *argv[]) {
       pipeline.discount.bad_action = lm::THROW_UP;
     }
 
+    if (vm.count("binary")) {
+      UTIL_THROW_IF(vm.count("arpa"), util::Exception, "Specify either --arpa or --binary, not both.");
+      pipeline.binary_type = ParseBinaryType(binary_type, vm, pipeline.binary_config);
+    }
+
     // parse pruning thresholds.  These depend on order, so it is not done as a notifier.
     pipeline.prune_thresholds = ParsePruning(pruning, pipeline.order);
     
@@ -199,6 +244,10 @@ int main(int argc, char *argv[]) {
     if (vm.count("arpa")) {
       out.reset(util::CreateOrThrow(arpa.c_str()));
     }
+    if (vm.count("binary")) {
+      // Leave stdout open.
+      out.release();
+    }
 
     // Read from stdin
     try {
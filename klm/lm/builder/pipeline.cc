@@ -1,6 +1,7 @@
 #include "lm/builder/pipeline.hh"
 
 #include "lm/builder/adjust_counts.hh"
+#include "lm/builder/binary.hh"
 #include "lm/builder/corpus_count.hh"
 #include "lm/builder/hash_gamma.hh"
 #include "lm/builder/initial_probabilities.hh"
@@ -207,32 +208,64 @@ class Master {
     util::FixedArray<util::stream::FileBuffer> files_;
 };
 
+void FinishCount(Master &master, util::stream::Sort<SuffixOrder, AddCombiner> &sorter, uint64_t token_count, WordIndex type_count) {
+  std::cerr << "Unigram tokens " << token_count << " types " << type_count << std::endl;
+  std::cerr << "=== 2/5 Calculating and sorting adjusted counts ===" << std::endl;
+  master.InitForAdjust(sorter, type_count);
+}
+
+// Memory for the chains carrying n-gram occurrences to each shard.
+const std::size_t kShardRawMemory = 1 << 22;
+
 void CountText(int text_file /* input */, int vocab_file /* output */, Master &master, uint64_t &token_count, std::string &text_file_name) {
   const PipelineConfig &config = master.Config();
   std::cerr << "=== 1/5 Counting and sorting n-grams ===" << std::endl;
 
   const std::size_t vocab_usage = CorpusCount::VocabUsage(config.vocab_estimate);
   UTIL_THROW_IF(config.TotalMemory() < vocab_usage, util::Exception, "Vocab hash size estimate " << vocab_usage << " exceeds total memory " << config.TotalMemory());
+  const std::size_t raw_usage = config.shards > 1 ? config.shards * kShardRawMemory : 0;
+  UTIL_THROW_IF(config.TotalMemory() < vocab_usage + raw_usage, util::Exception, "Vocab hash size estimate " << vocab_usage << " and " << config.shards << " shard buffers exceed total memory " << config.TotalMemory());
   std::size_t memory_for_chain = 
     // This much memory to work with after vocab hash table.
-    static_cast<float>(config.TotalMemory() - vocab_usage) /
+    static_cast<float>(config.TotalMemory() - vocab_usage - raw_usage) /
     // Solve for block size including the dedupe multiplier for one block.
     (static_cast<float>(config.block_count) + CorpusCount::DedupeMultiplier(config.order)) *
     // Chain likes memory expressed in terms of total memory.
     static_cast<float>(config.block_count);
-  util::stream::Chain chain(util::stream::ChainConfig(NGram::TotalSize(config.order), config.block_count, memory_for_chain));
 
   WordIndex type_count = config.vocab_estimate;
   util::FilePiece text(text_file, NULL, &std::cerr);
   text_file_name = text.FileName();
-  CorpusCount counter(text, vocab_file, token_count, type_count, chain.BlockSize() / chain.EntrySize(), config.disallowed_symbol_action);
-  chain >> boost::ref(counter);
 
-  util::stream::Sort<SuffixOrder, AddCombiner> sorter(chain, config.sort, SuffixOrder(config.order), AddCombiner());
-  chain.Wait(true);
-  std::cerr << "Unigram tokens " << token_count << " types " << type_count << std::endl;
-  std::cerr << "=== 2/5 Calculating and sorting adjusted counts ===" << std::endl;
-  master.InitForAdjust(sorter, type_count);
+  if (config.shards <= 1) {
+    util::stream::Chain chain(util::stream::ChainConfig(NGram::TotalSize(config.order), config.block_count, memory_for_chain));
+    CorpusCount counter(text, vocab_file, token_count, type_count, chain.BlockSize() / chain.EntrySize(), config.disallowed_symbol_action);
+    chain >> boost::ref(counter);
+
+    util::stream::Sort<SuffixOrder, AddCombiner> sorter(chain, config.sort, SuffixOrder(config.order), AddCombiner());
+    chain.Wait(true);
+    FinishCount(master, sorter, token_count, type_count);
+    return;
+  }
+
+  // Each shard deduplicates the n-grams ending with its words then sorts
+  // them, all in parallel.  The shards are merged by one sort.
+  util::stream::Chains raw(config.shards), counted(config.shards);
+  for (std::size_t i = 0; i < config.shards; ++i) {
+    raw.push_back(util::stream::ChainConfig(config.order * sizeof(WordIndex), config.block_count, kShardRawMemory));
+    counted.push_back(util::stream::ChainConfig(NGram::TotalSize(config.order), config.block_count, memory_for_chain / config.shards));
+  }
+  CorpusCount counter(text, vocab_file, token_count, type_count, 0, config.disallowed_symbol_action);
+  raw >> boost::ref(counter);
+  for (std::size_t i = 0; i < config.shards; ++i) {
+    raw[i] >> ShardCount(counted[i].Add(), i == 0);
+  }
+  raw >> util::stream::kRecycle;
+
+  util::stream::Sort<SuffixOrder, AddCombiner> sorter(counted, config.sort, SuffixOrder(config.order), AddCombiner());
+  raw.Wait(true);
+  counted.Wait(true);
+  FinishCount(master, sorter, token_count, type_count);
 }
 
 void InitialProbabilities(const std::vector<uint64_t> &counts, const std::vector<uint64_t> &counts_pruned, const std::vector<Discount> &discounts, Master &master, Sorts<SuffixOrder> &primary,
@@ -326,11 +359,19 @@ void Pipeline(PipelineConfig config, int text_file, int out_arpa) {
       InterpolateProbabilities(counts_pruned, master, primary, gammas);
     }
 
-    std::cerr << "=== 5/5 Writing ARPA model ===" << std::endl;
+    std::cerr << (config.binary_file.empty() ? "=== 5/5 Writing ARPA model ===" : "=== 5/5 Building binary model ===") << std::endl;
     VocabReconstitute vocab(vocab_file.get());
     UTIL_THROW_IF(vocab.Size() != counts[0], util::Exception, "Vocab words don't match up.  Is there a null byte in the input?");
-    HeaderInfo header_info(text_file_name, token_count);
-    master >> PrintARPA(vocab, counts_pruned, (config.verbose_header ? &header_info : NULL), out_arpa) >> util::stream::kRecycle;
+    if (config.binary_file.empty()) {
+      HeaderInfo header_info(text_file_name, token_count);
+      master >> PrintARPA(vocab, counts_pruned, (config.verbose_header ? &header_info : NULL), out_arpa) >> util::stream::kRecycle;
+    } else {
+      util::scoped_fd closer(out_arpa);
+      lm::ngram::Config &binary = config.binary_config;
+      binary.write_mmap = config.binary_file.c_str();
+      if (!binary.temporary_directory_prefix) binary.temporary_directory_prefix = config.TempPrefix().c_str();
+      master >> BuildBinary(vocab, counts_pruned, config.binary_type, binary) >> util::stream::kRecycle;
+    }
     master.MutableChains().Wait(true);
   } catch (const util::Exception &e) {
     std::cerr << e.what() << std::endl;
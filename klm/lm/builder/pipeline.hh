@@ -4,7 +4,9 @@
 #include "lm/builder/adjust_counts.hh"
 #include "lm/builder/initial_probabilities.hh"
 #include "lm/builder/header_info.hh"
+#include "lm/config.hh"
 #include "lm/lm_exception.hh"
+#include "lm/model_type.hh"
 #include "lm/word_index.hh"
 #include "util/stream/config.hh"
 #include "util/file_piece.hh"
@@ -34,6 +36,10 @@ struct PipelineConfig {
   // Number of blocks to use.  This will be overridden to 1 if everything fits.
   std::size_t block_count;
 
+  // Number of threads that count and sort n-grams in parallel, each for the
+  // n-grams ending with a subset of the vocabulary.  1 counts in one thread.
+  std::size_t shards;
+
   // n-gram count thresholds for pruning. 0 values means no pruning for
   // corresponding n-gram order
   std::vector<uint64_t> prune_thresholds; //mjd
@@ -62,11 +68,20 @@ struct PipelineConfig {
    */
   WarningAction disallowed_symbol_action;
 
+  /* Build a binary model in this file instead of writing an ARPA file.  Empty
+   * to write ARPA.  The pipeline sets binary_config.write_mmap and, unless
+   * given, binary_config.temporary_directory_prefix.
+   */
+  std::string binary_file;
+  lm::ngram::ModelType binary_type;
+  lm::ngram::Config binary_config;
+
   const std::string &TempPrefix() const { return sort.temp_prefix; }
   std::size_t TotalMemory() const { return sort.total_memory; }
 };
 
-// Takes ownership of text_file and out_arpa.
+// Takes ownership of text_file and out_arpa.  out_arpa is ignored (and may be
+// -1) if config.binary_file is set.
 void Pipeline(PipelineConfig config, int text_file, int out_arpa);
 
 }} // namespaces
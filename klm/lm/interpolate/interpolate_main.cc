@@ -0,0 +1,133 @@
+#include "lm/interpolate/pipeline.hh"
+#include "lm/interpolate/tune_weights.hh"
+#include "lm/model_type.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/usage.hh"
+
+#include <iostream>
+
+#include <boost/program_options.hpp>
+#include <vector>
+
+#include <math.h>
+
+namespace {
+class SizeNotify {
+  public:
+    SizeNotify(std::size_t &out) : behind_(out) {}
+
+    void operator()(const std::string &from) {
+      behind_ = util::ParseSize(from);
+    }
+
+  private:
+    std::size_t &behind_;
+};
+
+boost::program_options::typed_value<std::string> *SizeOption(std::size_t &to, const char *default_value) {
+  return boost::program_options::value<std::string>()->notifier(SizeNotify(to))->default_value(default_value);
+}
+
+lm::ngram::ModelType ParseBinaryType(const std::string &type, lm::ngram::Config &config) {
+  if (type == "probing") {
+    config.write_method = lm::ngram::Config::WRITE_AFTER;
+    return lm::ngram::PROBING;
+  }
+  UTIL_THROW_IF(type != "trie", util::Exception, "Unknown binary type " << type << ".  Use probing or trie.");
+  config.write_method = lm::ngram::Config::WRITE_MMAP;
+  return lm::ngram::TRIE;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    namespace po = boost::program_options;
+    po::options_description options("Language model interpolation options");
+    lm::interpolate::InterpolateConfig config;
+    std::string tune, arpa, binary_type;
+
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show this help message")
+      ("model,m", po::value<std::vector<std::string> >(&config.models)->multitoken(), "ARPA files to interpolate")
+      ("weight,w", po::value<std::vector<float> >(&config.weights)->multitoken(), "Weight of each model.  Defaults to uniform weights.")
+      ("tune", po::value<std::string>(&tune), "Tune the weights to minimize the perplexity of this text, starting from --weight")
+      ("temp_prefix,T", po::value<std::string>(&config.sort.temp_prefix)->default_value("/tmp/lm"), "Temporary file prefix")
+      ("memory,S", SizeOption(config.sort.total_memory, util::GuessPhysicalMemory() ? "50%" : "1G"), "Sorting memory")
+      ("sort_block", SizeOption(config.sort.buffer_size, "64M"), "Size of IO operations for sort (determines arity)")
+      ("block_count", po::value<std::size_t>(&config.block_count)->default_value(2), "Block count (per order)")
+      ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout")
+      ("binary", po::value<std::string>(&config.binary_file), "Build a KenLM binary file directly instead of writing ARPA")
+      ("binary_type", po::value<std::string>(&binary_type)->default_value("probing"), "Data structure of the binary file: probing or trie")
+      ("probing_multiplier", po::value<float>(&config.binary_config.probing_multiplier)->default_value(1.5), "Space multiplier of the probing hash table.  Must be > 1.0");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+
+    if (argc == 1 || vm["help"].as<bool>()) {
+      std::cerr <<
+        "Linearly interpolates ARPA language models into one backoff model.  Probabilities\n"
+        "are interpolated then backoffs are recomputed so the model is normalized.  The\n"
+        "n-grams are sorted on disk, so setting the temporary file location (-T) and\n"
+        "sorting memory (-S) is recommended.  The ARPA file will be written to stdout.\n"
+        "A model that lacks a word gives it the probability of <unk>, so the result sums\n"
+        "to more than one if the vocabularies differ.\n\n"
+        "Memory sizes are specified like GNU sort: a number followed by a unit character.\n"
+        "Valid units are \% for percentage of memory (supported platforms only) and (in\n"
+        "increasing powers of 1024): b, K, M, G, T, P, E, Z, Y.  Default is K (*1024).\n\n";
+      std::cerr << options << std::endl;
+      return 1;
+    }
+
+    po::notify(vm);
+
+    UTIL_THROW_IF(config.models.empty(), util::Exception, "Specify the models to interpolate with --model.");
+    if (config.weights.empty()) {
+      config.weights.assign(config.models.size(), 1.0 / static_cast<float>(config.models.size()));
+    }
+    UTIL_THROW_IF(config.weights.size() != config.models.size(), util::Exception, "There are " << config.models.size() << " models but " << config.weights.size() << " weights.");
+    float sum = 0.0;
+    for (std::vector<float>::const_iterator i = config.weights.begin(); i != config.weights.end(); ++i) {
+      UTIL_THROW_IF(*i < 0.0, util::Exception, "Weight " << *i << " is negative.");
+      sum += *i;
+    }
+    UTIL_THROW_IF(fabs(sum - 1.0) > 0.001, util::Exception, "The weights sum to " << sum << " instead of 1.");
+
+    if (vm.count("tune")) {
+      lm::interpolate::TuneWeights(config.models, tune, config.weights);
+      std::cerr << "Tuned weights:";
+      for (std::vector<float>::const_iterator i = config.weights.begin(); i != config.weights.end(); ++i) {
+        std::cerr << ' ' << *i;
+      }
+      std::cerr << std::endl;
+    }
+
+    if (vm.count("binary")) {
+      UTIL_THROW_IF(vm.count("arpa"), util::Exception, "Specify either --arpa or --binary, not both.");
+      config.binary_type = ParseBinaryType(binary_type, config.binary_config);
+    }
+
+    util::NormalizeTempPrefix(config.sort.temp_prefix);
+
+    util::scoped_fd out(1);
+    if (vm.count("arpa")) {
+      out.reset(util::CreateOrThrow(arpa.c_str()));
+    }
+    if (vm.count("binary")) {
+      // Leave stdout open.
+      out.release();
+    }
+
+    try {
+      lm::interpolate::Pipeline(config, out.release());
+    } catch (const util::MallocException &e) {
+      std::cerr << e.what() << std::endl;
+      std::cerr << "Try rerunning with a more conservative -S setting than " << vm["memory"].as<std::string>() << std::endl;
+      return 1;
+    }
+    util::PrintUsage(std::cerr);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
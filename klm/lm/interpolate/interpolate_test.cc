@@ -0,0 +1,230 @@
+#include "lm/interpolate/pipeline.hh"
+#include "lm/interpolate/tune_weights.hh"
+
+#include "lm/model.hh"
+#include "util/file.hh"
+
+#define BOOST_TEST_MODULE InterpolateTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace lm { namespace interpolate { namespace {
+
+// Both models have the same vocabulary and their unigrams sum to one.
+const char kBigram[] =
+  "\\data\\\n"
+  "ngram 1=5\n"
+  "ngram 2=4\n"
+  "\n"
+  "\\1-grams:\n"
+  "-1\t<unk>\t0\n"
+  "-99\t<s>\t-0.3\n"
+  "-0.69897\t</s>\t0\n"
+  "-0.39794\ta\t-0.2\n"
+  "-0.522879\tb\t-0.25\n"
+  "\n"
+  "\\2-grams:\n"
+  "-0.3\t<s> a\n"
+  "-0.4\ta b\n"
+  "-0.35\tb a\n"
+  "-0.5\tb </s>\n"
+  "\n"
+  "\\end\\\n";
+
+const char kTrigram[] =
+  "\\data\\\n"
+  "ngram 1=5\n"
+  "ngram 2=5\n"
+  "ngram 3=2\n"
+  "\n"
+  "\\1-grams:\n"
+  "-1.30103\t<unk>\t0\n"
+  "-99\t<s>\t-0.2\n"
+  "-0.60206\t</s>\t0\n"
+  "-0.522879\ta\t-0.1\n"
+  "-0.39794\tb\t-0.15\n"
+  "\n"
+  "\\2-grams:\n"
+  "-0.2\t<s> a\t-0.05\n"
+  "-0.5\t<s> b\n"
+  "-0.8\ta a\n"
+  "-0.3\ta b\t-0.1\n"
+  "-0.4\tb </s>\n"
+  "\n"
+  "\\3-grams:\n"
+  "-0.1\t<s> a b\n"
+  "-0.2\ta b </s>\n"
+  "\n"
+  "\\end\\\n";
+
+// A named temporary file that is removed on destruction.
+class TempFile {
+  public:
+    explicit TempFile(const std::string &contents = std::string()) : name_("/tmp/interpolate_test_XXXXXX") {
+      util::scoped_fd fd(mkstemp(&name_[0]));
+      UTIL_THROW_IF(fd.get() == -1, util::ErrnoException, "mkstemp failed");
+      util::WriteOrThrow(fd.get(), contents.data(), contents.size());
+    }
+
+    ~TempFile() { unlink(name_.c_str()); }
+
+    const std::string &Name() const { return name_; }
+
+  private:
+    std::string name_;
+};
+
+ngram::Config Quiet() {
+  ngram::Config config;
+  config.messages = NULL;
+  return config;
+}
+
+// Scores words after a context that starts a sentence if it begins with <s>.
+class Scorer {
+  public:
+    explicit Scorer(const std::string &file) : model_(file.c_str(), Quiet()) {}
+
+    float Score(const std::vector<std::string> &context, const std::string &word) const {
+      ngram::State state, out;
+      std::vector<std::string>::const_iterator i = context.begin();
+      if (i != context.end() && *i == "<s>") {
+        state = model_.BeginSentenceState();
+        ++i;
+      } else {
+        state = model_.NullContextState();
+      }
+      for (; i != context.end(); ++i) {
+        model_.FullScore(state, model_.GetVocabulary().Index(*i), out);
+        state = out;
+      }
+      return model_.FullScore(state, model_.GetVocabulary().Index(word), out).prob;
+    }
+
+  private:
+    ngram::ProbingModel model_;
+};
+
+std::vector<std::string> Words(const char *text) {
+  std::vector<std::string> ret;
+  std::string word;
+  for (const char *i = text; ; ++i) {
+    if (*i == ' ' || !*i) {
+      if (!word.empty()) ret.push_back(word);
+      word.clear();
+      if (!*i) return ret;
+    } else {
+      word += *i;
+    }
+  }
+}
+
+const float kWeights[] = {0.3, 0.7};
+
+BOOST_AUTO_TEST_CASE(Interpolate) {
+  TempFile bigram(kBigram), trigram(kTrigram), mixed;
+  InterpolateConfig config;
+  config.models.push_back(bigram.Name());
+  config.models.push_back(trigram.Name());
+  config.weights.assign(kWeights, kWeights + 2);
+  config.sort.temp_prefix = "/tmp/interpolate_test_sort";
+  config.sort.buffer_size = 4096;
+  config.sort.total_memory = 1 << 20;
+  config.block_count = 2;
+  Pipeline(config, util::CreateOrThrow(mixed.Name().c_str()));
+
+  Scorer bigram_model(bigram.Name()), trigram_model(trigram.Name()), result(mixed.Name());
+  const Scorer *models[2] = {&bigram_model, &trigram_model};
+
+  // The n-grams of either model get the interpolated probability.
+  const char *kSeen[] = {
+    "<unk>", "</s>", "a", "b",
+    "<s> a", "<s> b", "a a", "a b", "b a", "b </s>",
+    "<s> a b", "a b </s>"};
+  for (std::size_t i = 0; i < sizeof(kSeen) / sizeof(const char*); ++i) {
+    std::vector<std::string> context(Words(kSeen[i]));
+    const std::string word(context.back());
+    context.pop_back();
+    double expected = 0.0;
+    for (std::size_t m = 0; m < 2; ++m) {
+      expected += kWeights[m] * pow(10.0, models[m]->Score(context, word));
+    }
+    BOOST_CHECK_CLOSE(expected, pow(10.0, result.Score(context, word)), 0.01);
+  }
+
+  // The recomputed backoffs normalize every context, seen or not.
+  const char *kContexts[] = {
+    "", "<s>", "a", "b",
+    "<s> a", "<s> b", "a a", "a b", "b a", "b b"};
+  const char *kVocab[] = {"<unk>", "</s>", "a", "b"};
+  for (std::size_t i = 0; i < sizeof(kContexts) / sizeof(const char*); ++i) {
+    const std::vector<std::string> context(Words(kContexts[i]));
+    double sum = 0.0;
+    for (std::size_t w = 0; w < sizeof(kVocab) / sizeof(const char*); ++w) {
+      sum += pow(10.0, result.Score(context, kVocab[w]));
+    }
+    BOOST_CHECK_CLOSE(1.0, sum, 0.01);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ScoreTextMatchesModel) {
+  TempFile trigram(kTrigram), text("a b\nb a b a c\n<unk> a\n\na a b\n");
+  std::vector<float> probs;
+  std::vector<bool> known;
+  ScoreText(trigram.Name(), text.Name(), probs, known);
+
+  const char *kSentences[] = {"a b", "b a b a c", "<unk> a", "", "a a b"};
+  Scorer model(trigram.Name());
+  std::size_t token = 0;
+  for (std::size_t s = 0; s < sizeof(kSentences) / sizeof(const char*); ++s) {
+    std::vector<std::string> words(Words(kSentences[s])), context(1, "<s>");
+    words.push_back("</s>");
+    for (std::vector<std::string>::const_iterator w = words.begin(); w != words.end(); ++w, ++token) {
+      BOOST_REQUIRE(token < probs.size());
+      BOOST_CHECK_CLOSE(model.Score(context, *w), probs[token], 0.001);
+      BOOST_CHECK_EQUAL(*w == "</s>" || (*w != "c" && *w != "<unk>"), known[token]);
+      context.push_back(*w);
+    }
+  }
+  BOOST_CHECK_EQUAL(token, probs.size());
+}
+
+// Log10 probability of the text under the mixture.
+double MixedLogProb(const std::vector<std::string> &models, const std::string &text, const std::vector<float> &weights) {
+  std::vector<std::vector<float> > probs(models.size());
+  std::vector<bool> known;
+  for (std::size_t m = 0; m < models.size(); ++m) {
+    ScoreText(models[m], text, probs[m], known);
+  }
+  double total = 0.0;
+  for (std::size_t t = 0; t < probs[0].size(); ++t) {
+    double mixed = 0.0;
+    for (std::size_t m = 0; m < models.size(); ++m) {
+      mixed += weights[m] * pow(10.0, probs[m][t]);
+    }
+    total += log10(mixed);
+  }
+  return total;
+}
+
+BOOST_AUTO_TEST_CASE(TuneLowersPerplexity) {
+  TempFile bigram(kBigram), trigram(kTrigram), text("a b\na b\nb a\n");
+  std::vector<std::string> models;
+  models.push_back(bigram.Name());
+  models.push_back(trigram.Name());
+  const std::vector<float> initial(2, 0.5);
+  std::vector<float> weights(initial);
+  TuneWeights(models, text.Name(), weights);
+  BOOST_REQUIRE_EQUAL(2, weights.size());
+  BOOST_CHECK_CLOSE(1.0, weights[0] + weights[1], 0.01);
+  BOOST_CHECK(MixedLogProb(models, text.Name(), weights) > MixedLogProb(models, text.Name(), initial));
+}
+
+}}} // namespaces
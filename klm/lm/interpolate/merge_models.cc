@@ -0,0 +1,67 @@
+#include "lm/interpolate/merge_models.hh"
+
+#include "lm/builder/sort.hh"
+#include "lm/interpolate/mixed_gram.hh"
+#include "lm/lm_exception.hh"
+#include "util/stream/multi_stream.hh"
+#include "util/stream/stream.hh"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+
+namespace lm { namespace interpolate {
+
+void MergeModels::Run(const util::stream::ChainPositions &positions) {
+  assert(positions.size() == (order_ == 1 ? 2 : 3));
+  util::stream::Stream in(positions[0]);
+  util::stream::Stream out(positions[positions.size() - 1]);
+  const std::size_t entry_size = MixedGram::TotalSize(order_, models_);
+  const std::size_t words_size = order_ * sizeof(WordIndex);
+
+  // Backoffs of the current context from each model.
+  util::stream::Stream backoffs;
+  if (order_ > 1) backoffs.Init(positions[1]);
+  const std::size_t context_size = (order_ - 1) * sizeof(WordIndex);
+  const builder::SuffixOrder context_order(order_ - 1);
+  std::vector<float> context(models_, 0.0f);
+  std::vector<WordIndex> current_context(order_ - 1);
+  bool have_context = false;
+
+  for (; in; ++out) {
+    memcpy(out.Get(), in.Get(), entry_size);
+    MixedGram merged(out.Get(), order_, models_);
+    // Same n-gram from the other models.
+    for (++in; in && !memcmp(in.Get(), out.Get(), words_size); ++in) {
+      const MixedGram other(in.Get(), order_, models_);
+      for (std::size_t m = 0; m < models_; ++m) {
+        if (other.Probs()[m] == kAbsent) continue;
+        UTIL_THROW_IF(merged.Probs()[m] != kAbsent, FormatLoadException, "Duplicate " << order_ << "-gram in model " << (m + 1));
+        merged.Probs()[m] = other.Probs()[m];
+      }
+    }
+
+    if (order_ == 1) continue;
+    // Contexts arrive in SuffixOrder, the order of the backoffs.
+    if (!have_context || memcmp(&current_context[0], merged.begin(), context_size)) {
+      std::copy(merged.begin(), merged.end() - 1, current_context.begin());
+      have_context = true;
+      std::fill(context.begin(), context.end(), 0.0f);
+      while (backoffs && context_order(backoffs.Get(), merged.begin())) ++backoffs;
+      for (; backoffs && !memcmp(backoffs.Get(), merged.begin(), context_size); ++backoffs) {
+        const ModelBackoff backoff(backoffs.Get(), order_ - 1);
+        context[backoff.Model()] = backoff.Backoff();
+      }
+    }
+    std::copy(context.begin(), context.end(), merged.ContextBackoffs());
+  }
+  out.Poison();
+  // Backoffs of n-grams that are not a context.
+  if (order_ > 1) {
+    for (; backoffs; ++backoffs) {}
+  }
+}
+
+}} // namespaces
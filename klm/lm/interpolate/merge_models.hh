@@ -0,0 +1,27 @@
+#ifndef LM_INTERPOLATE_MERGE_MODELS_H
+#define LM_INTERPOLATE_MERGE_MODELS_H
+
+#include <cstddef>
+
+namespace util { namespace stream { class ChainPositions; } }
+
+namespace lm { namespace interpolate {
+
+// Joins the records of the same n-gram from different models into one
+// MixedGram and looks up the models' backoffs of its context.
+class MergeModels {
+  public:
+    MergeModels(std::size_t order, std::size_t models) : order_(order), models_(models) {}
+
+    /* positions are the MixedGram records of this order in ContextOrder, the
+     * ModelBackoff records of order - 1 in SuffixOrder (unless this is the
+     * unigram order), and the output.
+     */
+    void Run(const util::stream::ChainPositions &positions);
+
+  private:
+    std::size_t order_, models_;
+};
+
+}} // namespaces
+#endif // LM_INTERPOLATE_MERGE_MODELS_H
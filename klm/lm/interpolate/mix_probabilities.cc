@@ -0,0 +1,129 @@
+#include "lm/interpolate/mix_probabilities.hh"
+
+#include "lm/builder/ngram.hh"
+#include "lm/interpolate/mixed_gram.hh"
+#include "lm/lm_exception.hh"
+#include "util/fixed_array.hh"
+#include "util/stream/stream.hh"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+namespace lm { namespace interpolate {
+
+namespace {
+
+class Mixer {
+  public:
+    Mixer(const std::vector<float> &weights, const util::stream::ChainPositions &suffix_out, const util::stream::ChainPositions &context_out, std::vector<uint64_t> &counts)
+      : weights_(weights), order_(suffix_out.size()), suffix_(order_), context_(order_ - 1),
+        model_probs_(order_ * weights.size()), mixed_(order_),
+        unknown_(weights.size(), kUnknownMissing), counts_(counts) {
+      for (std::size_t i = 0; i < order_; ++i) {
+        suffix_.push_back(suffix_out[i]);
+      }
+      for (std::size_t i = 0; i + 1 < order_; ++i) {
+        context_.push_back(context_out[i]);
+      }
+      counts_.assign(order_, 0);
+    }
+
+    // Called after the last n-gram.
+    void Finish() {
+      for (util::stream::Stream *i = suffix_.begin(); i != suffix_.end(); ++i) {
+        i->Poison();
+      }
+      for (util::stream::Stream *i = context_.begin(); i != context_.end(); ++i) {
+        i->Poison();
+      }
+    }
+
+    void Enter(unsigned int order_minus_1, const MixedGram &gram) {
+      const std::size_t models = weights_.size();
+      float *probs = &model_probs_[order_minus_1 * models];
+      const float *lower = order_minus_1 ? &model_probs_[(order_minus_1 - 1) * models] : NULL;
+      double sum = 0.0;
+      for (std::size_t m = 0; m < models; ++m) {
+        float prob = gram.Probs()[m];
+        if (prob == kAbsent) {
+          prob = order_minus_1 ? (gram.ContextBackoffs()[m] + lower[m]) : unknown_[m];
+        }
+        probs[m] = prob;
+        sum += weights_[m] * pow(10.0, static_cast<double>(prob));
+      }
+      // <unk> has the lowest id so it comes first.
+      if (!order_minus_1 && *gram.begin() == builder::kUNK) {
+        std::copy(probs, probs + models, unknown_.begin());
+      }
+      // Correcting for numerical precision issues.
+      mixed_[order_minus_1] = std::min(0.0f, static_cast<float>(log10(sum)));
+
+      util::stream::Stream &out = suffix_[order_minus_1];
+      builder::NGram written(out.Get(), order_minus_1 + 1);
+      std::copy(gram.begin(), gram.end(), written.begin());
+      written.Value().complete.prob = mixed_[order_minus_1];
+      written.Value().complete.backoff = order_minus_1 ? mixed_[order_minus_1 - 1] : 0.0;
+      if (order_minus_1) {
+        memcpy(context_[order_minus_1 - 1].Get(), out.Get(), written.TotalSize());
+        ++context_[order_minus_1 - 1];
+      }
+      ++out;
+      ++counts_[order_minus_1];
+    }
+
+  private:
+    const std::vector<float> &weights_;
+    std::size_t order_;
+    util::FixedArray<util::stream::Stream> suffix_, context_;
+    // Probability of the n-gram on the stack at each order from each model.
+    std::vector<float> model_probs_;
+    std::vector<float> mixed_;
+    std::vector<float> unknown_;
+    std::vector<uint64_t> &counts_;
+};
+
+} // namespace
+
+MixProbabilities::MixProbabilities(const std::vector<float> &weights, const util::stream::ChainPositions &suffix_out, const util::stream::ChainPositions &context_out, std::vector<uint64_t> &counts)
+  : weights_(weights), suffix_out_(suffix_out), context_out_(context_out), counts_(counts) {}
+
+void MixProbabilities::Run(const util::stream::ChainPositions &positions) {
+  const std::size_t models = weights_.size();
+  assert(positions.size() == suffix_out_.size());
+  Mixer mixer(weights_, suffix_out_, context_out_, counts_);
+  util::FixedArray<util::stream::Stream> streams(positions.size());
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    streams.push_back(positions[i]);
+  }
+
+  // Like builder::JointOrder: visit each n-gram right after its suffix.
+  unsigned int order;
+  for (order = 0; order < positions.size() && streams[order]; ++order) {}
+  UTIL_THROW_IF(!order, FormatLoadException, "The models have no unigrams");
+  unsigned int current = 0;
+  while (true) {
+    // Does the suffix match the n-gram of the lower order?
+    if (!current || !memcmp(streams[current - 1].Get(), static_cast<const WordIndex*>(streams[current].Get()) + 1, sizeof(WordIndex) * current)) {
+      mixer.Enter(current, MixedGram(streams[current].Get(), current + 1, models));
+      // Transition to looking for extensions.
+      if (++current < order) continue;
+    }
+    // No extension left.
+    while (true) {
+      assert(current > 0);
+      --current;
+      if (++streams[current]) break;
+      UTIL_THROW_IF(order != current + 1, FormatLoadException, "Detected n-gram without matching suffix");
+      order = current;
+      if (!order) {
+        mixer.Finish();
+        return;
+      }
+    }
+  }
+}
+
+}} // namespaces
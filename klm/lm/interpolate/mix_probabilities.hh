@@ -0,0 +1,40 @@
+#ifndef LM_INTERPOLATE_MIX_PROBABILITIES_H
+#define LM_INTERPOLATE_MIX_PROBABILITIES_H
+
+#include "util/stream/multi_stream.hh"
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace lm { namespace interpolate {
+
+/* Linearly interpolates the probabilities of the models.  A model that does
+ * not contain an n-gram gives it the backoff probability: the backoff of the
+ * context times the probability of the suffix (or the probability of <unk>
+ * for unigrams).  The n-grams of all orders are read jointly in SuffixOrder so
+ * that the suffix was just computed.
+ *
+ * Writes builder::NGram records with the interpolated log10 probability and,
+ * in the backoff field, the interpolated log10 probability of the suffix.
+ */
+class MixProbabilities {
+  public:
+    /* suffix_out gets the n-grams of each order in SuffixOrder and
+     * context_out another copy of the n-grams of orders 2 and up (to be
+     * sorted in ContextOrder).  counts receives the number of n-grams of each
+     * order in the union of the models.
+     */
+    MixProbabilities(const std::vector<float> &weights, const util::stream::ChainPositions &suffix_out, const util::stream::ChainPositions &context_out, std::vector<uint64_t> &counts);
+
+    // positions are the MixedGram records of each order in SuffixOrder.
+    void Run(const util::stream::ChainPositions &positions);
+
+  private:
+    std::vector<float> weights_;
+    util::stream::ChainPositions suffix_out_, context_out_;
+    std::vector<uint64_t> &counts_;
+};
+
+}} // namespaces
+#endif // LM_INTERPOLATE_MIX_PROBABILITIES_H
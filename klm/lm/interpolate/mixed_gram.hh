@@ -0,0 +1,90 @@
+#ifndef LM_INTERPOLATE_MIXED_GRAM_H
+#define LM_INTERPOLATE_MIXED_GRAM_H
+
+#include "lm/word_index.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+#include <stdint.h>
+
+namespace lm { namespace interpolate {
+
+// Probability slot of a model that does not contain the n-gram.
+const float kAbsent = std::numeric_limits<float>::infinity();
+
+// What the query data structures assume for a model without <unk>.
+const float kUnknownMissing = -100.0;
+
+/* An n-gram of the union of the models, laid out as
+ *   WordIndex words[order];
+ *   float prob[models];            // log10 p from each model or kAbsent
+ *   float context_backoff[models]; // log10 backoff of words[0, order - 1)
+ * The context backoff is zero if the model does not contain the context.
+ */
+class MixedGram {
+  public:
+    MixedGram(void *begin, std::size_t order, std::size_t models)
+      : begin_(static_cast<WordIndex*>(begin)), order_(order), models_(models) {}
+
+    const WordIndex *begin() const { return begin_; }
+    WordIndex *begin() { return begin_; }
+    const WordIndex *end() const { return begin_ + order_; }
+    WordIndex *end() { return begin_ + order_; }
+
+    const float *Probs() const { return reinterpret_cast<const float*>(end()); }
+    float *Probs() { return reinterpret_cast<float*>(end()); }
+
+    const float *ContextBackoffs() const { return Probs() + models_; }
+    float *ContextBackoffs() { return Probs() + models_; }
+
+    // Mark all the models absent.
+    void Clear() {
+      std::fill(Probs(), Probs() + models_, kAbsent);
+      std::fill(ContextBackoffs(), ContextBackoffs() + models_, 0.0f);
+    }
+
+    std::size_t Order() const { return order_; }
+    std::size_t Models() const { return models_; }
+
+    static std::size_t TotalSize(std::size_t order, std::size_t models) {
+      return order * sizeof(WordIndex) + 2 * models * sizeof(float);
+    }
+
+  private:
+    WordIndex *begin_;
+    std::size_t order_, models_;
+};
+
+/* Backoff of an n-gram in one model, laid out as
+ *   WordIndex words[order]; uint32_t model; float backoff;
+ * These are sorted separately to look up the backoffs of contexts.
+ */
+class ModelBackoff {
+  public:
+    ModelBackoff(void *begin, std::size_t order)
+      : begin_(static_cast<WordIndex*>(begin)), order_(order) {}
+
+    const WordIndex *begin() const { return begin_; }
+    WordIndex *begin() { return begin_; }
+    const WordIndex *end() const { return begin_ + order_; }
+    WordIndex *end() { return begin_ + order_; }
+
+    uint32_t Model() const { return *reinterpret_cast<const uint32_t*>(end()); }
+    uint32_t &Model() { return *reinterpret_cast<uint32_t*>(end()); }
+
+    float Backoff() const { return *reinterpret_cast<const float*>(end() + 1); }
+    float &Backoff() { return *reinterpret_cast<float*>(end() + 1); }
+
+    static std::size_t TotalSize(std::size_t order) {
+      return order * sizeof(WordIndex) + sizeof(uint32_t) + sizeof(float);
+    }
+
+  private:
+    WordIndex *begin_;
+    std::size_t order_;
+};
+
+}} // namespaces
+#endif // LM_INTERPOLATE_MIXED_GRAM_H
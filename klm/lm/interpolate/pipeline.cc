@@ -0,0 +1,198 @@
+#include "lm/interpolate/pipeline.hh"
+
+#include "lm/builder/binary.hh"
+#include "lm/builder/ngram.hh"
+#include "lm/builder/print.hh"
+#include "lm/builder/sort.hh"
+#include "lm/interpolate/merge_models.hh"
+#include "lm/interpolate/mix_probabilities.hh"
+#include "lm/interpolate/mixed_gram.hh"
+#include "lm/interpolate/read_models.hh"
+#include "lm/interpolate/recompute_backoffs.hh"
+#include "lm/vocab.hh"
+
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/fixed_array.hh"
+#include "util/stream/io.hh"
+#include "util/stream/multi_stream.hh"
+#include "util/stream/timer.hh"
+
+#include <boost/ref.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+namespace lm { namespace interpolate {
+
+namespace {
+
+// Each of the chains running at the same time gets an equal share of memory.
+util::stream::ChainConfig ChainShare(const InterpolateConfig &config, std::size_t entry_size, std::size_t chains) {
+  return util::stream::ChainConfig(entry_size, config.block_count, std::max(config.TotalMemory() / chains, entry_size * config.block_count));
+}
+
+// Reads all the models into per-order sorts.  Returns the vocabulary size.
+WordIndex ReadAndSort(const InterpolateConfig &config, int vocab_file, std::size_t &order, builder::Sorts<builder::ContextOrder> &grams, builder::Sorts<builder::SuffixOrder> &backoffs) {
+  std::cerr << "=== 1/4 Reading and sorting n-grams ===" << std::endl;
+  ngram::GrowableVocab<ngram::WriteUniqueWords> vocab(1 << 16, vocab_file);
+  ReadModels reader(config.models, vocab);
+  order = reader.Order();
+  const std::size_t models = reader.Models();
+
+  const std::size_t chain_count = 2 * order - 1;
+  util::stream::Chains chains(chain_count);
+  for (std::size_t n = 1; n <= order; ++n) {
+    chains.push_back(ChainShare(config, MixedGram::TotalSize(n, models), chain_count));
+  }
+  for (std::size_t n = 1; n < order; ++n) {
+    chains.push_back(ChainShare(config, ModelBackoff::TotalSize(n), chain_count));
+  }
+  chains >> boost::ref(reader);
+
+  grams.Init(order);
+  for (std::size_t n = 1; n <= order; ++n) {
+    grams.push_back(chains[n - 1], config.sort, builder::ContextOrder(n));
+  }
+  backoffs.Init(order - 1);
+  for (std::size_t n = 1; n < order; ++n) {
+    backoffs.push_back(chains[order + n - 1], config.sort, builder::SuffixOrder(n));
+  }
+  chains.Wait(true);
+  return vocab.Size();
+}
+
+void Merge(const InterpolateConfig &config, std::size_t order, builder::Sorts<builder::ContextOrder> &grams, builder::Sorts<builder::SuffixOrder> &backoffs, builder::Sorts<builder::SuffixOrder> &merged) {
+  std::cerr << "=== 2/4 Merging and sorting n-grams ===" << std::endl;
+  const std::size_t models = config.models.size();
+  // Merge sort before allocating chain memory.
+  for (std::size_t i = 0; i < order; ++i) {
+    grams[i].Merge(0);
+  }
+  for (std::size_t i = 0; i + 1 < order; ++i) {
+    backoffs[i].Merge(0);
+  }
+  const std::size_t chain_count = 3 * order - 1;
+  util::FixedArray<util::stream::Chains> chains(order);
+  merged.Init(order);
+  for (std::size_t n = 1; n <= order; ++n) {
+    const std::size_t entry_size = MixedGram::TotalSize(n, models);
+    chains.push_back(static_cast<std::size_t>(n == 1 ? 2 : 3));
+    util::stream::Chains &merging = chains.back();
+    merging.push_back(ChainShare(config, entry_size, chain_count));
+    grams[n - 1].Output(merging.back(), 0);
+    if (n > 1) {
+      merging.push_back(ChainShare(config, ModelBackoff::TotalSize(n - 1), chain_count));
+      backoffs[n - 2].Output(merging.back(), 0);
+    }
+    merging.push_back(ChainShare(config, entry_size, chain_count));
+    merging >> MergeModels(n, models);
+    for (std::size_t i = 0; i + 1 < merging.size(); ++i) {
+      merging[i] >> util::stream::kRecycle;
+    }
+    merged.push_back(merging.back(), config.sort, builder::SuffixOrder(n));
+  }
+  for (util::stream::Chains *i = chains.begin(); i != chains.end(); ++i) {
+    i->Wait(true);
+  }
+}
+
+void Mix(const InterpolateConfig &config, std::size_t order, builder::Sorts<builder::SuffixOrder> &merged, std::vector<uint64_t> &counts, util::FixedArray<util::stream::FileBuffer> &files, builder::Sorts<builder::ContextOrder> &extensions) {
+  std::cerr << "=== 3/4 Interpolating probabilities ===" << std::endl;
+  const std::size_t models = config.models.size();
+  for (std::size_t i = 0; i < order; ++i) {
+    merged[i].Merge(0);
+  }
+  const std::size_t chain_count = 3 * order - 1;
+  util::stream::Chains in(order), suffix(order), context(order - 1);
+  for (std::size_t n = 1; n <= order; ++n) {
+    in.push_back(ChainShare(config, MixedGram::TotalSize(n, models), chain_count));
+    merged[n - 1].Output(in.back(), 0);
+    suffix.push_back(ChainShare(config, builder::NGram::TotalSize(n), chain_count));
+  }
+  for (std::size_t n = 2; n <= order; ++n) {
+    context.push_back(ChainShare(config, builder::NGram::TotalSize(n), chain_count));
+  }
+  in >> MixProbabilities(config.weights, util::stream::ChainPositions(suffix), util::stream::ChainPositions(context), counts) >> util::stream::kRecycle;
+
+  files.Init(order);
+  for (std::size_t i = 0; i < order; ++i) {
+    files.push_back(util::MakeTemp(config.TempPrefix()));
+    suffix[i] >> files.back().Sink();
+  }
+  extensions.Init(order - 1);
+  for (std::size_t n = 2; n <= order; ++n) {
+    extensions.push_back(context[n - 2], config.sort, builder::ContextOrder(n));
+  }
+  in.Wait(true);
+  suffix.Wait(true);
+  context.Wait(true);
+}
+
+} // namespace
+
+void Pipeline(InterpolateConfig config, int out_arpa) {
+  UTIL_THROW_IF(config.models.empty(), util::Exception, "No models to interpolate.");
+  UTIL_THROW_IF(config.models.size() != config.weights.size(), util::Exception, "There are " << config.models.size() << " models but " << config.weights.size() << " weights.");
+  if (config.sort.buffer_size * 4 > config.TotalMemory()) {
+    config.sort.buffer_size = config.TotalMemory() / 4;
+    std::cerr << "Warning: changing sort block size to " << config.sort.buffer_size << " bytes due to low total memory." << std::endl;
+  }
+
+  UTIL_TIMER("(%w s) Total wall time elapsed\n");
+
+  try {
+    util::scoped_fd vocab_file(util::MakeTemp(config.TempPrefix()));
+    std::size_t order;
+    std::vector<uint64_t> counts;
+    util::FixedArray<util::stream::FileBuffer> files;
+    builder::Sorts<builder::ContextOrder> extensions;
+    WordIndex vocab_size;
+    {
+      builder::Sorts<builder::SuffixOrder> merged;
+      {
+        builder::Sorts<builder::ContextOrder> grams;
+        builder::Sorts<builder::SuffixOrder> backoffs;
+        vocab_size = ReadAndSort(config, vocab_file.get(), order, grams, backoffs);
+        Merge(config, order, grams, backoffs, merged);
+      }
+      Mix(config, order, merged, counts, files, extensions);
+    }
+    UTIL_THROW_IF(counts[0] != vocab_size, util::Exception, "The union of the models has " << counts[0] << " unigrams but " << vocab_size << " words.  Are there words in n-grams that are not unigrams?");
+
+    std::cerr << (config.binary_file.empty() ? "=== 4/4 Recomputing backoffs and writing ARPA model ===" : "=== 4/4 Recomputing backoffs and building binary model ===") << std::endl;
+    for (std::size_t i = 0; i + 1 < order; ++i) {
+      extensions[i].Merge(0);
+    }
+    const std::size_t chain_count = 2 * order - 1;
+    util::stream::Chains chains(order), extension_chains(order - 1);
+    for (std::size_t n = 1; n <= order; ++n) {
+      chains.push_back(ChainShare(config, builder::NGram::TotalSize(n), chain_count));
+      chains.back() >> files[n - 1].Source();
+    }
+    for (std::size_t n = 2; n <= order; ++n) {
+      extension_chains.push_back(ChainShare(config, builder::NGram::TotalSize(n), chain_count));
+      extensions[n - 2].Output(extension_chains.back(), 0);
+    }
+    chains >> RecomputeBackoffs(util::stream::ChainPositions(extension_chains));
+    extension_chains >> util::stream::kRecycle;
+
+    builder::VocabReconstitute vocab(vocab_file.get());
+    if (config.binary_file.empty()) {
+      chains >> builder::PrintARPA(vocab, counts, NULL, out_arpa) >> util::stream::kRecycle;
+    } else {
+      util::scoped_fd closer(out_arpa);
+      lm::ngram::Config &binary = config.binary_config;
+      binary.write_mmap = config.binary_file.c_str();
+      if (!binary.temporary_directory_prefix) binary.temporary_directory_prefix = config.TempPrefix().c_str();
+      chains >> builder::BuildBinary(vocab, counts, config.binary_type, binary) >> util::stream::kRecycle;
+    }
+    chains.Wait(true);
+    extension_chains.Wait(true);
+  } catch (const util::Exception &e) {
+    std::cerr << e.what() << std::endl;
+    abort();
+  }
+}
+
+}} // namespaces
@@ -0,0 +1,44 @@
+#ifndef LM_INTERPOLATE_PIPELINE_H
+#define LM_INTERPOLATE_PIPELINE_H
+
+#include "lm/config.hh"
+#include "lm/model_type.hh"
+#include "util/stream/config.hh"
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+
+namespace lm { namespace interpolate {
+
+struct InterpolateConfig {
+  // ARPA files to interpolate.
+  std::vector<std::string> models;
+
+  // Weight of each model.  These should sum to one.
+  std::vector<float> weights;
+
+  util::stream::SortConfig sort;
+
+  // Number of blocks to use in each chain.
+  std::size_t block_count;
+
+  /* Build a binary model in this file instead of writing an ARPA file.  Empty
+   * to write ARPA.  The pipeline sets binary_config.write_mmap and, unless
+   * given, binary_config.temporary_directory_prefix.
+   */
+  std::string binary_file;
+  lm::ngram::ModelType binary_type;
+  lm::ngram::Config binary_config;
+
+  const std::string &TempPrefix() const { return sort.temp_prefix; }
+  std::size_t TotalMemory() const { return sort.total_memory; }
+};
+
+// Linearly interpolates the models with bounded memory by sorting on disk.
+// Takes ownership of out_arpa, which is ignored if config.binary_file is set.
+void Pipeline(InterpolateConfig config, int out_arpa);
+
+}} // namespaces
+#endif // LM_INTERPOLATE_PIPELINE_H
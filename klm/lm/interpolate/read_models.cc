@@ -0,0 +1,107 @@
+#include "lm/interpolate/read_models.hh"
+
+#include "lm/builder/ngram.hh"
+#include "lm/interpolate/mixed_gram.hh"
+#include "lm/read_arpa.hh"
+#include "lm/vocab.hh"
+#include "util/stream/multi_stream.hh"
+#include "util/stream/stream.hh"
+
+#include <algorithm>
+
+#include <assert.h>
+
+namespace lm { namespace interpolate {
+
+namespace {
+
+// Like Read1Gram but the vocabulary is shared with the other models.
+WordIndex ReadUnigram(util::FilePiece &f, ngram::GrowableVocab<ngram::WriteUniqueWords> &vocab, ProbBackoff &weights, PositiveProbWarn &warn) {
+  try {
+    weights.prob = f.ReadFloat();
+    if (weights.prob > 0.0) {
+      warn.Warn(weights.prob);
+      weights.prob = 0.0;
+    }
+    UTIL_THROW_IF(f.get() != '\t', FormatLoadException, "Expected tab after probability");
+    WordIndex word = vocab.FindOrInsert(f.ReadDelimited(kARPASpaces));
+    ReadBackoff(f, weights);
+    return word;
+  } catch(util::Exception &e) {
+    e << " in the 1-gram at byte " << f.Offset();
+    throw;
+  }
+}
+
+} // namespace
+
+ReadModels::ReadModels(const std::vector<std::string> &files, ngram::GrowableVocab<ngram::WriteUniqueWords> &vocab)
+  : files_(files.size()), counts_(files.size()), order_(0), vocab_(vocab) {
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    files_.push_back(files[i].c_str());
+    ReadARPACounts(files_.back(), counts_[i]);
+    UTIL_THROW_IF(counts_[i].empty(), FormatLoadException, "No n-grams in " << files[i]);
+    order_ = std::max(order_, counts_[i].size());
+  }
+}
+
+void ReadModels::Run(const util::stream::ChainPositions &positions) {
+  assert(positions.size() == 2 * order_ - 1);
+  util::FixedArray<util::stream::Stream> grams(order_), backoffs(order_ - 1);
+  for (std::size_t i = 0; i < order_; ++i) {
+    grams.push_back(positions[i]);
+  }
+  for (std::size_t i = 0; i + 1 < order_; ++i) {
+    backoffs.push_back(positions[order_ + i]);
+  }
+
+  PositiveProbWarn warn;
+  ProbBackoff weights;
+  for (std::size_t model = 0; model < Models(); ++model) {
+    util::FilePiece &f = files_[model];
+    const std::vector<uint64_t> &counts = counts_[model];
+    for (unsigned int n = 1; n <= counts.size(); ++n) {
+      ReadNGramHeader(f, n);
+      util::stream::Stream &out = grams[n - 1];
+      bool have_unk = false;
+      for (uint64_t i = 0; i < counts[n - 1]; ++i, ++out) {
+        MixedGram gram(out.Get(), n, Models());
+        gram.Clear();
+        if (n == 1) {
+          *gram.begin() = ReadUnigram(f, vocab_, weights, warn);
+          have_unk |= (*gram.begin() == builder::kUNK);
+        } else {
+          ReadNGram(f, n, vocab_, gram.begin(), weights, warn);
+        }
+        gram.Probs()[model] = weights.prob;
+        // Zero backoffs are the same as missing contexts.
+        if (n < order_ && weights.backoff != 0.0) {
+          ModelBackoff backoff(backoffs[n - 1].Get(), n);
+          std::copy(gram.begin(), gram.end(), backoff.begin());
+          backoff.Model() = model;
+          backoff.Backoff() = weights.backoff;
+          ++backoffs[n - 1];
+        }
+      }
+      // Models without <unk> give it the usual probability so that every
+      // word of the union is a unigram.
+      if (n == 1 && !have_unk) {
+        MixedGram gram(out.Get(), 1, Models());
+        gram.Clear();
+        *gram.begin() = builder::kUNK;
+        gram.Probs()[model] = kUnknownMissing;
+        ++out;
+      }
+    }
+    ReadEnd(f);
+  }
+
+  for (util::stream::Stream *i = grams.begin(); i != grams.end(); ++i) {
+    i->Poison();
+  }
+  for (util::stream::Stream *i = backoffs.begin(); i != backoffs.end(); ++i) {
+    i->Poison();
+  }
+}
+
+}} // namespaces
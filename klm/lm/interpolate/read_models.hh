@@ -0,0 +1,55 @@
+#ifndef LM_INTERPOLATE_READ_MODELS_H
+#define LM_INTERPOLATE_READ_MODELS_H
+
+#include "util/file_piece.hh"
+#include "util/fixed_array.hh"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace util { namespace stream { class ChainPositions; } }
+
+namespace lm {
+
+namespace ngram {
+template <class T> class GrowableVocab;
+class WriteUniqueWords;
+} // namespace ngram
+
+namespace interpolate {
+
+// Streams the n-grams of several ARPA files, one model after another, as
+// MixedGram records with only the reading model's probability set.
+class ReadModels {
+  public:
+    // Opens the files and reads their counts.  Words get the same ids in all
+    // the models.
+    ReadModels(const std::vector<std::string> &files, ngram::GrowableVocab<ngram::WriteUniqueWords> &vocab);
+
+    std::size_t Models() const { return counts_.size(); }
+
+    // Highest order of any of the models.
+    std::size_t Order() const { return order_; }
+
+    const std::vector<uint64_t> &Counts(std::size_t model) const { return counts_[model]; }
+
+    /* positions has Order() chains of MixedGram records for orders 1 through
+     * Order() followed by Order() - 1 chains of ModelBackoff records.  Only
+     * non-zero backoffs are written.
+     */
+    void Run(const util::stream::ChainPositions &positions);
+
+  private:
+    util::FixedArray<util::FilePiece> files_;
+
+    std::vector<std::vector<uint64_t> > counts_;
+
+    std::size_t order_;
+
+    ngram::GrowableVocab<ngram::WriteUniqueWords> &vocab_;
+};
+
+}} // namespaces
+#endif // LM_INTERPOLATE_READ_MODELS_H
@@ -0,0 +1,53 @@
+#include "lm/interpolate/recompute_backoffs.hh"
+
+#include "lm/builder/ngram_stream.hh"
+#include "lm/builder/sort.hh"
+#include "util/stream/timer.hh"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+namespace lm { namespace interpolate {
+
+namespace {
+
+// left and lower_left are the probability mass the context and its suffix
+// leave for the words that do not extend the context.
+float Backoff(double left, double lower_left) {
+  // Rounding can leave no mass, in which case backing off hardly matters.
+  if (left <= 0.0 || lower_left <= 0.0) return 0.0;
+  return log10(left / lower_left);
+}
+
+} // namespace
+
+void RecomputeBackoffs::Run(const util::stream::ChainPositions &positions) {
+  UTIL_TIMER("(%w s) Recomputed backoffs\n");
+  assert(positions.size() == extensions_.size() + 1);
+  for (std::size_t i = 0; i < extensions_.size(); ++i) {
+    const std::size_t context_size = (i + 1) * sizeof(WordIndex);
+    const builder::SuffixOrder context_order(i + 1);
+    builder::NGramStream extension(extensions_[i]);
+    for (builder::NGramStream context(positions[i]); context; ++context) {
+      // Skip extensions of contexts that are not n-grams.
+      while (extension && context_order(extension->begin(), context->begin())) ++extension;
+      double left = 1.0, lower_left = 1.0;
+      bool extended = false;
+      for (; extension && !memcmp(extension->begin(), context->begin(), context_size); ++extension) {
+        // MixProbabilities put the probability of the suffix in the backoff.
+        left -= pow(10.0, static_cast<double>(extension->Value().complete.prob));
+        lower_left -= pow(10.0, static_cast<double>(extension->Value().complete.backoff));
+        extended = true;
+      }
+      context->Value().complete.backoff = extended ? Backoff(left, lower_left) : 0.0;
+    }
+    for (; extension; ++extension) {}
+  }
+  // The highest order has no backoffs.
+  for (builder::NGramStream top(positions.back()); top; ++top) {
+    top->Value().complete.backoff = 0.0;
+  }
+}
+
+}} // namespaces
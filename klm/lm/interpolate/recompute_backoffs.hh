@@ -0,0 +1,29 @@
+#ifndef LM_INTERPOLATE_RECOMPUTE_BACKOFFS_H
+#define LM_INTERPOLATE_RECOMPUTE_BACKOFFS_H
+
+#include "util/stream/multi_stream.hh"
+
+namespace lm { namespace interpolate {
+
+/* Sets the backoff of each context so that its probabilities sum to one:
+ *   backoff(h) = (1 - sum_w p(w | h)) / (1 - sum_w p(w | h'))
+ * where w ranges over the words that extend h and h' is h without its first
+ * word.  The interpolated model is not normalized otherwise.
+ *
+ * Like PrintARPA, reads all unigrams before all bigrams etc.
+ */
+class RecomputeBackoffs {
+  public:
+    // extensions are the n-grams of orders 2 and up in ContextOrder.
+    explicit RecomputeBackoffs(const util::stream::ChainPositions &extensions) : extensions_(extensions) {}
+
+    // positions are the n-grams of each order in SuffixOrder as written by
+    // MixProbabilities.  Their backoffs are replaced.
+    void Run(const util::stream::ChainPositions &positions);
+
+  private:
+    util::stream::ChainPositions extensions_;
+};
+
+}} // namespaces
+#endif // LM_INTERPOLATE_RECOMPUTE_BACKOFFS_H
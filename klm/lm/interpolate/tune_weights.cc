@@ -0,0 +1,265 @@
+#include "lm/interpolate/tune_weights.hh"
+
+#include "lm/interpolate/mixed_gram.hh"
+#include "lm/lm_exception.hh"
+#include "lm/read_arpa.hh"
+#include "lm/weights.hh"
+#include "util/file_piece.hh"
+#include "util/murmur_hash.hh"
+#include "util/tokenize_piece.hh"
+
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+#include <math.h>
+
+namespace lm { namespace interpolate {
+
+namespace {
+
+const unsigned int kMaxIterations = 100;
+// Stop when the perplexity improves by less than this fraction.
+const double kConvergence = 1e-5;
+
+// Word ids of the development text.  <unk> is 0, then <s> and </s>.
+const WordIndex kDevUnk = 0, kDevBOS = 1, kDevEOS = 2;
+
+// The development text as word ids with <s> and </s> around each sentence.
+class DevText {
+  public:
+    explicit DevText(const std::string &file) {
+      Find("<unk>");
+      Find("<s>");
+      Find("</s>");
+      util::FilePiece text(file.c_str());
+      StringPiece line;
+      while (text.ReadLineOrEOF(line)) {
+        sentences_.resize(sentences_.size() + 1);
+        std::vector<WordIndex> &sentence = sentences_.back();
+        sentence.push_back(kDevBOS);
+        for (util::TokenIter<util::BoolCharacter, true> word(line, util::BoolCharacter(util::kSpaces)); word; ++word) {
+          sentence.push_back(Find(*word));
+        }
+        sentence.push_back(kDevEOS);
+      }
+    }
+
+    const std::vector<std::vector<WordIndex> > &Sentences() const { return sentences_; }
+
+    WordIndex Size() const { return static_cast<WordIndex>(words_.size()); }
+
+    // Id of word or Size() if the text does not have it.
+    WordIndex Index(const StringPiece &word) const {
+      boost::unordered_map<std::string, WordIndex>::const_iterator i = words_.find(std::string(word.data(), word.size()));
+      return i == words_.end() ? Size() : i->second;
+    }
+
+  private:
+    WordIndex Find(const StringPiece &word) {
+      return words_.insert(std::make_pair(std::string(word.data(), word.size()), Size())).first->second;
+    }
+
+    boost::unordered_map<std::string, WordIndex> words_;
+    std::vector<std::vector<WordIndex> > sentences_;
+};
+
+uint64_t HashGram(const WordIndex *begin, const WordIndex *end) {
+  return util::MurmurHashNative(begin, (end - begin) * sizeof(WordIndex));
+}
+
+/* The probabilities and backoffs of one model restricted to the n-grams that
+ * occur in the development text.  The ARPA file is streamed once and only
+ * matching n-grams are kept, so memory scales with the text, not the model.
+ */
+class DevModel {
+  public:
+    DevModel(const std::string &file, const DevText &text) : unigrams_(text.Size()), known_(text.Size(), false) {
+      util::FilePiece f(file.c_str());
+      std::vector<uint64_t> counts;
+      ReadARPACounts(f, counts);
+      UTIL_THROW_IF(counts.empty(), FormatLoadException, "No n-grams in " << file);
+      order_ = counts.size();
+      PositiveProbWarn warn;
+      ProbBackoff weights;
+
+      WordIndex index;
+      ReadNGramHeader(f, 1);
+      for (uint64_t i = 0; i < counts[0]; ++i) {
+        if (!ReadNGram(f, 1, text, &index, weights, warn)) continue;
+        unigrams_[index] = weights;
+        known_[index] = true;
+      }
+      // Same default as ReadModels.
+      if (!known_[kDevUnk]) {
+        unigrams_[kDevUnk].prob = kUnknownMissing;
+        unigrams_[kDevUnk].backoff = 0.0;
+      }
+
+      // Contexts and n-grams of the text as this model sees them.
+      const ProbBackoff missing = {0.0, 0.0};
+      sentences_ = text.Sentences();
+      for (std::vector<std::vector<WordIndex> >::iterator s = sentences_.begin(); s != sentences_.end(); ++s) {
+        for (std::vector<WordIndex>::iterator w = s->begin(); w != s->end(); ++w) {
+          if (!known_[*w]) *w = kDevUnk;
+        }
+        for (std::size_t end = 2; end <= s->size(); ++end) {
+          for (std::size_t begin = (end > order_ ? end - order_ : 0); begin + 2 <= end; ++begin) {
+            grams_.insert(std::make_pair(HashGram(&(*s)[begin], &(*s)[0] + end), std::make_pair(false, missing)));
+          }
+        }
+      }
+
+      std::vector<WordIndex> ids(order_);
+      for (unsigned int n = 2; n <= order_; ++n) {
+        ReadNGramHeader(f, n);
+        for (uint64_t i = 0; i < counts[n - 1]; ++i) {
+          if (!ReadNGram(f, n, text, &ids[0], weights, warn)) continue;
+          Table::iterator found = grams_.find(HashGram(&ids[0], &ids[0] + n));
+          if (found != grams_.end()) found->second = std::make_pair(true, weights);
+        }
+      }
+      ReadEnd(f);
+    }
+
+    /* Appends the log10 probability of each word and </s> in the text.  known
+     * records whether the model has the word in its vocabulary.  This matches
+     * the FullScore of a KenLM model built from the same ARPA file.
+     */
+    void Score(std::vector<float> &probs, std::vector<bool> &known) const {
+      for (std::vector<std::vector<WordIndex> >::const_iterator s = sentences_.begin(); s != sentences_.end(); ++s) {
+        const std::vector<WordIndex> &sentence = *s;
+        for (std::size_t i = 1; i < sentence.size(); ++i) {
+          const std::size_t earliest = i + 1 > order_ ? i + 1 - order_ : 0;
+          // Find the longest n-gram ending at i.  Unigrams always match.
+          std::size_t begin = earliest;
+          float prob = 0.0;
+          for (; begin < i; ++begin) {
+            const ProbBackoff *found = Find(&sentence[begin], &sentence[i] + 1);
+            if (found) {
+              prob = found->prob;
+              break;
+            }
+          }
+          if (begin == i) prob = unigrams_[sentence[i]].prob;
+          // Charge the backoffs of the longer contexts.
+          for (std::size_t context = earliest; context < begin; ++context) {
+            const ProbBackoff *found = (context + 1 == i) ? &unigrams_[sentence[context]] : Find(&sentence[context], &sentence[i]);
+            if (found) prob += found->backoff;
+          }
+          probs.push_back(prob);
+          known.push_back(sentence[i] != kDevUnk || i + 1 == sentence.size());
+        }
+      }
+    }
+
+  private:
+    typedef boost::unordered_map<uint64_t, std::pair<bool, ProbBackoff> > Table;
+
+    /* Like lm::ReadNGram but with the vocabulary of the text.  Returns false
+     * if the text does not have one of the words.
+     */
+    static bool ReadNGram(util::FilePiece &f, unsigned int n, const DevText &text, WordIndex *ids, ProbBackoff &weights, PositiveProbWarn &warn) {
+      try {
+        weights.prob = f.ReadFloat();
+        if (weights.prob > 0.0) {
+          warn.Warn(weights.prob);
+          weights.prob = 0.0;
+        }
+        UTIL_THROW_IF(f.get() != '\t', FormatLoadException, "Expected tab after probability");
+        bool in_text = true;
+        for (unsigned int i = 0; i < n; ++i) {
+          StringPiece word(f.ReadDelimited(kARPASpaces));
+          if (word == StringPiece("<unk>", 5) || word == StringPiece("<UNK>", 5)) {
+            ids[i] = kDevUnk;
+          } else {
+            ids[i] = text.Index(word);
+            in_text &= (ids[i] != text.Size());
+          }
+        }
+        ReadBackoff(f, weights);
+        return in_text;
+      } catch(util::Exception &e) {
+        e << " in the " << n << "-gram at byte " << f.Offset();
+        throw;
+      }
+    }
+
+    const ProbBackoff *Find(const WordIndex *begin, const WordIndex *end) const {
+      Table::const_iterator found = grams_.find(HashGram(begin, end));
+      return (found != grams_.end() && found->second.first) ? &found->second.second : NULL;
+    }
+
+    std::size_t order_;
+    std::vector<ProbBackoff> unigrams_;
+    std::vector<bool> known_;
+    std::vector<std::vector<WordIndex> > sentences_;
+    Table grams_;
+};
+
+} // namespace
+
+void ScoreText(const std::string &model_file, const std::string &text_file, std::vector<float> &probs, std::vector<bool> &known) {
+  DevText text(text_file);
+  DevModel(model_file, text).Score(probs, known);
+}
+
+void TuneWeights(const std::vector<std::string> &models, const std::string &dev_file, std::vector<float> &weights) {
+  const std::size_t count = models.size();
+  // Linear probabilities of the tokens, token-major.
+  std::vector<double> probs;
+  std::vector<bool> known;
+  DevText text(dev_file);
+  for (std::size_t m = 0; m < count; ++m) {
+    std::cerr << "Scoring " << dev_file << " with " << models[m] << std::endl;
+    std::vector<float> model_probs;
+    std::vector<bool> model_known;
+    DevModel(models[m], text).Score(model_probs, model_known);
+    if (!m) {
+      probs.resize(model_probs.size() * count);
+      known.resize(model_probs.size());
+    }
+    UTIL_THROW_IF(model_probs.size() * count != probs.size(), util::Exception, "Different token counts for " << models[m]);
+    for (std::size_t t = 0; t < model_probs.size(); ++t) {
+      probs[t * count + m] = pow(10.0, static_cast<double>(model_probs[t]));
+      known[t] = known[t] || model_known[t];
+    }
+  }
+
+  std::vector<double> current(weights.begin(), weights.end()), next(count);
+  double previous_perplexity = 0.0;
+  for (unsigned int iteration = 1; iteration <= kMaxIterations; ++iteration) {
+    std::fill(next.begin(), next.end(), 0.0);
+    double log_total = 0.0;
+    uint64_t tokens = 0;
+    for (std::size_t t = 0; t < known.size(); ++t) {
+      if (!known[t]) continue;
+      const double *token = &probs[t * count];
+      double mixed = 0.0;
+      for (std::size_t m = 0; m < count; ++m) {
+        mixed += current[m] * token[m];
+      }
+      for (std::size_t m = 0; m < count; ++m) {
+        next[m] += current[m] * token[m] / mixed;
+      }
+      log_total += log10(mixed);
+      ++tokens;
+    }
+    UTIL_THROW_IF(!tokens, util::Exception, "No known words in " << dev_file);
+    double perplexity = pow(10.0, -log_total / static_cast<double>(tokens));
+    std::cerr << "Iteration " << iteration << " perplexity " << perplexity << " weights";
+    for (std::size_t m = 0; m < count; ++m) {
+      std::cerr << ' ' << current[m];
+    }
+    std::cerr << std::endl;
+    if (iteration > 1 && previous_perplexity - perplexity < kConvergence * perplexity) break;
+    previous_perplexity = perplexity;
+    for (std::size_t m = 0; m < count; ++m) {
+      current[m] = next[m] / static_cast<double>(tokens);
+    }
+  }
+  weights.assign(current.begin(), current.end());
+}
+
+}} // namespaces
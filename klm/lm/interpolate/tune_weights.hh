@@ -0,0 +1,25 @@
+#ifndef LM_INTERPOLATE_TUNE_WEIGHTS_H
+#define LM_INTERPOLATE_TUNE_WEIGHTS_H
+
+#include <string>
+#include <vector>
+
+namespace lm { namespace interpolate {
+
+/* Appends the log10 probability that the ARPA model in model_file gives each
+ * word and </s> of text_file, as FullScore of a KenLM model would.  known
+ * records whether the model has the word in its vocabulary.  The ARPA file is
+ * streamed once keeping only the n-grams of the text, so memory scales with
+ * the text rather than the model.
+ */
+void ScoreText(const std::string &model_file, const std::string &text_file, std::vector<float> &probs, std::vector<bool> &known);
+
+/* Tunes the linear interpolation weights to minimize the perplexity of the
+ * text in dev_file with expectation maximization.  Each model scores the text
+ * with ScoreText.  Words that none of the models know are skipped.  weights
+ * has the initial weights and receives the tuned ones.
+ */
+void TuneWeights(const std::vector<std::string> &models, const std::string &dev_file, std::vector<float> &weights);
+
+}} // namespaces
+#endif // LM_INTERPOLATE_TUNE_WEIGHTS_H
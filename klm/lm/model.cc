@@ -4,6 +4,7 @@
 #include "lm/lm_exception.hh"
 #include "lm/search_hashed.hh"
 #include "lm/search_trie.hh"
+#include "lm/ngram_source.hh"
 #include "lm/read_arpa.hh"
 #include "util/have.hh"
 #include "util/murmur_hash.hh"
@@ -75,7 +76,15 @@ template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::Ge
     ComplainAboutARPA(init_config, kModelType);
     InitializeFromARPA(fd.release(), file, init_config);
   }
+  InitializeStates();
+}
+
+template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::GenericModel(NGramSource &source, const Config &init_config) : backing_(init_config) {
+  InitializeFromSource(source, "", init_config);
+  InitializeStates();
+}
 
+template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT>::InitializeStates() {
   // g++ prints warnings unless these are fully initialized.
   State begin_sentence = State();
   begin_sentence.length = 1;
@@ -93,44 +102,48 @@ template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT
   // Backing file is the ARPA.
   util::FilePiece f(fd, file, config.ProgressMessages());
   try {
-    std::vector<uint64_t> counts;
-    // File counts do not include pruned trigrams that extend to quadgrams etc.   These will be fixed by search_.
-    ReadARPACounts(f, counts);
-    CheckCounts(counts);
-    if (counts.size() < 2) UTIL_THROW(FormatLoadException, "This ngram implementation assumes at least a bigram model.");
-    if (config.probing_multiplier <= 1.0) UTIL_THROW(ConfigException, "probing multiplier must be > 1.0");
-
-    std::size_t vocab_size = util::CheckOverflow(VocabularyT::Size(counts[0], config));
-    // Setup the binary file for writing the vocab lookup table.  The search_ is responsible for growing the binary file to its needs.
-    vocab_.SetupMemory(backing_.SetupJustVocab(vocab_size, counts.size()), vocab_size, counts[0], config);
-
-    if (config.write_mmap && config.include_vocab) {
-      WriteWordsWrapper wrap(config.enumerate_vocab);
-      vocab_.ConfigureEnumerate(&wrap, counts[0]);
-      search_.InitializeFromARPA(file, f, counts, config, vocab_, backing_);
-      void *vocab_rebase, *search_rebase;
-      backing_.WriteVocabWords(wrap.Buffer(), vocab_rebase, search_rebase);
-      // Due to writing at the end of file, mmap may have relocated data.  So remap.
-      vocab_.Relocate(vocab_rebase);
-      search_.SetupMemory(reinterpret_cast<uint8_t*>(search_rebase), counts, config);
-    } else {
-      vocab_.ConfigureEnumerate(config.enumerate_vocab, counts[0]);
-      search_.InitializeFromARPA(file, f, counts, config, vocab_, backing_);
-    }
-
-    if (!vocab_.SawUnk()) {
-      assert(config.unknown_missing != THROW_UP);
-      // Default probabilities for unknown.
-      search_.UnknownUnigram().backoff = 0.0;
-      search_.UnknownUnigram().prob = config.unknown_missing_logprob;
-    }
-    backing_.FinishFile(config, kModelType, kVersion, counts);
+    InitializeFromSource(f, file, config);
   } catch (util::Exception &e) {
     e << " Byte: " << f.Offset();
     throw;
   }
 }
 
+template <class Search, class VocabularyT> template <class Source> void GenericModel<Search, VocabularyT>::InitializeFromSource(Source &f, const char *file, const Config &config) {
+  std::vector<uint64_t> counts;
+  // File counts do not include pruned trigrams that extend to quadgrams etc.   These will be fixed by search_.
+  ReadARPACounts(f, counts);
+  CheckCounts(counts);
+  if (counts.size() < 2) UTIL_THROW(FormatLoadException, "This ngram implementation assumes at least a bigram model.");
+  if (config.probing_multiplier <= 1.0) UTIL_THROW(ConfigException, "probing multiplier must be > 1.0");
+
+  std::size_t vocab_size = util::CheckOverflow(VocabularyT::Size(counts[0], config));
+  // Setup the binary file for writing the vocab lookup table.  The search_ is responsible for growing the binary file to its needs.
+  vocab_.SetupMemory(backing_.SetupJustVocab(vocab_size, counts.size()), vocab_size, counts[0], config);
+
+  if (config.write_mmap && config.include_vocab) {
+    WriteWordsWrapper wrap(config.enumerate_vocab);
+    vocab_.ConfigureEnumerate(&wrap, counts[0]);
+    search_.InitializeFromARPA(file, f, counts, config, vocab_, backing_);
+    void *vocab_rebase, *search_rebase;
+    backing_.WriteVocabWords(wrap.Buffer(), vocab_rebase, search_rebase);
+    // Due to writing at the end of file, mmap may have relocated data.  So remap.
+    vocab_.Relocate(vocab_rebase);
+    search_.SetupMemory(reinterpret_cast<uint8_t*>(search_rebase), counts, config);
+  } else {
+    vocab_.ConfigureEnumerate(config.enumerate_vocab, counts[0]);
+    search_.InitializeFromARPA(file, f, counts, config, vocab_, backing_);
+  }
+
+  if (!vocab_.SawUnk()) {
+    assert(config.unknown_missing != THROW_UP);
+    // Default probabilities for unknown.
+    search_.UnknownUnigram().backoff = 0.0;
+    search_.UnknownUnigram().prob = config.unknown_missing_logprob;
+  }
+  backing_.FinishFile(config, kModelType, kVersion, counts);
+}
+
 template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search, VocabularyT>::FullScore(const State &in_state, const WordIndex new_word, State &out_state) const {
   FullScoreReturn ret = ScoreExceptBackoff(in_state.words, in_state.words + in_state.length, new_word, out_state);
   for (const float *i = in_state.backoff + ret.ngram_length - 1; i < in_state.backoff + in_state.length; ++i) {
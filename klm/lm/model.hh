@@ -23,6 +23,7 @@
 namespace util { class FilePiece; }
 
 namespace lm {
+class NGramSource;
 namespace ngram {
 namespace detail {
 
@@ -51,6 +52,12 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
      */
     explicit GenericModel(const char *file, const Config &config = Config());
 
+    /* Build the model from n-grams that do not come from a file, e.g. while
+     * estimating it.  Set config.write_mmap to write a binary file.  Building
+     * a trie uses config.temporary_directory_prefix for its temporary files.
+     */
+    GenericModel(NGramSource &source, const Config &config);
+
     /* Score p(new_word | in_state) and incorporate new_word into out_state.
      * Note that in_state and out_state must be different references:
      * &in_state != &out_state.  
@@ -114,6 +121,12 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
 
     void InitializeFromARPA(int fd, const char *file, const Config &config);
 
+    // Source is util::FilePiece or NGramSource.
+    template <class Source> void InitializeFromSource(Source &f, const char *file, const Config &config);
+
+    // Prepare the begin sentence and null context states once the model is loaded.
+    void InitializeStates();
+
     float InternalUnRest(const uint64_t *pointers_begin, const uint64_t *pointers_end, unsigned char first_length) const;
 
     BinaryFormat backing_;
@@ -132,6 +145,7 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
 class name : public from {\
   public:\
     name(const char *file, const Config &config = Config()) : from(file, config) {}\
+    name(NGramSource &source, const Config &config) : from(source, config) {}\
 };
 
 LM_NAME_MODEL(ProbingModel, detail::GenericModel<detail::HashedSearch<BackoffValue> LM_COMMA() ProbingVocabulary>);
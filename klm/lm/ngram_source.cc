@@ -0,0 +1,25 @@
+#include "lm/ngram_source.hh"
+
+#include "lm/blank.hh"
+
+#include <cmath>
+
+#ifdef WIN32
+#include <float.h>
+#endif
+
+namespace lm {
+
+void SetBackoff(float value, float &backoff) {
+  // Always make zero negative, as ReadBackoff does.
+  backoff = (value == ngram::kExtensionBackoff) ? ngram::kNoExtensionBackoff : value;
+#ifdef WIN32
+  int float_class = _fpclass(backoff);
+  UTIL_THROW_IF(float_class == _FPCLASS_SNAN || float_class == _FPCLASS_QNAN || float_class == _FPCLASS_NINF || float_class == _FPCLASS_PINF, FormatLoadException, "Bad backoff " << backoff);
+#else
+  int float_class = std::fpclassify(backoff);
+  UTIL_THROW_IF(float_class == FP_NAN || float_class == FP_INFINITE, FormatLoadException, "Bad backoff " << backoff);
+#endif
+}
+
+} // namespace lm
@@ -0,0 +1,112 @@
+#ifndef LM_NGRAM_SOURCE_H
+#define LM_NGRAM_SOURCE_H
+
+#include "lm/lm_exception.hh"
+#include "lm/max_order.hh"
+#include "lm/read_arpa.hh"
+#include "lm/weights.hh"
+#include "lm/word_index.hh"
+#include "util/string_piece.hh"
+
+#include <cstddef>
+#include <vector>
+
+#include <stdint.h>
+
+namespace lm {
+
+/* Supplies the n-grams of a model without going through an ARPA file, e.g.
+ * from the estimation pipeline in lm/builder.  The data structures read an
+ * NGramSource with the same functions (and in the same order) as an ARPA file:
+ * the counts, then all unigrams, all bigrams, etc.  Words are given as the
+ * source's own ids, which the unigrams define.
+ */
+class NGramSource {
+  public:
+    virtual ~NGramSource() {}
+
+    // Number of n-grams of each order, like the \data\ section of an ARPA file.
+    virtual void ReadCounts(std::vector<uint64_t> &counts) = 0;
+
+    // Called before reading the n-grams of each order.
+    virtual void BeginOrder(unsigned int order) = 0;
+
+    // Reads the next n-gram of the current order.  backoff is ignored for the
+    // highest order.
+    virtual void ReadNGram(WordIndex *words, float &prob, float &backoff) = 0;
+
+    virtual StringPiece Word(WordIndex word) const = 0;
+
+    // Maps the source's ids to the model's vocabulary.  Filled by Read1Grams.
+    std::vector<WordIndex> &VocabMap() { return vocab_map_; }
+    const std::vector<WordIndex> &VocabMap() const { return vocab_map_; }
+
+  private:
+    std::vector<WordIndex> vocab_map_;
+};
+
+inline void ReadARPACounts(NGramSource &in, std::vector<uint64_t> &number) {
+  in.ReadCounts(number);
+}
+
+inline void ReadNGramHeader(NGramSource &in, unsigned int length) {
+  in.BeginOrder(length);
+}
+
+inline void ReadEnd(NGramSource &/*in*/) {}
+
+// Same checks and conventions as ReadBackoff for ARPA files.
+inline void SetBackoff(float /*value*/, Prob &/*weights*/) {}
+void SetBackoff(float value, float &backoff);
+inline void SetBackoff(float value, ProbBackoff &weights) {
+  SetBackoff(value, weights.backoff);
+}
+inline void SetBackoff(float value, RestWeights &weights) {
+  SetBackoff(value, weights.backoff);
+}
+
+template <class Weights> void SetProb(float prob, Weights &weights, PositiveProbWarn &warn) {
+  if (prob > 0.0) {
+    warn.Warn(prob);
+    prob = 0.0;
+  }
+  weights.prob = prob;
+}
+
+template <class Voc, class Weights> void Read1Grams(NGramSource &f, std::size_t count, Voc &vocab, Weights *unigrams, PositiveProbWarn &warn) {
+  ReadNGramHeader(f, 1);
+  std::vector<WordIndex> words(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    float prob, backoff;
+    f.ReadNGram(&words[i], prob, backoff);
+    Weights &w = unigrams[vocab.Insert(f.Word(words[i]))];
+    SetProb(prob, w, warn);
+    SetBackoff(backoff, w);
+  }
+  vocab.FinishedLoading(unigrams);
+  // The vocabulary may have renumbered the words while finishing.
+  std::vector<WordIndex> &map = f.VocabMap();
+  map.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    if (words[i] >= map.size()) map.resize(words[i] + 1, 0);
+    map[words[i]] = vocab.Index(f.Word(words[i]));
+  }
+}
+
+// Read ngram, write vocab ids to indices_out.
+template <class Voc, class Weights, class Iterator> void ReadNGram(NGramSource &f, const unsigned char n, const Voc &/*vocab*/, Iterator indices_out, Weights &weights, PositiveProbWarn &warn) {
+  WordIndex words[KENLM_MAX_ORDER];
+  float prob, backoff;
+  f.ReadNGram(words, prob, backoff);
+  SetProb(prob, weights, warn);
+  const std::vector<WordIndex> &map = f.VocabMap();
+  for (unsigned char i = 0; i < n; ++i, ++indices_out) {
+    UTIL_THROW_IF(words[i] >= map.size(), FormatLoadException, "Word id " << words[i] << " was not seen in the unigrams but appears in a " << static_cast<unsigned int>(n) << "-gram");
+    *indices_out = map[words[i]];
+  }
+  SetBackoff(backoff, weights);
+}
+
+} // namespace lm
+
+#endif // LM_NGRAM_SOURCE_H
@@ -17,6 +17,7 @@
 namespace util { class FilePiece; }
 
 namespace lm {
+class NGramSource;
 namespace ngram {
 class BinaryFormat;
 class ProbingVocabulary;
@@ -86,6 +87,9 @@ template <class Value> class HashedSearch {
 
     void InitializeFromARPA(const char *file, util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, ProbingVocabulary &vocab, BinaryFormat &backing);
 
+    // Same as above, reading the n-grams from source instead of an ARPA file.
+    void InitializeFromARPA(const char *file, NGramSource &f, const std::vector<uint64_t> &counts, const Config &config, ProbingVocabulary &vocab, BinaryFormat &backing);
+
     unsigned char Order() const {
       return middle_.size() + 2;
     }
@@ -137,10 +141,13 @@ template <class Value> class HashedSearch {
     }
 
   private:
+    // Source is util::FilePiece for ARPA files or NGramSource.
+    template <class Source> void InitializeFrom(Source &f, const std::vector<uint64_t> &counts, const Config &config, ProbingVocabulary &vocab, BinaryFormat &backing);
+
     // Interpret config's rest cost build policy and pass the right template argument to ApplyBuild.
-    void DispatchBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn);
+    template <class Source> void DispatchBuild(Source &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn);
 
-    template <class Build> void ApplyBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const ProbingVocabulary &vocab, PositiveProbWarn &warn, const Build &build);
+    template <class Source, class Build> void ApplyBuild(Source &f, const std::vector<uint64_t> &counts, const ProbingVocabulary &vocab, PositiveProbWarn &warn, const Build &build);
 
     class Unigram {
       public:
@@ -2,6 +2,7 @@
 
 #include "lm/config.hh"
 #include "lm/lm_exception.hh"
+#include "lm/ngram_source.hh"
 #include "lm/read_arpa.hh"
 #include "lm/vocab.hh"
 #include "lm/weights.hh"
@@ -188,6 +189,14 @@ void RecordReader::Rewind() {
 }
 
 SortedFiles::SortedFiles(const Config &config, util::FilePiece &f, std::vector<uint64_t> &counts, size_t buffer, const std::string &file_prefix, SortedVocabulary &vocab) {
+  Init(config, f, counts, buffer, file_prefix, vocab);
+}
+
+SortedFiles::SortedFiles(const Config &config, NGramSource &f, std::vector<uint64_t> &counts, size_t buffer, const std::string &file_prefix, SortedVocabulary &vocab) {
+  Init(config, f, counts, buffer, file_prefix, vocab);
+}
+
+template <class Source> void SortedFiles::Init(const Config &config, Source &f, std::vector<uint64_t> &counts, size_t buffer, const std::string &file_prefix, SortedVocabulary &vocab) {
   PositiveProbWarn warn(config.positive_log_probability);
   unigram_.reset(util::MakeTemp(file_prefix));
   {
@@ -237,7 +246,7 @@ class Closer {
 };
 } // namespace
 
-void SortedFiles::ConvertToSorted(util::FilePiece &f, const SortedVocabulary &vocab, const std::vector<uint64_t> &counts, const std::string &file_prefix, unsigned char order, PositiveProbWarn &warn, void *mem, std::size_t mem_size) {
+template <class Source> void SortedFiles::ConvertToSorted(Source &f, const SortedVocabulary &vocab, const std::vector<uint64_t> &counts, const std::string &file_prefix, unsigned char order, PositiveProbWarn &warn, void *mem, std::size_t mem_size) {
   ReadNGramHeader(f, order);
   const size_t count = counts[order - 1];
   // Size of weights.  Does it include backoff?  
@@ -21,6 +21,7 @@ class FilePiece;
 } // namespace util
 
 namespace lm {
+class NGramSource;
 class PositiveProbWarn;
 namespace ngram {
 class SortedVocabulary;
@@ -87,6 +88,9 @@ class SortedFiles {
     // Build from ARPA
     SortedFiles(const Config &config, util::FilePiece &f, std::vector<uint64_t> &counts, std::size_t buffer, const std::string &file_prefix, SortedVocabulary &vocab);
 
+    // Build from an n-gram source
+    SortedFiles(const Config &config, NGramSource &f, std::vector<uint64_t> &counts, std::size_t buffer, const std::string &file_prefix, SortedVocabulary &vocab);
+
     int StealUnigram() {
       return unigram_.release();
     }
@@ -100,7 +104,10 @@ class SortedFiles {
     }
 
   private:
-    void ConvertToSorted(util::FilePiece &f, const SortedVocabulary &vocab, const std::vector<uint64_t> &counts, const std::string &prefix, unsigned char order, PositiveProbWarn &warn, void *mem, std::size_t mem_size);
+    // Source is util::FilePiece or NGramSource.
+    template <class Source> void Init(const Config &config, Source &f, std::vector<uint64_t> &counts, std::size_t buffer, const std::string &file_prefix, SortedVocabulary &vocab);
+
+    template <class Source> void ConvertToSorted(Source &f, const SortedVocabulary &vocab, const std::vector<uint64_t> &counts, const std::string &prefix, unsigned char order, PositiveProbWarn &warn, void *mem, std::size_t mem_size);
     
     util::scoped_fd unigram_;
 
@@ -109,6 +109,10 @@ const unsigned char kPolicyOneLeft = 1;
 const unsigned char kPolicyOneRight = 2;
 // Reveal everything in the next branch.  Used to terminate the left/right policies.
 //    static const unsigned char kPolicyEverything = 3;
+// The language model state is fully revealed but multiple hypotheses remain
+// because the caller recombines on additional state (i.e. other features).
+// Branch to one hypothesis per child.
+const unsigned char kPolicyEnumerate = 4;
 
 } // namespace
 
@@ -164,6 +168,8 @@ void VertexNode::FinishedAppending(const unsigned char common_left, const unsign
 
   if (!all_full && !all_non_full) {
     policy_ = kPolicyAlternate;
+  } else if (left.Complete() && right.Complete()) {
+    policy_ = kPolicyEnumerate;
   } else if (left.Complete()) {
     policy_ = kPolicyOneRight;
   } else if (right.Complete()) {
@@ -191,7 +197,13 @@ void VertexNode::BuildExtend() {
       left_branch = false;
       break;
   }
-  if (left_branch) {
+  if (policy_ == kPolicyEnumerate) {
+    // Hypotheses are already sorted by score, so the children are too.
+    extend_.resize(hypos_.size());
+    for (std::size_t i = 0; i < hypos_.size(); ++i) {
+      extend_[i].AppendHypothesis(hypos_[i]);
+    }
+  } else if (left_branch) {
     Split(DivideLeft(state_.left.length), hypos_, extend_);
   } else {
     Split(DivideRight(state_.right.length), hypos_, extend_);
@@ -36,8 +36,9 @@ class VertexNode {
      * 4. If !Complete(), call BuildExtend to construct the extensions
      */
     // Must default construct, call AppendHypothesis 1 or more times then do FinishedAppending.
+    // Hypotheses may share a language model state when the caller recombines
+    // on additional state (VertexGenerator::NewHypothesis with extra_hash).
     void AppendHypothesis(const NBestComplete &best) {
-      assert(hypos_.empty() || !(hypos_.front().state == *best.state));
       HypoState hypo;
       hypo.history = best.history;
       hypo.state = *best.state;
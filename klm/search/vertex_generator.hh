@@ -5,6 +5,7 @@
 #include "search/types.hh"
 #include "search/vertex.hh"
 
+#include <boost/functional/hash.hpp>
 #include <boost/unordered_map.hpp>
 
 namespace lm {
@@ -26,6 +27,14 @@ template <class Output> class VertexGenerator {
       nbest_.Add(existing_[hash_value(partial.CompletedState())], partial);
     }
 
+    // Recombine only hypotheses that also agree on state outside the
+    // language model, summarized by the caller as extra_hash.
+    void NewHypothesis(PartialEdge partial, uint64_t extra_hash) {
+      std::size_t key = hash_value(partial.CompletedState());
+      boost::hash_combine(key, extra_hash);
+      nbest_.Add(existing_[key], partial);
+    }
+
     void FinishedSearch() {
       gen_.root_.InitRoot();
       for (typename Existing::iterator i(existing_.begin()); i != existing_.end(); ++i) {
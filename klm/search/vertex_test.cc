@@ -0,0 +1,77 @@
+#include "search/vertex.hh"
+
+#define BOOST_TEST_MODULE VertexTest
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <string.h>
+
+namespace search { namespace {
+
+// A language model state with one word of context on either side.
+lm::ngram::ChartState MakeState(uint64_t left, lm::WordIndex right) {
+  lm::ngram::ChartState state;
+  memset(&state, 0, sizeof(state));
+  state.left.pointers[0] = left;
+  state.left.length = 1;
+  state.left.full = false;
+  state.right.words[0] = right;
+  state.right.length = 1;
+  return state;
+}
+
+// Collects the hypotheses below vertex, visiting the continuation of each split
+// before its alternative, so the best hypothesis comes first.
+void Leaves(PartialVertex vertex, std::vector<History> &out) {
+  std::vector<PartialVertex> alternatives;
+  PartialVertex alternative;
+  while (!vertex.Complete()) {
+    if (vertex.Split(alternative)) alternatives.push_back(alternative);
+  }
+  out.push_back(vertex.End());
+  for (std::vector<PartialVertex>::const_iterator i = alternatives.begin(); i != alternatives.end(); ++i) {
+    Leaves(*i, out);
+  }
+}
+
+// Hypotheses recombined on state outside the language model (see
+// VertexGenerator::NewHypothesis with extra_hash) can share a language model
+// state.  Each of them must still be reachable.
+BOOST_AUTO_TEST_CASE(SharedState) {
+  int a, b, c;
+  lm::ngram::ChartState shared(MakeState(1, 1)), other(MakeState(2, 2));
+  VertexNode root;
+  root.InitRoot();
+  root.AppendHypothesis(NBestComplete(&b, shared, -2.0));
+  root.AppendHypothesis(NBestComplete(&c, other, -3.0));
+  root.AppendHypothesis(NBestComplete(&a, shared, -1.0));
+  root.FinishRoot();
+  BOOST_CHECK_EQUAL(-1.0, root.Bound());
+
+  std::vector<History> leaves;
+  Leaves(PartialVertex(root), leaves);
+  BOOST_REQUIRE_EQUAL(3, leaves.size());
+  BOOST_CHECK_EQUAL(&a, leaves[0]);
+  std::sort(leaves.begin(), leaves.end());
+  BOOST_CHECK(std::unique(leaves.begin(), leaves.end()) == leaves.end());
+}
+
+BOOST_AUTO_TEST_CASE(AllSharedState) {
+  int a, b;
+  lm::ngram::ChartState shared(MakeState(1, 1));
+  VertexNode root;
+  root.InitRoot();
+  root.AppendHypothesis(NBestComplete(&a, shared, -1.0));
+  root.AppendHypothesis(NBestComplete(&b, shared, -2.0));
+  root.FinishRoot();
+
+  std::vector<History> leaves;
+  Leaves(PartialVertex(root), leaves);
+  BOOST_REQUIRE_EQUAL(2, leaves.size());
+  BOOST_CHECK_EQUAL(&a, leaves[0]);
+  BOOST_CHECK_EQUAL(&b, leaves[1]);
+}
+
+}} // namespaces
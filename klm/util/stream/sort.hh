@@ -21,6 +21,7 @@
 #include "util/stream/chain.hh"
 #include "util/stream/config.hh"
 #include "util/stream/io.hh"
+#include "util/stream/multi_stream.hh"
 #include "util/stream/stream.hh"
 #include "util/stream/timer.hh"
 
@@ -28,6 +29,9 @@
 #include "util/scoped.hh"
 #include "util/sized_iterator.hh"
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include <algorithm>
 #include <iostream>
 #include <queue>
@@ -382,6 +386,59 @@ template <class Compare> class BlockSorter {
     SizedCompare<Compare> compare_;
 };
 
+// Blocks sorted by several threads take turns being appended to one file.
+class BlockAppender {
+  public:
+    BlockAppender(int fd, Offsets &offsets, std::size_t inputs)
+      : file_(fd), offsets_(&offsets), remaining_(inputs) {}
+
+    void Append(const Block &block) {
+      boost::mutex::scoped_lock lock(mutex_);
+      offsets_->Append(block.ValidSize());
+      WriteOrThrow(file_, block.Get(), block.ValidSize());
+    }
+
+    // Each input calls this when it is done.
+    void Finished() {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (!--remaining_) offsets_->FinishedAppending();
+    }
+
+  private:
+    boost::mutex mutex_;
+    int file_;
+    Offsets *offsets_;
+    std::size_t remaining_;
+};
+
+// Like BlockSorter followed by a write, but the file is shared.
+template <class Compare> class AppendingBlockSorter {
+  public:
+    AppendingBlockSorter(BlockAppender &appender, const Compare &compare) :
+      appender_(&appender), compare_(compare) {}
+
+    void Run(const ChainPosition &position) {
+      const std::size_t entry_size = position.GetChain().EntrySize();
+      for (Link link(position); link; ++link) {
+        void *end = static_cast<uint8_t*>(link->Get()) + link->ValidSize();
+#if defined(_WIN32) || defined(_WIN64)
+        std::stable_sort
+#else
+        std::sort
+#endif
+          (SizedIt(link->Get(), entry_size),
+           SizedIt(end, entry_size),
+           compare_);
+        appender_->Append(*link);
+      }
+      appender_->Finished();
+    }
+
+  private:
+    BlockAppender *appender_;
+    SizedCompare<Compare> compare_;
+};
+
 class BadSortConfig : public Exception {
   public:
     BadSortConfig() throw() {}
@@ -406,6 +463,28 @@ template <class Compare, class Combine = NeverCombine> class Sort {
       in >> BlockSorter<Compare>(offsets_, compare_) >> WriteAndRecycle(data_.get());
     }
 
+    /* Sorts the union of several chains with the same entry size.  Each chain
+     * sorts its blocks in its own thread so that e.g. shards produced in
+     * parallel are sorted in parallel.  The merge is the same as for one
+     * chain.
+     */
+    Sort(Chains &in, const SortConfig &config, const Compare &compare = Compare(), const Combine &combine = Combine())
+      : config_(config),
+        data_(MakeTemp(config.temp_prefix)),
+        offsets_file_(MakeTemp(config.temp_prefix)), offsets_(offsets_file_.get()),
+        compare_(compare), combine_(combine),
+        entry_size_(in.begin()->EntrySize()) {
+      UTIL_THROW_IF(!entry_size_, BadSortConfig, "Sorting entries of size 0");
+      config_.buffer_size -= config_.buffer_size % entry_size_;
+      UTIL_THROW_IF(!config_.buffer_size, BadSortConfig, "Sort buffer too small");
+      UTIL_THROW_IF(config_.total_memory < config_.buffer_size * 4, BadSortConfig, "Sorting memory " << config_.total_memory << " is too small for four buffers (two read and two write).");
+      appender_.reset(new BlockAppender(data_.get(), offsets_, in.size()));
+      for (Chain *i = in.begin(); i != in.end(); ++i) {
+        UTIL_THROW_IF(i->EntrySize() != entry_size_, BadSortConfig, "Sorting chains with different entry sizes");
+        *i >> AppendingBlockSorter<Compare>(*appender_, compare_) >> kRecycle;
+      }
+    }
+
     uint64_t Size() const {
       return SizeOrThrow(data_.get());
     }
@@ -530,6 +609,9 @@ template <class Compare, class Combine = NeverCombine> class Sort {
     scoped_fd offsets_file_;
     Offsets offsets_;
 
+    // Only used when sorting several chains.
+    boost::scoped_ptr<BlockAppender> appender_;
+
     const Compare compare_;
     const Combine combine_;
     const std::size_t entry_size_;
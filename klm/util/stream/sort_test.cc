@@ -59,4 +59,37 @@ BOOST_AUTO_TEST_CASE(FromShuffled) {
   BOOST_CHECK(!sorted);
 }
 
+BOOST_AUTO_TEST_CASE(FromShards) {
+  std::vector<uint64_t> shuffled[3];
+  for (uint64_t i = 0; i < kSize; ++i) {
+    shuffled[i % 3].push_back(i);
+  }
+  ChainConfig config;
+  config.entry_size = 8;
+  config.total_memory = 800;
+  config.block_count = 3;
+
+  SortConfig merge_config;
+  merge_config.temp_prefix = "sort_test_temp";
+  merge_config.buffer_size = 800;
+  merge_config.total_memory = 3300;
+
+  Chains shards(3);
+  for (std::size_t i = 0; i < 3; ++i) {
+    std::random_shuffle(shuffled[i].begin(), shuffled[i].end());
+    shards.push_back(config);
+    shards.back() >> Putter(shuffled[i]);
+  }
+  Sort<CompareUInt64> sorter(shards, merge_config, CompareUInt64());
+  shards.Wait(true);
+  Chain chain(config);
+  sorter.Output(chain);
+  Stream sorted;
+  chain >> sorted >> kRecycle;
+  for (uint64_t i = 0; i < kSize; ++i, ++sorted) {
+    BOOST_CHECK_EQUAL(i, *static_cast<const uint64_t*>(sorted.Get()));
+  }
+  BOOST_CHECK(!sorted);
+}
+
 }}} // namespaces
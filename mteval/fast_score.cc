@@ -19,6 +19,7 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("reference,r",po::value<vector<string> >(), "[1 or more required] Reference translation(s) in tokenized text files")
         ("evaluation_metric,m",po::value<string>()->default_value("IBM_BLEU"), "Evaluation metric (ibm_bleu, koehn_bleu, nist_bleu, ter, meteor, etc.)")
         ("in_file,i", po::value<string>()->default_value("-"), "Input file")
+        ("threads,j", po::value<unsigned>()->default_value(1), "Number of threads used to score segments (ignored for external metrics)")
         ("help,h", "Help");
   po::options_description dcmdline_options;
   dcmdline_options.add(opts);
@@ -50,23 +51,24 @@ int main(int argc, char** argv) {
   cerr << "Loaded " << ds.size() << " references for scoring with " << loss_function << endl;
 
   ReadFile rf(conf["in_file"].as<string>());
-  SufficientStats acc;
   istream& in = *rf.stream();
-  int lc = 0;
+  vector<vector<WordID> > hyps;
   string line;
   while(getline(in, line)) {
-    vector<WordID> sent;
-    TD::ConvertSentence(line, &sent);
-    SufficientStats t;
-    ds[lc]->Evaluate(sent, &t);
-    acc += t;
-    ++lc;
+    hyps.push_back(vector<WordID>());
+    TD::ConvertSentence(line, &hyps.back());
   }
+  const int lc = hyps.size();
   assert(lc > 0);
   if (lc > ds.size()) {
     cerr << "Too many (" << lc << ") translations in input, expected " << ds.size() << endl;
     return 1;
   }
+  vector<SufficientStats> stats;
+  ds.Evaluate(hyps, &stats, conf["threads"].as<unsigned>());
+  SufficientStats acc;
+  for (int i = 0; i < lc; ++i)
+    acc += stats[i];
   if (lc != ds.size())
     cerr << "Fewer sentences in hyp (" << lc << ") than refs ("
          << ds.size() << "): scoring partial set!\n";
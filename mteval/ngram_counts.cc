@@ -0,0 +1,71 @@
+#include "ngram_counts.h"
+
+#include <cassert>
+
+using namespace std;
+
+NGramCountTable::NGramCountTable(unsigned n) : n_(n), slots_(16), mask_(15), size_(), stamp_() {
+  assert(n > 0);
+}
+
+void NGramCountTable::AddReference(const vector<WordID>& ref) {
+  const unsigned base = words_.size();
+  words_.insert(words_.end(), ref.begin(), ref.end());
+  // hyp_count holds the count within this reference while it is added
+  NextStamp();
+  const int s = ref.size();
+  for (int j = 0; j < s; ++j) {
+    const int remaining = s - j;
+    const int k = (static_cast<int>(n_) < remaining ? n_ : remaining);
+    uint64_t h = 0;
+    for (int i = 1; i <= k; ++i) {
+      h = ExtendHash(h, ref[j + i - 1]);
+      Entry& e = FindOrInsert(base + j, i, h);
+      if (e.stamp != stamp_) {
+        e.stamp = stamp_;
+        e.hyp_count = 0;
+      }
+      if (++e.hyp_count > e.ref_count)
+        e.ref_count = e.hyp_count;
+    }
+  }
+}
+
+NGramCountTable::Entry& NGramCountTable::FindOrInsert(unsigned pos, unsigned order, uint64_t h) {
+  if (2 * (size_ + 1) > slots_.size()) Grow();
+  const WordID* ngram = &words_[pos];
+  uint64_t i = h & mask_;
+  for (; slots_[i].order; i = (i + 1) & mask_) {
+    Entry& e = slots_[i];
+    if (e.hash == h && e.order == order && Matches(e, ngram)) return e;
+  }
+  Entry& e = slots_[i];
+  e.hash = h;
+  e.pos = pos;
+  e.order = order;
+  ++size_;
+  return e;
+}
+
+void NGramCountTable::NextStamp() const {
+  if (++stamp_ == 0) {
+    // wrapped around: forget all stamps so that none can be mistaken for
+    // the current one
+    for (unsigned i = 0; i < slots_.size(); ++i)
+      slots_[i].stamp = 0;
+    stamp_ = 1;
+  }
+}
+
+void NGramCountTable::Grow() {
+  vector<Entry> old(slots_.size() * 2);
+  old.swap(slots_);
+  mask_ = slots_.size() - 1;
+  for (unsigned j = 0; j < old.size(); ++j) {
+    const Entry& e = old[j];
+    if (!e.order) continue;
+    uint64_t i = e.hash & mask_;
+    while (slots_[i].order) i = (i + 1) & mask_;
+    slots_[i] = e;
+  }
+}
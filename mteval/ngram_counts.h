@@ -0,0 +1,111 @@
+#ifndef NGRAM_COUNTS_H_
+#define NGRAM_COUNTS_H_
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+#include "wordid.h"
+
+// Reference n-gram counts for BLEU (max count over the references of every
+// n-gram up to order N), stored in an open-addressing table keyed by a
+// rolling hash of the words.  Hashes are confirmed against the reference
+// words, so collisions never change the statistics.  Clipping counts are
+// invalidated with a generation stamp rather than cleared, which makes
+// ComputeNgramStats allocation free and independent of the table size.
+//
+// ComputeNgramStats updates the clipping counts, so an instance must not be
+// used by several threads at once.
+class NGramCountTable {
+ public:
+  explicit NGramCountTable(unsigned n);
+
+  // the table keeps, for each n-gram, the maximum count in any reference
+  void AddReference(const std::vector<WordID>& ref);
+
+  // correct[i] and hyp[i] (i < N) receive the matched and total number of
+  // hypothesis (i+1)-grams.  Without clip_counts every n-gram up to the
+  // first one missing from the references counts as matched.
+  void ComputeNgramStats(const std::vector<WordID>& sent,
+                         float* correct,
+                         float* hyp,
+                         bool clip_counts = true) const;
+
+  unsigned Order() const { return n_; }
+
+ private:
+  struct Entry {
+    Entry() : hash(), pos(), order(), ref_count(), hyp_count(), stamp() {}
+    uint64_t hash;
+    unsigned pos;    // start of the n-gram in words_
+    unsigned order;  // 0 for empty slots
+    int ref_count;
+    mutable int hyp_count;
+    mutable unsigned stamp;  // hyp_count is 0 unless stamp == stamp_
+  };
+
+  static inline uint64_t ExtendHash(uint64_t h, WordID w) {
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(w)) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h * 0xff51afd7ed558ccdULL;
+  }
+
+  inline const Entry* Find(const WordID* ngram, unsigned order, uint64_t h) const {
+    for (uint64_t i = h & mask_; ; i = (i + 1) & mask_) {
+      const Entry& e = slots_[i];
+      if (!e.order) return NULL;
+      if (e.hash == h && e.order == order && Matches(e, ngram)) return &e;
+    }
+  }
+
+  inline bool Matches(const Entry& e, const WordID* ngram) const {
+    const WordID* w = &words_[e.pos];
+    for (unsigned i = 0; i < e.order; ++i)
+      if (w[i] != ngram[i]) return false;
+    return true;
+  }
+
+  Entry& FindOrInsert(unsigned pos, unsigned order, uint64_t h);
+  void NextStamp() const;
+  void Grow();
+
+  const unsigned n_;
+  std::vector<WordID> words_;  // all references, concatenated
+  std::vector<Entry> slots_;
+  uint64_t mask_;
+  unsigned size_;
+  mutable unsigned stamp_;
+};
+
+inline void NGramCountTable::ComputeNgramStats(const std::vector<WordID>& sent,
+                                               float* correct,
+                                               float* hyp,
+                                               bool clip_counts) const {
+  NextStamp();
+  const int s = sent.size();
+  for (int j = 0; j < s; ++j) {
+    const int remaining = s - j;
+    const int k = (static_cast<int>(n_) < remaining ? n_ : remaining);
+    uint64_t h = 0;
+    for (int i = 1; i <= k; ++i) {
+      h = ExtendHash(h, sent[j + i - 1]);
+      const Entry* e = Find(&sent[j], i, h);
+      if (!e) {
+        if (!clip_counts) correct[i-1]++;
+        // longer n-grams starting here can't be in the references either
+        for (; i <= k; ++i)
+          hyp[i-1]++;
+        break;
+      }
+      if (e->stamp != stamp_) {
+        e->stamp = stamp_;
+        e->hyp_count = 0;
+      }
+      if (!clip_counts || e->hyp_count < e->ref_count) {
+        ++e->hyp_count;
+        correct[i-1]++;
+      }
+      hyp[i-1]++;
+    }
+  }
+}
+
+#endif
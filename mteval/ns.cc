@@ -5,6 +5,7 @@
 #include "ns_cer.h"
 #include "ns_wer.h"
 #include "ns_ssk.h"
+#include "ngram_counts.h"
 
 #include <cstdio>
 #include <cassert>
@@ -32,6 +33,10 @@ bool EvaluationMetric::IsErrorMetric() const {
   return false;
 }
 
+bool EvaluationMetric::IsThreadSafe() const {
+  return true;
+}
+
 struct DefaultSegmentEvaluator : public SegmentEvaluator {
   DefaultSegmentEvaluator(const vector<vector<WordID> >& refs, const EvaluationMetric* em) : refs_(refs), em_(em) {}
   void Evaluate(const vector<WordID>& hyp, SufficientStats* out) const {
@@ -67,7 +72,7 @@ string EvaluationMetric::DetailedScore(const SufficientStats& stats) const {
 enum BleuType { IBM, Koehn, NIST, QCRI };
 template <unsigned int N = 4u, BleuType BrevityType = IBM>
 struct BleuSegmentEvaluator : public SegmentEvaluator {
-  BleuSegmentEvaluator(const vector<vector<WordID> >& refs, const EvaluationMetric* em) : evaluation_metric(em) {
+  BleuSegmentEvaluator(const vector<vector<WordID> >& refs, const EvaluationMetric* em) : evaluation_metric(em), ngrams_(N) {
     assert(refs.size() > 0);
     float tot = 0;
     int smallest = 9999999;
@@ -76,7 +81,7 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
       lengths_.push_back(ci->size());
       tot += lengths_.back();
       if (lengths_.back() < smallest) smallest = lengths_.back();
-      CountRef(*ci);
+      ngrams_.AddReference(*ci);
     }
     if (BrevityType == Koehn)
       lengths_[0] = tot / refs.size();
@@ -89,7 +94,7 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
     out->id_ = evaluation_metric->MetricId();
     for (unsigned i = 0; i < N+N+2; ++i) out->fields[i] = 0;
 
-    ComputeNgramStats(hyp, &out->fields[0], &out->fields[N], true);
+    ngrams_.ComputeNgramStats(hyp, &out->fields[0], &out->fields[N]);
     float& hyp_len = out->fields[2*N];
     float& ref_len = out->fields[2*N + 1];
     hyp_len = hyp.size();
@@ -108,83 +113,9 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
     }
   }
 
-  struct NGramCompare {
-    int operator() (const vector<WordID>& a, const vector<WordID>& b) const {
-      const size_t as = a.size();
-      const size_t bs = b.size();
-      const size_t s = (as < bs ? as : bs);
-      for (size_t i = 0; i < s; ++i) {
-         int d = a[i] - b[i];
-         if (d < 0) return true;
-         if (d > 0) return false;
-      }
-      return as < bs;
-    }
-  };
-  typedef map<vector<WordID>, pair<int,int>, NGramCompare> NGramCountMap;
-
-  void CountRef(const vector<WordID>& ref) {
-    NGramCountMap tc;
-    vector<WordID> ngram(N);
-    int s = ref.size();
-    for (int j=0; j<s; ++j) {
-      int remaining = s-j;
-      int k = (N < remaining ? N : remaining);
-      ngram.clear();
-      for (int i=1; i<=k; ++i) {
-        ngram.push_back(ref[j + i - 1]);
-        tc[ngram].first++;
-      }
-    }
-    for (typename NGramCountMap::iterator i = tc.begin(); i != tc.end(); ++i) {
-      pair<int,int>& p = ngrams_[i->first];
-      if (p.first < i->second.first)
-        p = i->second;
-    }
-  }
-
-  void ComputeNgramStats(const vector<WordID>& sent,
-                         float* correct,  // N elements reserved
-                         float* hyp,      // N elements reserved
-                         bool clip_counts = true) const {
-    // clear clipping stats
-    for (typename NGramCountMap::iterator it = ngrams_.begin(); it != ngrams_.end(); ++it)
-      it->second.second = 0;
-
-    vector<WordID> ngram(N);
-    *correct *= 0;
-    *hyp *= 0;
-    int s = sent.size();
-    for (int j=0; j<s; ++j) {
-      int remaining = s-j;
-      int k = (N < remaining ? N : remaining);
-      ngram.clear();
-      for (int i=1; i<=k; ++i) {
-        ngram.push_back(sent[j + i - 1]);
-        pair<int,int>& p = ngrams_[ngram];
-        if(clip_counts){
-          if (p.second < p.first) {
-            ++p.second;
-            correct[i-1]++;
-          }
-        } else {
-          ++p.second;
-          correct[i-1]++;
-        }
-        // if the 1 gram isn't found, don't try to match don't need to match any 2- 3- .. grams:
-        if (!p.first) {
-          for (; i<=k; ++i)
-            hyp[i-1]++;
-        } else {
-          hyp[i-1]++;
-        }
-      }
-    }
-  }
-
   const EvaluationMetric* evaluation_metric;
   vector<float> lengths_;
-  mutable NGramCountMap ngrams_;
+  NGramCountTable ngrams_;
 };
 
 template <unsigned int N = 4u, BleuType BrevityType = IBM>
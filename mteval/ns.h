@@ -104,6 +104,10 @@ class EvaluationMetric {
   // false for metrics like BLEU and METEOR where higher scores are better
   virtual bool IsErrorMetric() const;
 
+  // true if the SegmentEvaluators of different segments may be used from
+  // different threads at the same time (see DocumentScorer::Evaluate)
+  virtual bool IsThreadSafe() const;
+
   virtual unsigned SufficientStatisticsVectorSize() const;
   virtual float ComputeScore(const SufficientStats& stats) const = 0;
   virtual std::string DetailedScore(const SufficientStats& stats) const;
@@ -10,6 +10,12 @@ bool CERMetric::IsErrorMetric() const {
   return true;
 }
 
+// looks up the strings of the words, which races with a decoder adding words
+// to the dictionary in another thread
+bool CERMetric::IsThreadSafe() const {
+  return false;
+}
+
 unsigned CERMetric::SufficientStatisticsVectorSize() const {
   return 2;
 }
@@ -10,6 +10,7 @@ class CERMetric : public EvaluationMetric {
 
  public:
   virtual bool IsErrorMetric() const;
+  virtual bool IsThreadSafe() const;
   virtual unsigned SufficientStatisticsVectorSize() const;
   virtual void ComputeSufficientStatistics(const std::vector<WordID>& hyp,
                                            const std::vector<std::vector<WordID> >& refs,
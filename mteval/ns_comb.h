@@ -9,6 +9,7 @@ class CombinationMetric : public EvaluationMetric {
   virtual boost::shared_ptr<SegmentEvaluator> CreateSegmentEvaluator(const std::vector<std::vector<WordID> >& refs) const;
   virtual float ComputeScore(const SufficientStats& stats) const;
   virtual unsigned SufficientStatisticsVectorSize() const;
+  virtual bool IsThreadSafe() const;
  private:
   std::vector<EvaluationMetric*> metrics;
   std::vector<float> coeffs;
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <boost/thread/thread.hpp>
 
 #include "tdict.h"
 #include "filelib.h"
@@ -11,10 +12,10 @@ using namespace std;
 
 DocumentScorer::~DocumentScorer() {}
 
-DocumentScorer::DocumentScorer() {}
+DocumentScorer::DocumentScorer() : thread_safe_(true) {}
 
 DocumentScorer::DocumentScorer(const EvaluationMetric* metric,
-                               const string& src_ref_file) {
+                               const string& src_ref_file) : thread_safe_(metric->IsThreadSafe()) {
   const WordID kDIV = TD::Convert("|||");
   assert(!src_ref_file.empty());
   cerr << "Loading source and references from " << src_ref_file << "...\n";
@@ -52,6 +53,7 @@ void DocumentScorer::Init(const EvaluationMetric* metric,
             const string& src_file,
             bool verbose) {
   scorers_.clear();
+  thread_safe_ = metric->IsThreadSafe();
   static const WordID kDIV = TD::Convert("|||");
   if (verbose) cerr << "Loading references (" << ref_files.size() << " files)\n";
   assert(src_file.empty());
@@ -104,3 +106,46 @@ void DocumentScorer::Init(const EvaluationMetric* metric,
   if (verbose) cerr << "Loaded reference translations for " << scorers_.size() << " sentences.\n";
 }
 
+
+namespace {
+
+struct EvaluateWorker {
+  EvaluateWorker(const vector<boost::shared_ptr<SegmentEvaluator> >& scorers,
+                 const vector<vector<WordID> >& hyps,
+                 vector<SufficientStats>* stats,
+                 unsigned first,
+                 unsigned stride) :
+    scorers_(scorers), hyps_(hyps), stats_(*stats), first_(first), stride_(stride) {}
+
+  void operator()() const {
+    for (unsigned i = first_; i < hyps_.size(); i += stride_)
+      scorers_[i]->Evaluate(hyps_[i], &stats_[i]);
+  }
+
+  const vector<boost::shared_ptr<SegmentEvaluator> >& scorers_;
+  const vector<vector<WordID> >& hyps_;
+  vector<SufficientStats>& stats_;
+  const unsigned first_;
+  const unsigned stride_;
+};
+
+} // namespace
+
+void DocumentScorer::Evaluate(const vector<vector<WordID> >& hyps,
+                              vector<SufficientStats>* stats,
+                              unsigned threads) const {
+  assert(hyps.size() <= scorers_.size());
+  stats->clear();
+  stats->resize(hyps.size());
+  if (!thread_safe_ || threads < 1) threads = 1;
+  if (threads > hyps.size()) threads = hyps.size();
+  if (threads <= 1) {
+    EvaluateWorker(scorers_, hyps, stats, 0, 1)();
+    return;
+  }
+  // segments are interleaved so that long and short ones are spread evenly
+  boost::thread_group workers;
+  for (unsigned t = 0; t < threads; ++t)
+    workers.create_thread(EvaluateWorker(scorers_, hyps, stats, t, threads));
+  workers.join_all();
+}
@@ -4,8 +4,10 @@
 #include <vector>
 #include <string>
 #include <boost/shared_ptr.hpp>
+#include "wordid.h"
 
 class EvaluationMetric;
+class SufficientStats;
 struct SegmentEvaluator;
 class DocumentScorer {
  public:
@@ -21,6 +23,12 @@ class DocumentScorer {
                  const std::string& src_ref_composite_file);
   int size() const { return scorers_.size(); }
   const SegmentEvaluator* operator[](size_t i) const { return scorers_[i].get(); }
+
+  // scores hyps[i] against segment i, using up to threads threads if the
+  // metric allows it (see EvaluationMetric::IsThreadSafe)
+  void Evaluate(const std::vector<std::vector<WordID> >& hyps,
+                std::vector<SufficientStats>* stats,
+                unsigned threads = 1) const;
  private:
   void Init(const EvaluationMetric* metric,
             const std::vector<std::string>& ref_files,
@@ -28,6 +36,7 @@ class DocumentScorer {
             bool verbose=false);
 
   std::vector<boost::shared_ptr<SegmentEvaluator> > scorers_;
+  bool thread_safe_;
 };
 
 #endif
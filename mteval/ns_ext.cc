@@ -164,6 +164,11 @@ float ExternalMetric::ComputeScore(const SufficientStats& stats) const {
   return eval_server->ComputeScore(stats.fields);
 }
 
+// all requests go through a single pipe to the child process
+bool ExternalMetric::IsThreadSafe() const {
+  return false;
+}
+
 ExternalMetric::ExternalMetric(const string& metric_name, const std::string& command) :
     EvaluationMetric(metric_name),
     eval_server(new NScoreServer(command)) {}
@@ -12,6 +12,7 @@ class TERMetric : public EvaluationMetric {
   virtual bool IsErrorMetric() const;
   virtual unsigned SufficientStatisticsVectorSize() const;
   virtual std::string DetailedScore(const SufficientStats& stats) const;
+  virtual boost::shared_ptr<SegmentEvaluator> CreateSegmentEvaluator(const std::vector<std::vector<WordID> >& refs) const;
   virtual void ComputeSufficientStatistics(const std::vector<WordID>& hyp,
                                            const std::vector<std::vector<WordID> >& refs,
                                            SufficientStats* out) const;
@@ -19,6 +19,7 @@
 #include "tdict.h"
 #include "stringlib.h"
 #include "external_scorer.h"
+#include "ngram_counts.h"
 
 using boost::shared_ptr;
 using namespace std;
@@ -200,80 +201,8 @@ class BLEUScorerBase : public SentenceScorer {
 
   virtual float ComputeRefLength(const vector<WordID>& hyp) const = 0;
  private:
-  struct NGramCompare {
-    int operator() (const vector<WordID>& a, const vector<WordID>& b) const {
-      size_t as = a.size();
-      size_t bs = b.size();
-      const size_t s = (as < bs ? as : bs);
-      for (size_t i = 0; i < s; ++i) {
-         int d = a[i] - b[i];
-         if (d < 0) return true;
-	 if (d > 0) return false;
-      }
-      return as < bs;
-    }
-  };
-  typedef map<vector<WordID>, pair<int,int>, NGramCompare> NGramCountMap;
-  void CountRef(const vector<WordID>& ref) {
-    NGramCountMap tc;
-    vector<WordID> ngram(n_);
-    int s = ref.size();
-    for (int j=0; j<s; ++j) {
-      int remaining = s-j;
-      int k = (n_ < remaining ? n_ : remaining);
-      ngram.clear();
-      for (int i=1; i<=k; ++i) {
-	ngram.push_back(ref[j + i - 1]);
-        tc[ngram].first++;
-      }
-    }
-    for (NGramCountMap::iterator i = tc.begin(); i != tc.end(); ++i) {
-      pair<int,int>& p = ngrams_[i->first];
-      if (p.first < i->second.first)
-        p = i->second;
-    }
-  }
-
-  void ComputeNgramStats(const vector<WordID>& sent,
-			 valarray<float>* correct,
-			 valarray<float>* hyp,
-			 bool clip_counts)
-    const {
-    assert(correct->size() == n_);
-    assert(hyp->size() == n_);
-    vector<WordID> ngram(n_);
-    (*correct) *= 0;
-    (*hyp) *= 0;
-    int s = sent.size();
-    for (int j=0; j<s; ++j) {
-      int remaining = s-j;
-      int k = (n_ < remaining ? n_ : remaining);
-      ngram.clear();
-      for (int i=1; i<=k; ++i) {
-	ngram.push_back(sent[j + i - 1]);
-        pair<int,int>& p = ngrams_[ngram];
-	if(clip_counts){
-	  if (p.second < p.first) {
-	    ++p.second;
-	    (*correct)[i-1]++;
-	  }}
-	else {
-	  ++p.second;
-	  (*correct)[i-1]++;
-	}
-	// if the 1 gram isn't found, don't try to match don't need to match any 2- 3- .. grams:
-	if (!p.first) {
-	  for (; i<=k; ++i)
-	    (*hyp)[i-1]++;
-	} else {
-          (*hyp)[i-1]++;
-        }
-      }
-    }
-  }
-
-  mutable NGramCountMap ngrams_;
   int n_;
+  NGramCountTable ngrams_;
   vector<int> lengths_;
 };
 
@@ -563,19 +492,17 @@ void BLEUScore::Encode(string* out) const {
 }
 
 BLEUScorerBase::BLEUScorerBase(const vector<vector<WordID> >& references,
-                               int n) : SentenceScorer("BLEU"+boost::lexical_cast<string>(n),references),n_(n) {
+                               int n) : SentenceScorer("BLEU"+boost::lexical_cast<string>(n),references),n_(n),ngrams_(n) {
   for (vector<vector<WordID> >::const_iterator ci = references.begin();
        ci != references.end(); ++ci) {
     lengths_.push_back(ci->size());
-    CountRef(*ci);
+    ngrams_.AddReference(*ci);
   }
 }
 
 ScoreP BLEUScorerBase::ScoreCandidate(const vector<WordID>& hyp) const {
   BLEUScore* bs = new BLEUScore(n_);
-  for (NGramCountMap::iterator i=ngrams_.begin(); i != ngrams_.end(); ++i)
-    i->second.second = 0;
-  ComputeNgramStats(hyp, &bs->correct_ngram_hit_counts, &bs->hyp_ngram_counts, true);
+  ngrams_.ComputeNgramStats(hyp, &bs->correct_ngram_hit_counts[0], &bs->hyp_ngram_counts[0]);
   bs->ref_len = ComputeRefLength(hyp);
   bs->hyp_len = hyp.size();
   return ScoreP(bs);
@@ -583,10 +510,8 @@ ScoreP BLEUScorerBase::ScoreCandidate(const vector<WordID>& hyp) const {
 
 ScoreP BLEUScorerBase::ScoreCCandidate(const vector<WordID>& hyp) const {
   BLEUScore* bs = new BLEUScore(n_);
-  for (NGramCountMap::iterator i=ngrams_.begin(); i != ngrams_.end(); ++i)
-    i->second.second = 0;
   bool clip = false;
-  ComputeNgramStats(hyp, &bs->correct_ngram_hit_counts, &bs->hyp_ngram_counts,clip);
+  ngrams_.ComputeNgramStats(hyp, &bs->correct_ngram_hit_counts[0], &bs->hyp_ngram_counts[0], clip);
   bs->ref_len = ComputeRefLength(hyp);
   bs->hyp_len = hyp.size();
   return ScoreP(bs);
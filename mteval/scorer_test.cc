@@ -1,13 +1,17 @@
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #define BOOST_TEST_MODULE ScoreTest
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "ns_docscorer.h"
 #include "ns.h"
 #include "tdict.h"
 #include "scorer.h"
 #include "aer_scorer.h"
+#include "ter_impl.h"
 #include "kernel_string_subseq.h"
 
 using namespace std;
@@ -113,6 +117,105 @@ BOOST_AUTO_TEST_CASE(TestTERScorerSimple) {
   cerr << "DETAILS: " << details << endl;
 }
 
+// The bit-parallel shift search has to find the same edits as the plain DP
+// when the reference spans several 64-word blocks.
+BOOST_AUTO_TEST_CASE(TestTERBitParallelMatchesScalar) {
+  unsigned state = 1;
+  int total_shifts = 0;
+  const unsigned kRefLengths[] = {63, 64, 65, 128, 130, 131};
+  for (unsigned l = 0; l < sizeof(kRefLengths) / sizeof(unsigned); ++l) {
+    for (unsigned trial = 0; trial < 10; ++trial) {
+      // a small vocabulary so that words repeat and many shifts are possible
+      vector<WordID> ref;
+      for (unsigned i = 0; i < kRefLengths[l]; ++i) {
+        state = state * 1103515245 + 12345;
+        ostringstream w;
+        w << "w" << (state >> 16) % 20;
+        ref.push_back(TD::Convert(w.str()));
+      }
+      // move blocks of words around, then substitute, insert and delete some
+      vector<WordID> hyp(ref);
+      for (unsigned moves = 0; moves < 4; ++moves) {
+        state = state * 1103515245 + 12345;
+        const unsigned len = 1 + (state >> 16) % 8;
+        state = state * 1103515245 + 12345;
+        const unsigned from = (state >> 16) % (hyp.size() - len);
+        vector<WordID> block(hyp.begin() + from, hyp.begin() + from + len);
+        hyp.erase(hyp.begin() + from, hyp.begin() + from + len);
+        state = state * 1103515245 + 12345;
+        const unsigned to = (state >> 16) % (hyp.size() + 1);
+        hyp.insert(hyp.begin() + to, block.begin(), block.end());
+      }
+      for (unsigned edits = 0; edits < 10; ++edits) {
+        state = state * 1103515245 + 12345;
+        const unsigned pos = (state >> 16) % hyp.size();
+        switch (edits % 3) {
+          case 0: hyp[pos] = TD::Convert(edits % 2 ? "unseen" : "w3"); break;
+          case 1: hyp.insert(hyp.begin() + pos, TD::Convert("w7")); break;
+          case 2: hyp.erase(hyp.begin() + pos); break;
+        }
+      }
+
+      TERScorerImpl bit_parallel(ref), scalar(ref, false);
+      int subs, ins, dels, shifts;
+      const float score = bit_parallel.Calculate(hyp, &subs, &ins, &dels, &shifts);
+      int expected_subs, expected_ins, expected_dels, expected_shifts;
+      BOOST_CHECK_EQUAL(scalar.Calculate(hyp, &expected_subs, &expected_ins, &expected_dels, &expected_shifts), score);
+      BOOST_CHECK_EQUAL(expected_subs, subs);
+      BOOST_CHECK_EQUAL(expected_ins, ins);
+      BOOST_CHECK_EQUAL(expected_dels, dels);
+      BOOST_CHECK_EQUAL(expected_shifts, shifts);
+      total_shifts += shifts;
+    }
+  }
+  BOOST_CHECK(total_shifts > 0);
+}
+
+// scores every hypothesis with the same evaluator, as several threads of
+// DocumentScorer::Evaluate do when they share a segment
+struct SharedEvaluatorWorker {
+  SharedEvaluatorWorker(const SegmentEvaluator& eval,
+                        const vector<vector<WordID> >& hyps,
+                        vector<SufficientStats>* stats) :
+    eval_(eval), hyps_(hyps), stats_(*stats) {}
+
+  void operator()() const {
+    for (unsigned i = 0; i < hyps_.size(); ++i)
+      eval_.Evaluate(hyps_[i], &stats_[i]);
+  }
+
+  const SegmentEvaluator& eval_;
+  const vector<vector<WordID> >& hyps_;
+  vector<SufficientStats>& stats_;
+};
+
+BOOST_AUTO_TEST_CASE(TestTERSharedAcrossThreads) {
+  EvaluationMetric* metric = EvaluationMetric::Instance("TER");
+  BOOST_REQUIRE(metric->IsThreadSafe());
+  boost::shared_ptr<SegmentEvaluator> eval = metric->CreateSegmentEvaluator(refs1);
+  // rotations of both hypotheses, so that each needs a different set of shifts
+  vector<vector<WordID> > hyps;
+  for (unsigned r = 0; r < 40; ++r) {
+    vector<WordID> hyp(r % 2 ? hyp1 : hyp2);
+    rotate(hyp.begin(), hyp.begin() + (r * 7) % hyp.size(), hyp.end());
+    hyps.push_back(hyp);
+  }
+  vector<SufficientStats> expected(hyps.size());
+  SharedEvaluatorWorker(*eval, hyps, &expected)();
+
+  const unsigned kThreads = 4;
+  vector<vector<SufficientStats> > stats(kThreads, vector<SufficientStats>(hyps.size()));
+  for (unsigned round = 0; round < 5; ++round) {
+    boost::thread_group workers;
+    for (unsigned t = 0; t < kThreads; ++t)
+      workers.create_thread(SharedEvaluatorWorker(*eval, hyps, &stats[t]));
+    workers.join_all();
+    for (unsigned t = 0; t < kThreads; ++t)
+      for (unsigned i = 0; i < hyps.size(); ++i)
+        BOOST_CHECK(expected[i] == stats[t][i]);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestSERScorerSimple) {
   vector<vector<WordID> > ref(1);
   TD::ConvertSentence("A B C D", &ref[0]);
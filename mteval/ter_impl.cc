@@ -0,0 +1,448 @@
+#include "ter_impl.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace {
+
+struct COSTS {
+  static const float substitution;
+  static const float deletion;
+  static const float insertion;
+  static const float shift;
+};
+const float COSTS::substitution = 1.0f;
+const float COSTS::deletion = 1.0f;
+const float COSTS::insertion = 1.0f;
+const float COSTS::shift = 1.0f;
+
+const int MAX_SHIFT_SIZE = 10;
+const int MAX_SHIFT_DIST = 50;
+
+const uint64_t kHighBit = static_cast<uint64_t>(1) << 63;
+
+void PerformShift(const vector<int>& in,
+  int start, int end, int moveto, vector<int>* out) {
+  out->clear();
+  if (moveto == -1) {
+    for (int i = start; i <= end; ++i)
+     out->push_back(in[i]);
+    for (int i = 0; i < start; ++i)
+     out->push_back(in[i]);
+    for (int i = end+1; i < in.size(); ++i)
+     out->push_back(in[i]);
+  } else if (moveto < start) {
+    for (int i = 0; i <= moveto; ++i)
+     out->push_back(in[i]);
+    for (int i = start; i <= end; ++i)
+     out->push_back(in[i]);
+    for (int i = moveto+1; i < start; ++i)
+     out->push_back(in[i]);
+    for (int i = end+1; i < in.size(); ++i)
+     out->push_back(in[i]);
+  } else if (moveto > end) {
+    for (int i = 0; i < start; ++i)
+     out->push_back(in[i]);
+    for (int i = end+1; i <= moveto; ++i)
+     out->push_back(in[i]);
+    for (int i = start; i <= end; ++i)
+     out->push_back(in[i]);
+    for (int i = moveto+1; i < in.size(); ++i)
+     out->push_back(in[i]);
+  } else {
+    for (int i = 0; i < start; ++i)
+     out->push_back(in[i]);
+    for (int i = end+1; (i < in.size()) && (i <= end + (moveto - start)); ++i)
+     out->push_back(in[i]);
+    for (int i = start; i <= end; ++i)
+     out->push_back(in[i]);
+    for (int i = (end + (moveto - start))+1; i < in.size(); ++i)
+     out->push_back(in[i]);
+  }
+  assert(out->size() == in.size());
+}
+
+} // namespace
+
+struct TERScorerImpl::Shift {
+  unsigned int d_;
+  Shift() : d_() {}
+  Shift(int b, int e, int m) : d_() {
+    begin(b);
+    end(e);
+    moveto(m);
+  }
+  inline int begin() const {
+    return d_ & 0x3ff;
+  }
+  inline int end() const {
+    return (d_ >> 10) & 0x3ff;
+  }
+  inline int moveto() const {
+    int m = (d_ >> 20) & 0x7ff;
+    if (m > 1024) { m -= 1024; m *= -1; }
+    return m;
+  }
+  inline void begin(int b) {
+    d_ &= 0xfffffc00u;
+    d_ |= (b & 0x3ff);
+  }
+  inline void end(int e) {
+    d_ &= 0xfff003ffu;
+    d_ |= (e & 0x3ff) << 10;
+  }
+  inline void moveto(int m) {
+    bool neg = (m < 0);
+    if (neg) { m *= -1; m += 1024; }
+    d_ &= 0xfffff;
+    d_ |= (m & 0x7ff) << 20;
+  }
+};
+
+TERScorerImpl::TERScorerImpl(const vector<WordID>& ref, bool bit_parallel) :
+    ref_(ref), ref_syms_(ref.size()), bit_parallel_(bit_parallel) {
+  for (unsigned i = 0; i < ref.size(); ++i) {
+    int& sym = sym_[ref[i]];
+    if (!sym) sym = sym_.size();
+    ref_syms_[i] = sym;
+  }
+  blocks_ = (ref.size() + 63) / 64;
+  last_bit_ = ref.empty() ? 0 : static_cast<uint64_t>(1) << ((ref.size() - 1) % 64);
+  peq_.resize((sym_.size() + 1) * blocks_);
+  for (unsigned i = 0; i < ref.size(); ++i)
+    peq_[ref_syms_[i] * blocks_ + i / 64] |= static_cast<uint64_t>(1) << (i % 64);
+}
+
+float TERScorerImpl::MinimumEditDistance(const Symbols& hyp, vector<TransType>* path, Scratch* s) const {
+  const unsigned cols = ref_syms_.size() + 1;
+  vector<float>& cmat = s->cmat;
+  vector<unsigned char>& bmat = s->bmat;
+  bmat.assign((hyp.size() + 1) * cols, MATCH);
+  cmat.assign((hyp.size() + 1) * cols, 0);
+  for (int i = 0; i <= hyp.size(); ++i)
+    cmat[i * cols] = i;
+  for (int j = 0; j < cols; ++j)
+    cmat[j] = j;
+  for (int i = 1; i <= hyp.size(); ++i) {
+    const int& hw = hyp[i-1];
+    const float* prev_c = &cmat[(i - 1) * cols];
+    float* row_c = &cmat[i * cols];
+    unsigned char* row_b = &bmat[i * cols];
+    for (int j = 1; j < cols; ++j) {
+      const int& rw = ref_syms_[j-1];
+      float& cur_c = row_c[j];
+      unsigned char& cur_b = row_b[j];
+
+      if (rw == hw) {
+        cur_c = prev_c[j-1];
+        cur_b = MATCH;
+      } else {
+        cur_c = prev_c[j-1] + COSTS::substitution;
+        cur_b = SUBSTITUTION;
+      }
+      float cwoi = prev_c[j];
+      if (cur_c > cwoi + COSTS::insertion) {
+        cur_c = cwoi + COSTS::insertion;
+        cur_b = INSERTION;
+      }
+      float cwod = row_c[j-1];
+      if (cur_c > cwod + COSTS::deletion) {
+        cur_c = cwod + COSTS::deletion;
+        cur_b = DELETION;
+      }
+    }
+  }
+
+  // trace back along the best path and record the transition types
+  path->clear();
+  int i = hyp.size();
+  int j = ref_syms_.size();
+  while (i > 0 || j > 0) {
+    if (j == 0) {
+      --i;
+      path->push_back(INSERTION);
+    } else if (i == 0) {
+      --j;
+      path->push_back(DELETION);
+    } else {
+      TransType t = static_cast<TransType>(bmat[i * cols + j]);
+      path->push_back(t);
+      switch (t) {
+        case SUBSTITUTION:
+        case MATCH:
+          --i; --j; break;
+        case INSERTION:
+          --i; break;
+        case DELETION:
+          --j; break;
+      }
+    }
+  }
+  reverse(path->begin(), path->end());
+  return cmat[hyp.size() * cols + ref_syms_.size()];
+}
+
+// Advances the vertical deltas pv/mv (reference positions are rows) by one
+// hypothesis word and returns the change in distance at the last row.
+inline int TERScorerImpl::Column(int sym, uint64_t* pv, uint64_t* mv) const {
+  const uint64_t* peq = blocks_ ? &peq_[sym * blocks_] : NULL;
+  int hin = 1;  // the first row is the distance to an empty reference
+  for (unsigned b = 0; b < blocks_; ++b) {
+    const uint64_t high = (b + 1 == blocks_) ? last_bit_ : kHighBit;
+    const uint64_t hneg = hin < 0 ? 1 : 0;
+    uint64_t eq = peq[b];
+    const uint64_t xv = eq | mv[b];
+    eq |= hneg;
+    const uint64_t xh = (((eq & pv[b]) + pv[b]) ^ pv[b]) | eq;
+    uint64_t ph = mv[b] | ~(xh | pv[b]);
+    uint64_t mh = pv[b] & xh;
+    int hout = 0;
+    if (ph & high) hout = 1;
+    else if (mh & high) hout = -1;
+    ph <<= 1;
+    mh <<= 1;
+    mh |= hneg;
+    if (hin > 0) ph |= 1;
+    pv[b] = mh | ~(xv | ph);
+    mv[b] = ph & xv;
+    hin = hout;
+  }
+  return hin;
+}
+
+// Records the DP column after every prefix of cur so that shifted versions
+// of cur can resume from their first changed word.
+void TERScorerImpl::PrepareColumns(const Symbols& cur, Scratch* s) const {
+  const unsigned stride = 2 * blocks_;
+  s->cols.resize((cur.size() + 1) * stride);
+  s->col_scores.resize(cur.size() + 1);
+  uint64_t* col = s->cols.empty() ? NULL : &s->cols[0];
+  fill(col, col + blocks_, ~static_cast<uint64_t>(0));
+  fill(col + blocks_, col + stride, 0);
+  int score = ref_syms_.size();
+  s->col_scores[0] = score;
+  for (unsigned j = 0; j < cur.size(); ++j) {
+    copy(col, col + stride, col + stride);
+    col += stride;
+    score += Column(cur[j], col, col + blocks_);
+    s->col_scores[j + 1] = score;
+  }
+}
+
+int TERScorerImpl::ShiftedEditDistance(const Symbols& shifted, unsigned first, Scratch* s) const {
+  int score = s->col_scores[first];
+  s->pv.resize(blocks_);
+  s->mv.resize(blocks_);
+  if (blocks_) {
+    const uint64_t* col = &s->cols[first * 2 * blocks_];
+    copy(col, col + blocks_, s->pv.begin());
+    copy(col + blocks_, col + 2 * blocks_, s->mv.begin());
+  }
+  uint64_t* pv = s->pv.empty() ? NULL : &s->pv[0];
+  uint64_t* mv = s->mv.empty() ? NULL : &s->mv[0];
+  for (unsigned j = first; j < shifted.size(); ++j)
+    score += Column(shifted[j], pv, mv);
+  return score;
+}
+
+void TERScorerImpl::BuildWordMatches(const Symbols& hyp, Scratch* s) const {
+  s->nmap.clear();
+  vector<bool> exists_both(sym_.size() + 1, false);
+  for (int i = 0; i < hyp.size(); ++i)
+    if (hyp[i]) exists_both[hyp[i]] = true;
+  for (int start=0; start<ref_syms_.size(); ++start) {
+    if (!exists_both[ref_syms_[start]]) continue;
+    Symbols cp;
+    int mlen = min(MAX_SHIFT_SIZE, static_cast<int>(ref_syms_.size() - start));
+    for (int len=0; len<mlen; ++len) {
+      if (len && !exists_both[ref_syms_[start + len]]) break;
+      cp.push_back(ref_syms_[start + len]);
+      // starts are visited in order, so positions stay sorted
+      s->nmap[cp].push_back(start);
+    }
+  }
+}
+
+void TERScorerImpl::GetAllPossibleShifts(const Symbols& hyp,
+    const vector<int>& ralign,
+    const vector<bool>& herr,
+    const vector<bool>& rerr,
+    const int min_size,
+    const Scratch& s,
+    vector<vector<Shift> >* shifts) const {
+  Symbols cp;
+  for (int start = 0; start < hyp.size(); ++start) {
+    cp.assign(1, hyp[start]);
+    NgramToIntsMap::const_iterator niter = s.nmap.find(cp);
+    if (niter == s.nmap.end()) continue;
+    bool ok = false;
+    int moveto;
+    for (vector<int>::const_iterator i = niter->second.begin(); i != niter->second.end(); ++i) {
+      moveto = *i;
+      int rm = ralign[moveto];
+      ok = (start != rm &&
+            (rm - start) < MAX_SHIFT_DIST &&
+            (start - rm - 1) < MAX_SHIFT_DIST);
+      if (ok) break;
+    }
+    if (!ok) continue;
+    cp.clear();
+    for (int end = start + min_size - 1;
+         ok && end < hyp.size() && end < (start + MAX_SHIFT_SIZE); ++end) {
+      cp.push_back(hyp[end]);
+      vector<Shift>& sshifts = (*shifts)[end - start];
+      ok = false;
+      NgramToIntsMap::const_iterator niter = s.nmap.find(cp);
+      if (niter == s.nmap.end()) break;
+      bool any_herr = false;
+      for (int i = start; i <= end && !any_herr; ++i)
+        any_herr = herr[i];
+      if (!any_herr) {
+        ok = true;
+        continue;
+      }
+      for (vector<int>::const_iterator mi = niter->second.begin();
+           mi != niter->second.end(); ++mi) {
+        int moveto = *mi;
+        int rm = ralign[moveto];
+        if (! ((rm != start) &&
+              ((rm < start) || (rm > end)) &&
+              (rm - start <= MAX_SHIFT_DIST) &&
+              ((start - rm - 1) <= MAX_SHIFT_DIST))) continue;
+        ok = true;
+        bool any_rerr = false;
+        for (int i = 0; (i <= end - start) && (!any_rerr); ++i)
+          any_rerr = rerr[moveto+i];
+        if (!any_rerr) continue;
+        for (int roff = 0; roff <= (end - start); ++roff) {
+          int rmr = ralign[moveto+roff];
+          if ((start != rmr) && ((roff == 0) || (rmr != ralign[moveto])))
+            sshifts.push_back(Shift(start, end, moveto + roff));
+        }
+      }
+    }
+  }
+}
+
+bool TERScorerImpl::CalculateBestShift(const Symbols& cur,
+                                       float curerr,
+                                       const vector<TransType>& path,
+                                       Symbols* new_hyp,
+                                       float* newerr,
+                                       vector<TransType>* new_path,
+                                       Scratch* scratch) const {
+  vector<bool> herr, rerr;
+  vector<int> ralign;
+  int hpos = -1;
+  for (int i = 0; i < path.size(); ++i) {
+    switch (path[i]) {
+      case MATCH:
+        ++hpos;
+        herr.push_back(false);
+        rerr.push_back(false);
+        ralign.push_back(hpos);
+        break;
+      case SUBSTITUTION:
+        ++hpos;
+        herr.push_back(true);
+        rerr.push_back(true);
+        ralign.push_back(hpos);
+        break;
+      case INSERTION:
+        ++hpos;
+        herr.push_back(true);
+        break;
+      case DELETION:
+        rerr.push_back(true);
+        ralign.push_back(hpos);
+        break;
+    }
+  }
+
+  vector<vector<Shift> > shifts(MAX_SHIFT_SIZE + 1);
+  GetAllPossibleShifts(cur, ralign, herr, rerr, 1, *scratch, &shifts);
+  bool any_shifts = false;
+  for (int i = 0; i < shifts.size() && !any_shifts; ++i)
+    any_shifts = !shifts[i].empty();
+  if (!any_shifts) return false;
+  if (bit_parallel_) PrepareColumns(cur, scratch);
+  Symbols& shifted = scratch->shifted;
+
+  float cur_best_shift_cost = 0;
+  *newerr = curerr;
+  bool res = false;
+  for (int i = shifts.size() - 1; i >=0; --i) {
+    float curfix = curerr - (cur_best_shift_cost + *newerr);
+    float maxfix = 2.0f * (1 + i) - COSTS::shift;
+    if ((curfix > maxfix) || ((cur_best_shift_cost == 0) && (curfix == maxfix))) break;
+    for (int j = 0; j < shifts[i].size(); ++j) {
+      const Shift& s = shifts[i][j];
+      curfix = curerr - (cur_best_shift_cost + *newerr);
+      maxfix = 2.0f * (1 + i) - COSTS::shift;  // TODO remove?
+      if ((curfix > maxfix) || ((cur_best_shift_cost == 0) && (curfix == maxfix))) continue;
+      PerformShift(cur, s.begin(), s.end(), ralign[s.moveto()], &shifted);
+      unsigned first = 0;
+      while (first < cur.size() && shifted[first] == cur[first]) ++first;
+      float try_cost = bit_parallel_ ? ShiftedEditDistance(shifted, first, scratch)
+                                     : MinimumEditDistance(shifted, &scratch->shifted_path, scratch);
+      float gain = (*newerr + cur_best_shift_cost) - (try_cost + COSTS::shift);
+      if (gain > 0.0f || ((cur_best_shift_cost == 0.0f) && (gain == 0.0f))) {
+        *newerr = try_cost;
+        cur_best_shift_cost = COSTS::shift;
+        new_hyp->assign(shifted.begin(), shifted.end());
+        res = true;
+      }
+    }
+  }
+
+  // only the shift that was taken needs its alignment
+  if (res) {
+    const float cost = MinimumEditDistance(*new_hyp, new_path, scratch);
+    assert(cost == *newerr);
+    (void) cost;
+  }
+  return res;
+}
+
+float TERScorerImpl::Calculate(const vector<WordID>& hyp, int* subs, int* ins, int* dels, int* shifts) const {
+  Symbols cur(hyp.size());
+  for (int i = 0; i < hyp.size(); ++i) {
+    unordered_map<WordID, int>::const_iterator it = sym_.find(hyp[i]);
+    cur[i] = (it == sym_.end() ? 0 : it->second);
+  }
+  Scratch scratch;
+  BuildWordMatches(cur, &scratch);
+  vector<TransType> path;
+  float med_cost = MinimumEditDistance(cur, &path, &scratch);
+  float edits = 0;
+  *shifts = 0;
+  Symbols new_hyp;
+  vector<TransType> new_path;
+  while (true) {
+    float new_med_cost;
+    if (!CalculateBestShift(cur, med_cost, path, &new_hyp, &new_med_cost, &new_path, &scratch))
+      break;
+    edits += COSTS::shift;
+    ++(*shifts);
+    med_cost = new_med_cost;
+    path.swap(new_path);
+    cur.swap(new_hyp);
+  }
+
+  *subs = *ins = *dels = 0;
+  for (int i = 0; i < path.size(); ++i) {
+    switch (path[i]) {
+      case SUBSTITUTION:
+        ++(*subs);
+      case MATCH:
+        break;
+      case INSERTION:
+        ++(*ins); break;
+      case DELETION:
+        ++(*dels); break;
+    }
+  }
+  return med_cost + edits;
+}
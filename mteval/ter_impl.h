@@ -0,0 +1,89 @@
+#ifndef TER_IMPL_H_
+#define TER_IMPL_H_
+
+#include <vector>
+#include <stdint.h>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+#include <boost/functional/hash.hpp>
+#include "wordid.h"
+
+// Computes translation edit rate against a single reference; shared by
+// TERScorer (ter.cc) and TERMetric (ns_ter.cc).
+//
+// Candidate shifts are scored with the bit-parallel edit distance of Myers
+// (1999), in the multi-word form of Hyyro (2003), resuming from the column
+// where the shifted hypothesis first differs from the unshifted one.  The
+// full DP with a backtrace only runs on the initial hypothesis and on
+// accepted shifts, so the results are identical to the plain DP.  This
+// relies on substitutions, insertions and deletions all costing 1.
+//
+// Calculate keeps its scratch space on the stack, so one instance can score
+// hypotheses from several threads at once.
+class TERScorerImpl {
+ public:
+  // bit_parallel = false scores every candidate shift with the plain DP, as
+  // the scalar implementation did; it is only there to check the results.
+  explicit TERScorerImpl(const std::vector<WordID>& ref, bool bit_parallel = true);
+
+  float Calculate(const std::vector<WordID>& hyp, int* subs, int* ins, int* dels, int* shifts) const;
+
+  inline int GetRefLength() const {
+    return ref_.size();
+  }
+
+ private:
+  enum TransType { MATCH, SUBSTITUTION, INSERTION, DELETION };
+  struct Shift;
+
+  // words are renumbered so that reference words are 1..|V(ref)| and all
+  // other words are 0, which no reference position matches
+  typedef std::vector<int> Symbols;
+  typedef std::unordered_map<Symbols, std::vector<int>, boost::hash<Symbols> > NgramToIntsMap;
+
+  // buffers of one Calculate call
+  struct Scratch {
+    NgramToIntsMap nmap;
+    std::vector<float> cmat;
+    std::vector<unsigned char> bmat;
+    std::vector<uint64_t> cols;  // Pv and Mv after every column of the current hypothesis
+    std::vector<int> col_scores;
+    std::vector<uint64_t> pv, mv;
+    Symbols shifted;
+    std::vector<TransType> shifted_path;
+  };
+
+  float MinimumEditDistance(const Symbols& hyp, std::vector<TransType>* path, Scratch* s) const;
+  int Column(int sym, uint64_t* pv, uint64_t* mv) const;
+  void PrepareColumns(const Symbols& cur, Scratch* s) const;
+  int ShiftedEditDistance(const Symbols& shifted, unsigned first, Scratch* s) const;
+  void BuildWordMatches(const Symbols& hyp, Scratch* s) const;
+  void GetAllPossibleShifts(const Symbols& hyp,
+                            const std::vector<int>& ralign,
+                            const std::vector<bool>& herr,
+                            const std::vector<bool>& rerr,
+                            const int min_size,
+                            const Scratch& s,
+                            std::vector<std::vector<Shift> >* shifts) const;
+  bool CalculateBestShift(const Symbols& cur,
+                          float curerr,
+                          const std::vector<TransType>& path,
+                          Symbols* new_hyp,
+                          float* newerr,
+                          std::vector<TransType>* new_path,
+                          Scratch* s) const;
+
+  std::vector<WordID> ref_;
+  Symbols ref_syms_;
+  std::unordered_map<WordID, int> sym_;
+  unsigned blocks_;     // 64-bit words per DP column
+  uint64_t last_bit_;   // last reference position within the final word
+  std::vector<uint64_t> peq_;  // match masks, blocks_ words per symbol
+  bool bit_parallel_;
+};
+
+#endif
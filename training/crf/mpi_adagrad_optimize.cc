@@ -8,6 +8,7 @@
 
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include "config.h"
@@ -25,6 +26,7 @@
 #include "weights.h"
 #include "sparse_vector.h"
 #include "sampler.h"
+#include "threaded_gradient_observer.h"
 
 #ifdef HAVE_MPI
 #include <boost/mpi/timer.hpp>
@@ -51,7 +53,8 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("regularization,r", po::value<string>()->default_value("none"),
             "Regularization 'none', 'l1', or 'l2'")
         ("regularization_strength,C", po::value<double>(), "Regularization strength")
-        ("eta,e", po::value<double>()->default_value(1.0), "Initial learning rate (eta)");
+        ("eta,e", po::value<double>()->default_value(1.0), "Initial learning rate (eta)")
+        ("threads,j", po::value<unsigned>()->default_value(1), "Number of threads computing expectations (per process)");
   po::options_description clo("Command line options");
   clo.add_options()
         ("config", po::value<string>(), "Configuration file")
@@ -358,6 +361,12 @@ int main(int argc, char** argv) {
 
   TrainingObserver observer;
   ConditionalLikelihoodObserver cllh_observer;
+  boost::scoped_ptr<ThreadedGradientObserver> threaded_observer;
+  const unsigned threads = conf["threads"].as<unsigned>();
+  if (threads > 1)
+    threaded_observer.reset(new ThreadedGradientObserver(threads));
+  DecoderObserver* training_observer = &observer;
+  if (threaded_observer) training_observer = threaded_observer.get();
 
   const time_t start_time = time(NULL);
   while (!converged) {
@@ -373,6 +382,7 @@ int main(int argc, char** argv) {
         }
       }
       observer.Reset();
+      if (threaded_observer) threaded_observer->Reset();
       if (rank == 0) {
         converged = (iter == max_iteration);
         string fname = "weights.cur.gz";
@@ -397,7 +407,13 @@ int main(int argc, char** argv) {
         int ei = corpus.size() * rng->next();
         int id = ids[ei];
         decoder.SetId(id);
-        decoder.Decode(corpus[ei], &observer);
+        decoder.Decode(corpus[ei], training_observer);
+      }
+      if (threaded_observer) {
+        SparseVector<prob_t> model_minus_ref;
+        unsigned trg_words;
+        threaded_observer->Collect(&model_minus_ref, &observer.acc_obj, &trg_words);
+        observer.acc_grad -= model_minus_ref;  // accumulates E_ref - E_model
       }
       SparseVector<double> local_grad, g;
       observer.GetGradient(&local_grad);
@@ -11,12 +11,14 @@
 namespace mpi = boost::mpi;
 #endif
 
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 
 #include "sentence_metadata.h"
 #include "cllh_observer.h"
+#include "threaded_gradient_observer.h"
 #include "verbose.h"
 #include "hg.h"
 #include "prob.h"
@@ -45,7 +47,8 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
 	("correction_buffers,M", po::value<int>()->default_value(10), "Number of gradients for LBFGS to maintain in memory")
         ("gaussian_prior,p","Use a Gaussian prior on the weights")
         ("sigma_squared", po::value<double>()->default_value(1.0), "Sigma squared term for spherical Gaussian prior")
-        ("means,u", po::value<string>(), "(optional) file containing the means for Gaussian prior");
+        ("means,u", po::value<string>(), "(optional) file containing the means for Gaussian prior")
+        ("threads,j", po::value<unsigned>()->default_value(1), "Number of threads computing expectations (per process)");
   po::options_description clo("Command line options");
   clo.add_options()
         ("config", po::value<string>(), "Configuration file")
@@ -267,8 +270,15 @@ int main(int argc, char** argv) {
 
   TrainingObserver observer;
   ConditionalLikelihoodObserver cllh_observer;
+  boost::scoped_ptr<ThreadedGradientObserver> threaded_observer;
+  const unsigned threads = conf["threads"].as<unsigned>();
+  if (threads > 1)
+    threaded_observer.reset(new ThreadedGradientObserver(threads));
+  DecoderObserver* training_observer = &observer;
+  if (threaded_observer) training_observer = threaded_observer.get();
   while (!converged) {
     observer.Reset();
+    if (threaded_observer) threaded_observer->Reset();
     cllh_observer.Reset();
 #ifdef HAVE_MPI
     mpi::timer timer;
@@ -279,7 +289,9 @@ int main(int argc, char** argv) {
       cerr << "  Testset size: " << test_corpus.size() << " sentences / proc)\n";
     }
     for (int i = 0; i < corpus.size(); ++i)
-      decoder->Decode(corpus[i], &observer);
+      decoder->Decode(corpus[i], training_observer);
+    if (threaded_observer)
+      threaded_observer->Collect(&observer.acc_grad, &observer.acc_obj, &observer.trg_words);
     cerr << "  process " << rank << '/' << size << " done\n";
     fill(gradient.begin(), gradient.end(), 0);
     observer.SetLocalGradientAndObjective(&gradient, &objective);
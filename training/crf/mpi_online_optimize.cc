@@ -8,6 +8,7 @@
 
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include "stringlib.h"
@@ -23,6 +24,7 @@
 #include "weights.h"
 #include "sparse_vector.h"
 #include "sampler.h"
+#include "threaded_gradient_observer.h"
 
 #ifdef HAVE_MPI
 #include <boost/mpi/timer.hpp>
@@ -46,7 +48,8 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("random_seed,S", po::value<uint32_t>(), "Random seed (if not specified, /dev/random will be used)")
         ("eta_0,e", po::value<double>()->default_value(0.2), "Initial learning rate for SGD (eta_0)")
         ("L1,1","Use L1 regularization")
-        ("regularization_strength,C", po::value<double>()->default_value(1.0), "Regularization strength (C)");
+        ("regularization_strength,C", po::value<double>()->default_value(1.0), "Regularization strength (C)")
+        ("threads,j", po::value<unsigned>()->default_value(1), "Number of threads computing expectations (per process)");
   po::options_description clo("Command line options");
   clo.add_options()
         ("config", po::value<string>(), "Configuration file")
@@ -302,6 +305,12 @@ int main(int argc, char** argv) {
   SparseVector<double> x;
   Weights::InitSparseVector(init_weights, &x);
   TrainingObserver observer;
+  boost::scoped_ptr<ThreadedGradientObserver> threaded_observer;
+  const unsigned threads = conf["threads"].as<unsigned>();
+  if (threads > 1)
+    threaded_observer.reset(new ThreadedGradientObserver(threads));
+  DecoderObserver* training_observer = &observer;
+  if (threaded_observer) training_observer = threaded_observer.get();
 
   int write_weights_every_ith = 100; // TODO configure
   int titer = -1;
@@ -332,6 +341,7 @@ int main(int argc, char** argv) {
       x.init_vector(&lambdas);
       ++iter; ++titer;
       observer.Reset();
+      if (threaded_observer) threaded_observer->Reset();
       if (rank == 0) {
         converged = (iter == max_iteration);
         Weights::SanityCheck(lambdas);
@@ -358,7 +368,13 @@ int main(int argc, char** argv) {
         int ei = corpus.size() * rng->next();
         int id = ids[ei];
         decoder.SetId(id);
-        decoder.Decode(corpus[ei], &observer);
+        decoder.Decode(corpus[ei], training_observer);
+      }
+      if (threaded_observer) {
+        SparseVector<prob_t> model_minus_ref;
+        unsigned trg_words;
+        threaded_observer->Collect(&model_minus_ref, &observer.acc_obj, &trg_words);
+        observer.acc_grad -= model_minus_ref;  // accumulates E_ref - E_model
       }
       SparseVector<double> local_grad, g;
       observer.GetGradient(&local_grad);
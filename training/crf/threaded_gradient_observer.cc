@@ -0,0 +1,138 @@
+#include "threaded_gradient_observer.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include <boost/bind.hpp>
+
+#include "inside_outside.h"
+#include "sentence_metadata.h"
+
+using namespace std;
+
+static const double kMINUS_EPSILON = -1e-6;
+
+ThreadedGradientObserver::ThreadedGradientObserver(unsigned threads) :
+    cur_(NULL), acc_(threads), busy_(), done_(false) {
+  assert(threads > 0);
+  for (unsigned i = 0; i < threads; ++i)
+    workers_.create_thread(boost::bind(&ThreadedGradientObserver::Work, this, i));
+}
+
+ThreadedGradientObserver::~ThreadedGradientObserver() {
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    done_ = true;
+  }
+  has_job_.notify_all();
+  workers_.join_all();
+  delete cur_;
+  for (deque<Job*>::iterator it = queue_.begin(); it != queue_.end(); ++it)
+    delete *it;
+}
+
+void ThreadedGradientObserver::WaitForQueue() {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (busy_) drained_.wait(lock);
+}
+
+void ThreadedGradientObserver::Reset() {
+  WaitForQueue();
+  for (unsigned i = 0; i < acc_.size(); ++i)
+    acc_[i] = Accumulator();
+}
+
+void ThreadedGradientObserver::Collect(SparseVector<prob_t>* grad, double* obj, unsigned* trg_words) {
+  WaitForQueue();
+  grad->clear();
+  *obj = 0;
+  *trg_words = 0;
+  for (unsigned i = 0; i < acc_.size(); ++i) {
+    *grad += acc_[i].grad;
+    *obj += acc_[i].obj;
+    *trg_words += acc_[i].trg_words;
+  }
+}
+
+// drops the forest of a sentence whose reference was unreachable
+void ThreadedGradientObserver::NotifyDecodingStart(const SentenceMetadata&) {
+  delete cur_;
+  cur_ = NULL;
+}
+
+// the decoder goes on to intersect the translation forest with the
+// reference, so it has to be copied here
+void ThreadedGradientObserver::NotifyTranslationForest(const SentenceMetadata&, Hypergraph* hg) {
+  assert(!cur_);
+  cur_ = new Job;
+  cur_->model = *hg;
+}
+
+void ThreadedGradientObserver::NotifyAlignmentForest(const SentenceMetadata& smeta, Hypergraph* hg) {
+  assert(cur_);
+  cur_->ref = *hg;
+  cur_->trg_words = smeta.GetReference().size();
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    // keep a bounded number of forests in memory
+    while (queue_.size() >= 2 * acc_.size()) has_space_.wait(lock);
+    queue_.push_back(cur_);
+    ++busy_;
+  }
+  cur_ = NULL;
+  has_job_.notify_one();
+}
+
+void ThreadedGradientObserver::Work(unsigned id) {
+  Accumulator& acc = acc_[id];
+  while (true) {
+    Job* job;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (queue_.empty() && !done_) has_job_.wait(lock);
+      if (queue_.empty()) return;
+      job = queue_.front();
+      queue_.pop_front();
+    }
+    has_space_.notify_one();
+
+    // model expectations, denominator of objective
+    SparseVector<prob_t> model_exp;
+    const prob_t z = InsideOutside<prob_t,
+                                   EdgeProb,
+                                   SparseVector<prob_t>,
+                                   EdgeFeaturesAndProbWeightFunction>(job->model, &model_exp);
+    const double log_z = log(z);
+    model_exp /= z;
+
+    // "empirical" expectations, numerator of objective
+    SparseVector<prob_t> ref_exp;
+    const prob_t ref_z = InsideOutside<prob_t,
+                                       EdgeProb,
+                                       SparseVector<prob_t>,
+                                       EdgeFeaturesAndProbWeightFunction>(job->ref, &ref_exp);
+    ref_exp /= ref_z;
+    const double log_ref_z = log(ref_z);
+
+    // rounding errors means that <0 is too strict
+    if ((log_z - log_ref_z) < kMINUS_EPSILON) {
+      cerr << "DIFF. ERR! log_model_z < log_ref_z: " << log_z << " " << log_ref_z << endl;
+      exit(1);
+    }
+    assert(!std::isnan(log_ref_z));
+    model_exp -= ref_exp;
+    acc.grad += model_exp;
+    acc.obj += (log_z - log_ref_z);
+    acc.trg_words += job->trg_words;
+    delete job;
+
+    bool drained;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      drained = (--busy_ == 0);
+    }
+    if (drained) drained_.notify_all();
+  }
+}
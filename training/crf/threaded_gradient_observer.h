@@ -0,0 +1,67 @@
+#ifndef _THREADED_GRADIENT_OBSERVER_H_
+#define _THREADED_GRADIENT_OBSERVER_H_
+
+#include <deque>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "decoder.h"
+#include "hg.h"
+#include "prob.h"
+#include "sparse_vector.h"
+
+// Computes the conditional log likelihood objective and its gradient on a
+// pool of threads.  Decoding stays in the calling thread (the decoder, its
+// grammars and language models are shared and not reentrant); each time a
+// sentence's translation and alignment forests are complete they are copied
+// and handed to a worker, which runs the two inside-outside passes.  Every
+// worker sums into its own accumulator, so no locks are taken on the
+// gradient; Collect() merges them once the queue drains.
+class ThreadedGradientObserver : public DecoderObserver {
+ public:
+  explicit ThreadedGradientObserver(unsigned threads);
+  ~ThreadedGradientObserver();
+
+  // Waits for the queued sentences and clears the accumulators
+  void Reset();
+
+  // Waits for the queued sentences and returns the sums since the last
+  // Reset(): obj is sum_i log Z(x_i) - log Z(x_i,y_i) and grad is its
+  // gradient, E_model[f] - E_ref[f]
+  void Collect(SparseVector<prob_t>* grad, double* obj, unsigned* trg_words);
+
+  virtual void NotifyDecodingStart(const SentenceMetadata&);
+  virtual void NotifyTranslationForest(const SentenceMetadata&, Hypergraph* hg);
+  virtual void NotifyAlignmentForest(const SentenceMetadata& smeta, Hypergraph* hg);
+
+ private:
+  struct Job {
+    Hypergraph model;
+    Hypergraph ref;
+    unsigned trg_words;
+  };
+  struct Accumulator {
+    Accumulator() : obj(), trg_words() {}
+    SparseVector<prob_t> grad;
+    double obj;
+    unsigned trg_words;
+  };
+
+  void Work(unsigned id);
+  void WaitForQueue();
+
+  Job* cur_;  // the sentence being decoded
+  std::vector<Accumulator> acc_;
+
+  boost::mutex mutex_;
+  boost::condition_variable has_job_, has_space_, drained_;
+  std::deque<Job*> queue_;
+  unsigned busy_;  // jobs queued or being worked on
+  bool done_;
+  boost::thread_group workers_;
+};
+
+#endif
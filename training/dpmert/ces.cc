@@ -21,17 +21,17 @@ void ComputeErrorSurface(const SegmentEvaluator& ss,
                          const EvaluationMetric* metric,
                          const Hypergraph& hg) {
   vector<WordID> prev_trans;
-  const vector<boost::shared_ptr<MERTPoint> >& ienv = ve.GetSortedSegs();
+  const vector<MERTPoint>& ienv = ve.GetSortedSegs();
   env->resize(ienv.size());
   SufficientStats prev_score; // defaults to 0
   int j = 0;
   for (unsigned i = 0; i < ienv.size(); ++i) {
-    const MERTPoint& seg = *ienv[i];
+    const MERTPoint& seg = ienv[i];
     vector<WordID> trans;
 #if 0
     if (type == AER) {
       vector<bool> edges(hg.edges_.size(), false);
-      seg.CollectEdgesUsed(&edges);  // get the set of edges in the viterbi
+      ve.CollectEdgesUsed(i, &edges);  // get the set of edges in the viterbi
                                      // alignment
       ostringstream os;
       const string* psrc = ss.GetSource();
@@ -53,7 +53,7 @@ void ComputeErrorSurface(const SegmentEvaluator& ss,
       TD::ConvertSentence(tstr.substr(tstr.rfind(" ||| ") + 5), &trans);
     } else {
 #endif
-      seg.ConstructTranslation(&trans);
+      ve.ConstructTranslation(i, &trans);
     //}
     //cerr << "Scoring: " << TD::GetString(trans) << endl;
     if (trans == prev_trans) {
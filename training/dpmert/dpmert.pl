@@ -24,6 +24,7 @@ die "Can't execute $FAST_SCORE" unless -x $FAST_SCORE;
 my $MAPINPUT = "$bin_dir/mr_dpmert_generate_mapper_input";
 my $MAPPER = "$bin_dir/mr_dpmert_map";
 my $REDUCER = "$bin_dir/mr_dpmert_reduce";
+my $OPTIMIZER = "$bin_dir/dpmert_optimize";
 my $parallelize = "$util_dir/parallelize.pl";
 my $libcall = "$util_dir/libcall.pl";
 my $sentserver = "$util_dir/sentserver";
@@ -57,6 +58,7 @@ my $weights;
 my $initialWeights;
 my $bleu_weight=1;
 my $use_make = 1;  # use make to parallelize line search
+my $opt_threads = 0;  # if > 0, run the line search in-process (dpmert_optimize)
 my $useqsub;
 my $pass_suffix = '';
 my $devset;
@@ -72,6 +74,7 @@ if (GetOptions(
 	"iterations=i" => \$max_iterations,
 	"pmem=s" => \$pmem,
 	"random-directions=i" => \$rand_directions,
+	"opt-threads=i" => \$opt_threads,
 	"metric=s" => \$metric,
 	"source-file=s" => \$srcFile,
 	"output-dir=s" => \$dir,
@@ -269,7 +272,23 @@ while (1){
 	my $score = 0;
 	my $icc = 0;
 	my $inweights="$dir/weights.$im1";
-	for (my $opt_iter=1; $opt_iter<$optimization_iters; $opt_iter++) {
+	if ($opt_threads > 0) {
+		my $finalFile="$dir/weights.$im1-opt";
+		my $niters = $optimization_iters - 1;
+		$cmd="$OPTIMIZER -w $inweights -f $dir/hgs -s $devSize -d $rand_directions -n $niters -e $epsilon --previous_score=$last_score -m $metric $refs -j $opt_threads -o $finalFile";
+		print STDERR "COMMAND:\n$cmd\n";
+		check_call($cmd);
+		open W, "<$finalFile" or die "Can't read $finalFile: $!";
+		my $summary = <W>;
+		close W;
+		die "Unexpected optimizer output in $finalFile" unless $summary =~ /^# line searches=(\d+) projected score=(\S+)/;
+		$icc = $1;
+		$score = $2;
+		$last_score = $score;
+		print STDERR "PROJECTED SCORE: $score\n";
+		$inweights = $finalFile;
+	}
+	for (my $opt_iter=1; $opt_threads == 0 && $opt_iter<$optimization_iters; $opt_iter++) {
 		print STDERR "\nGENERATE OPTIMIZATION STRATEGY (OPT-ITERATION $opt_iter/$optimization_iters)\n";
 		print STDERR unchecked_output("date");
 		$icc++;
@@ -549,6 +568,10 @@ Job control options:
 		Use qsub to run jobs in parallel (qsub must be configured in
 		environment/LocalEnvironment.pm)
 
+	--opt-threads <I>
+		Run the line search in a single process with <I> threads
+		(dpmert_optimize) instead of map/reduce jobs.
+
 	--pmem <N>
 		Amount of physical memory requested for parallel decoding jobs
 		(used with qsub requests only)
@@ -0,0 +1,222 @@
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "ns.h"
+#include "ns_docscorer.h"
+#include "ces.h"
+#include "filelib.h"
+#include "stringlib.h"
+#include "sparse_vector.h"
+#include "mert_geometry.h"
+#include "inside_outside.h"
+#include "error_surface.h"
+#include "line_optimizer.h"
+#include "weights.h"
+#include "hg_io.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+// Runs the line searches of one MERT iteration in a single process: the
+// forests are read once and the error surfaces for all directions are
+// computed by a pool of threads.  This replaces the
+// mr_dpmert_generate_mapper_input | mr_dpmert_map | mr_dpmert_reduce
+// pipeline used by dpmert.pl.
+
+void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
+  po::options_description opts("Configuration options");
+  opts.add_options()
+        ("reference,r",po::value<vector<string> >(), "[REQD] Reference translation (tokenized text)")
+        ("forest_repository,f",po::value<string>(),"[REQD] Path to forest repository (0.bin.gz, 1.bin.gz, ...)")
+        ("dev_set_size,s",po::value<unsigned>(),"[REQD] Development set size (# of parallel sentences)")
+        ("weights,w",po::value<string>(),"[REQD] Current feature weights file")
+        ("output,o",po::value<string>()->default_value("-"),"Write the optimized weights to this file")
+        ("evaluation_metric,m",po::value<string>()->default_value("ibm_bleu"), "Evaluation metric being optimized")
+        ("optimize_feature,F",po::value<vector<string> >(), "Feature to optimize (if none specified, all weights listed in the weights file will be optimized)")
+        ("random_directions,d",po::value<unsigned int>()->default_value(20),"Number of random directions to run the line optimizer in")
+        ("iterations,n",po::value<unsigned int>()->default_value(5),"Maximum number of line searches")
+        ("epsilon,e",po::value<double>()->default_value(0.0001),"Stop when the step or the score change is smaller than this")
+        ("previous_score,p",po::value<double>()->default_value(-10000000),"Projected score of the previous iteration (for the stopping criterion)")
+        ("threads,j",po::value<unsigned>()->default_value(1),"Number of threads used to compute error surfaces")
+        ("help,h", "Help");
+  po::options_description dcmdline_options;
+  dcmdline_options.add(opts);
+  po::store(parse_command_line(argc, argv, dcmdline_options), *conf);
+  bool flag = false;
+  if (!conf->count("reference")) {
+    cerr << "Please specify one or more references using -r <REF.TXT>\n";
+    flag = true;
+  }
+  if (!conf->count("forest_repository")) {
+    cerr << "Please specify the forest repository location using -f <DIR>\n";
+    flag = true;
+  }
+  if (!conf->count("dev_set_size")) {
+    cerr << "Please specify the size of the development set using -s N\n";
+    flag = true;
+  }
+  if (!conf->count("weights")) {
+    cerr << "Please specify the starting-point weights using -w <weightfile.txt>\n";
+    flag = true;
+  }
+  if (flag || conf->count("help")) {
+    cerr << dcmdline_options << endl;
+    exit(1);
+  }
+}
+
+// computes the error surfaces of sentences first, first + stride, ... along
+// every direction.  Each segment evaluator is only used by one thread.
+struct ErrorSurfaceWorker {
+  ErrorSurfaceWorker(const vector<Hypergraph>& hgs,
+                     const DocumentScorer& ds,
+                     const EvaluationMetric* metric,
+                     const SparseVector<double>& origin,
+                     const vector<SparseVector<double> >& directions,
+                     vector<vector<ErrorSurface> >* surfaces,
+                     unsigned first,
+                     unsigned stride) :
+    hgs_(hgs), ds_(ds), metric_(metric), origin_(origin), directions_(directions),
+    surfaces_(*surfaces), first_(first), stride_(stride) {}
+
+  void operator()() const {
+    for (unsigned i = first_; i < hgs_.size(); i += stride_) {
+      for (unsigned j = 0; j < directions_.size(); ++j) {
+        const ConvexHullWeightFunction wf(origin_, directions_[j]);
+        const ConvexHull hull = Inside<ConvexHull, ConvexHullWeightFunction>(hgs_[i], NULL, wf);
+        ComputeErrorSurface(*ds_[i], hull, &surfaces_[j][i], metric_, hgs_[i]);
+      }
+    }
+  }
+
+  const vector<Hypergraph>& hgs_;
+  const DocumentScorer& ds_;
+  const EvaluationMetric* metric_;
+  const SparseVector<double>& origin_;
+  const vector<SparseVector<double> >& directions_;
+  vector<vector<ErrorSurface> >& surfaces_;
+  const unsigned first_;
+  const unsigned stride_;
+};
+
+int main(int argc, char** argv) {
+  po::variables_map conf;
+  InitCommandLine(argc, argv, &conf);
+  RandomNumberGenerator<boost::mt19937> rng;
+  const string evaluation_metric = conf["evaluation_metric"].as<string>();
+  EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
+  DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
+  cerr << "Loaded " << ds.size() << " references for scoring with " << evaluation_metric << endl;
+  const LineOptimizer::ScoreType opt_type =
+    metric->IsErrorMetric() ? LineOptimizer::MINIMIZE_SCORE : LineOptimizer::MAXIMIZE_SCORE;
+
+  vector<string> features;
+  vector<weight_t> w;
+  Weights::InitFromFile(conf["weights"].as<string>(), &w, &features);
+  SparseVector<double> origin;
+  Weights::InitSparseVector(w, &origin);
+  if (conf.count("optimize_feature") > 0)
+    features = conf["optimize_feature"].as<vector<string> >();
+  vector<int> fids(features.size());
+  for (unsigned i = 0; i < features.size(); ++i)
+    fids[i] = FD::Convert(features[i]);
+
+  const string forest_repository = conf["forest_repository"].as<string>();
+  if (!DirectoryExists(forest_repository)) {
+    cerr << "Forest repository directory " << forest_repository << " not found!\n";
+    return 1;
+  }
+  const unsigned dev_set_size = conf["dev_set_size"].as<unsigned>();
+  if (dev_set_size > ds.size()) {
+    cerr << "Development set has " << dev_set_size << " sentences but only " << ds.size() << " references\n";
+    return 1;
+  }
+  // reading the forests updates the word and feature dictionaries, so this
+  // is done before any threads are started
+  vector<Hypergraph> hgs(dev_set_size);
+  for (unsigned i = 0; i < dev_set_size; ++i) {
+    ostringstream os;
+    os << forest_repository << '/' << i << ".bin.gz";
+    ReadFile rf(os.str());
+    if (!HypergraphIO::ReadFromBinary(rf.stream(), &hgs[i])) {
+      cerr << "Error reading forest " << os.str() << endl;
+      return 1;
+    }
+  }
+  cerr << "Loaded " << hgs.size() << " forests\n";
+
+  unsigned threads = conf["threads"].as<unsigned>();
+  if (!metric->IsThreadSafe()) {
+    if (threads > 1) cerr << evaluation_metric << " can't be computed by several threads, using one\n";
+    threads = 1;
+  }
+  if (threads < 1) threads = 1;
+  if (threads > hgs.size()) threads = hgs.size();
+
+  const unsigned max_iterations = conf["iterations"].as<unsigned>();
+  const double epsilon = conf["epsilon"].as<double>();
+  double last_score = conf["previous_score"].as<double>();
+  float score = 0;
+  unsigned iteration = 0;
+  while (iteration < max_iterations) {
+    ++iteration;
+    cerr << "\nLINE SEARCH " << iteration << '/' << max_iterations << endl;
+    vector<SparseVector<double> > directions;
+    LineOptimizer::CreateOptimizationDirections(
+       fids,
+       conf["random_directions"].as<unsigned int>(),
+       &rng,
+       &directions);
+    vector<vector<ErrorSurface> > surfaces(directions.size(), vector<ErrorSurface>(hgs.size()));
+    if (threads == 1) {
+      ErrorSurfaceWorker(hgs, ds, metric, origin, directions, &surfaces, 0, 1)();
+    } else {
+      boost::thread_group workers;
+      for (unsigned t = 0; t < threads; ++t)
+        workers.create_thread(ErrorSurfaceWorker(hgs, ds, metric, origin, directions, &surfaces, t, threads));
+      workers.join_all();
+    }
+
+    int best = -1;
+    double best_x = 0;
+    float best_score = 0;
+    for (unsigned j = 0; j < directions.size(); ++j) {
+      float dir_score;
+      const double x = LineOptimizer::LineOptimize(metric, surfaces[j], opt_type, &dir_score);
+      if (best < 0 ||
+          (opt_type == LineOptimizer::MAXIMIZE_SCORE ? dir_score > best_score : dir_score < best_score)) {
+        best = j;
+        best_x = x;
+        best_score = dir_score;
+      }
+    }
+    if (best < 0) break;
+    score = best_score;
+    cerr << "PROJECTED SCORE: " << score << endl;
+    if (fabs(best_x) < epsilon) {
+      cerr << "OPTIMIZER: no score improvement: abs(" << best_x << ") < " << epsilon << endl;
+      break;
+    }
+    const double psd = score - last_score;
+    last_score = score;
+    if (fabs(psd) < epsilon) {
+      cerr << "OPTIMIZER: no score improvement: abs(" << psd << ") < " << epsilon << endl;
+      break;
+    }
+    origin += directions[best] * best_x;
+  }
+
+  w.clear();
+  origin.init_vector(&w);
+  ostringstream os;
+  os << "line searches=" << iteration << " projected score=" << score;
+  const string extra = os.str();
+  Weights::WriteToFile(conf["output"].as<string>(), w, true, &extra);
+  return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <iostream>
+#include <limits>
 #include <boost/shared_ptr.hpp>
 
 #include "hg.h"
@@ -11,71 +12,99 @@
 static const double kMinusInfinity = -std::numeric_limits<double>::infinity();
 static const double kPlusInfinity = std::numeric_limits<double>::infinity();
 
+// a line m * x + b that is part of an upper envelope
 struct MERTPoint {
-  MERTPoint() : x(), m(), b(), edge() {}
+  MERTPoint() : x(), m(), b(), id(kNoBackPointer) {}
   MERTPoint(double _m, double _b) :
-    x(kMinusInfinity), m(_m), b(_b), edge() {}
-  MERTPoint(double _x, double _m, double _b, const boost::shared_ptr<MERTPoint>& p1_, const boost::shared_ptr<MERTPoint>& p2_) :
-    x(_x), m(_m), b(_b), p1(p1_), p2(p2_), edge() {}
-  MERTPoint(double _m, double _b, const Hypergraph::Edge& edge) :
-    x(kMinusInfinity), m(_m), b(_b), edge(&edge) {}
+    x(kMinusInfinity), m(_m), b(_b), id(kNoBackPointer) {}
+  MERTPoint(double _x, double _m, double _b, unsigned _id) :
+    x(_x), m(_m), b(_b), id(_id) {}
+
+  static const unsigned kNoBackPointer = ~0u;
 
   double x;                   // x intersection with previous segment in env, or -inf if none
   double m;                   // this line's slope
   double b;                   // intercept with y-axis
+  unsigned id;                // derivation of this line in the ConvexHullArena
+};
+
+// Records how the lines of all envelopes computed in one inside pass were
+// derived, so that the Viterbi translation of every segment can be
+// reconstructed.  Entries refer to their "parents" by index, so creating a
+// line only appends to a vector instead of allocating a node.
+struct ConvexHullArena {
+  struct BackPointer {
+    BackPointer(unsigned p1_, unsigned p2_, const Hypergraph::Edge* edge_) :
+      p1(p1_), p2(p2_), edge(edge_) {}
+    unsigned p1;
+    unsigned p2;
+    // only lines created from an edge using the ConvexHullWeightFunction
+    // have an edge
+    const Hypergraph::Edge* edge;
+  };
 
-  // we keep a pointer to the "parents" of this segment so we can reconstruct
-  // the Viterbi translation corresponding to this segment
-  boost::shared_ptr<MERTPoint> p1;
-  boost::shared_ptr<MERTPoint> p2;
+  unsigned Add(unsigned p1, unsigned p2, const Hypergraph::Edge* edge) {
+    bps.push_back(BackPointer(p1, p2, edge));
+    return bps.size() - 1;
+  }
 
-  // only MERTPoints created from an edge using the ConvexHullWeightFunction
-  // have rules
-  // TRulePtr rule;
-  const Hypergraph::Edge* edge;
+  // recursively recover the Viterbi translation of line id
+  void ConstructTranslation(unsigned id, std::vector<WordID>* trans) const;
+  void CollectEdgesUsed(unsigned id, std::vector<bool>* edges_used) const;
 
-  // recursively recover the Viterbi translation that will result from setting
-  // the weights to origin + axis * x, where x is any value from this->x up
-  // until the next largest x in the containing ConvexHull
-  void ConstructTranslation(std::vector<WordID>* trans) const;
-  void CollectEdgesUsed(std::vector<bool>* edges_used) const;
+  std::vector<BackPointer> bps;
 };
 
 // this is the semiring value type,
 // it defines constructors for 0, 1, and the operations + and *
+//
+// The lines are kept in one flat array; all envelopes built by the same
+// ConvexHullWeightFunction share its arena for their back pointers.
 struct ConvexHull {
   // create semiring zero
   ConvexHull() : is_sorted(true) {}  // zero
-  // for debugging:
-  ConvexHull(const std::vector<boost::shared_ptr<MERTPoint> >& s) : points(s) { Sort(); }
   // create semiring 1 or 0
   explicit ConvexHull(int i);
-  ConvexHull(int n, MERTPoint* point) : is_sorted(true), points(n, boost::shared_ptr<MERTPoint>(point)) {}
+  ConvexHull(const boost::shared_ptr<ConvexHullArena>& arena, double m, double b, const Hypergraph::Edge& edge);
+  // for debugging: adds a line without a derivation
+  void AddLine(double m, double b) {
+    points.push_back(MERTPoint(m, b));
+    is_sorted = false;
+  }
   const ConvexHull& operator+=(const ConvexHull& other);
   const ConvexHull& operator*=(const ConvexHull& other);
   bool IsMultiplicativeIdentity() const {
-    return size() == 1 && (points[0]->b == 0.0 && points[0]->m == 0.0) && (!points[0]->edge) && (!points[0]->p1) && (!points[0]->p2); }
-  const std::vector<boost::shared_ptr<MERTPoint> >& GetSortedSegs() const {
+    return size() == 1 && (points[0].b == 0.0 && points[0].m == 0.0) && points[0].id == MERTPoint::kNoBackPointer; }
+  const std::vector<MERTPoint>& GetSortedSegs() const {
     if (!is_sorted) Sort();
     return points;
   }
   size_t size() const { return points.size(); }
 
+  // recover the Viterbi translation that will result from setting the
+  // weights to origin + axis * x, where x is any value from
+  // GetSortedSegs()[i].x up until the next largest x
+  void ConstructTranslation(unsigned i, std::vector<WordID>* trans) const;
+  void CollectEdgesUsed(unsigned i, std::vector<bool>* edges_used) const;
+
  private:
   bool IsEdgeEnvelope() const {
-    return points.size() == 1 && points[0]->edge; }
+    return points.size() == 1 && points[0].id != MERTPoint::kNoBackPointer && arena->bps[points[0].id].edge; }
+  void ShareArena(const ConvexHull& other);
   void Sort() const;
   mutable bool is_sorted;
-  mutable std::vector<boost::shared_ptr<MERTPoint> > points;
+  mutable std::vector<MERTPoint> points;
+  boost::shared_ptr<ConvexHullArena> arena;
 };
 std::ostream& operator<<(std::ostream& os, const ConvexHull& env);
 
 struct ConvexHullWeightFunction {
   ConvexHullWeightFunction(const SparseVector<double>& ori,
-                           const SparseVector<double>& dir) : origin(ori), direction(dir) {}
+                           const SparseVector<double>& dir) : origin(ori), direction(dir), arena(new ConvexHullArena) {}
   const ConvexHull operator()(const Hypergraph::Edge& e) const;
   const SparseVector<double> origin;
   const SparseVector<double> direction;
+  const boost::shared_ptr<ConvexHullArena> arena;
 };
 
 #endif
@@ -3,6 +3,10 @@
 #include "kbestget.h"
 #include "ksampler.h"
 #include "pairsampling.h"
+#include "shard.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 
 using namespace dtrain;
 
@@ -45,7 +49,10 @@ dtrain_init(int argc, char** argv, po::variables_map* cfg)
     ("batch",             po::value<bool>()->zero_tokens(),                                               "do batch optimization")
     ("repeat",            po::value<unsigned>()->default_value(1),          "repeat optimization over kbest list this number of times")
     ("check",             po::value<bool>()->zero_tokens(),                                  "produce list of loss differentials")
-    ("noup",              po::value<bool>()->zero_tokens(),                                               "do not update weights");
+    ("noup",              po::value<bool>()->zero_tokens(),                                               "do not update weights")
+    ("threads",           po::value<unsigned>()->default_value(1),       "train on this number of shards of the input in parallel")
+    ("mix",               po::value<string>()->default_value("l2 select_k 100000"), "how to mix the weights of the shards, as lplp.rb")
+    ("mix_every",         po::value<unsigned>()->default_value(0),      "also mix after this number of inputs per shard (0: per epoch)");
   po::options_description cl("Command Line Options");
   cl.add_options()
     ("config,c",         po::value<string>(),              "dtrain config file")
@@ -97,9 +104,51 @@ dtrain_init(int argc, char** argv, po::variables_map* cfg)
     cerr << "Wrong 'select_weights' param: '" << (*cfg)["select_weights"].as<string>() << "', use 'last' or 'best'." << endl;
     return false;
   }
+  if ((*cfg)["threads"].as<unsigned>() > 1) {
+    vector<string> mix;
+    boost::split(mix, (*cfg)["mix"].as<string>(), boost::is_any_of(" "));
+    if (mix.size() != 3 || (mix[0] != "l0" && mix[0] != "l1" && mix[0] != "l2" && mix[0] != "linfty"
+          && mix[0] != "mean" && mix[0] != "median") || (mix[1] != "select_k" && mix[1] != "cut")) {
+      cerr << "Wrong 'mix' param: '" << (*cfg)["mix"].as<string>() << "', use '<l0|l1|l2|linfty|mean|median> <select_k|cut> <k|threshold>'." << endl;
+      return false;
+    }
+    if (cfg->count("check")) {
+      cerr << "'check' only works with 1 thread." << endl;
+      return false;
+    }
+  }
   return true;
 }
 
+LocalScorer*
+make_scorer(const string& scorer_str, const unsigned N, const score_t approx_bleu_d)
+{
+  LocalScorer* scorer;
+  if (scorer_str == "bleu") {
+
+    scorer = static_cast<BleuScorer*>(new BleuScorer);
+  } else if (scorer_str == "stupid_bleu") {
+    scorer = static_cast<StupidBleuScorer*>(new StupidBleuScorer);
+  } else if (scorer_str == "fixed_stupid_bleu") {
+    scorer = static_cast<FixedStupidBleuScorer*>(new FixedStupidBleuScorer);
+  } else if (scorer_str == "smooth_bleu") {
+    scorer = static_cast<SmoothBleuScorer*>(new SmoothBleuScorer);
+  } else if (scorer_str == "sum_bleu") {
+    scorer = static_cast<SumBleuScorer*>(new SumBleuScorer);
+  } else if (scorer_str == "sumexp_bleu") {
+    scorer = static_cast<SumExpBleuScorer*>(new SumExpBleuScorer);
+  } else if (scorer_str == "sumwhatever_bleu") {
+    scorer = static_cast<SumWhateverBleuScorer*>(new SumWhateverBleuScorer);
+  } else if (scorer_str == "approx_bleu") {
+    scorer = static_cast<ApproxBleuScorer*>(new ApproxBleuScorer(N, approx_bleu_d));
+  } else if (scorer_str == "lc_bleu") {
+    scorer = static_cast<LinearBleuScorer*>(new LinearBleuScorer(N));
+  } else {
+    return NULL;
+  }
+  return scorer;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -145,6 +194,11 @@ main(int argc, char** argv)
   vector<string> print_weights;
   if (cfg.count("print_weights"))
     boost::split(print_weights, cfg["print_weights"].as<string>(), boost::is_any_of(" "));
+  unsigned threads = cfg["threads"].as<unsigned>();
+  if (threads < 1) threads = 1;
+  vector<string> mix;
+  boost::split(mix, cfg["mix"].as<string>(), boost::is_any_of(" "));
+  const unsigned mix_every = cfg["mix_every"].as<unsigned>();
 
   // setup decoder
   register_feature_functions();
@@ -156,44 +210,15 @@ main(int argc, char** argv)
 
   // scoring metric/scorer
   string scorer_str = cfg["scorer"].as<string>();
-  LocalScorer* scorer;
-  if (scorer_str == "bleu") {
-    scorer = static_cast<BleuScorer*>(new BleuScorer);
-  } else if (scorer_str == "stupid_bleu") {
-    scorer = static_cast<StupidBleuScorer*>(new StupidBleuScorer);
-  } else if (scorer_str == "fixed_stupid_bleu") {
-    scorer = static_cast<FixedStupidBleuScorer*>(new FixedStupidBleuScorer);
-  } else if (scorer_str == "smooth_bleu") {
-    scorer = static_cast<SmoothBleuScorer*>(new SmoothBleuScorer);
-  } else if (scorer_str == "sum_bleu") {
-    scorer = static_cast<SumBleuScorer*>(new SumBleuScorer);
-  } else if (scorer_str == "sumexp_bleu") {
-    scorer = static_cast<SumExpBleuScorer*>(new SumExpBleuScorer);
-  } else if (scorer_str == "sumwhatever_bleu") {
-    scorer = static_cast<SumWhateverBleuScorer*>(new SumWhateverBleuScorer);
-  } else if (scorer_str == "approx_bleu") {
-    scorer = static_cast<ApproxBleuScorer*>(new ApproxBleuScorer(N, approx_bleu_d));
-  } else if (scorer_str == "lc_bleu") {
-    scorer = static_cast<LinearBleuScorer*>(new LinearBleuScorer(N));
-  } else {
+  LocalScorer* scorer = make_scorer(scorer_str, N, approx_bleu_d);
+  if (!scorer) {
     cerr << "Don't know scoring metric: '" << scorer_str << "', exiting." << endl;
     exit(1);
   }
-  vector<score_t> bleu_weights;
-  scorer->Init(N, bleu_weights);
-
-  // setup decoder observer
-  MT19937 rng; // random number generator, only for forest sampling
-  HypSampler* observer;
-  if (sample_from == "kbest")
-    observer = static_cast<KBestGetter*>(new KBestGetter(k, filter_type));
-  else
-    observer = static_cast<KSampler*>(new KSampler(k, &rng));
-  observer->SetScorer(scorer);
 
   // init weights
   vector<weight_t>& decoder_weights = decoder.CurrentWeightVector();
-  SparseVector<weight_t> lambdas, cumulative_penalties, w_average;
+  SparseVector<weight_t> lambdas, w_average;
   if (cfg.count("input_weights")) Weights::InitFromFile(cfg["input_weights"].as<string>(), &decoder_weights);
   Weights::InitSparseVector(decoder_weights, &lambdas);
 
@@ -241,6 +266,29 @@ main(int argc, char** argv)
   }
 
   unsigned in_sz = std::numeric_limits<unsigned>::max(); // input index, input size
+  // with threads, the input is read at once and split into shards
+  const bool buffered = threads > 1;
+  if (buffered) {
+    string in, ref;
+    while ((stop_after == 0 || src_str_buf.size() < stop_after) && getline(*input, in)) {
+      if (read_bitext) {
+        vector<string> strs;
+        boost::algorithm::split_regex(strs, in, boost::regex(" \\|\\|\\| "));
+        in = strs[0];
+        ref = strs[1];
+      } else {
+        getline(*refs, ref);
+      }
+      vector<string> ref_tok;
+      vector<WordID> ref_ids;
+      boost::split(ref_tok, ref, boost::is_any_of(" "));
+      register_and_convert(ref_tok, ref_ids);
+      ref_ids_buf.push_back(ref_ids);
+      src_str_buf.push_back(in);
+    }
+    in_sz = src_str_buf.size();
+    if (threads > in_sz) threads = max(in_sz, 1u);
+  }
   vector<pair<score_t, score_t> > all_scores;
   score_t max_score = 0.;
   unsigned best_it = 0;
@@ -287,14 +335,48 @@ main(int argc, char** argv)
       cerr << setw(25) << "weights in " << "'" << cfg["input_weights"].as<string>() << "'" << endl;
     if (stop_after > 0)
       cerr << setw(25) << "stop_after " << stop_after << endl;
-    if (!verbose) cerr << "(a dot represents " << DTRAIN_DOTS << " inputs)" << endl;
+    if (threads > 1) {
+      cerr << setw(25) << "threads " << threads << endl;
+      cerr << setw(25) << "mix " << "'" << cfg["mix"].as<string>() << "'" << endl;
+      if (mix_every > 0)
+        cerr << setw(25) << "mix every " << mix_every << endl;
+    } else if (!verbose) {
+      cerr << "(a dot represents " << DTRAIN_DOTS << " inputs)" << endl;
+    }
   }
 
-  // pclr
-  SparseVector<weight_t> learning_rates;
-  // batch
-  SparseVector<weight_t> batch_updates;
-  score_t batch_loss;
+  // learners, one per shard of the input
+  LearnerParams params;
+  params.noup = noup;
+  params.check = check;
+  params.batch = batch;
+  params.rescale = rescale;
+  params.scale_bleu_diff = scale_bleu_diff;
+  params.faster_perceptron = faster_perceptron;
+  params.l1naive = l1naive;
+  params.l1clip = l1clip;
+  params.l1cumul = l1cumul;
+  params.pair_sampling = pair_sampling;
+  params.pclr = pclr;
+  params.pair_threshold = pair_threshold;
+  params.max_pairs = max_pairs;
+  params.hi_lo = hi_lo;
+  params.loss_margin = loss_margin;
+  params.gamma = gamma;
+  params.l1_reg = l1_reg;
+  vector<Shard*> shards;
+  for (unsigned i = 0; i < threads; i++) {
+    if (i > 0) scorer = make_scorer(scorer_str, N, approx_bleu_d);
+    vector<score_t> bleu_weights;
+    scorer->Init(N, bleu_weights);
+    shards.push_back(new Shard(params, scorer, sample_from, k, filter_type, eta, repeat));
+    shards[i]->lambdas_ = lambdas;
+    if (threads > 1)
+      for (unsigned j = i*in_sz/threads; j < (i+1)*in_sz/threads; j++)
+        shards[i]->inputs_.push_back(j);
+  }
+  Shard& shard = *shards[0];
+  boost::mutex decoder_mutex;
 
   for (unsigned t = 0; t < T; t++) // T epochs
   {
@@ -304,8 +386,30 @@ main(int argc, char** argv)
   score_t score_sum = 0.;
   score_t model_sum(0);
   unsigned ii = 0, rank_errors = 0, margin_violations = 0, npairs = 0, f_count = 0, list_sz = 0, kbest_loss_improve = 0;
-  batch_loss = 0.;
+  score_t batch_loss = 0.;
   if (!quiet) cerr << "Iteration #" << t+1 << " of " << T << "." << endl;
+  for (unsigned i = 0; i < shards.size(); i++) shards[i]->StartEpoch();
+
+  if (threads > 1) {
+    // the shards learn in rounds of mix_every inputs, with their
+    // weights mixed in between
+    unsigned shard_sz = 0;
+    for (unsigned i = 0; i < shards.size(); i++)
+      shard_sz = max(shard_sz, (unsigned)shards[i]->inputs_.size());
+    const unsigned round_sz = mix_every > 0 ? mix_every : shard_sz;
+    for (unsigned begin = 0; begin < shard_sz; begin += round_sz) {
+      boost::thread_group workers;
+      for (unsigned i = 0; i < shards.size(); i++)
+        workers.create_thread(boost::bind(&Shard::Train, shards[i], &decoder, &decoder_mutex,
+                                          &src_str_buf, &ref_ids_buf, begin, begin + round_sz, verbose));
+      workers.join_all();
+      if (begin + round_sz < shard_sz) {
+        mix_weights(shards, mix[0], mix[1], boost::lexical_cast<score_t>(mix[2]), lambdas);
+        for (unsigned i = 0; i < shards.size(); i++) shards[i]->lambdas_ = lambdas;
+      }
+      if (!quiet) cerr << " " << min(begin + round_sz, shard_sz) << " inputs per shard" << endl;
+    }
+  } else {
 
   while(true)
   {
@@ -313,9 +417,10 @@ main(int argc, char** argv)
     string in;
     string ref;
     bool next = false, stop = false; // next iteration or premature stop
-    if (t == 0) {
+    const bool from_input = t == 0 && !buffered;
+    if (from_input) {
       if(!getline(*input, in)) next = true;
-      if(read_bitext) {
+      if(read_bitext && !next) {
         vector<string> strs;
         boost::algorithm::split_regex(strs, in, boost::regex(" \\|\\|\\| "));
         in = strs[0];
@@ -352,11 +457,11 @@ main(int argc, char** argv)
     if (next || stop) break;
 
     // weights
-    lambdas.init_vector(&decoder_weights);
+    shard.lambdas_.init_vector(&decoder_weights);
 
     // getting input
     vector<WordID> ref_ids; // reference as vector<WordID>
-    if (t == 0) {
+    if (from_input) {
       if (!read_bitext) {
         getline(*refs, ref);
       }
@@ -368,215 +473,51 @@ main(int argc, char** argv)
     } else {
       ref_ids = ref_ids_buf[ii];
     }
-    observer->SetRef(ref_ids);
-    if (t == 0)
-      decoder.Decode(in, observer);
+    shard.sampler_->SetRef(ref_ids);
+    if (from_input)
+      decoder.Decode(in, shard.sampler_);
     else
-      decoder.Decode(src_str_buf[ii], observer);
+      decoder.Decode(src_str_buf[ii], shard.sampler_);
 
     // get (scored) samples
-    vector<ScoredHyp>* samples = observer->GetSamples();
-
-    if (verbose) {
-      cerr << "--- ref for " << ii << ": ";
-      if (t > 0) printWordIDVec(ref_ids_buf[ii]);
-      else printWordIDVec(ref_ids);
-      cerr << endl;
-      for (unsigned u = 0; u < samples->size(); u++) {
-        cerr << _p2 << _np << "[" << u << ". '";
-        printWordIDVec((*samples)[u].w);
-        cerr << "'" << endl;
-        cerr << "SCORE=" << (*samples)[u].score << ",model="<< (*samples)[u].model << endl;
-        cerr << "F{" << (*samples)[u].f << "} ]" << endl << endl;
-      }
-    }
-
-    if (repeat == 1) {
-      score_sum += (*samples)[0].score; // stats for 1best
-      model_sum += (*samples)[0].model;
-    }
-
-    f_count += observer->get_f_count();
-    list_sz += observer->get_sz();
-
-    // weight updates
-    if (!noup) {
-      // get pairs
-      vector<pair<ScoredHyp,ScoredHyp> > pairs;
-      if (pair_sampling == "all")
-        all_pairs(samples, pairs, pair_threshold, max_pairs, faster_perceptron);
-      if (pair_sampling == "XYX")
-        partXYX(samples, pairs, pair_threshold, max_pairs, faster_perceptron, hi_lo);
-      if (pair_sampling == "PRO")
-        PROsampling(samples, pairs, pair_threshold, max_pairs);
-      int cur_npairs = pairs.size();
-      npairs += cur_npairs;
-
-      score_t kbest_loss_first = 0.0, kbest_loss_last = 0.0;
-
-      if (check) repeat = 2;
-      vector<float> losses; // for check
-
-      for (vector<pair<ScoredHyp,ScoredHyp> >::iterator it = pairs.begin();
-           it != pairs.end(); it++) {
-        score_t model_diff = it->first.model - it->second.model;
-        score_t loss = max(0.0, -1.0 * model_diff);
-        losses.push_back(loss);
-        kbest_loss_first += loss;
-      }
+    vector<ScoredHyp>* samples = shard.sampler_->GetSamples();
 
-      score_t kbest_loss = 0.0;
-      for (int ki=0; ki < repeat; ki++) {
+    if (verbose) print_samples(ii, ref_ids, samples);
 
-      SparseVector<weight_t> lambdas_copy; // for l1 regularization
-      SparseVector<weight_t> sum_up; // for pclr
-      if (l1naive||l1clip||l1cumul) lambdas_copy = lambdas;
-
-      unsigned pair_idx = 0; // for check
-      for (vector<pair<ScoredHyp,ScoredHyp> >::iterator it = pairs.begin();
-           it != pairs.end(); it++) {
-        score_t model_diff = it->first.model - it->second.model;
-        score_t loss = max(0.0, -1.0 * model_diff);
-
-        if (check && ki==repeat-1) cout << losses[pair_idx] - loss << endl;
-        pair_idx++;
-
-        if (repeat > 1) {
-          model_diff = lambdas.dot(it->first.f) - lambdas.dot(it->second.f);
-          kbest_loss += loss;
-        }
-        bool rank_error = false;
-        score_t margin;
-        if (faster_perceptron) { // we only have considering misranked pairs
-          rank_error = true; // pair sampling already did this for us
-          margin = std::numeric_limits<float>::max();
-        } else {
-          rank_error = model_diff<=0.0;
-          margin = fabs(model_diff);
-          if (!rank_error && margin < loss_margin) margin_violations++;
-        }
-        if (rank_error && ki==0) rank_errors++;
-        if (scale_bleu_diff) eta = it->first.score - it->second.score;
-        if (rank_error || margin < loss_margin) {
-          SparseVector<weight_t> diff_vec = it->first.f - it->second.f;
-          if (batch) {
-            batch_loss += max(0., -1.0 * model_diff);
-            batch_updates += diff_vec;
-            continue;
-          }
-          if (pclr != "no") {
-            sum_up += diff_vec;
-          } else {
-            lambdas.plus_eq_v_times_s(diff_vec, eta);
-            if (gamma) lambdas.plus_eq_v_times_s(lambdas, -2*gamma*eta*(1./cur_npairs));
-          }
-        }
-      }
-
-      // per-coordinate learning rate
-      if (pclr != "no") {
-        SparseVector<weight_t>::iterator it = sum_up.begin();
-        for (; it != sum_up.end(); ++it) {
-          if (pclr == "simple") {
-           lambdas[it->first] += it->second / max(1.0, learning_rates[it->first]);
-           learning_rates[it->first]++;
-          } else if (pclr == "adagrad") {
-            if (learning_rates[it->first] == 0) {
-             lambdas[it->first] +=  it->second * eta;
-            } else {
-             lambdas[it->first] +=  it->second * eta * learning_rates[it->first];
-            }
-            learning_rates[it->first] += pow(it->second, 2.0);
-          }
-        }
-      }
-
-      // l1 regularization
-      // please note that this regularizations happen
-      // after a _sentence_ -- not after each example/pair!
-      if (l1naive) {
-        SparseVector<weight_t>::iterator it = lambdas.begin();
-        for (; it != lambdas.end(); ++it) {
-          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
-              it->second *= max(0.0000001, eta/(eta+learning_rates[it->first])); // FIXME
-              learning_rates[it->first]++;
-            it->second -= sign(it->second) * l1_reg;
-          }
-        }
-      } else if (l1clip) {
-        SparseVector<weight_t>::iterator it = lambdas.begin();
-        for (; it != lambdas.end(); ++it) {
-          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
-            if (it->second != 0) {
-              weight_t v = it->second;
-              if (v > 0) {
-                it->second = max(0., v - l1_reg);
-              } else {
-                it->second = min(0., v + l1_reg);
-              }
-            }
-          }
-        }
-      } else if (l1cumul) {
-        weight_t acc_penalty = (ii+1) * l1_reg; // ii is the index of the current input
-        SparseVector<weight_t>::iterator it = lambdas.begin();
-        for (; it != lambdas.end(); ++it) {
-          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
-            if (it->second != 0) {
-              weight_t v = it->second;
-              weight_t penalized = 0.;
-              if (v > 0) {
-                penalized = max(0., v-(acc_penalty + cumulative_penalties.get(it->first)));
-              } else {
-                penalized = min(0., v+(acc_penalty - cumulative_penalties.get(it->first)));
-              }
-              it->second = penalized;
-              cumulative_penalties.set_value(it->first, cumulative_penalties.get(it->first)+penalized);
-            }
-          }
-        }
-      }
-
-      if (ki==repeat-1) { // done
-        kbest_loss_last = kbest_loss;
-        if (repeat > 1) {
-          score_t best_model = -std::numeric_limits<score_t>::max();
-          unsigned best_idx = 0;
-          for (unsigned i=0; i < samples->size(); i++) {
-            score_t s = lambdas.dot((*samples)[i].f);
-            if (s > best_model) {
-              best_idx = i;
-              best_model = s;
-            }
-          }
-          score_sum += (*samples)[best_idx].score;
-          model_sum += best_model;
-        }
-      }
-    } // repeat
-
-    if ((kbest_loss_first - kbest_loss_last) >= 0) kbest_loss_improve++;
-
-    } // noup
-
-    if (rescale) lambdas /= lambdas.l2norm();
+    shard.Learn(samples);
 
     ++ii;
 
   } // input loop
 
-  if (t == 0) in_sz = ii; // remember size of input (# lines)
+  if (t == 0 && !buffered) in_sz = ii; // remember size of input (# lines)
 
+  }
 
-  if (batch) {
-    lambdas.plus_eq_v_times_s(batch_updates, eta);
-    if (gamma) lambdas.plus_eq_v_times_s(lambdas, -2*gamma*eta*(1./npairs));
-    batch_updates.clear();
+  for (unsigned i = 0; i < shards.size(); i++) {
+    Shard& s = *shards[i];
+    s.EndEpoch();
+    score_sum += s.score_sum_;
+    model_sum += s.model_sum_;
+    batch_loss += s.batch_loss_;
+    rank_errors += s.rank_errors_;
+    margin_violations += s.margin_violations_;
+    npairs += s.npairs_;
+    f_count += s.f_count_;
+    list_sz += s.list_sz_;
+    kbest_loss_improve += s.kbest_loss_improve_;
+  }
+  if (threads > 1) {
+    mix_weights(shards, mix[0], mix[1], boost::lexical_cast<score_t>(mix[2]), lambdas);
+    for (unsigned i = 0; i < shards.size(); i++) shards[i]->lambdas_ = lambdas;
+  } else {
+    lambdas = shard.lambdas_;
   }
 
   if (average) w_average += lambdas;
 
-  if (scorer_str == "approx_bleu" || scorer_str == "lc_bleu") scorer->Reset();
+  if (scorer_str == "approx_bleu" || scorer_str == "lc_bleu")
+    for (unsigned i = 0; i < shards.size(); i++) shards[i]->scorer_->Reset();
 
   // print some stats
   score_t score_avg = score_sum/(score_t)in_sz;
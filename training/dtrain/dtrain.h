@@ -91,12 +91,28 @@ struct HypSampler : public DecoderObserver
   vector<WordID>* ref_;
   unsigned f_count_, sz_;
   virtual vector<ScoredHyp>* GetSamples()=0;
+  virtual void SampleFrom(const Hypergraph& forest, const unsigned src_len)=0;
   inline void SetScorer(LocalScorer* scorer) { scorer_ = scorer; }
   inline void SetRef(vector<WordID>& ref) { ref_ = &ref; }
   inline unsigned get_f_count() { return f_count_; }
   inline unsigned get_sz() { return sz_; }
 };
 
+// keeps a copy of the forest, to be sampled from while the decoder translates
+// the next input
+struct ForestCopier : public DecoderObserver
+{
+  Hypergraph forest_;
+  unsigned src_len_;
+
+  virtual void
+  NotifyTranslationForest(const SentenceMetadata& smeta, Hypergraph* hg)
+  {
+    forest_ = *hg;
+    src_len_ = smeta.GetSourceLength();
+  }
+};
+
 struct HSReporter
 {
   string task_id_;
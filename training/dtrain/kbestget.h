@@ -20,8 +20,14 @@ struct KBestGetter : public HypSampler
   virtual void
   NotifyTranslationForest(const SentenceMetadata& smeta, Hypergraph* hg)
   {
-    src_len_ = smeta.GetSourceLength();
-    KBestScored(*hg);
+    SampleFrom(*hg, smeta.GetSourceLength());
+  }
+
+  void
+  SampleFrom(const Hypergraph& forest, const unsigned src_len)
+  {
+    src_len_ = src_len;
+    KBestScored(forest);
   }
 
   vector<ScoredHyp>* GetSamples() { return &s_; }
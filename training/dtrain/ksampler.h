@@ -27,8 +27,14 @@ struct KSampler : public HypSampler
   virtual void
   NotifyTranslationForest(const SentenceMetadata& smeta, Hypergraph* hg)
   {
-    src_len_ = smeta.GetSourceLength();
-    ScoredSamples(*hg);
+    SampleFrom(*hg, smeta.GetSourceLength());
+  }
+
+  void
+  SampleFrom(const Hypergraph& forest, const unsigned src_len)
+  {
+    src_len_ = src_len;
+    ScoredSamples(forest);
   }
 
   vector<ScoredHyp>* GetSamples() { return &s_; }
@@ -0,0 +1,365 @@
+#ifndef _DTRAIN_SHARD_H_
+#define _DTRAIN_SHARD_H_
+
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
+namespace dtrain
+{
+
+
+inline void
+print_samples(unsigned ii, vector<WordID>& ref, vector<ScoredHyp>* samples)
+{
+  cerr << "--- ref for " << ii << ": ";
+  printWordIDVec(ref);
+  cerr << endl;
+  for (unsigned u = 0; u < samples->size(); u++) {
+    cerr << _p2 << _np << "[" << u << ". '";
+    printWordIDVec((*samples)[u].w);
+    cerr << "'" << endl;
+    cerr << "SCORE=" << (*samples)[u].score << ",model="<< (*samples)[u].model << endl;
+    cerr << "F{" << (*samples)[u].f << "} ]" << endl << endl;
+  }
+}
+
+// learner parameters, shared by all shards
+struct LearnerParams
+{
+  bool noup, check, batch, rescale, scale_bleu_diff, faster_perceptron;
+  bool l1naive, l1clip, l1cumul;
+  string pair_sampling, pclr;
+  score_t pair_threshold;
+  unsigned max_pairs;
+  float hi_lo;
+  weight_t loss_margin, gamma, l1_reg;
+};
+
+/*
+ * a learner with its own weights, scorer and sampler, trained on a shard
+ * of the input; with --threads each shard is trained by its own thread and
+ * the weights of the shards are mixed in memory (see mix_weights)
+ */
+struct Shard
+{
+  const LearnerParams& p_;
+  LocalScorer* scorer_;
+  MT19937 rng_; // only for forest sampling
+  HypSampler* sampler_;
+  ForestCopier copier_;
+  vector<unsigned> inputs_; // indexes of the shard's inputs (--threads)
+
+  SparseVector<weight_t> lambdas_, cumulative_penalties_;
+  SparseVector<weight_t> learning_rates_; // pclr
+  SparseVector<weight_t> batch_updates_;  // batch
+  weight_t eta_;
+  int repeat_;
+
+  // stats for the current epoch
+  score_t score_sum_, model_sum_, batch_loss_;
+  unsigned ii_, rank_errors_, margin_violations_, npairs_, f_count_, list_sz_, kbest_loss_improve_;
+
+  Shard(const LearnerParams& p, LocalScorer* scorer, const string& sample_from,
+        const unsigned k, const string& filter_type, weight_t eta, int repeat) :
+    p_(p), scorer_(scorer), eta_(eta), repeat_(repeat)
+  {
+    if (sample_from == "kbest")
+      sampler_ = static_cast<KBestGetter*>(new KBestGetter(k, filter_type));
+    else
+      sampler_ = static_cast<KSampler*>(new KSampler(k, &rng_));
+    sampler_->SetScorer(scorer_);
+  }
+
+  void
+  StartEpoch()
+  {
+    score_sum_ = model_sum_ = batch_loss_ = 0.;
+    ii_ = rank_errors_ = margin_violations_ = npairs_ = f_count_ = list_sz_ = kbest_loss_improve_ = 0;
+  }
+
+  // updates the weights with the pairs sampled from one input's samples
+  void
+  Learn(vector<ScoredHyp>* samples)
+  {
+    if (repeat_ == 1) {
+      score_sum_ += (*samples)[0].score; // stats for 1best
+      model_sum_ += (*samples)[0].model;
+    }
+
+    f_count_ += sampler_->get_f_count();
+    list_sz_ += sampler_->get_sz();
+
+    // weight updates
+    if (!p_.noup) {
+      // get pairs
+      vector<pair<ScoredHyp,ScoredHyp> > pairs;
+      if (p_.pair_sampling == "all")
+        all_pairs(samples, pairs, p_.pair_threshold, p_.max_pairs, p_.faster_perceptron);
+      if (p_.pair_sampling == "XYX")
+        partXYX(samples, pairs, p_.pair_threshold, p_.max_pairs, p_.faster_perceptron, p_.hi_lo);
+      if (p_.pair_sampling == "PRO")
+        PROsampling(samples, pairs, p_.pair_threshold, p_.max_pairs);
+      int cur_npairs = pairs.size();
+      npairs_ += cur_npairs;
+
+      score_t kbest_loss_first = 0.0, kbest_loss_last = 0.0;
+
+      if (p_.check) repeat_ = 2;
+      vector<float> losses; // for check
+
+      for (vector<pair<ScoredHyp,ScoredHyp> >::iterator it = pairs.begin();
+           it != pairs.end(); it++) {
+        score_t model_diff = it->first.model - it->second.model;
+        score_t loss = max(0.0, -1.0 * model_diff);
+        losses.push_back(loss);
+        kbest_loss_first += loss;
+      }
+
+      score_t kbest_loss = 0.0;
+      for (int ki=0; ki < repeat_; ki++) {
+
+      SparseVector<weight_t> lambdas_copy; // for l1 regularization
+      SparseVector<weight_t> sum_up; // for pclr
+      if (p_.l1naive||p_.l1clip||p_.l1cumul) lambdas_copy = lambdas_;
+
+      unsigned pair_idx = 0; // for check
+      for (vector<pair<ScoredHyp,ScoredHyp> >::iterator it = pairs.begin();
+           it != pairs.end(); it++) {
+        score_t model_diff = it->first.model - it->second.model;
+        score_t loss = max(0.0, -1.0 * model_diff);
+
+        if (p_.check && ki==repeat_-1) cout << losses[pair_idx] - loss << endl;
+        pair_idx++;
+
+        if (repeat_ > 1) {
+          model_diff = lambdas_.dot(it->first.f) - lambdas_.dot(it->second.f);
+          kbest_loss += loss;
+        }
+        bool rank_error = false;
+        score_t margin;
+        if (p_.faster_perceptron) { // we only have considering misranked pairs
+          rank_error = true; // pair sampling already did this for us
+          margin = std::numeric_limits<float>::max();
+        } else {
+          rank_error = model_diff<=0.0;
+          margin = fabs(model_diff);
+          if (!rank_error && margin < p_.loss_margin) margin_violations_++;
+        }
+        if (rank_error && ki==0) rank_errors_++;
+        if (p_.scale_bleu_diff) eta_ = it->first.score - it->second.score;
+        if (rank_error || margin < p_.loss_margin) {
+          SparseVector<weight_t> diff_vec = it->first.f - it->second.f;
+          if (p_.batch) {
+            batch_loss_ += max(0., -1.0 * model_diff);
+            batch_updates_ += diff_vec;
+            continue;
+          }
+          if (p_.pclr != "no") {
+            sum_up += diff_vec;
+          } else {
+            lambdas_.plus_eq_v_times_s(diff_vec, eta_);
+            if (p_.gamma) lambdas_.plus_eq_v_times_s(lambdas_, -2*p_.gamma*eta_*(1./cur_npairs));
+          }
+        }
+      }
+
+      // per-coordinate learning rate
+      if (p_.pclr != "no") {
+        SparseVector<weight_t>::iterator it = sum_up.begin();
+        for (; it != sum_up.end(); ++it) {
+          if (p_.pclr == "simple") {
+           lambdas_[it->first] += it->second / max(1.0, learning_rates_[it->first]);
+           learning_rates_[it->first]++;
+          } else if (p_.pclr == "adagrad") {
+            if (learning_rates_[it->first] == 0) {
+             lambdas_[it->first] +=  it->second * eta_;
+            } else {
+             lambdas_[it->first] +=  it->second * eta_ * learning_rates_[it->first];
+            }
+            learning_rates_[it->first] += pow(it->second, 2.0);
+          }
+        }
+      }
+
+      // l1 regularization
+      // please note that this regularizations happen
+      // after a _sentence_ -- not after each example/pair!
+      if (p_.l1naive) {
+        SparseVector<weight_t>::iterator it = lambdas_.begin();
+        for (; it != lambdas_.end(); ++it) {
+          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
+              it->second *= max(0.0000001, eta_/(eta_+learning_rates_[it->first])); // FIXME
+              learning_rates_[it->first]++;
+            it->second -= sign(it->second) * p_.l1_reg;
+          }
+        }
+      } else if (p_.l1clip) {
+        SparseVector<weight_t>::iterator it = lambdas_.begin();
+        for (; it != lambdas_.end(); ++it) {
+          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
+            if (it->second != 0) {
+              weight_t v = it->second;
+              if (v > 0) {
+                it->second = max(0., v - p_.l1_reg);
+              } else {
+                it->second = min(0., v + p_.l1_reg);
+              }
+            }
+          }
+        }
+      } else if (p_.l1cumul) {
+        weight_t acc_penalty = (ii_+1) * p_.l1_reg; // ii_ is the index of the current input
+        SparseVector<weight_t>::iterator it = lambdas_.begin();
+        for (; it != lambdas_.end(); ++it) {
+          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
+            if (it->second != 0) {
+              weight_t v = it->second;
+              weight_t penalized = 0.;
+              if (v > 0) {
+                penalized = max(0., v-(acc_penalty + cumulative_penalties_.get(it->first)));
+              } else {
+                penalized = min(0., v+(acc_penalty - cumulative_penalties_.get(it->first)));
+              }
+              it->second = penalized;
+              cumulative_penalties_.set_value(it->first, cumulative_penalties_.get(it->first)+penalized);
+            }
+          }
+        }
+      }
+
+      if (ki==repeat_-1) { // done
+        kbest_loss_last = kbest_loss;
+        if (repeat_ > 1) {
+          score_t best_model = -std::numeric_limits<score_t>::max();
+          unsigned best_idx = 0;
+          for (unsigned i=0; i < samples->size(); i++) {
+            score_t s = lambdas_.dot((*samples)[i].f);
+            if (s > best_model) {
+              best_idx = i;
+              best_model = s;
+            }
+          }
+          score_sum_ += (*samples)[best_idx].score;
+          model_sum_ += best_model;
+        }
+      }
+    } // repeat
+
+    if ((kbest_loss_first - kbest_loss_last) >= 0) kbest_loss_improve_++;
+
+    } // noup
+
+    if (p_.rescale) lambdas_ /= lambdas_.l2norm();
+
+    ++ii_;
+  }
+
+  // applies the batch update of the epoch
+  void
+  EndEpoch()
+  {
+    if (p_.batch) {
+      lambdas_.plus_eq_v_times_s(batch_updates_, eta_);
+      if (p_.gamma) lambdas_.plus_eq_v_times_s(lambdas_, -2*p_.gamma*eta_*(1./npairs_));
+      batch_updates_.clear();
+    }
+  }
+
+  /*
+   * learns from the shard's inputs [begin, end); only one shard decodes at a
+   * time (the decoder and the dictionaries are shared), the forest is copied
+   * and sampled, scored and learned from while other shards decode
+   */
+  void
+  Train(Decoder* decoder, boost::mutex* decoder_mutex, const vector<string>* src,
+        vector<vector<WordID> >* refs, unsigned begin, unsigned end, bool verbose)
+  {
+    for (unsigned i = begin; i < end && i < inputs_.size(); i++) {
+      const unsigned id = inputs_[i];
+      {
+        boost::mutex::scoped_lock lock(*decoder_mutex);
+        lambdas_.init_vector(&decoder->CurrentWeightVector());
+        copier_.forest_.clear();
+        decoder->Decode((*src)[id], &copier_);
+      }
+      if (copier_.forest_.nodes_.empty()) continue; // no translation
+      sampler_->SetRef((*refs)[id]);
+      sampler_->SampleFrom(copier_.forest_, copier_.src_len_);
+      vector<ScoredHyp>* samples = sampler_->GetSamples();
+      if (verbose) {
+        boost::mutex::scoped_lock lock(*decoder_mutex);
+        print_samples(id, (*refs)[id], samples);
+      }
+      Learn(samples);
+    }
+  }
+};
+
+inline score_t
+column_norm(const string& norm, vector<weight_t>& column, unsigned n)
+{
+  score_t r = 0.;
+  if (norm == "l0") {
+    r = column.size() >= n ? 1 : 0;
+  } else if (norm == "l1") {
+    for (unsigned i = 0; i < column.size(); i++) r += fabs(column[i]);
+  } else if (norm == "l2") {
+    for (unsigned i = 0; i < column.size(); i++) r += column[i]*column[i];
+    r = sqrt(r);
+  } else if (norm == "linfty") {
+    for (unsigned i = 0; i < column.size(); i++) r = max(r, fabs(column[i]));
+  } else if (norm == "mean") {
+    for (unsigned i = 0; i < column.size(); i++) r += column[i];
+    r /= n;
+  } else if (norm == "median") {
+    vector<weight_t> padded(column);
+    padded.resize(max((unsigned)column.size(), n), 0.);
+    sort(padded.begin(), padded.end());
+    r = padded[padded.size()/2];
+  }
+  return r;
+}
+
+inline bool
+cmp_norm_d(const pair<score_t, unsigned>& a, const pair<score_t, unsigned>& b)
+{
+  return a.first > b.first;
+}
+
+/*
+ * mixes the weights of the shards like lplp.rb: features are ranked by the
+ * norm of their column of non-zero weights, and the top k ('select_k') or
+ * those with a norm of at least x ('cut') get their mean weight over
+ * all shards
+ */
+inline void
+mix_weights(const vector<Shard*>& shards, const string& norm, const string& type,
+            score_t x, SparseVector<weight_t>& mixed)
+{
+  const unsigned n = shards.size();
+  map<unsigned, vector<weight_t> > columns;
+  for (unsigned s = 0; s < n; s++) {
+    const SparseVector<weight_t>& w = shards[s]->lambdas_;
+    for (SparseVector<weight_t>::const_iterator it = w.begin(); it != w.end(); ++it)
+      if (it->second != 0) columns[it->first].push_back(it->second);
+  }
+  vector<pair<score_t, unsigned> > ranked;
+  for (map<unsigned, vector<weight_t> >::iterator it = columns.begin(); it != columns.end(); ++it)
+    ranked.push_back(make_pair(column_norm(norm, it->second, n), it->first));
+  if (type == "select_k") {
+    stable_sort(ranked.begin(), ranked.end(), cmp_norm_d);
+    if (x >= 1 && x < ranked.size()) ranked.resize((unsigned)x);
+  }
+  mixed.clear();
+  for (unsigned i = 0; i < ranked.size(); i++) {
+    if (type == "cut" && fabs(ranked[i].first) < x) continue;
+    mixed.set_value(ranked[i].second, column_norm("mean", columns[ranked[i].second], n));
+  }
+}
+
+
+} // namespace
+
+#endif
+
@@ -3,6 +3,7 @@
 #include <vector>
 #include <limits>
 
+#include <boost/scoped_ptr.hpp>
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 
@@ -16,6 +17,7 @@
 #include "ns.h"
 #include "ns_docscorer.h"
 #include "candidate_set.h"
+#include "candidate_store.h"
 #include "risk.h"
 #include "entropy.h"
 
@@ -161,29 +163,39 @@ int main(int argc, char** argv) {
   string line, file;
   vector<training::CandidateSet> kis;
   cerr << "Loading hypergraphs...\n";
+  // the pools are kept in a CandidateStore; pools of sentences it doesn't
+  // have yet are read from the text files of earlier versions
+  boost::scoped_ptr<training::CandidateStore> store;
+  boost::scoped_ptr<training::CandidateStoreWriter> writer;
+  if (kbest_repo.size()) {
+    const string store_file = kbest_repo + "/candidates.bin";
+    if (FileExists(store_file)) store.reset(new training::CandidateStore(store_file));
+    writer.reset(new training::CandidateStoreWriter(store_file));
+  }
   while(getline(in, line)) {
     istringstream is(line);
     int sent_id = 0;
+    is >> file >> sent_id;
     kis.resize(kis.size() + 1);
     training::CandidateSet& curkbest = kis.back();
-    string kbest_file;
-    if (kbest_repo.size()) {
+    if (store && store->Has(sent_id)) {
+      store->Read(sent_id, &curkbest);
+    } else if (kbest_repo.size()) {
       ostringstream os;
       os << kbest_repo << "/kbest." << sent_id << ".txt.gz";
-      kbest_file = os.str();
+      const string kbest_file = os.str();
       if (FileExists(kbest_file))
         curkbest.ReadFromFile(kbest_file);
     }
-    is >> file >> sent_id;
     ReadFile rf(file);
     if (kis.size() % 5 == 0) { cerr << '.'; }
     if (kis.size() % 200 == 0) { cerr << " [" << kis.size() << "]\n"; }
     HypergraphIO::ReadFromBinary(rf.stream(), &hg);
     hg.Reweight(weights);
     curkbest.AddKBestCandidates(hg, kbest_size, ds[sent_id]);
-    if (kbest_file.size())
-      curkbest.WriteToFile(kbest_file);
+    if (writer) writer->Add(sent_id, curkbest);
   }
+  if (writer) writer->Close();
   cerr << "\nHypergraphs loaded.\n";
   weights.resize(FD::NumFeats());
 
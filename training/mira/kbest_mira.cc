@@ -1,12 +1,19 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <climits>
 
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "stringlib.h"
 #include "hg_sampler.h"
@@ -57,6 +64,9 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("sample_forest,f", "Instead of a k-best list, sample k hypotheses from the decoder's forest")
         ("sample_forest_unit_weight_vector,x", "Before sampling (must use -f option), rescale the weight vector used so it has unit length; this may improve the quality of the samples")
         ("random_seed,S", po::value<uint32_t>(), "Random seed (if not specified, /dev/random will be used)")
+        ("minibatch_size,b", po::value<unsigned>()->default_value(1), "Number of sentences decoded with the same weights before they are updated")
+        ("mix_updates", "Average the updates of a minibatch, all computed against the weights it was decoded with (iterative parameter mixing), instead of applying them one after another")
+        ("threads,j", po::value<unsigned>()->default_value(1), "Number of threads searching the forests of a minibatch for oracles while decoding continues")
         ("decoder_config,c",po::value<string>(),"Decoder configuration file");
   po::options_description clo("Command line options");
   clo.add_options()
@@ -90,23 +100,87 @@ struct HypothesisInfo {
 struct GoodBadOracle {
   boost::shared_ptr<HypothesisInfo> good;
   boost::shared_ptr<HypothesisInfo> bad;
+  boost::shared_ptr<HypothesisInfo> best;  // model best of the last decode
 };
 
 struct TrainingObserver : public DecoderObserver {
-  TrainingObserver(const int k, const DocumentScorer& d, const EvaluationMetric& m, bool sf, vector<GoodBadOracle>* o) : ds(d), metric(m), oracles(*o), kbest_size(k), sample_forest(sf) {}
+  TrainingObserver(const int k, const DocumentScorer& d, const EvaluationMetric& m, bool sf, vector<GoodBadOracle>* o, unsigned threads) : ds(d), metric(m), oracles(*o), kbest_size(k), sample_forest(sf), busy(), done() {
+    for (unsigned i = 0; i < threads; ++i)
+      workers.create_thread(boost::bind(&TrainingObserver::Work, this));
+  }
+  ~TrainingObserver() {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      done = true;
+    }
+    has_job.notify_all();
+    workers.join_all();
+  }
   const DocumentScorer& ds;
   const EvaluationMetric& metric;
   vector<GoodBadOracle>& oracles;
-  boost::shared_ptr<HypothesisInfo> cur_best;
   const int kbest_size;
   const bool sample_forest;
 
-  const HypothesisInfo& GetCurrentBestHypothesis() const {
-    return *cur_best;
-  }
+  // with worker threads, the forests are copied and searched for oracles
+  // while the decoder goes on with the rest of the minibatch
+  struct Job {
+    int sent_id;
+    Hypergraph forest;
+    uint32_t seed;
+  };
+  boost::thread_group workers;
+  boost::mutex mutex;
+  boost::condition_variable has_job, has_space, drained;
+  deque<Job*> queue;
+  unsigned busy;  // jobs queued or being worked on
+  bool done;
 
   virtual void NotifyTranslationForest(const SentenceMetadata& smeta, Hypergraph* hg) {
-    UpdateOracles(smeta.GetSentenceID(), *hg);
+    if (workers.size() == 0) {
+      UpdateOracles(smeta.GetSentenceID(), *hg, &*rng);
+      return;
+    }
+    Job* job = new Job;
+    job->sent_id = smeta.GetSentenceID();
+    job->forest = *hg;
+    job->seed = sample_forest ? rng->next() * UINT_MAX : 0;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      while (queue.size() >= 2 * workers.size()) has_space.wait(lock);
+      queue.push_back(job);
+      ++busy;
+    }
+    has_job.notify_one();
+  }
+
+  // waits until the oracles of every decoded sentence are known
+  void Wait() {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (busy) drained.wait(lock);
+  }
+
+  void Work() {
+    while (true) {
+      Job* job;
+      {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (queue.empty() && !done) has_job.wait(lock);
+        if (queue.empty()) return;
+        job = queue.front();
+        queue.pop_front();
+      }
+      has_space.notify_one();
+      MT19937 job_rng(job->seed);
+      UpdateOracles(job->sent_id, job->forest, &job_rng);
+      delete job;
+      bool last;
+      {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        last = (--busy == 0);
+      }
+      if (last) drained.notify_all();
+    }
   }
 
   boost::shared_ptr<HypothesisInfo> MakeHypothesisInfo(const SparseVector<double>& feats, const double score) {
@@ -116,9 +190,12 @@ struct TrainingObserver : public DecoderObserver {
     return h;
   }
 
-  void UpdateOracles(int sent_id, const Hypergraph& forest) {
+  // only touches the oracles of sent_id, so different sentences can be
+  // searched at the same time
+  void UpdateOracles(int sent_id, const Hypergraph& forest, MT19937* rng) {
     boost::shared_ptr<HypothesisInfo>& cur_good = oracles[sent_id].good;
     boost::shared_ptr<HypothesisInfo>& cur_bad = oracles[sent_id].bad;
+    boost::shared_ptr<HypothesisInfo>& cur_best = oracles[sent_id].best;
     cur_bad.reset();  // TODO get rid of??
 
     if (sample_forest) {
@@ -130,7 +207,7 @@ struct TrainingObserver : public DecoderObserver {
       cur_best = MakeHypothesisInfo(ViterbiFeatures(forest), sentscore);
 
       vector<HypergraphSampler::Hypothesis> samples;
-      HypergraphSampler::sample_hypotheses(forest, kbest_size, &*rng, &samples);
+      HypergraphSampler::sample_hypotheses(forest, kbest_size, rng, &samples);
       for (unsigned i = 0; i < samples.size(); ++i) {
         ds[sent_id]->Evaluate(samples[i].words, &sstats);
         float sentscore = metric.ComputeScore(sstats);
@@ -234,7 +311,15 @@ int main(int argc, char** argv) {
   assert(corpus.size() > 0);
   vector<GoodBadOracle> oracles(corpus.size());
 
-  TrainingObserver observer(conf["k_best_size"].as<int>(), ds, *metric, sample_forest, &oracles);
+  const unsigned minibatch_size = max(conf["minibatch_size"].as<unsigned>(), 1u);
+  const bool mix_updates = conf.count("mix_updates") > 0;
+  unsigned threads = conf["threads"].as<unsigned>();
+  if (threads > 1 && !metric->IsThreadSafe()) {
+    cerr << metric_name << " can't be computed by several threads, using one\n";
+    threads = 1;
+  }
+  // with one thread the forests are searched for oracles as they are decoded
+  TrainingObserver observer(conf["k_best_size"].as<int>(), ds, *metric, sample_forest, &oracles, threads > 1 ? threads : 0);
   int cur_sent = 0;
   int lcount = 0;
   int normalizer = 0;
@@ -272,7 +357,8 @@ int main(int argc, char** argv) {
     if (cur_sent == 0) {
       cerr << "PASS " << (lcount / corpus.size() + 1) << endl;
     }
-    decoder.SetId(order[cur_sent]);
+    // a minibatch never spans two passes, so no sentence is in it twice
+    const unsigned batch = min<size_t>(minibatch_size, min<size_t>(corpus.size() - cur_sent, max_iteration + 1 - lcount));
     double sc = 1.0;
     if (sample_forest_unit_weight_vector) {
       sc = lambdas.l2norm();
@@ -281,34 +367,49 @@ int main(int argc, char** argv) {
           dense_weights[i] /= sc;
       }
     }
-    decoder.Decode(corpus[order[cur_sent]], &observer);  // update oracles
+    for (unsigned b = 0; b < batch; ++b) {
+      decoder.SetId(order[cur_sent + b]);
+      decoder.Decode(corpus[order[cur_sent + b]], &observer);  // update oracles
+    }
+    observer.Wait();
     if (sc && sc != 1.0) {
       for (unsigned i = 0; i < dense_weights.size(); ++i)
         dense_weights[i] *= sc;
     }
-    const HypothesisInfo& cur_hyp = observer.GetCurrentBestHypothesis();
-    const HypothesisInfo& cur_good = *oracles[order[cur_sent]].good;
-    const HypothesisInfo& cur_bad = *oracles[order[cur_sent]].bad;
-    tot_loss += cur_hyp.mt_metric;
-    if (!ApproxEqual(cur_hyp.mt_metric, cur_good.mt_metric)) {
-      const double loss = cur_bad.features.dot(dense_weights) - cur_good.features.dot(dense_weights) +
-          mt_metric_scale * (cur_good.mt_metric - cur_bad.mt_metric);
-      //cerr << "LOSS: " << loss << endl;
-      if (loss > 0.0) {
-        SparseVector<double> diff = cur_good.features;
-        diff -= cur_bad.features;
-        double step_size = loss / diff.l2norm_sq();
-        //cerr << loss << " " << step_size << " " << diff << endl;
-        if (step_size > max_step_size) step_size = max_step_size;
-        lambdas += (cur_good.features * step_size);
-        lambdas -= (cur_bad.features * step_size);
-        //cerr << "L: " << lambdas << endl;
+    SparseVector<double> mixed;
+    for (unsigned b = 0; b < batch; ++b) {
+      if (b > 0 && !mix_updates) lambdas.init_vector(&dense_weights);
+      const GoodBadOracle& oracle = oracles[order[cur_sent]];
+      const HypothesisInfo& cur_hyp = *oracle.best;
+      const HypothesisInfo& cur_good = *oracle.good;
+      const HypothesisInfo& cur_bad = *oracle.bad;
+      tot_loss += cur_hyp.mt_metric;
+      if (!ApproxEqual(cur_hyp.mt_metric, cur_good.mt_metric)) {
+        const double loss = cur_bad.features.dot(dense_weights) - cur_good.features.dot(dense_weights) +
+            mt_metric_scale * (cur_good.mt_metric - cur_bad.mt_metric);
+        //cerr << "LOSS: " << loss << endl;
+        if (loss > 0.0) {
+          SparseVector<double> diff = cur_good.features;
+          diff -= cur_bad.features;
+          double step_size = loss / diff.l2norm_sq();
+          //cerr << loss << " " << step_size << " " << diff << endl;
+          if (step_size > max_step_size) step_size = max_step_size;
+          SparseVector<double>& update = mix_updates ? mixed : lambdas;
+          update += (cur_good.features * step_size);
+          update -= (cur_bad.features * step_size);
+          //cerr << "L: " << lambdas << endl;
+        }
       }
+      if (!mix_updates) tot += lambdas;
+      ++normalizer;
+      ++lcount;
+      ++cur_sent;
+    }
+    if (mix_updates) {
+      mixed /= batch;
+      lambdas += mixed;
+      tot += lambdas * batch;
     }
-    tot += lambdas;
-    ++normalizer;
-    ++lcount;
-    ++cur_sent;
   }
   cerr << endl;
   Weights::WriteToFile("weights.mira-final.gz", dense_weights, true, &msg);
@@ -26,6 +26,7 @@ die "Can't execute $FAST_SCORE" unless -x $FAST_SCORE;
 my $MAPINPUT = "$bin_dir/mr_pro_generate_mapper_input.pl";
 my $MAPPER = "$bin_dir/mr_pro_map";
 my $REDUCER = "$bin_dir/mr_pro_reduce";
+my $OPTIMIZER = "$bin_dir/pro_optimize";
 my $parallelize = "$UTILS_DIR/parallelize.pl";
 my $libcall = "$UTILS_DIR/libcall.pl";
 my $sentserver = "$UTILS_DIR/sentserver";
@@ -34,6 +35,7 @@ my $LocalConfig = "$SCRIPT_DIR/../../environment/LocalConfig.pm";
 
 my $SCORER = $FAST_SCORE;
 die "Can't find $MAPPER" unless -x $MAPPER;
+die "Can't find $OPTIMIZER" unless -x $OPTIMIZER;
 my $cdec = "$bin_dir/../../decoder/cdec";
 die "Can't find decoder in $cdec" unless -x $cdec;
 die "Can't find $parallelize" unless -x $parallelize;
@@ -262,6 +264,17 @@ while (1){
 	my $score = 0;
 	my $icc = 0;
 	my $inweights="$dir/weights.$im1";
+	if ($use_make) {
+		# sample the training pairs and train the classifier in one process,
+		# with a thread per job instead of a mapper per shard
+		$cmd="$OPTIMIZER -j $jobs -H $dir/hgs -K $dir/kbest -m $metric -r $refs -w $inweights -C $reg -y $reg_previous --interpolate_with_weights $psi > $dir/weights.$iteration";
+		print STDERR "COMMAND:\n$cmd\n";
+		check_bash_call($cmd);
+		$lastWeightsFile = "$dir/weights.$iteration";
+		$iteration++;
+		print STDERR "\n==========\n";
+		next;
+	}
 	$cmd="$MAPINPUT $dir/hgs > $dir/agenda.$im1";
 	print STDERR "COMMAND:\n$cmd\n";
 	check_call($cmd);
@@ -278,14 +291,6 @@ while (1){
 	@cleanupcmds = ();
 	my %o2i = ();
 	my $first_shard = 1;
-	my $mkfile; # only used with makefiles
-	my $mkfilename;
-	if ($use_make) {
-		$mkfilename = "$dir/splag.$im1/domap.mk";
-		open $mkfile, ">$mkfilename" or die "Couldn't write $mkfilename: $!";
-		print $mkfile "all: $dir/splag.$im1/map.done\n\n";
-	}
-	my @mkouts = ();  # only used with makefiles
 	my @mapoutputs = ();
 	for my $shard (@shards) {
 		my $mapoutput = $shard;
@@ -296,56 +301,35 @@ while (1){
 		push @mapoutputs, "$dir/splag.$im1/$mapoutput";
 		$o2i{"$dir/splag.$im1/$mapoutput"} = "$dir/splag.$im1/$shard";
 		my $script = "$MAPPER -s $srcFile -m $metric -r $refs -w $inweights -K $dir/kbest < $dir/splag.$im1/$shard > $dir/splag.$im1/$mapoutput";
-		if ($use_make) {
-			my $script_file = "$dir/scripts/map.$shard";
-			open F, ">$script_file" or die "Can't write $script_file: $!";
-			print F "#!/bin/bash\n";
-			print F "$script\n";
-			close F;
-			my $output = "$dir/splag.$im1/$mapoutput";
-			push @mkouts, $output;
-			chmod(0755, $script_file) or die "Can't chmod $script_file: $!";
-			if ($first_shard) { print STDERR "$script\n"; $first_shard=0; }
-			print $mkfile "$output: $dir/splag.$im1/$shard\n\t$script_file\n\n";
-		} else {
-			my $script_file = "$dir/scripts/map.$shard";
-			open F, ">$script_file" or die "Can't write $script_file: $!";
-			print F "$script\n";
-			close F;
-			if ($first_shard) { print STDERR "$script\n"; $first_shard=0; }
-
-			$nmappers++;
-			my $qcmd = "$QSUB_CMD -N $client_name -o /dev/null -e $logdir/$client_name.ER $script_file";
-			my $jobid = check_output("$qcmd");
-			chomp $jobid;
-			$jobid =~ s/^(\d+)(.*?)$/\1/g;
-			$jobid =~ s/^Your job (\d+) .*$/\1/;
-		 	push(@cleanupcmds, "qdel $jobid 2> /dev/null");
-			print STDERR " $jobid";
-			if ($joblist == "") { $joblist = $jobid; }
-			else {$joblist = $joblist . "\|" . $jobid; }
-		}
+		my $script_file = "$dir/scripts/map.$shard";
+		open F, ">$script_file" or die "Can't write $script_file: $!";
+		print F "$script\n";
+		close F;
+		if ($first_shard) { print STDERR "$script\n"; $first_shard=0; }
+
+		$nmappers++;
+		my $qcmd = "$QSUB_CMD -N $client_name -o /dev/null -e $logdir/$client_name.ER $script_file";
+		my $jobid = check_output("$qcmd");
+		chomp $jobid;
+		$jobid =~ s/^(\d+)(.*?)$/\1/g;
+		$jobid =~ s/^Your job (\d+) .*$/\1/;
+		push(@cleanupcmds, "qdel $jobid 2> /dev/null");
+		print STDERR " $jobid";
+		if ($joblist == "") { $joblist = $jobid; }
+		else {$joblist = $joblist . "\|" . $jobid; }
 	}
 	my @dev_outs = ();
 	my @devtest_outs = ();
 	@dev_outs = @mapoutputs;
-	if ($use_make) {
-		print $mkfile "$dir/splag.$im1/map.done: @mkouts\n\ttouch $dir/splag.$im1/map.done\n\n";
-		close $mkfile;
-		my $mcmd = "make -j $jobs -f $mkfilename";
-		print STDERR "\nExecuting: $mcmd\n";
-		check_call($mcmd);
-	} else {
-		print STDERR "\nLaunched $nmappers mappers.\n";
-      		sleep 8;
-		print STDERR "Waiting for mappers to complete...\n";
-		while ($nmappers > 0) {
-		  sleep 5;
-		  my @livejobs = grep(/$joblist/, split(/\n/, unchecked_output("qstat | grep -v ' C '")));
-		  $nmappers = scalar @livejobs;
-		}
-		print STDERR "All mappers complete.\n";
+	print STDERR "\nLaunched $nmappers mappers.\n";
+	sleep 8;
+	print STDERR "Waiting for mappers to complete...\n";
+	while ($nmappers > 0) {
+	  sleep 5;
+	  my @livejobs = grep(/$joblist/, split(/\n/, unchecked_output("qstat | grep -v ' C '")));
+	  $nmappers = scalar @livejobs;
 	}
+	print STDERR "All mappers complete.\n";
 	my $tol = 0;
 	my $til = 0;
 	my $dev_test_file = "$dir/splag.$im1/devtest.gz";
@@ -475,7 +459,8 @@ Regularization options:
 Job control options:
 
 	--jobs <I>
-		Number of decoder processes to run in parallel. [default=$default_jobs]
+		Number of decoder processes to run in parallel, and of threads
+		used by the optimizer. [default=$default_jobs]
 
 	--qsub
 		Use qsub to run jobs in parallel (qsub must be configured in
@@ -0,0 +1,165 @@
+#include "pro_classifier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "liblbfgs/lbfgs++.h"
+
+using namespace std;
+
+namespace pro {
+
+namespace {
+
+// since this is a ranking model, there should be equal numbers of
+// positive and negative examples, so the bias should be 0
+
+void GradAdd(const SparseVector<weight_t>& v, const double scale, weight_t* acc) {
+  for (SparseVector<weight_t>::const_iterator it = v.begin();
+       it != v.end(); ++it) {
+    acc[it->first] += it->second * scale;
+  }
+}
+
+double ApplyRegularizationTerms(const double C,
+                                const double T,
+                                const vector<weight_t>& weights,
+                                const vector<weight_t>& prev_weights,
+                                weight_t* g) {
+  double reg = 0;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    const double prev_w_i = (i < prev_weights.size() ? prev_weights[i] : 0.0);
+    const double& w_i = weights[i];
+    reg += C * w_i * w_i;
+    g[i] += 2 * C * w_i;
+
+    const double diff_i = w_i - prev_w_i;
+    reg += T * diff_i * diff_i;
+    g[i] += 2 * T * diff_i;
+  }
+  return reg;
+}
+
+// negative log likelihood of corpus[begin, end), adding its gradient to g
+void BlockInference(const vector<weight_t>& x,
+                    const PairCorpus& corpus,
+                    size_t begin,
+                    size_t end,
+                    weight_t* g,
+                    double* pcll) {
+  double cll = 0;
+  for (size_t i = begin; i < end; ++i) {
+    const double dotprod = corpus[i].second.dot(x) + (x.size() ? x[0] : weight_t()); // x[0] is bias
+    double lp_false = dotprod;
+    double lp_true = -dotprod;
+    if (0 < lp_true) {
+      lp_true += log1p(exp(-lp_true));
+      lp_false = log1p(exp(lp_false));
+    } else {
+      lp_true = log1p(exp(lp_true));
+      lp_false += log1p(exp(-lp_false));
+    }
+    lp_true*=-1;
+    lp_false*=-1;
+    if (corpus[i].first) {  // true label
+      cll -= lp_true;
+      if (g) {
+        // g -= corpus[i].second * exp(lp_false);
+        GradAdd(corpus[i].second, -exp(lp_false), g);
+        g[0] -= exp(lp_false); // bias
+      }
+    } else {                  // false label
+      cll -= lp_false;
+      if (g) {
+        // g += corpus[i].second * exp(lp_true);
+        GradAdd(corpus[i].second, exp(lp_true), g);
+        g[0] += exp(lp_true); // bias
+      }
+    }
+  }
+  *pcll = cll;
+}
+
+// splits the corpus into one contiguous block per thread; each thread sums
+// into its own gradient, and the blocks are added up in order afterwards
+double TrainingInference(const vector<weight_t>& x,
+                         const PairCorpus& corpus,
+                         unsigned threads,
+                         weight_t* g) {
+  if (threads > corpus.size()) threads = corpus.size();
+  if (threads <= 1) {
+    double cll;
+    BlockInference(x, corpus, 0, corpus.size(), g, &cll);
+    return cll;
+  }
+  vector<vector<weight_t> > grads(threads, vector<weight_t>(g ? x.size() : 0, 0.0));
+  vector<double> clls(threads);
+  boost::thread_group workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    const size_t begin = corpus.size() * t / threads;
+    const size_t end = corpus.size() * (t + 1) / threads;
+    workers.create_thread(boost::bind(&BlockInference, boost::cref(x), boost::cref(corpus),
+                                      begin, end, g ? &grads[t][0] : NULL, &clls[t]));
+  }
+  workers.join_all();
+  double cll = 0;
+  for (unsigned t = 0; t < threads; ++t) {
+    cll += clls[t];
+    if (g) {
+      for (size_t i = 0; i < x.size(); ++i)
+        g[i] += grads[t][i];
+    }
+  }
+  return cll;
+}
+
+struct ProLoss {
+  ProLoss(const PairCorpus& tr,
+          const PairCorpus& te,
+          const double c,
+          const double t,
+          const vector<weight_t>& px,
+          unsigned th) : training(tr), testing(te), C(c), T(t), prev_x(px), threads(th) {}
+  double operator()(const vector<double>& x, double* g) const {
+    fill(g, g + x.size(), 0.0);
+    double cll = TrainingInference(x, training, threads, g);
+    tppl = 0;
+    if (testing.size())
+      tppl = pow(2.0, TrainingInference(x, testing, threads, g) / (log(2) * testing.size()));
+    double ppl = cll / log(2);
+    ppl /= training.size();
+    ppl = pow(2.0, ppl);
+    double reg = ApplyRegularizationTerms(C, T, x, prev_x, g);
+    return cll + reg;
+  }
+  const PairCorpus& training, testing;
+  const double C, T;
+  const vector<double>& prev_x;
+  const unsigned threads;
+  mutable double tppl;
+};
+
+}  // namespace
+
+// return held-out log likelihood
+double LearnParameters(const PairCorpus& training,
+                       const PairCorpus& testing,
+                       const double C,
+                       const double C1,
+                       const double T,
+                       const unsigned memory_buffers,
+                       const vector<weight_t>& prev_x,
+                       vector<weight_t>* px,
+                       unsigned threads) {
+  assert(px->size() == prev_x.size());
+  ProLoss loss(training, testing, C, T, prev_x, threads);
+  LBFGS<ProLoss> lbfgs(px, loss, memory_buffers, C1);
+  lbfgs.MinimizeFunction();
+  return loss.tppl;
+}
+
+}
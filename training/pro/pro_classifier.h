@@ -0,0 +1,32 @@
+#ifndef _PRO_CLASSIFIER_H_
+#define _PRO_CLASSIFIER_H_
+
+#include <utility>
+#include <vector>
+
+#include "sparse_vector.h"
+#include "weights.h"
+
+namespace pro {
+
+// pairwise ranking examples: label and feature difference
+typedef std::vector<std::pair<bool, SparseVector<weight_t> > > PairCorpus;
+
+// Trains the logistic regression classifier on the pairs with L-BFGS,
+// starting from *px (x[0] is the bias).  C is the l2 and C1 the l1
+// regularization strength, T penalizes the distance to prev_x.  The
+// likelihood and its gradient are summed over the examples by threads
+// threads.  Returns the held-out perplexity, 0 without testing examples.
+double LearnParameters(const PairCorpus& training,
+                       const PairCorpus& testing,
+                       const double C,
+                       const double C1,
+                       const double T,
+                       const unsigned memory_buffers,
+                       const std::vector<weight_t>& prev_x,
+                       std::vector<weight_t>* px,
+                       unsigned threads = 1);
+
+}
+
+#endif
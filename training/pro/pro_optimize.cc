@@ -0,0 +1,237 @@
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <climits>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "candidate_set.h"
+#include "candidate_store.h"
+#include "sampler.h"
+#include "filelib.h"
+#include "stringlib.h"
+#include "weights.h"
+#include "hg.h"
+#include "hg_io.h"
+#include "ns.h"
+#include "ns_docscorer.h"
+#include "pro_classifier.h"
+#include "pro_sample.h"
+
+// One PRO iteration in a single process: adds the k-best lists of this
+// iteration's forests to the candidate pools, samples training pairs
+// (mr_pro_map) and trains the classifier on them (mr_pro_reduce), using
+// threads instead of mapper processes.  Writes weights like mr_pro_reduce.
+// The pools are kept in a CandidateStore, candidates.bin in the repository.
+
+using namespace std;
+namespace po = boost::program_options;
+
+void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
+  po::options_description opts("Configuration options");
+  opts.add_options()
+        ("reference,r",po::value<vector<string> >(), "[REQD] Reference translation (tokenized text)")
+        ("weights,w",po::value<string>(), "[REQD] Weights files from current iterations")
+        ("hypergraphs,H",po::value<string>(), "[REQD] Directory of this iteration's forests (as written by cdec -O)")
+        ("kbest_repository,K",po::value<string>()->default_value("./kbest"),"K-best list repository (directory)")
+        ("evaluation_metric,m",po::value<string>()->default_value("IBM_BLEU"), "Evaluation metric (ibm_bleu, koehn_bleu, nist_bleu, ter, meteor, etc.)")
+        ("kbest_size,k",po::value<unsigned>()->default_value(1500u), "Top k-hypotheses to extract")
+        ("candidate_pairs,G", po::value<unsigned>()->default_value(5000u), "Number of pairs to sample per hypothesis (Gamma)")
+        ("best_pairs,X", po::value<unsigned>()->default_value(50u), "Number of pairs, ranked by magnitude of objective delta, to retain (Xi)")
+        ("random_seed,S", po::value<uint32_t>(), "Random seed (if not specified, /dev/random will be used)")
+        ("regularization_strength,C",po::value<double>()->default_value(500.0), "l2 regularization strength")
+        ("l1",po::value<double>()->default_value(0.0), "l1 regularization strength")
+        ("regularize_to_weights,y",po::value<double>()->default_value(5000.0), "Differences in learned weights to previous weights are penalized with an l2 penalty with this strength; 0.0 = no effect")
+        ("memory_buffers",po::value<unsigned>()->default_value(100), "Number of memory buffers (LBFGS)")
+        ("interpolate_with_weights,p",po::value<double>()->default_value(1.0), "[deprecated] Output weights are p*w + (1-p)*w_prev; 1.0 = no effect")
+        ("threads,j",po::value<unsigned>()->default_value(1), "Number of threads")
+        ("help,h", "Help");
+  po::options_description dcmdline_options;
+  dcmdline_options.add(opts);
+  po::store(parse_command_line(argc, argv, dcmdline_options), *conf);
+  bool flag = false;
+  if (!conf->count("reference")) {
+    cerr << "Please specify one or more references using -r <REF.TXT>\n";
+    flag = true;
+  }
+  if (!conf->count("weights")) {
+    cerr << "Please specify weights using -w <WEIGHTS.TXT>\n";
+    flag = true;
+  }
+  if (!conf->count("hypergraphs")) {
+    cerr << "Please specify the forest directory using -H <DIR>\n";
+    flag = true;
+  }
+  if (flag || conf->count("help")) {
+    cerr << dcmdline_options << endl;
+    exit(1);
+  }
+}
+
+static void Slurp(const string& file, string* out) {
+  ReadFile rf(file);
+  ostringstream os;
+  os << rf.stream()->rdbuf();
+  *out = os.str();
+}
+
+// Updates the candidate pool of every threads-th sentence, starting with
+// the first one, and samples its training pairs.  Reading forests and text
+// pools adds to the word and feature dictionaries, so it is done under
+// dict_mutex; pools from the store, decompression, k-best extraction,
+// scoring and sampling don't need it.
+struct SampleWorker {
+  SampleWorker(const string& hg_dir, const string& kbest_repo, const training::CandidateStore* st,
+               training::CandidateStoreWriter* sw, const vector<weight_t>& w,
+               const DocumentScorer& d, const EvaluationMetric* m, unsigned k, unsigned g, unsigned x,
+               const vector<uint32_t>& s, boost::mutex* dm, vector<vector<pro::TrainingInstance> >* o,
+               unsigned f, unsigned t) :
+      hgs(hg_dir), kbests(kbest_repo), store(st), writer(sw), weights(w), ds(d), metric(m),
+      kbest_size(k), gamma(g), xi(x), seeds(s), dict_mutex(dm), instances(*o), first(f), threads(t) {}
+
+  void operator()() const {
+    string pool_data, hg_data;
+    for (unsigned sent_id = first; sent_id < instances.size(); sent_id += threads) {
+      training::CandidateSet J_i;
+      // pools of sentences missing from the store may still be in the text
+      // files written by mr_pro_map
+      bool have_text_pool = false;
+      if (store && store->Has(sent_id)) {
+        store->Read(sent_id, &J_i);
+      } else {
+        ostringstream kos;
+        kos << kbests << "/kbest." << sent_id << ".txt.gz";
+        have_text_pool = FileExists(kos.str());
+        if (have_text_pool) Slurp(kos.str(), &pool_data);
+      }
+      ostringstream hos;
+      hos << hgs << '/' << sent_id << ".bin.gz";
+      Slurp(hos.str(), &hg_data);
+
+      Hypergraph hg;
+      {
+        boost::mutex::scoped_lock lock(*dict_mutex);
+        if (have_text_pool) {
+          istringstream is(pool_data);
+          J_i.ReadFromStream(&is);
+        }
+        istringstream is(hg_data);
+        HypergraphIO::ReadFromBinary(&is, &hg);
+      }
+      hg.Reweight(weights);
+      J_i.AddKBestCandidates(hg, kbest_size, ds[sent_id]);
+      writer->Add(sent_id, J_i);
+
+      MT19937 rng(seeds[sent_id]);
+      pro::Sample(gamma, xi, J_i, metric, &rng, &instances[sent_id]);
+    }
+  }
+
+  const string& hgs;
+  const string& kbests;
+  const training::CandidateStore* store;
+  training::CandidateStoreWriter* writer;
+  const vector<weight_t>& weights;
+  const DocumentScorer& ds;
+  const EvaluationMetric* metric;
+  const unsigned kbest_size, gamma, xi;
+  const vector<uint32_t>& seeds;
+  boost::mutex* dict_mutex;
+  vector<vector<pro::TrainingInstance> >& instances;
+  const unsigned first, threads;
+};
+
+int main(int argc, char** argv) {
+  po::variables_map conf;
+  InitCommandLine(argc, argv, &conf);
+  boost::shared_ptr<MT19937> rng;
+  if (conf.count("random_seed"))
+    rng.reset(new MT19937(conf["random_seed"].as<uint32_t>()));
+  else
+    rng.reset(new MT19937);
+  const string evaluation_metric = conf["evaluation_metric"].as<string>();
+
+  EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
+  DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
+  cerr << "Loaded " << ds.size() << " references for scoring with " << evaluation_metric << endl;
+
+  const double C = conf["regularization_strength"].as<double>();
+  const double C1 = conf["l1"].as<double>();
+  const double T = conf["regularize_to_weights"].as<double>();
+  assert(C >= 0.0);
+  const double psi = conf["interpolate_with_weights"].as<double>();
+  if (psi < 0.0 || psi > 1.0) { cerr << "Invalid interpolation weight: " << psi << endl; return 1; }
+
+  vector<weight_t> weights;
+  Weights::InitFromFile(conf["weights"].as<string>(), &weights);
+  const string kbest_repo = conf["kbest_repository"].as<string>();
+  MkDirP(kbest_repo);
+
+  unsigned threads = conf["threads"].as<unsigned>();
+  if (threads < 1) threads = 1;
+  unsigned sample_threads = threads;
+  if (!metric->IsThreadSafe()) {
+    if (threads > 1) cerr << evaluation_metric << " can't be computed by several threads, sampling with one\n";
+    sample_threads = 1;
+  }
+  if (sample_threads > ds.size()) sample_threads = ds.size();
+
+  // one generator per sentence, so the pairs don't depend on the threads
+  vector<uint32_t> seeds(ds.size());
+  for (unsigned i = 0; i < seeds.size(); ++i)
+    seeds[i] = rng->next() * UINT_MAX;
+
+  vector<vector<pro::TrainingInstance> > instances(ds.size());
+  boost::mutex dict_mutex;
+  const string hg_dir = conf["hypergraphs"].as<string>();
+  const unsigned kbest_size = conf["kbest_size"].as<unsigned>();
+  const unsigned gamma = conf["candidate_pairs"].as<unsigned>();
+  const unsigned xi = conf["best_pairs"].as<unsigned>();
+  const string store_file = kbest_repo + "/candidates.bin";
+  boost::scoped_ptr<training::CandidateStore> store;
+  if (FileExists(store_file)) store.reset(new training::CandidateStore(store_file));
+  training::CandidateStoreWriter writer(store_file);
+  if (sample_threads == 1) {
+    SampleWorker(hg_dir, kbest_repo, store.get(), &writer, weights, ds, metric, kbest_size, gamma, xi, seeds, &dict_mutex, &instances, 0, 1)();
+  } else {
+    boost::thread_group workers;
+    for (unsigned t = 0; t < sample_threads; ++t)
+      workers.create_thread(SampleWorker(hg_dir, kbest_repo, store.get(), &writer, weights, ds, metric, kbest_size, gamma, xi, seeds, &dict_mutex, &instances, t, sample_threads));
+    workers.join_all();
+  }
+  writer.Close();
+
+  // each pair is a positive and a negative example, as in mr_pro_map's output
+  pro::PairCorpus training, testing;
+  for (unsigned i = 0; i < instances.size(); ++i) {
+    for (unsigned j = 0; j < instances[i].size(); ++j) {
+      const pro::TrainingInstance& vi = instances[i][j];
+      training.push_back(make_pair(vi.y, vi.x));
+      training.push_back(make_pair(!vi.y, vi.x * -1.0));
+    }
+    vector<pro::TrainingInstance>().swap(instances[i]);
+  }
+
+  vector<weight_t> x, prev_x;  // x[0] is bias
+  x = weights;
+  x.resize(FD::NumFeats());
+  prev_x = x;
+  cerr << "         Number of features: " << x.size() << endl;
+  cerr << "Number of training examples: " << training.size() << endl;
+  const double tppl = pro::LearnParameters(training, testing, C, C1, T, conf["memory_buffers"].as<unsigned>(), prev_x, &x, threads);
+  for (int i = 1; i < x.size(); ++i) {
+    x[i] = (x[i] * psi) + prev_x[i] * (1.0 - psi);
+  }
+  cout.precision(15);
+  cout << "# C=" << C << "\theld out perplexity=";
+  if (tppl) { cout << tppl << endl; } else { cout << "N/A\n"; }
+  Weights::WriteToFile("-", x);
+  return 0;
+}
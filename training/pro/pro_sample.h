@@ -0,0 +1,35 @@
+#ifndef _PRO_SAMPLE_H_
+#define _PRO_SAMPLE_H_
+
+#include <vector>
+
+#include "sampler.h"
+#include "sparse_vector.h"
+#include "weights.h"
+
+class EvaluationMetric;
+namespace training { class CandidateSet; }
+
+namespace pro {
+
+struct TrainingInstance {
+  TrainingInstance(const SparseVector<weight_t>& feats, bool positive, float diff) : x(feats), y(positive), gdiff(diff) {}
+  SparseVector<weight_t> x;
+  bool y;
+  float gdiff;
+};
+
+// This is Figure 4 (Algorithm Sampler) from Hopkins&May (2011): draws gamma
+// pairs of candidates from J_i and appends the xi with the largest metric
+// differences to pv.  Only reads J_i and the metric, so different sentences
+// can be sampled at the same time with different generators.
+void Sample(const unsigned gamma,
+            const unsigned xi,
+            const training::CandidateSet& J_i,
+            const EvaluationMetric* metric,
+            MT19937* rng,
+            std::vector<TrainingInstance>* pv);
+
+}
+
+#endif
@@ -112,7 +112,11 @@ static void ParseSparseVector(string& line, size_t cur, SparseVector<double>* ou
 
 void CandidateSet::WriteToFile(const string& file) const {
   WriteFile wf(file);
-  ostream& out = *wf.stream();
+  WriteToStream(wf.stream());
+}
+
+void CandidateSet::WriteToStream(ostream* pout) const {
+  ostream& out = *pout;
   out.precision(10);
   string ss;
   for (unsigned i = 0; i < cs.size(); ++i) {
@@ -126,7 +130,12 @@ void CandidateSet::WriteToFile(const string& file) const {
 void CandidateSet::ReadFromFile(const string& file) {
   if(!SILENT) cerr << "Reading candidates from " << file << endl;
   ReadFile rf(file);
-  istream& in = *rf.stream();
+  ReadFromStream(rf.stream());
+  if(!SILENT) cerr << "  read " << cs.size() << " candidates\n";
+}
+
+void CandidateSet::ReadFromStream(istream* pin) {
+  istream& in = *pin;
   string cand;
   string feats;
   string ss;
@@ -139,7 +148,6 @@ void CandidateSet::ReadFromFile(const string& file) {
     ParseSparseVector(feats, 0, &cs.back().fmap);
     cs.back().eval_feats = SufficientStats(ss);
   }
-  if(!SILENT) cerr << "  read " << cs.size() << " candidates\n";
 }
 
 void CandidateSet::Dedup() {
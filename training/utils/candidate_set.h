@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <iosfwd>
 
 #include "ns.h"
 #include "wordid.h"
@@ -46,11 +47,16 @@ class CandidateSet {
 
   void ReadFromFile(const std::string& file);
   void WriteToFile(const std::string& file) const;
+  // the same format on streams; reading adds the words and feature names to
+  // the dictionaries and writing looks them up
+  void ReadFromStream(std::istream* in);
+  void WriteToStream(std::ostream* out) const;
   void AddKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer = NULL);
   void AddUniqueKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer = NULL);
   // TODO add code to draw k samples
 
  private:
+  friend class CandidateStore;
   void Dedup();
   std::vector<Candidate> cs;
 };
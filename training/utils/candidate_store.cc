@@ -0,0 +1,345 @@
+#include "candidate_store.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "candidate_set.h"
+#include "fdict.h"
+#include "tdict.h"
+
+using namespace std;
+
+// All values are in native byte order:
+//   magic "\0cdeccnd", uint32 version, uint32 0
+//   uint64 offset of the string tables, uint64 offset of the index
+//   pools, each a block of columns (n is the number of candidates):
+//     varint n, varint metric id index + 1 (0 if no candidate is scored)
+//     varint |ewords|[n], varint #features[n], varint #stats[n]
+//     varint word indexes of all the candidates
+//     feature indexes, as zigzag varint differences to the previous index of
+//     the candidate (the order of the features is kept, since Dedup's
+//     comparisons depend on it)
+//     double feature values
+//     float sufficient statistics
+//   string tables for words, feature names and metric ids, each
+//     uint32 #strings, then for each string: uint32 length, characters
+//   uint32 #sentences, uint64 offset of each sentence's pool (0 if none)
+static const char kCandidateStoreMagic[] = "\0cdeccnd";
+static const int kCandidateStoreMagicSize = 8;
+static const uint32_t kCandidateStoreVersion = 1;
+static const size_t kCandidateStoreHeaderSize = 32;
+
+namespace training {
+
+namespace {
+
+void PutVarint(uint64_t v, string* out) {
+  while (v >= 0x80) {
+    out->push_back(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out->push_back(static_cast<char>(v));
+}
+
+void PutSignedVarint(int64_t v, string* out) {
+  PutVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63), out);
+}
+
+template <typename T> void PutArray(const T* values, size_t n, string* out) {
+  out->append(reinterpret_cast<const char*>(values), n * sizeof(T));
+}
+
+template <typename T> void Write(const T& value, ostream* out) {
+  out->write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void WriteStrings(const vector<string>& strings, ostream* out) {
+  Write(static_cast<uint32_t>(strings.size()), out);
+  for (unsigned i = 0; i < strings.size(); ++i) {
+    Write(static_cast<uint32_t>(strings[i].size()), out);
+    out->write(strings[i].data(), strings[i].size());
+  }
+}
+
+struct StoreReader {
+  StoreReader(const char* begin, const char* end, const string& file) :
+      cur(begin), end(end), file(file) {}
+
+  void Check(size_t size) const {
+    if (size > static_cast<size_t>(end - cur)) {
+      cerr << "Truncated candidate store " << file << endl;
+      abort();
+    }
+  }
+
+  template <typename T> T Read() {
+    T value;
+    ReadArray(&value, 1);
+    return value;
+  }
+
+  template <typename T> void ReadArray(T* values, size_t n) {
+    Check(n * sizeof(T));
+    memcpy(values, cur, n * sizeof(T));
+    cur += n * sizeof(T);
+  }
+
+  uint64_t ReadVarint() {
+    uint64_t v = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+      Check(1);
+      const unsigned char b = *cur++;
+      v |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+  }
+
+  int64_t ReadSignedVarint() {
+    const uint64_t v = ReadVarint();
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+  }
+
+  string ReadString() {
+    const uint32_t size = Read<uint32_t>();
+    Check(size);
+    string s(cur, size);
+    cur += size;
+    return s;
+  }
+
+  const char* cur;
+  const char* end;
+  const string& file;
+};
+
+}  // namespace
+
+CandidateStore::CandidateStore(const string& file) : file_(file), data_(NULL), size_(0) {
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd == -1) {
+    cerr << "Failed to open " << file << endl;
+    abort();
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1) {
+    cerr << "Failed to stat " << file << endl;
+    abort();
+  }
+  size_ = file_stat.st_size;
+  if (size_ < kCandidateStoreHeaderSize) {
+    cerr << "Truncated candidate store " << file << endl;
+    abort();
+  }
+  void* data = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    cerr << "Failed to map " << file << " into memory" << endl;
+    abort();
+  }
+  close(fd);
+  data_ = static_cast<const char*>(data);
+
+  StoreReader header(data_, data_ + size_, file_);
+  char magic[kCandidateStoreMagicSize];
+  header.ReadArray(magic, kCandidateStoreMagicSize);
+  if (memcmp(magic, kCandidateStoreMagic, kCandidateStoreMagicSize) != 0 ||
+      header.Read<uint32_t>() != kCandidateStoreVersion) {
+    cerr << "Unsupported candidate store " << file << endl;
+    abort();
+  }
+  header.Read<uint32_t>();
+  const uint64_t tables_offset = header.Read<uint64_t>();
+  const uint64_t index_offset = header.Read<uint64_t>();
+  if (tables_offset > size_ || index_offset > size_) {
+    cerr << "Truncated candidate store " << file << endl;
+    abort();
+  }
+
+  StoreReader tables(data_ + tables_offset, data_ + size_, file_);
+  words_.resize(tables.Read<uint32_t>());
+  for (unsigned i = 0; i < words_.size(); ++i)
+    words_[i] = TD::Convert(tables.ReadString());
+  features_.resize(tables.Read<uint32_t>());
+  for (unsigned i = 0; i < features_.size(); ++i)
+    features_[i] = FD::Convert(tables.ReadString());
+  metrics_.resize(tables.Read<uint32_t>());
+  for (unsigned i = 0; i < metrics_.size(); ++i)
+    metrics_[i] = tables.ReadString();
+
+  StoreReader index(data_ + index_offset, data_ + size_, file_);
+  index_.resize(index.Read<uint32_t>());
+  index.ReadArray(index_.data(), index_.size());
+}
+
+CandidateStore::~CandidateStore() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+bool CandidateStore::Has(unsigned sent_id) const {
+  return sent_id < index_.size() && index_[sent_id];
+}
+
+void CandidateStore::Read(unsigned sent_id, CandidateSet* cs) const {
+  if (!Has(sent_id)) return;
+  if (index_[sent_id] >= size_) {
+    cerr << "Truncated candidate store " << file_ << endl;
+    abort();
+  }
+  StoreReader in(data_ + index_[sent_id], data_ + size_, file_);
+  const size_t n = in.ReadVarint();
+  const size_t metric = in.ReadVarint();
+  if (metric > metrics_.size()) {
+    cerr << "Bad metric index in candidate store " << file_ << endl;
+    abort();
+  }
+  vector<size_t> lengths(n), num_feats(n), num_stats(n);
+  for (size_t i = 0; i < n; ++i) lengths[i] = in.ReadVarint();
+  for (size_t i = 0; i < n; ++i) num_feats[i] = in.ReadVarint();
+  for (size_t i = 0; i < n; ++i) num_stats[i] = in.ReadVarint();
+
+  vector<Candidate>& out = cs->cs;
+  const size_t first = out.size();
+  out.resize(first + n);
+  for (size_t i = 0; i < n; ++i) {
+    vector<WordID>& ewords = out[first + i].ewords;
+    ewords.resize(lengths[i]);
+    for (size_t j = 0; j < lengths[i]; ++j)
+      ewords[j] = words_.at(in.ReadVarint());
+  }
+  size_t total_feats = 0;
+  vector<int> fids;
+  for (size_t i = 0; i < n; ++i) {
+    int64_t f = 0;
+    for (size_t j = 0; j < num_feats[i]; ++j) {
+      f += in.ReadSignedVarint();
+      fids.push_back(features_.at(f));
+    }
+    total_feats += num_feats[i];
+  }
+  vector<double> values(total_feats);
+  in.ReadArray(values.data(), values.size());
+  size_t k = 0;
+  for (size_t i = 0; i < n; ++i) {
+    SparseVector<double>& fmap = out[first + i].fmap;
+    for (size_t j = 0; j < num_feats[i]; ++j, ++k)
+      fmap.set_value(fids[k], values[k]);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    SufficientStats& stats = out[first + i].eval_feats;
+    stats.fields.resize(num_stats[i]);
+    in.ReadArray(stats.fields.data(), num_stats[i]);
+    if (num_stats[i] && metric) stats.id_ = metrics_[metric - 1];
+  }
+}
+
+CandidateStoreWriter::CandidateStoreWriter(const string& file) :
+    file_(file), tmp_file_(file + ".tmp"),
+    out_(tmp_file_.c_str(), ios_base::binary), closed_(false) {
+  if (!out_) {
+    cerr << "Failed to open " << tmp_file_ << " for writing" << endl;
+    abort();
+  }
+  const string header(kCandidateStoreHeaderSize, '\0');
+  out_.write(header.data(), header.size());
+}
+
+CandidateStoreWriter::~CandidateStoreWriter() {
+  if (!closed_) Close();
+}
+
+unsigned CandidateStoreWriter::LocalId(unordered_map<int, unsigned>* ids, vector<int>* globals, int id) {
+  unordered_map<int, unsigned>::iterator it = ids->find(id);
+  if (it != ids->end()) return it->second;
+  const unsigned local = globals->size();
+  (*ids)[id] = local;
+  globals->push_back(id);
+  return local;
+}
+
+void CandidateStoreWriter::Add(unsigned sent_id, const CandidateSet& cs) {
+  boost::mutex::scoped_lock lock(mutex_);
+  const size_t n = cs.size();
+  size_t metric = 0;
+  for (size_t i = 0; i < n && !metric; ++i) {
+    const string& id = cs[i].eval_feats.id_;
+    if (cs[i].eval_feats.size() && id.size()) {
+      metric = find(metrics_.begin(), metrics_.end(), id) - metrics_.begin() + 1;
+      if (metric > metrics_.size()) metrics_.push_back(id);
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    const SufficientStats& stats = cs[i].eval_feats;
+    if (stats.size() && stats.id_.size() && stats.id_ != metrics_[metric - 1]) {
+      cerr << "Candidates of sentence " << sent_id << " were scored with both "
+           << metrics_[metric - 1] << " and " << stats.id_ << endl;
+      abort();
+    }
+  }
+
+  block_.clear();
+  PutVarint(n, &block_);
+  PutVarint(metric, &block_);
+  for (size_t i = 0; i < n; ++i) PutVarint(cs[i].ewords.size(), &block_);
+  for (size_t i = 0; i < n; ++i) PutVarint(cs[i].fmap.size(), &block_);
+  for (size_t i = 0; i < n; ++i) PutVarint(cs[i].eval_feats.size(), &block_);
+  for (size_t i = 0; i < n; ++i) {
+    const vector<WordID>& ewords = cs[i].ewords;
+    for (size_t j = 0; j < ewords.size(); ++j)
+      PutVarint(LocalId(&word_ids_, &words_, ewords[j]), &block_);
+  }
+  vector<double> values;
+  for (size_t i = 0; i < n; ++i) {
+    int64_t last = 0;
+    for (SparseVector<double>::const_iterator it = cs[i].fmap.begin(); it != cs[i].fmap.end(); ++it) {
+      const int64_t f = LocalId(&feature_ids_, &features_, it->first);
+      PutSignedVarint(f - last, &block_);
+      last = f;
+      values.push_back(it->second);
+    }
+  }
+  PutArray(values.data(), values.size(), &block_);
+  for (size_t i = 0; i < n; ++i)
+    PutArray(cs[i].eval_feats.fields.data(), cs[i].eval_feats.size(), &block_);
+
+  if (sent_id >= index_.size()) index_.resize(sent_id + 1);
+  index_[sent_id] = out_.tellp();
+  out_.write(block_.data(), block_.size());
+}
+
+void CandidateStoreWriter::Close() {
+  boost::mutex::scoped_lock lock(mutex_);
+  closed_ = true;
+  const uint64_t tables_offset = out_.tellp();
+  vector<string> strings(words_.size());
+  for (unsigned i = 0; i < words_.size(); ++i)
+    strings[i] = TD::Convert(words_[i]);
+  WriteStrings(strings, &out_);
+  strings.resize(features_.size());
+  for (unsigned i = 0; i < features_.size(); ++i)
+    strings[i] = FD::Convert(features_[i]);
+  WriteStrings(strings, &out_);
+  WriteStrings(metrics_, &out_);
+
+  const uint64_t index_offset = out_.tellp();
+  Write(static_cast<uint32_t>(index_.size()), &out_);
+  out_.write(reinterpret_cast<const char*>(index_.data()), index_.size() * sizeof(uint64_t));
+
+  out_.seekp(0);
+  out_.write(kCandidateStoreMagic, kCandidateStoreMagicSize);
+  Write(kCandidateStoreVersion, &out_);
+  Write(static_cast<uint32_t>(0), &out_);
+  Write(tables_offset, &out_);
+  Write(index_offset, &out_);
+  out_.close();
+  if (!out_ || rename(tmp_file_.c_str(), file_.c_str()) != 0) {
+    cerr << "Failed to write " << file_ << endl;
+    abort();
+  }
+}
+
+}
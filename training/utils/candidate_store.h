@@ -0,0 +1,82 @@
+#ifndef _CANDIDATE_STORE_H_
+#define _CANDIDATE_STORE_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+
+#include <boost/thread/mutex.hpp>
+
+#include "wordid.h"
+
+namespace training {
+
+class CandidateSet;
+
+// A binary file holding the candidate pools of all the sentences of a tuning
+// set, so the pools don't have to be parsed from text every iteration. Words,
+// feature names and metric ids are stored once, in string tables at the end
+// of the file; each pool is a block of columns (see candidate_store.cc)
+// found through an index by sentence. The file is memory mapped and the
+// strings are converted to ids when it is opened, after which pools can be
+// read from any number of threads.
+class CandidateStore {
+ public:
+  explicit CandidateStore(const std::string& file);
+  ~CandidateStore();
+
+  // true if the file has a pool for sent_id
+  bool Has(unsigned sent_id) const;
+  // adds the candidates of sent_id's pool (if any) to *cs
+  void Read(unsigned sent_id, CandidateSet* cs) const;
+
+ private:
+  CandidateStore(const CandidateStore&);
+  CandidateStore& operator=(const CandidateStore&);
+
+  std::string file_;
+  const char* data_;
+  size_t size_;
+  std::vector<WordID> words_;
+  std::vector<int> features_;
+  std::vector<std::string> metrics_;
+  std::vector<uint64_t> index_;
+};
+
+// Writes a CandidateStore. Pools may be added from several threads and in
+// any order; the file is written to file.tmp and renamed when it is closed,
+// so the previous store can still be read while the new one is written.
+class CandidateStoreWriter {
+ public:
+  explicit CandidateStoreWriter(const std::string& file);
+  ~CandidateStoreWriter();
+
+  void Add(unsigned sent_id, const CandidateSet& cs);
+  // writes the string tables (looking the ids up in TD and FD, so no
+  // other thread may add to them) and the index
+  void Close();
+
+ private:
+  unsigned LocalId(std::unordered_map<int, unsigned>* ids, std::vector<int>* globals, int id);
+
+  std::string file_, tmp_file_;
+  std::ofstream out_;
+  boost::mutex mutex_;
+  std::unordered_map<int, unsigned> word_ids_, feature_ids_;
+  std::vector<int> words_, features_;
+  std::vector<std::string> metrics_;
+  std::vector<uint64_t> index_;
+  std::string block_;
+  bool closed_;
+};
+
+}
+
+#endif
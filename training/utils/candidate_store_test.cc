@@ -0,0 +1,114 @@
+#define BOOST_TEST_MODULE CandidateStoreTest
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "candidate_set.h"
+#include "candidate_store.h"
+#include "fdict.h"
+#include "ns.h"
+#include "tdict.h"
+
+using namespace std;
+using namespace training;
+
+namespace {
+
+// a pool of candidates written in the text format, which is what the
+// store has to reproduce
+CandidateSet MakePool(unsigned sent_id, const string& metric) {
+  ostringstream text;
+  for (unsigned i = 0; i < 3 + sent_id; ++i) {
+    text << "the house number " << sent_id << " is " << (i % 2 ? "small" : "tiny") << '\n';
+    // features out of id order and a sparse feature only some candidates have
+    text << "LanguageModel=" << -10.5 - i << " PhraseModel_0=" << 0.25 * i;
+    if (i % 2) text << " Src:haus_Trg:house=1";
+    text << " Glue=" << static_cast<double>(sent_id) << '\n';
+    text << metric << ' ' << 6 - i << ' ' << 5 << ' ' << i << ' ' << 0.5 * sent_id << '\n';
+  }
+  istringstream in(text.str());
+  CandidateSet cs;
+  cs.ReadFromStream(&in);
+  return cs;
+}
+
+CandidateSet TextRoundTrip(const CandidateSet& cs) {
+  ostringstream out;
+  cs.WriteToStream(&out);
+  istringstream in(out.str());
+  CandidateSet read;
+  read.ReadFromStream(&in);
+  return read;
+}
+
+void AddPools(CandidateStoreWriter* writer, const vector<unsigned>* sent_ids, const vector<CandidateSet>* pools) {
+  for (unsigned i = 0; i < sent_ids->size(); ++i)
+    writer->Add((*sent_ids)[i], (*pools)[(*sent_ids)[i]]);
+}
+
+void CheckSamePool(const CandidateSet& expected, const CandidateSet& actual) {
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (unsigned i = 0; i < expected.size(); ++i) {
+    const Candidate& e = expected[i];
+    const Candidate& a = actual[i];
+    BOOST_CHECK_EQUAL(TD::GetString(e.ewords), TD::GetString(a.ewords));
+    BOOST_REQUIRE_EQUAL(e.fmap.size(), a.fmap.size());
+    SparseVector<double>::const_iterator ef = e.fmap.begin(), af = a.fmap.begin();
+    for (; ef != e.fmap.end(); ++ef, ++af) {
+      BOOST_CHECK_EQUAL(FD::Convert(ef->first), FD::Convert(af->first));
+      BOOST_CHECK_EQUAL(ef->second, af->second);
+    }
+    BOOST_CHECK_EQUAL(e.eval_feats.id_, a.eval_feats.id_);
+    BOOST_CHECK(e.eval_feats.fields == a.eval_feats.fields);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestStoreMatchesTextFormat) {
+  ostringstream file;
+  file << "/tmp/candidate_store_test." << getpid();
+
+  // sentence 1 has no pool, the others use two different metrics
+  vector<CandidateSet> pools(5);
+  pools[0] = MakePool(0, "IBM_BLEU");
+  pools[2] = MakePool(2, "TER");
+  pools[3] = MakePool(3, "IBM_BLEU");
+  pools[4] = MakePool(4, "IBM_BLEU");
+
+  // two threads adding their sentences out of order
+  vector<unsigned> first, second;
+  first.push_back(4);
+  first.push_back(0);
+  second.push_back(3);
+  second.push_back(2);
+  {
+    CandidateStoreWriter writer(file.str());
+    boost::thread a(boost::bind(&AddPools, &writer, &first, &pools));
+    boost::thread b(boost::bind(&AddPools, &writer, &second, &pools));
+    a.join();
+    b.join();
+    writer.Close();
+  }
+
+  CandidateStore store(file.str());
+  BOOST_CHECK(!store.Has(1));
+  BOOST_CHECK(!store.Has(5));
+  CandidateSet none;
+  store.Read(1, &none);
+  BOOST_CHECK_EQUAL(0, none.size());
+  for (unsigned sent_id = 0; sent_id < pools.size(); ++sent_id) {
+    if (sent_id == 1) continue;
+    BOOST_CHECK(store.Has(sent_id));
+    CandidateSet read;
+    store.Read(sent_id, &read);
+    CheckSamePool(TextRoundTrip(pools[sent_id]), read);
+  }
+  remove(file.str().c_str());
+}
@@ -0,0 +1,124 @@
+#include "alignment_refine.h"
+
+#include <set>
+#include <algorithm>
+
+using namespace std;
+
+AlignmentRefiner::AlignmentRefiner() {
+  neighbors_.push_back(make_pair(1,0));
+  neighbors_.push_back(make_pair(-1,0));
+  neighbors_.push_back(make_pair(0,1));
+  neighbors_.push_back(make_pair(0,-1));
+  neighbors_.push_back(make_pair(1,1));
+  neighbors_.push_back(make_pair(-1,1));
+  neighbors_.push_back(make_pair(1,-1));
+  neighbors_.push_back(make_pair(-1,-1));
+}
+
+bool AlignmentRefiner::ParseHeuristic(const string& name, Heuristic* h) {
+  if (name == "intersect") *h = kINTERSECT;
+  else if (name == "union") *h = kUNION;
+  else if (name == "grow-diag") *h = kGROW_DIAG;
+  else if (name == "grow-diag-final") *h = kGROW_DIAG_FINAL;
+  else if (name == "grow-diag-final-and") *h = kGROW_DIAG_FINAL_AND;
+  else return false;
+  return true;
+}
+
+static void EnsureSize(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
+  x->resize(max(a.width(), b.width()), max(a.height(), b.height()));
+}
+
+void AlignmentRefiner::Refine(Heuristic h, const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
+  Array2D<bool>& res = *x;
+  switch (h) {
+    case kINTERSECT:
+      EnsureSize(a, b, x);
+      for (unsigned i = 0; i < a.width(); ++i)
+        for (unsigned j = 0; j < a.height(); ++j)
+          res(i, j) = Safe(a, i, j) && Safe(b, i, j);
+      return;
+    case kUNION:
+      EnsureSize(a, b, x);
+      for (unsigned i = 0; i < res.width(); ++i)
+        for (unsigned j = 0; j < res.height(); ++j)
+          res(i, j) = Safe(a, i, j) || Safe(b, i, j);
+      return;
+    case kGROW_DIAG:
+      InitRefine(a, b);
+      Grow(&AlignmentRefiner::KoehnAligned, false, un_);
+      break;
+    case kGROW_DIAG_FINAL:
+      InitRefine(a, b);
+      Grow(&AlignmentRefiner::KoehnAligned, false, un_);
+      Grow(&AlignmentRefiner::IsOneOrBothUnaligned, true, a);
+      Grow(&AlignmentRefiner::IsOneOrBothUnaligned, true, b);
+      break;
+    case kGROW_DIAG_FINAL_AND:
+      InitRefine(a, b);
+      Grow(&AlignmentRefiner::KoehnAligned, false, un_);
+      Grow(&AlignmentRefiner::IsNeitherAligned, true, a);
+      Grow(&AlignmentRefiner::IsNeitherAligned, true, b);
+      break;
+  }
+  *x = res_;
+}
+
+bool AlignmentRefiner::IsNeighborAligned(int i, int j) const {
+  for (unsigned k = 0; k < neighbors_.size(); ++k) {
+    const int di = neighbors_[k].first;
+    const int dj = neighbors_[k].second;
+    if (Safe(res_, i + di, j + dj))
+      return true;
+  }
+  return false;
+}
+
+void AlignmentRefiner::InitRefine(const Array2D<bool>& a, const Array2D<bool>& b) {
+  res_.clear();
+  EnsureSize(a, b, &res_);
+  in_.clear(); un_.clear(); is_i_aligned_.clear(); is_j_aligned_.clear();
+  EnsureSize(a, b, &in_);
+  EnsureSize(a, b, &un_);
+  is_i_aligned_.resize(res_.width(), false);
+  is_j_aligned_.resize(res_.height(), false);
+  for (unsigned i = 0; i < in_.width(); ++i)
+    for (unsigned j = 0; j < in_.height(); ++j) {
+      un_(i, j) = Safe(a, i, j) || Safe(b, i, j);
+      in_(i, j) = Safe(a, i, j) && Safe(b, i, j);
+      if (in_(i, j)) Align(i, j);
+    }
+}
+
+// "grow" the resulting alignment using the points in adds
+// if they match the constraints determined by pred
+void AlignmentRefiner::Grow(Predicate pred, bool idempotent, const Array2D<bool>& adds) {
+  if (idempotent) {
+    for (unsigned i = 0; i < adds.width(); ++i)
+      for (unsigned j = 0; j < adds.height(); ++j) {
+        if (adds(i, j) && !res_(i, j) &&
+            (this->*pred)(i, j)) Align(i, j);
+      }
+    return;
+  }
+  set<pair<int, int> > p;
+  for (unsigned i = 0; i < adds.width(); ++i)
+    for (unsigned j = 0; j < adds.height(); ++j)
+      if (adds(i, j) && !res_(i, j))
+        p.insert(make_pair(i, j));
+  bool keep_going = !p.empty();
+  while (keep_going) {
+    keep_going = false;
+    set<pair<int, int> > added;
+    for (set<pair<int, int> >::iterator pi = p.begin(); pi != p.end(); ++pi) {
+      if ((this->*pred)(pi->first, pi->second)) {
+        Align(pi->first, pi->second);
+        added.insert(make_pair(pi->first, pi->second));
+        keep_going = true;
+      }
+    }
+    for (set<pair<int, int> >::iterator ai = added.begin(); ai != added.end(); ++ai)
+      p.erase(*ai);
+  }
+}
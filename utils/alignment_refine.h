@@ -0,0 +1,66 @@
+#ifndef ALIGNMENT_REFINE_H_
+#define ALIGNMENT_REFINE_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "array2d.h"
+
+// Symmetrization heuristics that combine two directional word alignments
+// (given as source x target grids) into one (Koehn et al., 2003).  Used by
+// atools and by fast_align when it trains both directions at once.
+class AlignmentRefiner {
+ public:
+  enum Heuristic {
+    kINTERSECT,
+    kUNION,
+    kGROW_DIAG,
+    kGROW_DIAG_FINAL,
+    kGROW_DIAG_FINAL_AND
+  };
+
+  AlignmentRefiner();
+
+  // returns false if name is not one of intersect, union, grow-diag,
+  // grow-diag-final, grow-diag-final-and
+  static bool ParseHeuristic(const std::string& name, Heuristic* h);
+
+  void Refine(Heuristic h, const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x);
+
+ private:
+  typedef bool (AlignmentRefiner::*Predicate)(int i, int j) const;
+
+  static bool Safe(const Array2D<bool>& a, int i, int j) {
+    if (i >= 0 && j >= 0 && i < static_cast<int>(a.width()) && j < static_cast<int>(a.height()))
+      return a(i,j);
+    else
+      return false;
+  }
+  void Align(unsigned i, unsigned j) {
+    res_(i, j) = true;
+    is_i_aligned_[i] = true;
+    is_j_aligned_[j] = true;
+  }
+  bool IsNeighborAligned(int i, int j) const;
+  bool IsNeitherAligned(int i, int j) const {
+    return !(is_i_aligned_[i] || is_j_aligned_[j]);
+  }
+  bool IsOneOrBothUnaligned(int i, int j) const {
+    return !(is_i_aligned_[i] && is_j_aligned_[j]);
+  }
+  bool KoehnAligned(int i, int j) const {
+    return IsOneOrBothUnaligned(i, j) && IsNeighborAligned(i, j);
+  }
+
+  void InitRefine(const Array2D<bool>& a, const Array2D<bool>& b);
+  void Grow(Predicate pred, bool idempotent, const Array2D<bool>& adds);
+
+  Array2D<bool> res_;  // refined alignment
+  Array2D<bool> in_;   // intersection alignment
+  Array2D<bool> un_;   // union alignment
+  std::vector<bool> is_i_aligned_;
+  std::vector<bool> is_j_aligned_;
+  std::vector<std::pair<int,int> > neighbors_;
+};
+
+#endif
@@ -604,6 +604,37 @@ vector<double> ME_Model::classify(ME_Sample& mes) const {
   return vp;
 }
 
+ME_CompiledModel::ME_CompiledModel(const ME_Model& model)
+    : _model(model), _num_classes(model._num_classes) {
+  assert(model._ref_modelp == NULL);
+  _weights.assign(model._featurename_bag.Size() * _num_classes, 0.0);
+  for (int i = 0; i < model._fb.Size(); i++) {
+    const ME_Model::ME_Feature f = model._fb.Feature(i);
+    _weights[f.feature() * _num_classes + f.label()] = model._vl[i];
+  }
+}
+
+void ME_CompiledModel::classify(const vector<int>& features,
+                                vector<double>& membp) const {
+  membp.assign(_num_classes, 0.0);
+  for (vector<int>::const_iterator j = features.begin(); j != features.end();
+       j++) {
+    if (*j < 0) continue;
+    const double* row = &_weights[*j * _num_classes];
+    for (int label = 0; label < _num_classes; label++)
+      membp[label] += row[label];
+  }
+
+  // as in ME_Model::conditional_probability()
+  double offset = max(0.0, *max_element(membp.begin(), membp.end()) - 700);
+  double sum = 0;
+  for (int label = 0; label < _num_classes; label++) {
+    membp[label] = exp(membp[label] - offset);
+    sum += membp[label];
+  }
+  for (int label = 0; label < _num_classes; label++) membp[label] /= sum;
+}
+
 // template<class FuncGrad>
 // std::vector<double>
 // perform_LBFGS(FuncGrad func_grad, const std::vector<double> & x0);
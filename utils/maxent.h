@@ -132,6 +132,8 @@ typedef struct ME_Model_Data {
   double weight;
 } ME_Model_Data;
 
+class ME_CompiledModel;
+
 class ME_Model {
  public:
   void add_training_sample(const ME_Sample& s);
@@ -382,6 +384,36 @@ class ME_Model {
                           std::vector<double>& grad);
   static double FunctionGradientWrapper(const std::vector<double>& x,
                                         std::vector<double>& grad);
+
+  friend class ME_CompiledModel;
+};
+
+//
+// a read-only form of a trained model for classifying many samples:
+// feature names are converted to integer ids once (feature_id()), and the
+// weights are kept in a dense num_features x num_classes matrix, so
+// classifying a sample is one row sum per feature id. The model it was
+// compiled from must outlive it. Reference models are not supported.
+//
+class ME_CompiledModel {
+ public:
+  explicit ME_CompiledModel(const ME_Model& model);
+  int num_classes() const { return _num_classes; }
+  int get_class_id(const std::string& s) const {
+    return _model.get_class_id(s);
+  }
+  // -1 if the model has no weights for s
+  int feature_id(const std::string& s) const {
+    return _model._featurename_bag.Id(s);
+  }
+  // membp[label] = p(label | features); ids of -1 are skipped
+  void classify(const std::vector<int>& features,
+                std::vector<double>& membp) const;
+
+ private:
+  const ME_Model& _model;
+  int _num_classes;
+  std::vector<double> _weights;
 };
 }  // namespace maxent
 
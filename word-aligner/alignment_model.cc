@@ -0,0 +1,164 @@
+#include "alignment_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "da.h"
+
+using namespace std;
+
+void EStep(const ParallelCorpus& corpus,
+           unsigned begin,
+           unsigned end,
+           const TTable& s2t,
+           const EStepParams& p,
+           EStepAccumulator* acc) {
+  vector<double> probs;
+  for (unsigned k = begin; k < end; ++k) {
+    const WordID* src = &corpus.words[corpus.src_begin(k, p.reverse)];
+    const size_t trg_begin = corpus.trg_begin(k, p.reverse);
+    const WordID* trg = &corpus.words[trg_begin];
+    const unsigned src_size = corpus.src_end(k, p.reverse) - corpus.src_begin(k, p.reverse);
+    const unsigned trg_size = corpus.trg_end(k, p.reverse) - trg_begin;
+    probs.resize(src_size + 1);
+    for (unsigned j = 0; j < trg_size; ++j) {
+      const WordID& f_j = trg[j];
+      double sum = 0;
+      double prob_a_i = 1.0 / (src_size + p.use_null);  // uniform (model 1)
+      if (p.use_null) {
+        if (p.favor_diagonal) prob_a_i = p.prob_align_null;
+        probs[0] = s2t.prob(p.kNULL, f_j) * prob_a_i;
+        sum += probs[0];
+      }
+      double az = 0;
+      if (p.favor_diagonal)
+        az = DiagonalAlignment::ComputeZ(j+1, trg_size, src_size, p.diagonal_tension) / p.prob_align_not_null;
+      for (unsigned i = 1; i <= src_size; ++i) {
+        if (p.favor_diagonal)
+          prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg_size, src_size, p.diagonal_tension) / az;
+        probs[i] = s2t.prob(src[i-1], f_j) * prob_a_i;
+        sum += probs[i];
+      }
+      if (p.final_iteration) {
+        if (p.add_viterbi || p.links) {
+          WordID max_i = 0;
+          double max_p = -1;
+          int max_index = -1;
+          if (p.use_null) {
+            max_i = p.kNULL;
+            max_index = 0;
+            max_p = probs[0];
+          }
+          for (unsigned i = 1; i <= src_size; ++i) {
+            if (probs[i] > max_p) {
+              max_index = i;
+              max_p = probs[i];
+              max_i = src[i-1];
+            }
+          }
+          if (p.links) p.links[trg_begin + j] = max_index - 1;
+          if (acc->viterbi.size() <= static_cast<unsigned>(max_i)) acc->viterbi.resize(max_i + 1);
+          acc->viterbi[max_i][f_j] = 1.0;
+        }
+      } else {
+        if (p.use_null) {
+          double count = probs[0] / sum;
+          acc->c0 += count;
+          acc->counts->Increment(p.kNULL, f_j, count);
+        }
+        for (unsigned i = 1; i <= src_size; ++i) {
+          const double pr = probs[i] / sum;
+          acc->counts->Increment(src[i-1], f_j, pr);
+          acc->emp_feat += DiagonalAlignment::Feature(j, i, trg_size, src_size) * pr;
+        }
+      }
+      acc->likelihood += log(sum);
+    }
+  }
+}
+
+namespace {
+
+// runs the E-step of every model on sentences [begin, end)
+void EStepAllModels(const ParallelCorpus& corpus,
+                    unsigned begin,
+                    unsigned end,
+                    const vector<AlignmentModel>& models,
+                    const vector<EStepParams>& params,
+                    vector<EStepAccumulator*> accs) {
+  for (unsigned d = 0; d < models.size(); ++d)
+    EStep(corpus, begin, end, models[d].s2t, params[d], accs[d]);
+}
+
+}  // namespace
+
+void InitAccumulators(vector<AlignmentModel>* models,
+                      unsigned threads,
+                      vector<vector<EStepAccumulator> >* accs) {
+  accs->assign(models->size(), vector<EStepAccumulator>(threads));
+  for (unsigned d = 0; d < models->size(); ++d) {
+    TTable& s2t = (*models)[d].s2t;
+    for (unsigned t = 0; t < threads; ++t) {
+      EStepAccumulator& acc = (*accs)[d][t];
+      if (threads == 1) {
+        acc.counts = &s2t;
+      } else {
+        if (s2t.IsFrozen()) acc.own_counts.InitCountsLike(s2t);
+        acc.counts = &acc.own_counts;
+      }
+    }
+  }
+}
+
+void ParallelEStep(const ParallelCorpus& corpus,
+                   unsigned begin,
+                   unsigned end,
+                   const vector<AlignmentModel>& models,
+                   const vector<EStepParams>& params,
+                   vector<vector<EStepAccumulator> >* accs) {
+  const unsigned threads = (*accs)[0].size();
+  boost::thread_group workers;
+  const unsigned per_thread = (end - begin + threads - 1) / threads;
+  for (unsigned t = 0; t < threads; ++t) {
+    const unsigned b = min(begin + t * per_thread, end);
+    const unsigned e = min(b + per_thread, end);
+    vector<EStepAccumulator*> thread_accs(models.size());
+    for (unsigned d = 0; d < models.size(); ++d) thread_accs[d] = &(*accs)[d][t];
+    if (threads == 1)
+      EStepAllModels(corpus, b, e, models, params, thread_accs);
+    else
+      workers.create_thread(boost::bind(EStepAllModels, boost::cref(corpus), b, e, boost::cref(models), boost::cref(params), thread_accs));
+  }
+  workers.join_all();
+}
+
+void CollectEStep(const vector<EStepAccumulator>& accs, AlignmentModel* model, EStepTotals* totals) {
+  AlignmentModel& m = *model;
+  for (unsigned t = 0; t < accs.size(); ++t) {
+    const EStepAccumulator& acc = accs[t];
+    totals->likelihood += acc.likelihood;
+    totals->c0 += acc.c0;
+    totals->emp_feat += acc.emp_feat;
+    if (acc.counts != &m.s2t) m.s2t += acc.own_counts;
+    if (acc.viterbi.size() > m.s2t_viterbi.size()) m.s2t_viterbi.resize(acc.viterbi.size());
+    for (unsigned i = 0; i < acc.viterbi.size(); ++i)
+      for (auto& v : acc.viterbi[i]) m.s2t_viterbi[i][v.first] = v.second;
+  }
+}
+
+void LinksToGrid(const ParallelCorpus& corpus, unsigned k, bool rev, const int* links, Array2D<bool>* grid) {
+  const size_t src_begin = corpus.src_begin(k, false);
+  const size_t trg_begin = corpus.trg_begin(k, false);
+  grid->clear();
+  grid->resize(corpus.src_end(k, false) - src_begin, corpus.trg_end(k, false) - trg_begin);
+  if (rev) {
+    for (size_t i = src_begin; i < corpus.src_end(k, false); ++i)
+      if (links[i] >= 0) (*grid)(i - src_begin, links[i]) = true;
+  } else {
+    for (size_t j = trg_begin; j < corpus.trg_end(k, false); ++j)
+      if (links[j] >= 0) (*grid)(links[j], j - trg_begin) = true;
+  }
+}
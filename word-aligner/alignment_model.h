@@ -0,0 +1,118 @@
+#ifndef _ALIGNMENT_MODEL_H_
+#define _ALIGNMENT_MODEL_H_
+
+#include <utility>
+#include <vector>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+#include <boost/functional/hash.hpp>
+
+#include "array2d.h"
+#include "ttables.h"
+#include "wordid.h"
+
+// numberized training corpus, read once and kept in memory; sentence k has
+// source words [starts[2k], starts[2k+1]) and target words
+// [starts[2k+1], starts[2k+2]).  In the reverse direction the roles of
+// source and target are swapped.
+struct ParallelCorpus {
+  ParallelCorpus() : starts(1, 0) {}
+  unsigned size() const { return starts.size() / 2; }
+  size_t src_begin(unsigned k, bool rev) const { return starts[2*k + rev]; }
+  size_t src_end(unsigned k, bool rev) const { return starts[2*k + 1 + rev]; }
+  size_t trg_begin(unsigned k, bool rev) const { return starts[2*k + !rev]; }
+  size_t trg_end(unsigned k, bool rev) const { return starts[2*k + 1 + !rev]; }
+  void Add(const std::vector<WordID>& s, const std::vector<WordID>& t) {
+    words.insert(words.end(), s.begin(), s.end());
+    starts.push_back(words.size());
+    words.insert(words.end(), t.begin(), t.end());
+    starts.push_back(words.size());
+  }
+  std::vector<WordID> words;
+  std::vector<size_t> starts;
+};
+
+typedef std::unordered_map<std::pair<short, short>, unsigned, boost::hash<std::pair<short, short> > > SizeCounts;
+
+// parameters and corpus statistics of one alignment direction
+struct AlignmentModel {
+  AlignmentModel(bool rev, double tension) :
+    reverse(rev), diagonal_tension(tension), tot_len_ratio(), mean_srclen_multiplier(), toks() {}
+  bool reverse;
+  TTable s2t;
+  TTable::Word2Word2Double s2t_viterbi;
+  double diagonal_tension;
+  SizeCounts size_counts;
+  double tot_len_ratio;
+  double mean_srclen_multiplier;
+  double toks;
+};
+
+struct EStepParams {
+  bool use_null;
+  bool favor_diagonal;
+  double prob_align_null;
+  double prob_align_not_null;
+  double diagonal_tension;
+  WordID kNULL;
+  bool final_iteration;
+  bool add_viterbi;
+  bool reverse;
+  // during the final iteration, links[t] is set to the source position
+  // target word t (an index into ParallelCorpus::words) is aligned to, or
+  // -1 for the null word
+  int* links;
+};
+
+// per-thread results of the E-step
+struct EStepAccumulator {
+  EStepAccumulator() : counts(), likelihood(), c0(), emp_feat() {}
+  TTable* counts;  // either own_counts or the shared table (single thread)
+  TTable own_counts;
+  double likelihood;
+  double c0;
+  double emp_feat;
+  TTable::Word2Word2Double viterbi;
+};
+
+// E-step totals of one direction, summed over the threads
+struct EStepTotals {
+  EStepTotals() : likelihood(), c0(), emp_feat() {}
+  double likelihood;
+  double c0;
+  double emp_feat;
+};
+
+void EStep(const ParallelCorpus& corpus,
+           unsigned begin,
+           unsigned end,
+           const TTable& s2t,
+           const EStepParams& p,
+           EStepAccumulator* acc);
+
+// sets up accs[d] with one accumulator per thread for models[d]; a single
+// thread counts directly into the model
+void InitAccumulators(std::vector<AlignmentModel>* models,
+                      unsigned threads,
+                      std::vector<std::vector<EStepAccumulator> >* accs);
+
+// runs the E-step of every model on sentences [begin, end), split into one
+// contiguous block per accumulator of accs[d]
+void ParallelEStep(const ParallelCorpus& corpus,
+                   unsigned begin,
+                   unsigned end,
+                   const std::vector<AlignmentModel>& models,
+                   const std::vector<EStepParams>& params,
+                   std::vector<std::vector<EStepAccumulator> >* accs);
+
+// adds the per-thread counts and Viterbi links of accs to model
+void CollectEStep(const std::vector<EStepAccumulator>& accs, AlignmentModel* model, EStepTotals* totals);
+
+// the Viterbi links of one direction for sentence k as a source x target grid
+void LinksToGrid(const ParallelCorpus& corpus, unsigned k, bool rev, const int* links, Array2D<bool>* grid);
+
+#endif
@@ -0,0 +1,196 @@
+#define BOOST_TEST_MODULE AlignmentModelTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include "alignment_io.h"
+#include "alignment_model.h"
+#include "alignment_refine.h"
+#include "corpus_tools.h"
+#include "filelib.h"
+#include "tdict.h"
+
+using namespace std;
+
+namespace {
+
+const char* kBitext[] = {
+  "das haus ist klein ||| the house is small",
+  "das haus ist gross ||| the house is big",
+  "das buch ist klein ||| the book is small",
+  "ein buch ||| a book",
+  "ein haus ||| a house",
+  "das kleine haus ||| the small house",
+  "ich lese das buch ||| i read the book",
+  "ich sehe ein kleines haus ||| i see a small house",
+  "das ist ein buch ||| this is a book",
+  "gross ist das haus nicht ||| the house is not big",
+  "ja ||| yes",
+  "ich ||| i"
+};
+
+void ReadCorpus(ParallelCorpus* corpus) {
+  vector<WordID> src, trg;
+  for (unsigned k = 0; k < sizeof(kBitext) / sizeof(kBitext[0]); ++k) {
+    src.clear(); trg.clear();
+    CorpusTools::ReadLine(kBitext[k], &src, &trg);
+    corpus->Add(src, trg);
+  }
+}
+
+string TestData() {
+  return boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA;
+}
+
+// sets links the way the E-step of the given direction does for sentence k
+void SetLinks(const ParallelCorpus& corpus, unsigned k, bool rev, const string& pharaoh, vector<int>* links) {
+  const boost::shared_ptr<Array2D<bool> > grid = AlignmentIO::ReadPharaohAlignmentGrid(pharaoh);
+  const size_t src_begin = corpus.src_begin(k, false);
+  const size_t trg_begin = corpus.trg_begin(k, false);
+  for (unsigned i = 0; i < grid->width(); ++i)
+    for (unsigned j = 0; j < grid->height(); ++j)
+      if ((*grid)(i, j)) {
+        if (rev)
+          (*links)[src_begin + i] = j;
+        else
+          (*links)[trg_begin + j] = i;
+      }
+}
+
+struct Training {
+  vector<AlignmentModel> models;
+  vector<vector<double> > likelihoods;  // per model and iteration
+  vector<int> links;
+};
+
+// trains Model 1 with the diagonal favoring alignment distribution for
+// iterations passes on threads threads, as fast_align does
+void Train(const ParallelCorpus& corpus, bool bidir, unsigned threads, Training* tr) {
+  const int iterations = 5;
+  tr->models.clear();
+  tr->models.push_back(AlignmentModel(false, 4.0));
+  if (bidir) tr->models.push_back(AlignmentModel(true, 4.0));
+  tr->likelihoods.assign(tr->models.size(), vector<double>());
+  tr->links.assign(corpus.words.size(), -2);
+  for (int iter = 0; iter < iterations; ++iter) {
+    const bool final_iteration = iter == iterations - 1;
+    vector<EStepParams> params(tr->models.size());
+    for (unsigned d = 0; d < tr->models.size(); ++d) {
+      EStepParams& p = params[d];
+      p.use_null = true;
+      p.favor_diagonal = true;
+      p.prob_align_null = 0.08;
+      p.prob_align_not_null = 0.92;
+      p.diagonal_tension = tr->models[d].diagonal_tension;
+      p.kNULL = TD::Convert("<eps>");
+      p.final_iteration = final_iteration;
+      p.add_viterbi = true;
+      p.reverse = tr->models[d].reverse;
+      p.links = final_iteration ? &tr->links[0] : NULL;
+    }
+    vector<vector<EStepAccumulator> > accs;
+    InitAccumulators(&tr->models, threads, &accs);
+    ParallelEStep(corpus, 0, corpus.size(), tr->models, params, &accs);
+    for (unsigned d = 0; d < tr->models.size(); ++d) {
+      EStepTotals totals;
+      CollectEStep(accs[d], &tr->models[d], &totals);
+      tr->likelihoods[d].push_back(totals.likelihood);
+      if (!final_iteration) {
+        tr->models[d].s2t.Normalize();
+        tr->models[d].s2t.Freeze();
+      }
+    }
+  }
+}
+
+void CheckSameTraining(const Training& expected, const Training& actual) {
+  BOOST_REQUIRE_EQUAL(expected.models.size(), actual.models.size());
+  for (unsigned d = 0; d < expected.models.size(); ++d) {
+    BOOST_REQUIRE_EQUAL(expected.likelihoods[d].size(), actual.likelihoods[d].size());
+    for (unsigned i = 0; i < expected.likelihoods[d].size(); ++i)
+      BOOST_CHECK_CLOSE(expected.likelihoods[d][i], actual.likelihoods[d][i], 1e-9);
+    // the likelihood improves, so the E-step does something
+    BOOST_CHECK(expected.likelihoods[d].back() > expected.likelihoods[d].front());
+
+    const TTable& e = expected.models[d].s2t;
+    const TTable& a = actual.models[d].s2t;
+    BOOST_REQUIRE_EQUAL(e.NumRows(), a.NumRows());
+    vector<pair<WordID, double> > erow, arow;
+    unsigned params = 0;
+    for (unsigned w = 0; w < e.NumRows(); ++w) {
+      e.GetRow(w, &erow);
+      a.GetRow(w, &arow);
+      BOOST_REQUIRE_EQUAL(erow.size(), arow.size());
+      for (unsigned k = 0; k < erow.size(); ++k) {
+        BOOST_CHECK_EQUAL(erow[k].first, arow[k].first);
+        BOOST_CHECK_CLOSE(erow[k].second, arow[k].second, 1e-9);
+      }
+      params += erow.size();
+    }
+    BOOST_CHECK(params > 0);
+
+    const TTable::Word2Word2Double& ev = expected.models[d].s2t_viterbi;
+    const TTable::Word2Word2Double& av = actual.models[d].s2t_viterbi;
+    BOOST_REQUIRE_EQUAL(ev.size(), av.size());
+    for (unsigned w = 0; w < ev.size(); ++w)
+      BOOST_CHECK(ev[w] == av[w]);
+  }
+  BOOST_CHECK(expected.links == actual.links);
+}
+
+}  // namespace
+
+// the corpus is split into blocks for the threads and their counts are
+// added up before the M-step, which only changes the order of the sums
+BOOST_AUTO_TEST_CASE(TestThreadedEStepMatchesSingleThread) {
+  ParallelCorpus corpus;
+  ReadCorpus(&corpus);
+  for (unsigned bidir = 0; bidir < 2; ++bidir) {
+    Training single;
+    Train(corpus, bidir, 1, &single);
+    const unsigned kThreads[] = {2, 3, 5};
+    for (unsigned t = 0; t < sizeof(kThreads) / sizeof(kThreads[0]); ++t) {
+      Training threaded;
+      Train(corpus, bidir, kThreads[t], &threaded);
+      CheckSameTraining(single, threaded);
+    }
+  }
+}
+
+// test_data/sym.grow-diag-final-and was written by atools -c
+// grow-diag-final-and from sym.fwd and sym.rev, before the heuristics were
+// shared with fast_align
+BOOST_AUTO_TEST_CASE(TestSymmetrizedLinksMatchAtools) {
+  const string path = TestData();
+  ParallelCorpus corpus;
+  ReadFile bitext(path + "/sym.fr-en");
+  string line;
+  vector<WordID> src, trg;
+  while (getline(*bitext.stream(), line)) {
+    src.clear(); trg.clear();
+    CorpusTools::ReadLine(line, &src, &trg);
+    corpus.Add(src, trg);
+  }
+  BOOST_REQUIRE_EQUAL(7, corpus.size());
+
+  ReadFile fwd(path + "/sym.fwd"), rev(path + "/sym.rev"), gold(path + "/sym.grow-diag-final-and");
+  vector<int> links(corpus.words.size(), -1);
+  AlignmentRefiner refiner;
+  Array2D<bool> fwd_grid, rev_grid, sym_grid;
+  for (unsigned k = 0; k < corpus.size(); ++k) {
+    string fwd_line, rev_line, expected;
+    BOOST_REQUIRE(getline(*fwd.stream(), fwd_line));
+    BOOST_REQUIRE(getline(*rev.stream(), rev_line));
+    BOOST_REQUIRE(getline(*gold.stream(), expected));
+    SetLinks(corpus, k, false, fwd_line, &links);
+    SetLinks(corpus, k, true, rev_line, &links);
+    LinksToGrid(corpus, k, false, &links[0], &fwd_grid);
+    LinksToGrid(corpus, k, true, &links[0], &rev_grid);
+    refiner.Refine(AlignmentRefiner::kGROW_DIAG_FINAL_AND, fwd_grid, rev_grid, &sym_grid);
+    ostringstream actual;
+    AlignmentIO::SerializePharaohFormat(sym_grid, &actual);
+    BOOST_CHECK_EQUAL(expected + "\n", actual.str());
+  }
+}
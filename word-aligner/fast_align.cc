@@ -8,14 +8,20 @@
 namespace std { using std::tr1::unordered_map; }
 #endif
 
+#include <boost/bind.hpp>
 #include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/program_options/variables_map.hpp>
 
 #include "m.h"
 #include "corpus_tools.h"
 #include "stringlib.h"
 #include "filelib.h"
+#include "alignment_io.h"
+#include "alignment_refine.h"
+#include "alignment_model.h"
 #include "ttables.h"
 #include "tdict.h"
 #include "da.h"
@@ -29,7 +35,8 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("input,i",po::value<string>(),"Parallel corpus input file")
         ("reverse,r","Reverse estimation (swap source and target during training)")
         ("iterations,I",po::value<unsigned>()->default_value(5),"Number of iterations of EM training")
-        //("bidir,b", "Run bidirectional alignment")
+        ("bidir,b", "Train both directions in the same passes over the corpus and write symmetrized alignments")
+        ("symmetrize,s",po::value<string>()->default_value("grow-diag-final-and"),"With --bidir, heuristic combining the alignments of both directions: intersect, union, grow-diag, grow-diag-final, grow-diag-final-and")
         ("favor_diagonal,d", "Use a static alignment distribution that assigns higher probabilities to alignments near the diagonal")
         ("prob_align_null", po::value<double>()->default_value(0.08), "When --favor_diagonal is set, what's the probability of a null alignment?")
         ("diagonal_tension,T", po::value<double>()->default_value(4.0), "How sharp or flat around the diagonal is the alignment distribution (<1 = flat >1 = sharp)")
@@ -38,12 +45,16 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("alpha,a", po::value<double>()->default_value(0.01), "Hyperparameter for optional Dirichlet prior")
         ("no_null_word,N","Do not generate from a null token")
         ("output_parameters,p", po::value<string>(), "Write model parameters to file")
+        ("output_reverse_parameters,P", po::value<string>(), "With --bidir, write the parameters of the reverse model to this file")
+        ("binary_parameters,B", "Write parameters in a binary format, which --force_align loads much faster than text")
         ("beam_threshold,t",po::value<double>()->default_value(-4),"When writing parameters, log_10 of beam threshold for writing parameter (-10000 to include everything, 0 max parameter only)")
         ("hide_training_alignments,H", "Hide training alignments (only useful if you want to use -x option and just compute testset statistics)")
         ("testset,x", po::value<string>(), "After training completes, compute the log likelihood of this set of sentence pairs under the learned model")
         ("no_add_viterbi,V","When writing model parameters, do not add Viterbi alignment points (may generate a grammar where some training sentence pairs are unreachable)")
 		("force_align,f",po::value<string>(), "Load previously written parameters to 'force align' input. Set --diagonal_tension and --mean_srclen_multiplier as estimated during training.")
-		("mean_srclen_multiplier,m",po::value<double>()->default_value(1), "When --force_align, use this source length multiplier");
+		("mean_srclen_multiplier,m",po::value<double>()->default_value(1), "When --force_align, use this source length multiplier")
+        ("threads,j",po::value<unsigned>()->default_value(1),"Number of threads used for the E-step and for aligning --testset / --force_align batches")
+        ("batch_size,z",po::value<unsigned>()->default_value(1000),"When --force_align or --testset, align up to this many sentence pairs at a time (taking only lines that are already available, so interactive use is not delayed)");
   po::options_description clo("Command line options");
   clo.add_options()
         ("config", po::value<string>(), "Configuration file")
@@ -67,11 +78,105 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
   return true;
 }
 
+void WriteParameters(const AlignmentModel& model, const string& fname, const double beam_threshold, const bool binary) {
+  TTable pruned;  // collects the parameters for binary output
+  boost::shared_ptr<WriteFile> params_out;
+  if (!binary) params_out.reset(new WriteFile(fname));
+  const TTable& s2t = model.s2t;
+  const TTable::Word2Word2Double& s2t_viterbi = model.s2t_viterbi;
+  const TTable::Word2Double no_viterbi;
+  vector<pair<WordID, double> > cpd;
+  for (unsigned eind = 1; eind < s2t.NumRows(); ++eind) {
+    s2t.GetRow(eind, &cpd);
+    const TTable::Word2Double& vit = eind < s2t_viterbi.size() ? s2t_viterbi[eind] : no_viterbi;
+    const string& esym = TD::Convert(eind);
+    double max_p = -1;
+    for (auto& fi : cpd)
+      if (fi.second > max_p) max_p = fi.second;
+    const double threshold = max_p * beam_threshold;
+    for (auto& fi : cpd) {
+      if (fi.second > threshold || (vit.find(fi.first) != vit.end())) {
+        if (binary) {
+          if (pruned.ttable.size() <= eind) pruned.ttable.resize(eind + 1);
+          pruned.ttable[eind][fi.first] = fi.second;
+        } else {
+          *params_out->stream() << esym << ' ' << TD::Convert(fi.first) << ' ' << log(fi.second) << endl;
+        }
+      }
+    }
+  }
+  if (binary) pruned.WriteBinary(fname);
+}
+
+// a sentence pair of --testset or --force_align, with the result
+struct TestSentence {
+  vector<WordID> src;
+  vector<WordID> trg;
+  string links;  // " i-j" for every word aligned to a source word
+  double log_prob;
+};
+
+// aligns sentences first, first + stride, ... of a batch
+void AlignTestSentences(const TTable& s2t,
+                        const EStepParams& p,
+                        const double mean_srclen_multiplier,
+                        const bool write_alignments,
+                        vector<TestSentence>* batch,
+                        unsigned first,
+                        unsigned stride) {
+  for (unsigned k = first; k < batch->size(); k += stride) {
+    TestSentence& s = (*batch)[k];
+    const vector<WordID>& src = s.src;
+    const vector<WordID>& trg = s.trg;
+    ostringstream links;
+    double log_prob = Md::log_poisson(trg.size(), 0.05 + src.size() * mean_srclen_multiplier);
+
+    // compute likelihood
+    for (unsigned j = 0; j < trg.size(); ++j) {
+      const WordID& f_j = trg[j];
+      double sum = 0;
+      int a_j = 0;
+      double max_pat = 0;
+      double prob_a_i = 1.0 / (src.size() + p.use_null);  // uniform (model 1)
+      if (p.use_null) {
+        if (p.favor_diagonal) prob_a_i = p.prob_align_null;
+        max_pat = s2t.prob(p.kNULL, f_j) * prob_a_i;
+        sum += max_pat;
+      }
+      double az = 0;
+      if (p.favor_diagonal)
+        az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), p.diagonal_tension) / p.prob_align_not_null;
+      for (unsigned i = 1; i <= src.size(); ++i) {
+        if (p.favor_diagonal)
+          prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), p.diagonal_tension) / az;
+        double pat = s2t.prob(src[i-1], f_j) * prob_a_i;
+        if (pat > max_pat) { max_pat = pat; a_j = i; }
+        sum += pat;
+      }
+      log_prob += log(sum);
+      if (write_alignments) {
+        if (a_j > 0) {
+          links << ' ';
+          if (p.reverse)
+            links << j << '-' << (a_j - 1);
+          else
+            links << (a_j - 1) << '-' << j;
+        }
+      }
+    }
+    s.links = links.str();
+    s.log_prob = log_prob;
+  }
+}
+
 int main(int argc, char** argv) {
+  // lets in_avail() see input that is waiting in a pipe
+  ios_base::sync_with_stdio(false);
   po::variables_map conf;
   if (!InitCommandLine(argc, argv, &conf)) return 1;
   const string fname = conf["input"].as<string>();
   const bool reverse = conf.count("reverse") > 0;
+  const bool bidir = conf.count("bidir") > 0;
   const int ITERATIONS = (conf.count("force_align")) ? 0 : conf["iterations"].as<unsigned>();
   const double BEAM_THRESHOLD = pow(10.0, conf["beam_threshold"].as<double>());
   const bool use_null = (conf.count("no_null_word") == 0);
@@ -79,7 +184,7 @@ int main(int argc, char** argv) {
   const bool add_viterbi = (conf.count("no_add_viterbi") == 0);
   const bool variational_bayes = (conf.count("variational_bayes") > 0);
   const bool output_parameters = (conf.count("force_align")) ? false : conf.count("output_parameters");
-  double diagonal_tension = conf["diagonal_tension"].as<double>();
+  const bool binary_parameters = conf.count("binary_parameters") > 0;
   bool optimize_tension = conf.count("optimize_tension");
   bool hide_training_alignments = (conf.count("hide_training_alignments") > 0);
   const bool write_alignments = (conf.count("force_align")) ? true : !hide_training_alignments;
@@ -94,37 +199,52 @@ int main(int argc, char** argv) {
     cerr << "--alpha must be > 0\n";
     return 1;
   }
-  
-  
-  TTable s2t, t2s;
-  TTable::Word2Word2Double s2t_viterbi;
-  unordered_map<pair<short, short>, unsigned, boost::hash<pair<short, short> > > size_counts;
-  double tot_len_ratio = 0;
-  double mean_srclen_multiplier = 0;
-  vector<double> probs;
-  
+  AlignmentRefiner::Heuristic heuristic = AlignmentRefiner::kGROW_DIAG_FINAL_AND;
+  if (bidir) {
+    if (reverse || conf.count("force_align") || testset.size()) {
+      cerr << "--bidir can't be combined with --reverse, --force_align or --testset\n";
+      return 1;
+    }
+    if (!AlignmentRefiner::ParseHeuristic(conf["symmetrize"].as<string>(), &heuristic)) {
+      cerr << "Unknown symmetrization heuristic: " << conf["symmetrize"].as<string>() << endl;
+      return 1;
+    }
+  }
+
+  // models[0] is the model being trained (or loaded); with --bidir,
+  // models[1] is trained in the reverse direction during the same passes
+  vector<AlignmentModel> models;
+  models.push_back(AlignmentModel(reverse, conf["diagonal_tension"].as<double>()));
+  if (bidir) models.push_back(AlignmentModel(true, conf["diagonal_tension"].as<double>()));
+  const unsigned num_models = models.size();
+  TTable& s2t = models[0].s2t;
+  double& diagonal_tension = models[0].diagonal_tension;
+  double& mean_srclen_multiplier = models[0].mean_srclen_multiplier;
+
   if (conf.count("force_align")) {
 	// load model parameters
-	ReadFile s2t_f(conf["force_align"].as<string>());
-	s2t.DeserializeLogProbsFromText(s2t_f.stream());
+	const string params_file = conf["force_align"].as<string>();
+	if (TTable::IsBinaryFile(params_file)) {
+	  s2t.ReadBinary(params_file);
+	} else {
+	  ReadFile s2t_f(params_file);
+	  s2t.DeserializeLogProbsFromText(s2t_f.stream());
+	  s2t.Freeze();
+	}
 	mean_srclen_multiplier = conf["mean_srclen_multiplier"].as<double>();
   }
   
-  for (int iter = 0; iter < ITERATIONS; ++iter) {
-    const bool final_iteration = (iter == (ITERATIONS - 1));
-    cerr << "ITERATION " << (iter + 1) << (final_iteration ? " (FINAL)" : "") << endl;
+  const unsigned max_threads = max(conf["threads"].as<unsigned>(), 1u);
+  const unsigned batch_size = max(conf["batch_size"].as<unsigned>(), 1u);
+  unsigned threads = max_threads;
+  ParallelCorpus corpus;
+  if (ITERATIONS > 0) {
     ReadFile rf(fname);
     istream& in = *rf.stream();
-    double likelihood = 0;
-    double denom = 0.0;
     int lc = 0;
     bool flag = false;
     string line;
-    string ssrc, strg;
     vector<WordID> src, trg;
-    double c0 = 0;
-    double emp_feat = 0;
-    double toks = 0;
     while(true) {
       getline(in, line);
       if (!in) break;
@@ -133,122 +253,138 @@ int main(int argc, char** argv) {
       if (lc %50000 == 0) { cerr << " [" << lc << "]\n" << flush; flag = false; }
       src.clear(); trg.clear();
       CorpusTools::ReadLine(line, &src, &trg);
-      if (reverse) swap(src, trg);
       if (src.size() == 0 || trg.size() == 0) {
         cerr << "Error: " << lc << "\n" << line << endl;
         return 1;
       }
-      if (iter == 0)
-        tot_len_ratio += static_cast<double>(trg.size()) / static_cast<double>(src.size());
-      denom += trg.size();
-      probs.resize(src.size() + 1);
-      if (iter == 0)
-        ++size_counts[make_pair<short,short>(trg.size(), src.size())];
-      bool first_al = true;  // used for write_alignments
-      toks += trg.size();
-      for (unsigned j = 0; j < trg.size(); ++j) {
-        const WordID& f_j = trg[j];
-        double sum = 0;
-        double prob_a_i = 1.0 / (src.size() + use_null);  // uniform (model 1)
-        if (use_null) {
-          if (favor_diagonal) prob_a_i = prob_align_null;
-          probs[0] = s2t.prob(kNULL, f_j) * prob_a_i;
-          sum += probs[0];
-        }
-        double az = 0;
-        if (favor_diagonal)
-          az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), diagonal_tension) / prob_align_not_null;
-        for (unsigned i = 1; i <= src.size(); ++i) {
-          if (favor_diagonal)
-            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), diagonal_tension) / az;
-          probs[i] = s2t.prob(src[i-1], f_j) * prob_a_i;
-          sum += probs[i];
-        }
-        if (final_iteration) {
-          if (add_viterbi || write_alignments) {
-            WordID max_i = 0;
-            double max_p = -1;
-            int max_index = -1;
-            if (use_null) {
-              max_i = kNULL;
-              max_index = 0;
-              max_p = probs[0];
-            }
-            for (unsigned i = 1; i <= src.size(); ++i) {
-              if (probs[i] > max_p) {
-                max_index = i;
-                max_p = probs[i];
-                max_i = src[i-1];
-              }
-            }
-            if (!hide_training_alignments && write_alignments) {
-              if (max_index > 0) {
-                if (first_al) first_al = false; else cout << ' ';
-                if (reverse)
-                  cout << j << '-' << (max_index - 1);
-                else
-                  cout << (max_index - 1) << '-' << j;
-              }
-            }
-            if (s2t_viterbi.size() <= static_cast<unsigned>(max_i)) s2t_viterbi.resize(max_i + 1);
-            s2t_viterbi[max_i][f_j] = 1.0;
-          }
-        } else {
-          if (use_null) {
-            double count = probs[0] / sum;
-            c0 += count;
-            s2t.Increment(kNULL, f_j, count);
+      for (unsigned d = 0; d < num_models; ++d) {
+        AlignmentModel& m = models[d];
+        const double src_size = m.reverse ? trg.size() : src.size();
+        const double trg_size = m.reverse ? src.size() : trg.size();
+        m.tot_len_ratio += trg_size / src_size;
+        ++m.size_counts[make_pair<short,short>(trg_size, src_size)];
+        m.toks += trg_size;
+      }
+      corpus.Add(src, trg);
+    }
+    if (flag) { cerr << endl; }
+    for (unsigned d = 0; d < num_models; ++d) {
+      models[d].mean_srclen_multiplier = models[d].tot_len_ratio / lc;
+      if (bidir) cerr << (d ? "reverse" : "forward") << ": ";
+      cerr << "expected target length = source length * " << models[d].mean_srclen_multiplier << endl;
+    }
+  }
+  if (threads > corpus.size()) threads = max(corpus.size(), 1u);
+  // sentences are processed in chunks so that the alignments of the final
+  // iteration can be written in order without keeping all of them
+  const unsigned kCHUNK = 50000;
+  vector<int> links;
+  AlignmentRefiner refiner;
+  Array2D<bool> fwd_grid, rev_grid, sym_grid;
+
+  for (int iter = 0; iter < ITERATIONS; ++iter) {
+    const bool final_iteration = (iter == (ITERATIONS - 1));
+    cerr << "ITERATION " << (iter + 1) << (final_iteration ? " (FINAL)" : "") << endl;
+    const bool output_alignments = final_iteration && write_alignments && !hide_training_alignments;
+    if (output_alignments) links.resize(corpus.words.size());
+    vector<EStepParams> params(num_models);
+    vector<vector<EStepAccumulator> > accs;
+    InitAccumulators(&models, threads, &accs);
+    for (unsigned d = 0; d < num_models; ++d) {
+      EStepParams& p = params[d];
+      p.use_null = use_null;
+      p.favor_diagonal = favor_diagonal;
+      p.prob_align_null = prob_align_null;
+      p.prob_align_not_null = prob_align_not_null;
+      p.diagonal_tension = models[d].diagonal_tension;
+      p.kNULL = kNULL;
+      p.final_iteration = final_iteration;
+      p.add_viterbi = add_viterbi;
+      p.reverse = models[d].reverse;
+      p.links = output_alignments ? &links[0] : NULL;
+    }
+    bool flag = false;
+    for (unsigned cb = 0; cb < corpus.size(); cb += kCHUNK) {
+      const unsigned ce = min(cb + kCHUNK, corpus.size());
+      ParallelEStep(corpus, cb, ce, models, params, &accs);
+      if (output_alignments) {
+        for (unsigned k = cb; k < ce; ++k) {
+          if (bidir) {
+            LinksToGrid(corpus, k, false, &links[0], &fwd_grid);
+            LinksToGrid(corpus, k, true, &links[0], &rev_grid);
+            refiner.Refine(heuristic, fwd_grid, rev_grid, &sym_grid);
+            AlignmentIO::SerializePharaohFormat(sym_grid, &cout);
+            continue;
           }
-          for (unsigned i = 1; i <= src.size(); ++i) {
-            const double p = probs[i] / sum;
-            s2t.Increment(src[i-1], f_j, p);
-            emp_feat += DiagonalAlignment::Feature(j, i, trg.size(), src.size()) * p;
+          const size_t trg_begin = corpus.trg_begin(k, reverse);
+          const size_t trg_end = corpus.trg_end(k, reverse);
+          bool first_al = true;
+          for (size_t j = trg_begin; j < trg_end; ++j) {
+            if (links[j] < 0) continue;
+            if (first_al) first_al = false; else cout << ' ';
+            if (reverse)
+              cout << (j - trg_begin) << '-' << links[j];
+            else
+              cout << links[j] << '-' << (j - trg_begin);
           }
+          cout << endl;
         }
-        likelihood += log(sum);
       }
-      if (write_alignments && final_iteration && !hide_training_alignments) cout << endl;
+      cerr << '.'; flag = true;
     }
+    if (flag) { cerr << endl; }
 
-    // log(e) = 1.0
-    double base2_likelihood = likelihood / log(2);
+    for (unsigned d = 0; d < num_models; ++d) {
+      AlignmentModel& m = models[d];
+      EStepTotals totals;
+      CollectEStep(accs[d], &m, &totals);
+      const double likelihood = totals.likelihood;
+      const double c0 = totals.c0;
+      double emp_feat = totals.emp_feat;
 
-    if (flag) { cerr << endl; }
-    if (iter == 0) {
-      mean_srclen_multiplier = tot_len_ratio / lc;
-      cerr << "expected target length = source length * " << mean_srclen_multiplier << endl;
-    }
-    emp_feat /= toks;
-    cerr << "  log_e likelihood: " << likelihood << endl;
-    cerr << "  log_2 likelihood: " << base2_likelihood << endl;
-    cerr << "     cross entropy: " << (-base2_likelihood / denom) << endl;
-    cerr << "        perplexity: " << pow(2.0, -base2_likelihood / denom) << endl;
-    cerr << "      posterior p0: " << c0 / toks << endl;
-    cerr << " posterior al-feat: " << emp_feat << endl;
-    //cerr << "     model tension: " << mod_feat / toks << endl;
-    cerr << "       size counts: " << size_counts.size() << endl;
-    if (!final_iteration) {
-      if (favor_diagonal && optimize_tension && iter > 0) {
-        for (int ii = 0; ii < 8; ++ii) {
-          double mod_feat = 0;
-          unordered_map<pair<short,short>,unsigned,boost::hash<pair<short, short> > >::iterator it = size_counts.begin();
-          for(; it != size_counts.end(); ++it) {
-            const pair<short,short>& p = it->first;
-            for (short j = 1; j <= p.first; ++j)
-              mod_feat += it->second * DiagonalAlignment::ComputeDLogZ(j, p.first, p.second, diagonal_tension);
+      // log(e) = 1.0
+      double base2_likelihood = likelihood / log(2);
+      const double toks = m.toks;
+      const double denom = toks;
+
+      emp_feat /= toks;
+      if (bidir) cerr << (d ? " REVERSE" : " FORWARD") << endl;
+      cerr << "  log_e likelihood: " << likelihood << endl;
+      cerr << "  log_2 likelihood: " << base2_likelihood << endl;
+      cerr << "     cross entropy: " << (-base2_likelihood / denom) << endl;
+      cerr << "        perplexity: " << pow(2.0, -base2_likelihood / denom) << endl;
+      cerr << "      posterior p0: " << c0 / toks << endl;
+      cerr << " posterior al-feat: " << emp_feat << endl;
+      //cerr << "     model tension: " << mod_feat / toks << endl;
+      cerr << "       size counts: " << m.size_counts.size() << endl;
+      if (!final_iteration) {
+        if (favor_diagonal && optimize_tension && iter > 0) {
+          for (int ii = 0; ii < 8; ++ii) {
+            double mod_feat = 0;
+            SizeCounts::iterator it = m.size_counts.begin();
+            for(; it != m.size_counts.end(); ++it) {
+              const pair<short,short>& p = it->first;
+              for (short j = 1; j <= p.first; ++j)
+                mod_feat += it->second * DiagonalAlignment::ComputeDLogZ(j, p.first, p.second, m.diagonal_tension);
+            }
+            mod_feat /= toks;
+            cerr << "  " << ii + 1 << "  model al-feat: " << mod_feat << " (tension=" << m.diagonal_tension << ")\n";
+            m.diagonal_tension += (emp_feat - mod_feat) * 20.0;
+            if (m.diagonal_tension <= 0.1) m.diagonal_tension = 0.1;
+            if (m.diagonal_tension > 14) m.diagonal_tension = 14;
           }
-          mod_feat /= toks;
-          cerr << "  " << ii + 1 << "  model al-feat: " << mod_feat << " (tension=" << diagonal_tension << ")\n";
-          diagonal_tension += (emp_feat - mod_feat) * 20.0;
-          if (diagonal_tension <= 0.1) diagonal_tension = 0.1;
-          if (diagonal_tension > 14) diagonal_tension = 14;
+          cerr << "     final tension: " << m.diagonal_tension << endl;
         }
-        cerr << "     final tension: " << diagonal_tension << endl;
+        if (variational_bayes)
+          m.s2t.NormalizeVB(alpha);
+        else
+          m.s2t.Normalize();
+        // every co-occurring pair has been seen in the first iteration, so
+        // the set of parameters doesn't change any more
+        m.s2t.Freeze();
       }
-      if (variational_bayes)
-        s2t.NormalizeVB(alpha);
-      else
-        s2t.Normalize();
+    }
+    if (!final_iteration) {
       //prob_align_null *= 0.8; // XXX
       //prob_align_null += (c0 / toks) * 0.2;
       prob_align_not_null = 1.0 - prob_align_null;
@@ -257,73 +393,53 @@ int main(int argc, char** argv) {
   if (testset.size()) {
     ReadFile rf(testset);
     istream& in = *rf.stream();
-    int lc = 0;
     double tlp = 0;
     string line;
-    while (getline(in, line)) {
-      ++lc;
-      vector<WordID> src, trg;
-      CorpusTools::ReadLine(line, &src, &trg);
-      cout << TD::GetString(src) << " ||| " << TD::GetString(trg) << " |||";
-      if (reverse) swap(src, trg);
-      double log_prob = Md::log_poisson(trg.size(), 0.05 + src.size() * mean_srclen_multiplier);
-
-      // compute likelihood
-      for (unsigned j = 0; j < trg.size(); ++j) {
-        const WordID& f_j = trg[j];
-        double sum = 0;
-        int a_j = 0;
-        double max_pat = 0;
-        double prob_a_i = 1.0 / (src.size() + use_null);  // uniform (model 1)
-        if (use_null) {
-          if (favor_diagonal) prob_a_i = prob_align_null;
-          max_pat = s2t.prob(kNULL, f_j) * prob_a_i;
-          sum += max_pat;
-        }
-        double az = 0;
-        if (favor_diagonal)
-          az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), diagonal_tension) / prob_align_not_null;
-        for (unsigned i = 1; i <= src.size(); ++i) {
-          if (favor_diagonal)
-            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), diagonal_tension) / az;
-          double pat = s2t.prob(src[i-1], f_j) * prob_a_i;
-          if (pat > max_pat) { max_pat = pat; a_j = i; }
-          sum += pat;
-        }
-        log_prob += log(sum);
-        if (write_alignments) {
-          if (a_j > 0) {
-            cout << ' ';
-            if (reverse)
-              cout << j << '-' << (a_j - 1);
-            else
-              cout << (a_j - 1) << '-' << j;
-          }
-        }
+    EStepParams params;
+    params.use_null = use_null;
+    params.favor_diagonal = favor_diagonal;
+    params.prob_align_null = prob_align_null;
+    params.prob_align_not_null = prob_align_not_null;
+    params.diagonal_tension = diagonal_tension;
+    params.kNULL = kNULL;
+    params.reverse = reverse;
+    vector<TestSentence> batch;
+    vector<string> prefixes;
+    while (true) {
+      // a batch is one line plus whatever has already arrived, so pairs sent
+      // one at a time through a pipe are answered immediately
+      batch.clear();
+      prefixes.clear();
+      while (batch.size() < batch_size && (batch.empty() || in.rdbuf()->in_avail() > 0) && getline(in, line)) {
+        batch.resize(batch.size() + 1);
+        TestSentence& s = batch.back();
+        CorpusTools::ReadLine(line, &s.src, &s.trg);
+        prefixes.push_back(TD::GetString(s.src) + " ||| " + TD::GetString(s.trg) + " |||");
+        if (reverse) swap(s.src, s.trg);
+      }
+      if (batch.empty()) break;
+      const unsigned batch_threads = min<unsigned>(max_threads, batch.size());
+      if (batch_threads == 1) {
+        AlignTestSentences(s2t, params, mean_srclen_multiplier, write_alignments, &batch, 0, 1);
+      } else {
+        boost::thread_group workers;
+        for (unsigned t = 0; t < batch_threads; ++t)
+          workers.create_thread(boost::bind(AlignTestSentences, boost::cref(s2t), boost::cref(params), mean_srclen_multiplier, write_alignments, &batch, t, batch_threads));
+        workers.join_all();
       }
-      tlp += log_prob;
-      cout << " ||| " << log_prob << endl << flush;
+      for (unsigned k = 0; k < batch.size(); ++k) {
+        tlp += batch[k].log_prob;
+        cout << prefixes[k] << batch[k].links << " ||| " << batch[k].log_prob << '\n';
+      }
+      cout << flush;
     } // loop over test set sentences
     cerr << "TOTAL LOG PROB " << tlp << endl;
   }
 
   if (output_parameters) {
-    WriteFile params_out(conf["output_parameters"].as<string>());
-    for (unsigned eind = 1; eind < s2t.ttable.size(); ++eind) {
-      const auto& cpd = s2t.ttable[eind];
-      const TTable::Word2Double& vit = s2t_viterbi[eind];
-      const string& esym = TD::Convert(eind);
-      double max_p = -1;
-      for (auto& fi : cpd)
-        if (fi.second > max_p) max_p = fi.second;
-      const double threshold = max_p * BEAM_THRESHOLD;
-      for (auto& fi : cpd) {
-        if (fi.second > threshold || (vit.find(fi.first) != vit.end())) {
-          *params_out << esym << ' ' << TD::Convert(fi.first) << ' ' << log(fi.second) << endl;
-        }
-      } 
-    }
+    WriteParameters(models[0], conf["output_parameters"].as<string>(), BEAM_THRESHOLD, binary_parameters);
+    if (bidir && conf.count("output_reverse_parameters"))
+      WriteParameters(models[1], conf["output_reverse_parameters"].as<string>(), BEAM_THRESHOLD, binary_parameters);
   }
   return 0;
 }
-
@@ -1,6 +1,9 @@
 #include "ttables.h"
 
 #include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdint.h>
 
 #include "dict.h"
 
@@ -38,6 +41,177 @@ void TTable::DeserializeLogProbsFromText(std::istream* in) {
   cerr << "Loaded " << c << " translation parameters.\n";
 }
 
+void TTable::Freeze() {
+  if (layout_) return;
+  boost::shared_ptr<Layout> layout(new Layout);
+  layout->rows.resize(ttable.size() + 1);
+  unsigned nnz = 0;
+  for (unsigned e = 0; e < ttable.size(); ++e) {
+    layout->rows[e] = nnz;
+    nnz += ttable[e].size();
+  }
+  layout->rows[ttable.size()] = nnz;
+  layout->cols.resize(nnz);
+  probs_.resize(nnz);
+  vector<pair<WordID, double> > row;
+  for (unsigned e = 0; e < ttable.size(); ++e) {
+    row.assign(ttable[e].begin(), ttable[e].end());
+    sort(row.begin(), row.end());
+    for (unsigned k = 0; k < row.size(); ++k) {
+      layout->cols[layout->rows[e] + k] = row[k].first;
+      probs_[layout->rows[e] + k] = row[k].second;
+    }
+  }
+  layout_ = layout;
+  flat_counts_.assign(nnz, 0.0);
+  Word2Word2Double().swap(ttable);
+  Word2Word2Double old_counts;
+  old_counts.swap(counts);
+  for (unsigned e = 0; e < old_counts.size(); ++e)
+    for (auto p : old_counts[e]) IncrementFrozen(e, p.first, p.second);
+}
+
+// binary t-table layout: BinaryHeader, double probs[nnz],
+// uint32 rows[num_words + 1], uint32 cols[nnz], then the num_words words as
+// NUL-terminated strings.  Rows and columns are indices into this
+// vocabulary, which is sorted by WordID when the file is written.
+static const char kBinaryMagic[8] = { 'F', 'A', 'T', 'T', 'B', 'I', 'N', '1' };
+
+struct BinaryHeader {
+  char magic[8];
+  uint64_t num_words;
+  uint64_t nnz;
+  uint64_t vocab_bytes;
+};
+
+bool TTable::IsBinaryFile(const string& fname) {
+  ifstream in(fname.c_str(), ios::binary);
+  char magic[sizeof(kBinaryMagic)];
+  return in.read(magic, sizeof(magic)) && memcmp(magic, kBinaryMagic, sizeof(magic)) == 0;
+}
+
+void TTable::WriteBinary(const string& fname) const {
+  vector<vector<pair<WordID, double> > > rows(NumRows());
+  vector<WordID> vocab;
+  for (unsigned e = 0; e < rows.size(); ++e) {
+    GetRow(e, &rows[e]);
+    if (rows[e].empty()) continue;
+    sort(rows[e].begin(), rows[e].end());
+    vocab.push_back(e);
+    for (unsigned k = 0; k < rows[e].size(); ++k)
+      vocab.push_back(rows[e][k].first);
+  }
+  sort(vocab.begin(), vocab.end());
+  vocab.erase(unique(vocab.begin(), vocab.end()), vocab.end());
+  vector<uint32_t> local(vocab.empty() ? 0 : vocab.back() + 1);
+  for (unsigned l = 0; l < vocab.size(); ++l) local[vocab[l]] = l;
+
+  BinaryHeader header;
+  memcpy(header.magic, kBinaryMagic, sizeof(kBinaryMagic));
+  header.num_words = vocab.size();
+  string words;
+  vector<double> probs;
+  vector<uint32_t> row_starts(1, 0);
+  vector<uint32_t> cols;
+  for (unsigned l = 0; l < vocab.size(); ++l) {
+    words += TD::Convert(vocab[l]);
+    words += '\0';
+    if (static_cast<unsigned>(vocab[l]) < rows.size()) {
+      const vector<pair<WordID, double> >& row = rows[vocab[l]];
+      for (unsigned k = 0; k < row.size(); ++k) {
+        cols.push_back(local[row[k].first]);
+        probs.push_back(row[k].second);
+      }
+    }
+    row_starts.push_back(cols.size());
+  }
+  header.nnz = cols.size();
+  header.vocab_bytes = words.size();
+
+  ofstream out(fname.c_str(), ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (header.nnz)
+    out.write(reinterpret_cast<const char*>(&probs[0]), probs.size() * sizeof(double));
+  out.write(reinterpret_cast<const char*>(&row_starts[0]), row_starts.size() * sizeof(uint32_t));
+  if (header.nnz)
+    out.write(reinterpret_cast<const char*>(&cols[0]), cols.size() * sizeof(uint32_t));
+  out.write(words.data(), words.size());
+  if (!out) {
+    cerr << "Failed to write translation table to " << fname << endl;
+    abort();
+  }
+}
+
+void TTable::ReadBinary(const string& fname) {
+  ifstream in(fname.c_str(), ios::binary);
+  BinaryHeader header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      memcmp(header.magic, kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+    cerr << fname << " is not a binary translation table\n";
+    abort();
+  }
+  vector<double> probs(header.nnz);
+  vector<uint32_t> row_starts(header.num_words + 1);
+  vector<uint32_t> cols(header.nnz);
+  string words(header.vocab_bytes, '\0');
+  if (header.nnz) in.read(reinterpret_cast<char*>(&probs[0]), probs.size() * sizeof(double));
+  in.read(reinterpret_cast<char*>(&row_starts[0]), row_starts.size() * sizeof(uint32_t));
+  if (header.nnz) in.read(reinterpret_cast<char*>(&cols[0]), cols.size() * sizeof(uint32_t));
+  if (header.vocab_bytes) in.read(&words[0], words.size());
+  if (!in) {
+    cerr << "Truncated translation table " << fname << endl;
+    abort();
+  }
+
+  // the WordIDs of this process generally differ from those of the writer
+  vector<WordID> ids(header.num_words);
+  WordID max_id = -1;
+  size_t pos = 0;
+  for (unsigned l = 0; l < ids.size(); ++l) {
+    const size_t end = words.find('\0', pos);
+    assert(end != string::npos);
+    ids[l] = TD::Convert(words.substr(pos, end - pos));
+    if (ids[l] > max_id) max_id = ids[l];
+    pos = end + 1;
+  }
+  vector<int> local(max_id + 1, -1);
+  for (unsigned l = 0; l < ids.size(); ++l) local[ids[l]] = l;
+
+  boost::shared_ptr<Layout> layout(new Layout);
+  layout->rows.resize(max_id + 2);
+  layout->cols.resize(header.nnz);
+  probs_.resize(header.nnz);
+  unsigned n = 0;
+  vector<pair<WordID, double> > row;
+  for (WordID e = 0; e <= max_id; ++e) {
+    layout->rows[e] = n;
+    if (local[e] < 0) continue;
+    const unsigned b = row_starts[local[e]], end = row_starts[local[e] + 1];
+    bool sorted = true;
+    for (unsigned k = b; k < end; ++k, ++n) {
+      layout->cols[n] = ids[cols[k]];
+      probs_[n] = probs[k];
+      if (k > b && layout->cols[n] < layout->cols[n - 1]) sorted = false;
+    }
+    if (!sorted) {
+      const unsigned rb = layout->rows[e];
+      row.clear();
+      for (unsigned k = rb; k < n; ++k) row.push_back(make_pair(layout->cols[k], probs_[k]));
+      sort(row.begin(), row.end());
+      for (unsigned k = rb; k < n; ++k) {
+        layout->cols[k] = row[k - rb].first;
+        probs_[k] = row[k - rb].second;
+      }
+    }
+  }
+  layout->rows[max_id + 1] = n;
+  layout_ = layout;
+  flat_counts_.assign(n, 0.0);
+  Word2Word2Double().swap(ttable);
+  Word2Word2Double().swap(counts);
+  cerr << "Loaded " << n << " translation parameters.\n";
+}
+
 void TTable::SerializeHelper(string* out, const Word2Word2Double& o) {
   assert(!"not implemented");
 }
@@ -2,25 +2,38 @@
 #define _TTABLES_H_
 
 #include <iostream>
+#include <string>
 #include <vector>
+#include <algorithm>
 #ifndef HAVE_OLD_CPP
 # include <unordered_map>
 #else
 # include <tr1/unordered_map>
 namespace std { using std::tr1::unordered_map; }
 #endif
+#include <boost/shared_ptr.hpp>
 
 #include "sparse_vector.h"
 #include "m.h"
 #include "wordid.h"
 #include "tdict.h"
 
+// Translation table p(f|e).  Parameters start out in hash maps, so that new
+// (e,f) pairs can be added while counting the first EM iteration.  Freeze()
+// then fixes the set of pairs and moves probabilities and counts into flat
+// arrays sorted by (e,f) (compressed sparse rows), which are faster to look
+// up and cheap to copy as per-thread count accumulators.
 class TTable {
  public:
   TTable() {}
   typedef std::unordered_map<WordID, double> Word2Double;
   typedef std::vector<Word2Double> Word2Word2Double;
+
   inline double prob(const int& e, const int& f) const {
+    if (layout_) {
+      const int k = Index(e, f);
+      return k < 0 ? 1e-9 : probs_[k];
+    }
     if (e < static_cast<int>(ttable.size())) {
       const Word2Double& cpd = ttable[e];
       const Word2Double::const_iterator it = cpd.find(f);
@@ -31,14 +44,29 @@ class TTable {
     }
   }
   inline void Increment(const int& e, const int& f) {
+    if (layout_) { IncrementFrozen(e, f, 1.0); return; }
     if (e >= static_cast<int>(ttable.size())) counts.resize(e + 1);
     counts[e][f] += 1.0;
   }
   inline void Increment(const int& e, const int& f, double x) {
+    if (layout_) { IncrementFrozen(e, f, x); return; }
     if (e >= static_cast<int>(counts.size())) counts.resize(e + 1);
     counts[e][f] += x;
   }
   void NormalizeVB(const double alpha) {
+    if (layout_) {
+      for (unsigned e = 0; e + 1 < layout_->rows.size(); ++e) {
+        const unsigned b = layout_->rows[e], end = layout_->rows[e + 1];
+        double tot = 0;
+        for (unsigned k = b; k < end; ++k)
+          tot += flat_counts_[k] + alpha;
+        if (!tot) tot = 1;
+        for (unsigned k = b; k < end; ++k)
+          probs_[k] = exp(Md::digamma(flat_counts_[k] + alpha) - Md::digamma(tot));
+      }
+      std::fill(flat_counts_.begin(), flat_counts_.end(), 0.0);
+      return;
+    }
     ttable.swap(counts);
     for (unsigned i = 0; i < ttable.size(); ++i) {
       double tot = 0;
@@ -52,6 +80,19 @@ class TTable {
     counts.clear();
   }
   void Normalize() {
+    if (layout_) {
+      for (unsigned e = 0; e + 1 < layout_->rows.size(); ++e) {
+        const unsigned b = layout_->rows[e], end = layout_->rows[e + 1];
+        double tot = 0;
+        for (unsigned k = b; k < end; ++k)
+          tot += flat_counts_[k];
+        if (!tot) tot = 1;
+        for (unsigned k = b; k < end; ++k)
+          probs_[k] = flat_counts_[k] / tot;
+      }
+      std::fill(flat_counts_.begin(), flat_counts_.end(), 0.0);
+      return;
+    }
     ttable.swap(counts);
     for (unsigned i = 0; i < ttable.size(); ++i) {
       double tot = 0;
@@ -66,6 +107,16 @@ class TTable {
   }
   // adds counts from another TTable - probabilities remain unchanged
   TTable& operator+=(const TTable& rhs) {
+    if (layout_) {
+      if (rhs.layout_ == layout_) {
+        for (unsigned k = 0; k < flat_counts_.size(); ++k)
+          flat_counts_[k] += rhs.flat_counts_[k];
+      } else {
+        for (unsigned i = 0; i < rhs.counts.size(); ++i)
+          for (auto p : rhs.counts[i]) IncrementFrozen(i, p.first, p.second);
+      }
+      return *this;
+    }
     if (rhs.counts.size() > counts.size()) counts.resize(rhs.counts.size());
     for (unsigned i = 0; i < rhs.counts.size(); ++i) {
       const Word2Double& cpd = rhs.counts[i];
@@ -74,15 +125,49 @@ class TTable {
     }
     return *this;
   }
+
+  // fixes the current set of (e,f) pairs with a probability; counts for
+  // other pairs are dropped from then on
+  void Freeze();
+  bool IsFrozen() const { return static_cast<bool>(layout_); }
+  // makes this an empty count accumulator with the pairs of a frozen table
+  void InitCountsLike(const TTable& model) {
+    layout_ = model.layout_;
+    probs_.clear();
+    flat_counts_.assign(model.flat_counts_.size(), 0.0);
+    ttable.clear();
+    counts.clear();
+  }
+
+  // the parameters of e, in both modes
+  unsigned NumRows() const { return layout_ ? layout_->rows.size() - 1 : ttable.size(); }
+  void GetRow(const WordID e, std::vector<std::pair<WordID, double> >* row) const {
+    row->clear();
+    if (layout_) {
+      if (e + 1 >= static_cast<int>(layout_->rows.size())) return;
+      for (unsigned k = layout_->rows[e]; k < layout_->rows[e + 1]; ++k)
+        row->push_back(std::make_pair(layout_->cols[k], probs_[k]));
+    } else if (e < static_cast<int>(ttable.size())) {
+      row->assign(ttable[e].begin(), ttable[e].end());
+    }
+  }
+
   void ShowTTable() const {
-    for (unsigned it = 0; it < ttable.size(); ++it) {
-      const Word2Double& cpd = ttable[it];
-      for (auto& p : cpd) {
+    std::vector<std::pair<WordID, double> > row;
+    for (unsigned it = 0; it < NumRows(); ++it) {
+      GetRow(it, &row);
+      for (auto& p : row) {
         std::cerr << "c(" << TD::Convert(p.first) << '|' << TD::Convert(it) << ") = " << p.second << std::endl;
       }
     }
   }
   void ShowCounts() const {
+    if (layout_) {
+      for (unsigned it = 0; it + 1 < layout_->rows.size(); ++it)
+        for (unsigned k = layout_->rows[it]; k < layout_->rows[it + 1]; ++k)
+          std::cerr << "c(" << TD::Convert(layout_->cols[k]) << '|' << TD::Convert(it) << ") = " << flat_counts_[k] << std::endl;
+      return;
+    }
     for (unsigned it = 0; it < counts.size(); ++it) {
       const Word2Double& cpd = counts[it];
       for (auto& p : cpd) {
@@ -92,13 +177,42 @@ class TTable {
   }
   void DeserializeProbsFromText(std::istream* in);
   void DeserializeLogProbsFromText(std::istream* in);
+  // binary format: the frozen arrays with the words stored by string, so a
+  // table can be loaded with a few bulk reads instead of being parsed
+  static bool IsBinaryFile(const std::string& fname);
+  void WriteBinary(const std::string& fname) const;
+  // leaves the table frozen
+  void ReadBinary(const std::string& fname);
   void SerializeCounts(std::string* out) const { SerializeHelper(out, counts); }
   void DeserializeCounts(const std::string& in) { DeserializeHelper(in, &counts); }
   void SerializeProbs(std::string* out) const { SerializeHelper(out, ttable); }
   void DeserializeProbs(const std::string& in) { DeserializeHelper(in, &ttable); }
  private:
+  struct Layout {
+    std::vector<unsigned> rows;  // row e is cols[rows[e]] .. cols[rows[e+1]-1]
+    std::vector<WordID> cols;    // sorted within each row
+  };
+
+  inline int Index(const int e, const int f) const {
+    if (e < 0 || e + 1 >= static_cast<int>(layout_->rows.size())) return -1;
+    const unsigned b = layout_->rows[e], end = layout_->rows[e + 1];
+    if (b == end) return -1;
+    const WordID* cols = &layout_->cols[0];
+    const WordID* it = std::lower_bound(cols + b, cols + end, f);
+    if (it == cols + end || *it != f) return -1;
+    return it - cols;
+  }
+  inline void IncrementFrozen(const int e, const int f, double x) {
+    const int k = Index(e, f);
+    if (k >= 0) flat_counts_[k] += x;
+  }
+
   static void SerializeHelper(std::string*, const Word2Word2Double& o);
   static void DeserializeHelper(const std::string&, Word2Word2Double* o);
+
+  boost::shared_ptr<const Layout> layout_;
+  std::vector<double> probs_;
+  std::vector<double> flat_counts_;
  public:
   Word2Word2Double ttable;
   Word2Word2Double counts;
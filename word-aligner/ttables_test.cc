@@ -0,0 +1,107 @@
+#define BOOST_TEST_MODULE TTableTest
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include "tdict.h"
+#include "ttables.h"
+
+using namespace std;
+
+namespace {
+
+// a temporary file name that is removed at the end of the test
+struct TempFile {
+  TempFile() {
+    char name[] = "/tmp/ttables_test.XXXXXX";
+    const int fd = mkstemp(name);
+    BOOST_REQUIRE(fd >= 0);
+    close(fd);
+    this->name = name;
+  }
+  ~TempFile() { remove(name.c_str()); }
+  string name;
+};
+
+string Contents(const string& fname) {
+  ifstream in(fname.c_str(), ios::binary);
+  return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+// p(f|e) for a few words, including the null word, a row with a single
+// entry and probabilities that text output would round
+void MakeTable(TTable* t) {
+  const char* kEntries[][2] = {
+    {"<eps>", "der"}, {"<eps>", "ja"},
+    {"house", "haus"}, {"house", "hauses"}, {"house", "das"},
+    {"the", "das"}, {"the", "der"}, {"the", "die"}, {"the", "dem"},
+    {"small", "klein"},
+    {"über-all", "überall"}, {"über-all", "a|b"}
+  };
+  const unsigned n = sizeof(kEntries) / sizeof(kEntries[0]);
+  for (unsigned i = 0; i < n; ++i) {
+    const WordID e = TD::Convert(kEntries[i][0]);
+    if (e >= static_cast<int>(t->ttable.size())) t->ttable.resize(e + 1);
+    t->ttable[e][TD::Convert(kEntries[i][1])] = 1.0 / (3 + i) + 1e-13 * i;
+  }
+}
+
+void CheckSameTable(const TTable& expected, const TTable& actual) {
+  vector<pair<WordID, double> > erow, arow;
+  unsigned params = 0;
+  for (unsigned e = 0; e < max(expected.NumRows(), actual.NumRows()); ++e) {
+    expected.GetRow(e, &erow);
+    actual.GetRow(e, &arow);
+    sort(erow.begin(), erow.end());
+    sort(arow.begin(), arow.end());
+    BOOST_REQUIRE_EQUAL(erow.size(), arow.size());
+    for (unsigned k = 0; k < erow.size(); ++k) {
+      BOOST_CHECK_EQUAL(TD::Convert(erow[k].first), TD::Convert(arow[k].first));
+      BOOST_CHECK_EQUAL(erow[k].second, arow[k].second);
+      BOOST_CHECK_EQUAL(erow[k].second, actual.prob(e, erow[k].first));
+    }
+    params += erow.size();
+  }
+  BOOST_CHECK_EQUAL(12, params);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestBinaryRoundTrip) {
+  TTable table;
+  MakeTable(&table);
+  TempFile unfrozen_file, frozen_file;
+  table.WriteBinary(unfrozen_file.name);
+  table.Freeze();
+  table.WriteBinary(frozen_file.name);
+  // the same parameters are written the same way in both layouts
+  BOOST_CHECK(Contents(unfrozen_file.name) == Contents(frozen_file.name));
+  BOOST_CHECK(TTable::IsBinaryFile(frozen_file.name));
+
+  TTable read;
+  read.ReadBinary(frozen_file.name);
+  BOOST_CHECK(read.IsFrozen());
+  CheckSameTable(table, read);
+  BOOST_CHECK_EQUAL(1e-9, read.prob(TD::Convert("small"), TD::Convert("haus")));
+  BOOST_CHECK_EQUAL(1e-9, read.prob(TD::Convert("unseen"), TD::Convert("haus")));
+
+  // and writing it again gives the same file
+  TempFile again;
+  read.WriteBinary(again.name);
+  BOOST_CHECK(Contents(frozen_file.name) == Contents(again.name));
+}
+
+BOOST_AUTO_TEST_CASE(TestTextIsNotBinary) {
+  TempFile text;
+  {
+    ofstream out(text.name.c_str());
+    out << "house haus -0.1\n";
+  }
+  BOOST_CHECK(!TTable::IsBinaryFile(text.name));
+}